@@ -1,26 +1,30 @@
 #include "EventBucket.h"
+#include <typeinfo>
 
 unsigned long EventBucket::m_GlobalMTime = 1;
 
 EventBucket::EventBucket()
 {
   m_MTime = m_GlobalMTime++;
+  m_Size = 0;
+
+  // Enough room for the events a model usually gets between updates
+  m_Bucket.reserve(16);
 }
 
 EventBucket::~EventBucket()
 {
-  Clear();
+  for(BucketIt it = m_Bucket.begin(); it != m_Bucket.end(); ++it)
+    {
+    delete(it->Event);
+    }
 }
 
 void EventBucket::Clear()
 {
+  // The event objects are kept for reuse
   m_Lock.Lock();
-  // Remove all the event objects
-  for(BucketIt it = m_Bucket.begin(); it != m_Bucket.end(); ++it)
-    {
-    delete(it->first);
-    }
-  m_Bucket.clear();
+  m_Size = 0;
   m_Lock.Unlock();
 
   m_MTime = m_GlobalMTime++;
@@ -30,12 +34,10 @@ bool EventBucket::HasEvent(const itk::EventObject &evt, const itk::Object *sourc
 {
   m_Lock.Lock();
   // Search for the event. Buckets are never too large so a linear search is fine
-  for(BucketIt it = m_Bucket.begin(); it != m_Bucket.end(); ++it)
+  for(unsigned int i = 0; i < m_Size; i++)
     {
-    const BucketEntry &entry = *it;
-    std::string echeck = evt.GetEventName();
-    std::string eentry = entry.first->GetEventName();
-    if(evt.CheckEvent(entry.first) && (source == NULL || source == entry.second))
+    const BucketEntry &entry = m_Bucket[i];
+    if(evt.CheckEvent(entry.Event) && (source == NULL || source == entry.Source))
       {
       m_Lock.Unlock();
       return true;
@@ -48,33 +50,58 @@ bool EventBucket::HasEvent(const itk::EventObject &evt, const itk::Object *sourc
 
 bool EventBucket::IsEmpty() const
 {
-  return m_Bucket.size() == 0;
+  return m_Size == 0;
 }
 
 void EventBucket::PutEvent(const itk::EventObject &evt, const itk::Object *source)
 {
-  if(!this->HasEvent(evt, source))
+  m_Lock.Lock();
+
+  // Coalesce with an event of the same type from the same source
+  for(unsigned int i = 0; i < m_Size; i++)
+    {
+    const BucketEntry &entry = m_Bucket[i];
+    if(entry.Source == source && typeid(*entry.Event) == typeid(evt))
+      {
+      m_Lock.Unlock();
+      return;
+      }
+    }
+
+  // Reuse the next entry if it holds an event of the same type. Events carry
+  // no data, so any object of the right type will do
+  if(m_Size == m_Bucket.size())
     {
     BucketEntry entry;
-    entry.first = evt.MakeObject();
-    entry.second = source;
-    m_Lock.Lock();
-    m_Bucket.insert(entry);
-    m_Lock.Unlock();
-    m_MTime = m_GlobalMTime++;
+    entry.Event = evt.MakeObject();
+    entry.Source = source;
+    m_Bucket.push_back(entry);
+    }
+  else
+    {
+    BucketEntry &entry = m_Bucket[m_Size];
+    if(typeid(*entry.Event) != typeid(evt))
+      {
+      delete entry.Event;
+      entry.Event = evt.MakeObject();
+      }
+    entry.Source = source;
     }
+
+  m_Size++;
+  m_Lock.Unlock();
+  m_MTime = m_GlobalMTime++;
 }
 
 std::ostream& operator<<(std::ostream& sink, const EventBucket& eb)
 {
   sink << "EventBucket[";
-  for(EventBucket::BucketIt it = eb.m_Bucket.begin(); it != eb.m_Bucket.end();)
+  for(unsigned int i = 0; i < eb.m_Size; i++)
     {
-    sink << it->first->GetEventName() << "(" << it->second << ")";
-    if(++it != eb.m_Bucket.end())
+    if(i > 0)
       sink << ", ";
+    sink << eb.m_Bucket[i].Event->GetEventName() << "(" << eb.m_Bucket[i].Source << ")";
     }
   sink << "]";
   return sink;
 }
-
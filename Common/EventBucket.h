@@ -3,7 +3,7 @@
 
 #include "SNAPEvents.h"
 #include "itkSimpleFastMutexLock.h"
-#include <set>
+#include <vector>
 #include <iostream>
 
 namespace itk
@@ -15,8 +15,11 @@ class Object;
   A simple 'bucket' that stores events. You can easily add events to
   the bucket and check if events are present there.
 
-  TODO: the bucket should keep track of objects that fired the event,
-  not only the event types!
+  The bucket holds at most one event of each type from each source, so
+  during a drag, when the same events are fired over and over, it stays
+  small and PutEvent() does not allocate anything. Events are kept in a
+  flat array, and the copies of the events are kept when the bucket is
+  cleared so they can be reused the next time the bucket is filled.
   */
 class EventBucket
 {
@@ -27,7 +30,8 @@ public:
   virtual ~EventBucket();
 
   /**
-   * @brief Add an event to the bucket.
+   * @brief Add an event to the bucket, unless the bucket already has an
+   * event of the same type from the same source.
    */
   void PutEvent(const itk::EventObject &evt, const itk::Object *source);
 
@@ -51,14 +55,22 @@ protected:
 
   /**
    * The bucket entry consists of a pointer to the event, which the
-   * bucket owns and destroys when it is destroyed or cleared, and the
+   * bucket owns and destroys when it is destroyed, and the
    * pointer to the originator the event.
    */
-  typedef std::pair<itk::EventObject *, const itk::Object *> BucketEntry;
-  typedef std::set<BucketEntry> BucketType;
+  struct BucketEntry
+  {
+    itk::EventObject *Event;
+    const itk::Object *Source;
+  };
+
+  typedef std::vector<BucketEntry> BucketType;
   typedef BucketType::iterator BucketIt;
 
+  // The first m_Size entries are in the bucket. The entries after them hold
+  // events from earlier, which are reused
   BucketType m_Bucket;
+  unsigned int m_Size;
   itk::SimpleFastMutexLock m_Lock;
 
   /** Each bucket has a unique id. This allows code to check whether or not
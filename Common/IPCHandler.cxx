@@ -3,6 +3,7 @@
 #include <cstring>
 #include <iostream>
 #include <cerrno>
+#include <algorithm>
 
 using namespace std;
 
@@ -24,6 +25,13 @@ using namespace std;
   #include <unistd.h>
   #include <signal.h>
   #include <sys/time.h>
+  #include <time.h>
+#endif
+
+#ifdef __linux__
+  #include <climits>
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
 #endif
 
 void IPCHandler::Attach(const char *path, short version, size_t message_size)
@@ -33,12 +41,17 @@ void IPCHandler::Attach(const char *path, short version, size_t message_size)
 
   // Store the size of the actual message
   m_MessageSize = message_size;
+  m_Buffer.resize(message_size);
 
   // Save the protocol version
   m_ProtocolVersion = version;
 
+  // Each slot holds a message, and is padded to a multiple of 64 bytes so
+  // that writers to different slots do not share cache lines
+  m_SlotSize = ((sizeof(Slot) + message_size + 63) / 64) * 64;
+
   // Determine size of shared memory
-  size_t msize = message_size + sizeof(Header);
+  size_t msize = sizeof(Header) + IPC_RING_SIZE * m_SlotSize;
 
 #ifdef WIN32
   // Create a shared memory block (key based on the preferences file)
@@ -74,7 +87,7 @@ void IPCHandler::Attach(const char *path, short version, size_t message_size)
     m_SharedData = shmat(m_Handle, (void *) 0, 0);
 
     // Check errors again
-    if(!m_SharedData)
+    if(m_SharedData == (void *) -1)
       {
       cerr << "Shared memory (shmat) error: " << strerror(errno) << endl;
       cerr << "Multisession support is disabled" << endl;
@@ -84,38 +97,79 @@ void IPCHandler::Attach(const char *path, short version, size_t message_size)
 
 #endif
 
-  // Set the user data pointer
   if(m_SharedData)
     {
-    Header *hptr = static_cast<Header *>(m_SharedData);
-    m_UserData = static_cast<void *>(hptr + 1);
-    }
-  else
-    {
-    m_UserData = NULL;
+    // The first session to attach sets the version and message size, and
+    // the sessions that attach later must agree with them
+    Header *header = static_cast<Header *>(m_SharedData);
+    int hversion = 0, hsize = 0;
+    header->version.compare_exchange_strong(hversion, (int) m_ProtocolVersion);
+    header->message_size.compare_exchange_strong(hsize, (int) m_MessageSize);
+    if((hversion != 0 && hversion != m_ProtocolVersion)
+       || (hsize != 0 && hsize != (int) m_MessageSize))
+      {
+      cerr << "Shared memory is used by an incompatible version of ITK-SNAP" << endl;
+      cerr << "Multisession support is disabled" << endl;
+      this->Close();
+      return;
+      }
+
+    // The most recent message counts as new, so that this session picks up
+    // the state of the other sessions
+    unsigned int head = header->head.load(std::memory_order_acquire);
+    m_NextMessage = head ? head - 1 : 0;
     }
 }
 
+IPCHandler::Slot *IPCHandler::GetSlot(unsigned int t)
+{
+  char *slots = static_cast<char *>(m_SharedData) + sizeof(Header);
+  return reinterpret_cast<Slot *>(slots + (t % IPC_RING_SIZE) * m_SlotSize);
+}
+
+bool IPCHandler::ReadSlot(unsigned int t, long &sender_pid, long &message_id)
+{
+  // The slot must hold the complete message t before and after copying
+  Slot *slot = this->GetSlot(t);
+  unsigned int seq = slot->seq.load(std::memory_order_acquire);
+  if(seq != 2 * t + 2)
+    return false;
+
+  sender_pid = slot->sender_pid;
+  message_id = slot->message_id;
+  memcpy(&m_Buffer[0], slot + 1, m_MessageSize);
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
 bool IPCHandler::Read(void *target_ptr)
 {
   // Must have some shared memory
   if(!m_SharedData)
     return false;
 
-  // Read the header, make sure it's the right version number
+  // Find the most recent complete message in the ring
   Header *header = static_cast<Header *>(m_SharedData);
-  if(header->version != m_ProtocolVersion)
-    return false;
+  unsigned int head = header->head.load(std::memory_order_acquire);
+  for(unsigned int k = 0; k < IPC_RING_SIZE && k < head; k++)
+    {
+    long sender, id;
+    if(this->ReadSlot(head - 1 - k, sender, id))
+      {
+      // Store the last sender / id
+      m_LastSender = sender;
+      m_LastReceivedMessageID = id;
 
-  // Store the last sender / id
-  m_LastSender = header->sender_pid;
-  m_LastReceivedMessageID = header->message_id;
+      // Copy the message to the target pointer
+      memcpy(target_ptr, &m_Buffer[0], m_MessageSize);
 
-  // Copy the message to the target pointer
-  memcpy(target_ptr, m_UserData, m_MessageSize);
+      // Success!
+      return true;
+      }
+    }
 
-  // Success!
-  return true;
+  return false;
 }
 
 bool IPCHandler::IsProcessRunning(int pid)
@@ -139,39 +193,51 @@ bool IPCHandler::ReadIfNew(void *target_ptr)
   if(!m_SharedData)
     return false;
 
-  // Read the header, make sure it's the right version number
+  // Check for messages that have not been looked at yet
   Header *header = static_cast<Header *>(m_SharedData);
-  if(header->version != m_ProtocolVersion)
-    return false;
+  unsigned int head = header->head.load(std::memory_order_acquire);
+  unsigned int n_new = std::min(head - m_NextMessage, (unsigned int) IPC_RING_SIZE);
+  m_NextMessage = head;
 
-  // Ignore our own messages
-  if(header->sender_pid == m_ProcessID)
-    return false;
+  // Find the most recent complete message among them. Older messages have
+  // been overtaken by it
+  for(unsigned int k = 0; k < n_new; k++)
+    {
+    long sender, id;
+    if(!this->ReadSlot(head - 1 - k, sender, id))
+      continue;
 
-  // If we have already seen this message from this sender, also ignore it
-  if(m_LastSender == header->sender_pid && m_LastReceivedMessageID == header->message_id)
-    return false;
+    // Ignore our own messages
+    if(sender == m_ProcessID)
+      return false;
 
-  // If the PID is known to be dead, ignore it
-  if(m_KnownDeadPIDs.find(header->sender_pid) != m_KnownDeadPIDs.end())
-    return false;
+    // If we have already seen this message from this sender, also ignore it
+    if(m_LastSender == sender && m_LastReceivedMessageID == id)
+      return false;
 
-  // Check if this is a dead PID
-  if(!this->IsProcessRunning(header->sender_pid))
-    {
-    m_KnownDeadPIDs.insert(header->sender_pid);
-    return false;
-    }
+    // If the PID is known to be dead, ignore it
+    if(m_KnownDeadPIDs.find(sender) != m_KnownDeadPIDs.end())
+      return false;
 
-  // Store the last sender / id
-  m_LastSender = header->sender_pid;
-  m_LastReceivedMessageID = header->message_id;
+    // Check if this is a dead PID
+    if(!this->IsProcessRunning(sender))
+      {
+      m_KnownDeadPIDs.insert(sender);
+      return false;
+      }
+
+    // Store the last sender / id
+    m_LastSender = sender;
+    m_LastReceivedMessageID = id;
 
-  // Copy the message to the target pointer
-  memcpy(target_ptr, m_UserData, m_MessageSize);
+    // Copy the message to the target pointer
+    memcpy(target_ptr, &m_Buffer[0], m_MessageSize);
+
+    // Success!
+    return true;
+    }
 
-  // Success!
-  return true;
+  return false;
 }
 
 
@@ -182,18 +248,34 @@ IPCHandler
   // Write to the shared memory
   if(m_SharedData)
     {
-    // Access the message header
+    // Claim the next slot in the ring
     Header *header = static_cast<Header *>(m_SharedData);
+    unsigned int t = header->reserved.fetch_add(1);
+    Slot *slot = this->GetSlot(t);
+
+    // Mark the slot as being written, so readers do not use a torn copy
+    slot->seq.store(2 * t + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Write the process ID and the message contents
+    slot->sender_pid = m_ProcessID;
+    slot->message_id = ++m_MessageID;
+    memcpy(slot + 1, message_ptr, m_MessageSize);
+
+    // Mark the slot as complete
+    slot->seq.store(2 * t + 2, std::memory_order_release);
+
+    // Publish the message. The head only moves forward, in case another
+    // session has published a later slot already
+    unsigned int head = header->head.load();
+    while((int) (t + 1 - head) > 0
+          && !header->head.compare_exchange_weak(head, t + 1))
+      {
+      }
 
-    // Write version number
-    header->version = m_ProtocolVersion;
-
-    // Write the process ID
-    header->sender_pid = m_ProcessID;
-    header->message_id = ++m_MessageID;
-
-    // Copy the message contents into the shared memory
-    memcpy(m_UserData, message_ptr, m_MessageSize);
+    // Wake up the sessions waiting for messages
+    if(header->waiters.load() > 0)
+      this->WakeWaiters();
 
     // Done
     return true;
@@ -202,9 +284,84 @@ IPCHandler
   return false;
 }
 
+unsigned int IPCHandler::GetMessageCounter()
+{
+  if(!m_SharedData)
+    return 0;
+
+  Header *header = static_cast<Header *>(m_SharedData);
+  return header->head.load(std::memory_order_acquire);
+}
+
+bool IPCHandler::WaitForMessage(unsigned int &last_seen, int timeout_ms)
+{
+  // Without shared memory, just let the time pass
+  if(!m_SharedData)
+    {
+#ifdef WIN32
+    Sleep(timeout_ms);
+#else
+    usleep(timeout_ms * 1000);
+#endif
+    return false;
+    }
+
+  Header *header = static_cast<Header *>(m_SharedData);
+  unsigned int head = header->head.load(std::memory_order_acquire);
+  if(head == last_seen)
+    {
+#ifdef __linux__
+    // Sleep until a writer wakes us up. The kernel checks that the head is
+    // still the same before sleeping, so a message sent in between is not
+    // missed
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    header->waiters.fetch_add(1);
+    syscall(SYS_futex, reinterpret_cast<unsigned int *>(&header->head),
+            FUTEX_WAIT, head, &ts, NULL, 0);
+    header->waiters.fetch_sub(1);
+#else
+    // Check for messages at intervals that grow while the sessions are idle,
+    // so that a waiting session does not keep waking up for nothing
+    int waited = 0;
+    while(waited < timeout_ms
+          && header->head.load(std::memory_order_acquire) == last_seen)
+      {
+      int interval = std::min(m_PollInterval, timeout_ms - waited);
+#ifdef WIN32
+      Sleep(interval);
+#else
+      usleep(interval * 1000);
+#endif
+      waited += interval;
+      m_PollInterval = std::min(2 * m_PollInterval, (int) IPC_POLL_MAX_INTERVAL_MS);
+      }
+#endif
+    head = header->head.load(std::memory_order_acquire);
+    }
+
+  // Check frequently again while messages are coming in
+  bool changed = (head != last_seen);
+  if(changed)
+    m_PollInterval = IPC_POLL_MIN_INTERVAL_MS;
+  last_seen = head;
+  return changed;
+}
+
+void IPCHandler::WakeWaiters()
+{
+#ifdef __linux__
+  Header *header = static_cast<Header *>(m_SharedData);
+  syscall(SYS_futex, reinterpret_cast<unsigned int *>(&header->head),
+          FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
 void IPCHandler::Close()
 {
 #ifdef WIN32
+  UnmapViewOfFile(m_SharedData);
   CloseHandle(m_Handle);
 #else
   // Detach from the shared memory segment
@@ -227,9 +384,12 @@ IPCHandler::IPCHandler()
   m_LastReceivedMessageID = -1;
   m_LastSender = -1;
   m_MessageID = 0;
+  m_NextMessage = 0;
 
   // Reset the shared memory
   m_SharedData = NULL;
+  m_MessageSize = m_SlotSize = 0;
+  m_PollInterval = IPC_POLL_MIN_INTERVAL_MS;
 
   // Get the process ID
 #ifdef WIN32
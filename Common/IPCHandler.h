@@ -2,11 +2,22 @@
 #define IPCHANDLER_H
 
 #include <cstddef>
+#include <atomic>
 #include <set>
+#include <vector>
 
 /**
  * Base class for IPCHandler. This class contains the definitions of the
  * core methods and is independent of the data structure being shared.
+ *
+ * The shared memory holds a ring of the most recent messages. Each slot in
+ * the ring is protected by a sequence lock, so a reader never sees a message
+ * that is being written by another session: it either gets a complete copy
+ * or moves on to an older message in the ring. Sessions that want to react to
+ * messages as soon as they are sent, rather than by polling, can block in
+ * WaitForMessage() in a helper thread. On Linux this sleeps on a futex in the
+ * shared memory; elsewhere it checks for new messages at intervals that grow
+ * while no messages arrive, and shrink again once they do.
  */
 class IPCHandler
 {
@@ -31,30 +42,90 @@ public:
   /** Whether the shared memory is attached */
   bool IsAttached() { return m_SharedData != NULL; }
 
-  /** Read a 'message', i.e., the contents of shared memory */
+  /** Read a 'message', i.e., the most recent complete message in shared memory */
   bool Read(void *target_ptr);
 
-  /** Read a 'message' but only if it has not been seen before */
+  /**
+   * Read a 'message' but only if it has not been seen before. If several
+   * messages have been sent since the last call, only the most recent one is
+   * read, since each message carries the complete shared state.
+   */
   bool ReadIfNew(void *target_ptr);
 
-  /** Broadcast a 'message' (i.e. replace shared memory contents */
+  /** Broadcast a 'message' (i.e. add it to the shared memory ring) */
   bool Broadcast(const void *message_ptr);
 
+  /** The number of messages broadcast so far by all sessions */
+  unsigned int GetMessageCounter();
+
+  /**
+   * Block until the message counter differs from last_seen, or until the
+   * timeout expires. Returns true if there are new messages (which may include
+   * this session's own messages) and updates last_seen. This method may be
+   * called from a different thread than the other methods, but the shared
+   * memory must not be closed while it is running.
+   */
+  bool WaitForMessage(unsigned int &last_seen, int timeout_ms);
+
 protected:
 
+  // Header of the shared memory block, followed by the slots of the ring.
+  // Fields are zero until the first session attaches
   struct Header
   {
-    short version;
+    // Version of the protocol and size of the message
+    std::atomic<int> version;
+    std::atomic<int> message_size;
+
+    // Number of messages published so far. Sessions waiting for messages
+    // sleep on this value
+    std::atomic<unsigned int> head;
+
+    // Number of slots handed out to writers, ahead of head while writing
+    std::atomic<unsigned int> reserved;
+
+    // Number of sessions waiting in WaitForMessage()
+    std::atomic<int> waiters;
+  };
+
+  // Header of a slot in the ring, followed by the message. The sequence is
+  // 2t+1 while message number t is written to the slot and 2t+2 once done
+  struct Slot
+  {
+    std::atomic<unsigned int> seq;
     long sender_pid;
     long message_id;
   };
 
+  // Number of slots in the ring
+  enum { IPC_RING_SIZE = 16 };
+
+  // Shortest and longest intervals at which WaitForMessage checks for
+  // messages without a futex. The interval doubles after each check that
+  // finds nothing, and is reset when a message arrives
+  enum { IPC_POLL_MIN_INTERVAL_MS = 5, IPC_POLL_MAX_INTERVAL_MS = 100 };
+
+  // Get the slot used by message number t
+  Slot *GetSlot(unsigned int t);
+
+  // Copy message number t to the buffer, failing if the slot does not hold a
+  // complete copy of that message
+  bool ReadSlot(unsigned int t, long &sender_pid, long &message_id);
+
+  // Wake up the sessions waiting for messages
+  void WakeWaiters();
 
   // Shared data pointer
-  void *m_SharedData, *m_UserData;
+  void *m_SharedData;
+
+  // Size of the shared data message, and of each slot in the ring
+  size_t m_MessageSize, m_SlotSize;
 
-  // Size of the shared data message
-  size_t m_MessageSize;
+  // Local copy of a message being read
+  std::vector<char> m_Buffer;
+
+  // Current interval at which WaitForMessage checks for messages
+  int m_PollInterval;
 
   // Version of the protocol (to avoid problems with older code)
   short m_ProtocolVersion;
@@ -74,6 +145,9 @@ protected:
   // Process ID and other values used by IPC
   long m_ProcessID, m_MessageID, m_LastSender, m_LastReceivedMessageID;
 
+  // Number of the first message that has not been looked at by ReadIfNew
+  unsigned int m_NextMessage;
+
   bool IsProcessRunning(int pid);
 
   // List of known process ids, with status (0 = alive, -1 = dead)
@@ -2,9 +2,12 @@
 #include "SNAPEventListenerCallbacks.h"
 #include "SNAPCommon.h"
 #include "EventBucket.h"
+#include <vector>
+#include <algorithm>
 
 Rebroadcaster::DispatchMap Rebroadcaster::m_SourceMap;
 Rebroadcaster::DispatchMap Rebroadcaster::m_TargetMap;
+Rebroadcaster::EventCountMap Rebroadcaster::m_RetiredEventCounts;
 
 unsigned long Rebroadcaster
 ::Rebroadcast(itk::Object *source, const itk::EventObject &sourceEvent,
@@ -90,6 +93,55 @@ unsigned long Rebroadcaster
   return Rebroadcast(source, sourceEvent, target, RefireEvent(), bucket);
 }
 
+void Rebroadcaster::GetEventCounts(EventCountMap &counts)
+{
+  counts = m_RetiredEventCounts;
+
+  // Every live association is in the list of its source
+  for(DispatchMap::const_iterator itmap = m_SourceMap.begin();
+      itmap != m_SourceMap.end(); ++itmap)
+    {
+    const AssociationList &l = itmap->second;
+    for(AssociationList::const_iterator it = l.begin(); it != l.end(); ++it)
+      {
+      if((*it)->m_EventCount)
+        counts[(*it)->m_TargetObjectName] += (*it)->m_EventCount;
+      }
+    }
+}
+
+void Rebroadcaster::ResetEventCounts()
+{
+  m_RetiredEventCounts.clear();
+  for(DispatchMap::iterator itmap = m_SourceMap.begin();
+      itmap != m_SourceMap.end(); ++itmap)
+    {
+    AssociationList &l = itmap->second;
+    for(AssociationIterator it = l.begin(); it != l.end(); ++it)
+      (*it)->m_EventCount = 0;
+    }
+}
+
+void Rebroadcaster::PrintEventCounts(std::ostream &sout)
+{
+  EventCountMap counts;
+  GetEventCounts(counts);
+
+  // Sort the classes by the number of events
+  std::vector<std::pair<unsigned long, std::string> > sorted;
+  unsigned long total = 0;
+  for(EventCountMap::const_iterator it = counts.begin(); it != counts.end(); ++it)
+    {
+    sorted.push_back(std::make_pair(it->second, it->first));
+    total += it->second;
+    }
+  std::sort(sorted.rbegin(), sorted.rend());
+
+  sout << "REBROADCAST event counts (" << total << " events)" << std::endl;
+  for(unsigned int i = 0; i < sorted.size(); i++)
+    sout << "  " << sorted[i].second << " : " << sorted[i].first << std::endl;
+}
+
 void Rebroadcaster::DeleteTargetCallback(
     itk::Object *target, const itk::EventObject &evt, void *cd)
 {
@@ -189,11 +241,15 @@ Rebroadcaster::Association::Association(
   // Are we refiring the source event or firing the target event?
   m_RefireSource = Rebroadcaster::RefireEvent().CheckEvent(m_TargetEvent);
 
-
+  m_EventCount = 0;
 }
 
 Rebroadcaster::Association::~Association()
 {
+  // Keep the event count of the target object's class
+  if(m_EventCount)
+    Rebroadcaster::m_RetiredEventCounts[m_TargetObjectName] += m_EventCount;
+
   delete m_TargetEvent;
 }
 
@@ -206,6 +262,7 @@ void Rebroadcaster::Association::ConstCallback(const itk::Object *source, const
 {
   // Decide what to do
   const itk::EventObject *firedEvent = m_RefireSource ? &evt : m_TargetEvent;
+  m_EventCount++;
 
 #ifdef SNAP_DEBUG_EVENTS
   if(flag_snap_debug_events)
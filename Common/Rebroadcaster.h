@@ -4,6 +4,8 @@
 #include <map>
 #include <set>
 #include <list>
+#include <string>
+#include <iostream>
 #include <itkObject.h>
 #include <itkEventObject.h>
 
@@ -34,6 +36,10 @@ class EventBucket;
  * target object from the source object will be added to the EventBucket. This
  * way, the target object (or another interested party) can keep track of what
  * events, and from whom, were rebroadcast.
+ *
+ * Every rebroadcast is counted, and the counts can be listed by the class of
+ * the target object (usually a UI model) to see which models fire the most
+ * events. With --debug-events, ITK-SNAP prints these counts on exit.
  */
 class Rebroadcaster
 {
@@ -64,6 +70,22 @@ public:
       itk::Object *source, const itk::EventObject &sourceEvent,
       itk::Object *target, EventBucket *bucket = NULL);
 
+  /** Number of events rebroadcast by objects of each class */
+  typedef std::map<std::string, unsigned long> EventCountMap;
+
+  /**
+   * Get the number of events rebroadcast since the start of the program (or
+   * since the last call to ResetEventCounts) by the target objects of each
+   * class, including objects that have since been deleted.
+   */
+  static void GetEventCounts(EventCountMap &counts);
+
+  /** Set all the event counts to zero */
+  static void ResetEventCounts();
+
+  /** Print the event counts, from the class with the most events down */
+  static void PrintEventCounts(std::ostream &sout);
+
 protected:
 
   // We define our own event type RefireEvent which is used to indicate that
@@ -94,6 +116,10 @@ protected:
     const char *m_SourceObjectName, *m_TargetObjectName;
 
     bool m_RefireSource;
+
+    // Number of events rebroadcast through this association. Not locked,
+    // the counts are only meant to give an idea of the event volume
+    unsigned long m_EventCount;
   };
 
   static void DeleteSourceCallback(
@@ -111,6 +137,9 @@ protected:
   typedef std::map<const itk::Object *, AssociationList> DispatchMap;
 
   static DispatchMap m_SourceMap, m_TargetMap;
+
+  // Event counts of the associations that have been deleted
+  static EventCountMap m_RetiredEventCounts;
 };
 
 #endif // REBROADCASTER_H
@@ -34,13 +34,16 @@
 =========================================================================*/
 #include "Registry.h"
 #include "IRISVectorTypes.h"
-#include "itkXMLFile.h"
 
 #include <stdio.h>
 #include <cstdlib>
 #include <cstdarg>
+#include <cstring>
+#include <cctype>
 #include <fstream>
 #include <iomanip>
+#include <mutex>
+#include <unordered_map>
 #include "itksys/SystemTools.hxx"
 #include "IRISException.h"
 
@@ -52,111 +55,377 @@ using namespace std;
 
 
 
-/** Reader for XML files */
-class RegistryXMLFileReader : public itk::XMLReader<Registry>
+/**
+ * A pull parser for the XML files written by Registry. The caller asks for
+ * the next element boundary and the file is read in blocks as needed, so no
+ * document tree is built. Only the subset of XML that appears in registry
+ * files is supported: elements with attributes, comments, processing
+ * instructions, CDATA and a DOCTYPE declaration with an internal subset,
+ * which are skipped along with any character data. Element and attribute
+ * names are converted to lower case, and attribute values are decoded and
+ * normalized the same way as by expat, which was used to read these files
+ * before.
+ */
+class RegistryXMLPullParser
 {
 public:
+  enum TokenType { START_ELEMENT, END_ELEMENT, END_OF_DOCUMENT };
+
+  RegistryXMLPullParser(istream &sin)
+    : m_Stream(sin), m_Buffer(0x10000), m_Pos(0), m_End(0), m_Line(1),
+      m_NumAttributes(0), m_Depth(0), m_PendingEnd(false), m_RootClosed(false) {}
 
-  irisITKObjectMacro(RegistryXMLFileReader, itk::XMLReader<Registry>)
+  /**
+   * Read up to the next element boundary. An empty element <x/> is reported
+   * as a START_ELEMENT followed by an END_ELEMENT.
+   */
+  TokenType Next();
 
-protected:
+  /** Name of the current element */
+  const string &GetName() const { return m_Name; }
 
-  RegistryXMLFileReader() {}
+  /** Value of an attribute of the current start element, or NULL */
+  const string *GetAttribute(const char *name) const
+  {
+    for(size_t i = 0; i < m_NumAttributes; i++)
+      if(m_AttrNames[i] == name)
+        return &m_AttrValues[i];
+    return NULL;
+  }
 
-  virtual int CanReadFile(const char *name) ITK_OVERRIDE;
-  virtual void StartElement(const char *name, const char **atts) ITK_OVERRIDE;
-  virtual void EndElement(const char *name) ITK_OVERRIDE;
-  virtual void CharacterDataHandler(const char *inData, int inLength) ITK_OVERRIDE;
+private:
 
-  static int strcmpi(const char *str1, const char *str2)
+  int Peek()
   {
-    return itksys::SystemTools::Strucmp(str1, str2);
+    if(m_Pos == m_End && !Fill())
+      return EOF;
+    return (unsigned char) m_Buffer[m_Pos];
   }
 
-  // The folder stack
-  std::list<Registry *> m_FolderStack;
+  int Get()
+  {
+    if(m_Pos == m_End && !Fill())
+      return EOF;
+    char c = m_Buffer[m_Pos++];
+    if(c == '\n')
+      m_Line++;
+    return (unsigned char) c;
+  }
+
+  bool Fill()
+  {
+    m_Stream.read(&m_Buffer[0], m_Buffer.size());
+    m_End = (size_t) m_Stream.gcount();
+    m_Pos = 0;
+    return m_End > 0;
+  }
+
+  void Fail(const char *message)
+  {
+    throw IRISException("Problem parsing Registry XML file at line %d: %s",
+                        m_Line, message);
+  }
+
+  void Expect(int c)
+  {
+    if(Get() != c)
+      Fail("unexpected character");
+  }
+
+  void SkipSpace()
+  {
+    int c;
+    while((c = Peek()) == ' ' || c == '\t' || c == '\n' || c == '\r')
+      Get();
+  }
+
+  void SkipPast(const char *terminator);
+  void SkipMarkupDeclaration();
+  void ReadName(string &name);
+  void ReadAttributeValue(int quote, string &value);
+  void ReadEntity(string &value);
+
+  istream &m_Stream;
+  vector<char> m_Buffer;
+  size_t m_Pos, m_End;
+  int m_Line;
+
+  // Name and attributes of the current element. The strings are reused from
+  // element to element so that parsing does not allocate memory once they
+  // have grown to the longest name and value
+  string m_Name;
+  vector<string> m_AttrNames, m_AttrValues;
+  size_t m_NumAttributes;
+
+  // Names of the open elements
+  vector<string> m_OpenElements;
+  size_t m_Depth;
+
+  bool m_PendingEnd, m_RootClosed;
 };
 
-int RegistryXMLFileReader::CanReadFile(const char *name)
+RegistryXMLPullParser::TokenType RegistryXMLPullParser::Next()
 {
-  if ( !itksys::SystemTools::FileExists(name)
-       || itksys::SystemTools::FileIsDirectory(name)
-       || itksys::SystemTools::FileLength(name) == 0 )
+  // The end of an empty element
+  if(m_PendingEnd)
     {
-    return 0;
+    m_PendingEnd = false;
+    m_RootClosed = (--m_Depth == 0);
+    return END_ELEMENT;
     }
 
-  return 1;
+  for(;;)
+    {
+    // Skip character data, which registry files do not use
+    int c = Get();
+    if(c == EOF)
+      {
+      if(m_Depth > 0 || !m_RootClosed)
+        Fail("unexpected end of file");
+      return END_OF_DOCUMENT;
+      }
+    else if(c != '<')
+      continue;
+
+    c = Peek();
+    if(c == '?')
+      {
+      SkipPast("?>");
+      }
+    else if(c == '!')
+      {
+      Get();
+      SkipMarkupDeclaration();
+      }
+    else if(c == '/')
+      {
+      // End tag, which must match the last open element
+      Get();
+      ReadName(m_Name);
+      SkipSpace();
+      Expect('>');
+      if(m_Depth == 0 || m_OpenElements[m_Depth - 1] != m_Name)
+        Fail("mismatched tag");
+      m_RootClosed = (--m_Depth == 0);
+      return END_ELEMENT;
+      }
+    else
+      {
+      // Start tag
+      if(m_RootClosed)
+        Fail("junk after document element");
+
+      ReadName(m_Name);
+      m_NumAttributes = 0;
+      for(;;)
+        {
+        SkipSpace();
+        c = Peek();
+        if(c == '>')
+          {
+          Get();
+          break;
+          }
+        if(c == '/')
+          {
+          Get();
+          Expect('>');
+          m_PendingEnd = true;
+          break;
+          }
+        if(c == EOF)
+          Fail("unexpected end of file");
+
+        // An attribute
+        if(m_NumAttributes == m_AttrNames.size())
+          {
+          m_AttrNames.push_back(string());
+          m_AttrValues.push_back(string());
+          }
+        ReadName(m_AttrNames[m_NumAttributes]);
+        SkipSpace();
+        Expect('=');
+        SkipSpace();
+        int quote = Get();
+        if(quote != '"' && quote != '\'')
+          Fail("attribute value is not quoted");
+        ReadAttributeValue(quote, m_AttrValues[m_NumAttributes]);
+        m_NumAttributes++;
+        }
+
+      if(m_Depth == m_OpenElements.size())
+        m_OpenElements.push_back(m_Name);
+      else
+        m_OpenElements[m_Depth] = m_Name;
+      m_Depth++;
+      return START_ELEMENT;
+      }
+    }
 }
 
-void RegistryXMLFileReader::StartElement(const char *name, const char **atts)
+void RegistryXMLPullParser::SkipPast(const char *terminator)
 {
-  // If this is the root-level element <registry>, it can be ignored
-  if(strcmpi(name, "registry") == 0)
+  // Compare the last characters read to the terminator (at most 3 long)
+  size_t n = strlen(terminator);
+  char window[3] = { 0, 0, 0 };
+  for(;;)
     {
-    // Put the target registry on the stack
-    assert(this->GetOutputObject());
-    m_FolderStack.push_back(this->GetOutputObject());
-    return;
+    int c = Get();
+    if(c == EOF)
+      Fail("unexpected end of file");
+    window[0] = window[1]; window[1] = window[2]; window[2] = (char) c;
+    if(strncmp(window + 3 - n, terminator, n) == 0)
+      return;
     }
+}
 
-  // If the stack is empty throw up
-  if(m_FolderStack.size() == 0)
-    throw IRISException("Problem parsing Registry XML file. The file might not be valid.");
-
-  // Read the attributes into a map
-  typedef std::map<std::string, std::string> AttributeMap;
-  typedef AttributeMap::const_iterator AttrIter;
-  AttributeMap attrmap;
-
-  for(int i = 0; atts[i] != NULL && atts[i+1] != NULL; i+=2)
-    attrmap[itksys::SystemTools::LowerCase(atts[i])] = atts[i+1];
-
-  // Process tags
-  if(strcmpi(name, "folder") == 0)
+void RegistryXMLPullParser::SkipMarkupDeclaration()
+{
+  // Comments and CDATA sections
+  if(Peek() == '-')
     {
-    AttrIter itKey = attrmap.find("key");
-    if(itKey == attrmap.end())
-      throw IRISException("Missing 'key' attribute to <folder> element");
-
-    // Create a new folder and place it on the stack
-    Registry &newFolder = m_FolderStack.back()->Folder(itKey->second);
-    m_FolderStack.push_back(&newFolder);
+    Get();
+    Expect('-');
+    SkipPast("-->");
+    return;
     }
-  else if(strcmpi(name, "entry") == 0)
+  if(Peek() == '[')
     {
-    AttrIter itKey = attrmap.find("key");
-    if(itKey == attrmap.end())
-      throw IRISException("Missing 'key' attribute to <entry> element");
-
-    AttrIter itValue = attrmap.find("value");
-    if(itValue == attrmap.end())
-      throw IRISException("Missing 'value' attribute to <entry> element");
+    SkipPast("]]>");
+    return;
+    }
 
-    // Create a new entry (TODO: decode!)
-    m_FolderStack.back()->Entry(itKey->second) = RegistryValue(itValue->second);
+  // A declaration such as DOCTYPE, which may have an internal subset in
+  // square brackets containing quoted strings and declarations of its own
+  int depth = 0;
+  for(;;)
+    {
+    int c = Get();
+    if(c == EOF)
+      Fail("unexpected end of file");
+    else if(c == '"' || c == '\'')
+      {
+      int q;
+      while((q = Get()) != c)
+        if(q == EOF)
+          Fail("unexpected end of file");
+      }
+    else if(c == '[')
+      depth++;
+    else if(c == ']')
+      depth--;
+    else if(c == '>' && depth == 0)
+      return;
     }
-  else
-    throw IRISException("Unknown XML element <%s>", name);
 }
 
-
-void RegistryXMLFileReader::EndElement(const char *name)
+void RegistryXMLPullParser::ReadName(string &name)
 {
-  if(strcmpi(name, "registry") == 0)
+  name.clear();
+  for(int c = Peek(); c != EOF; c = Peek())
     {
-    m_FolderStack.clear();
+    if(c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+       c == '/' || c == '>' || c == '=' || c == '<')
+      break;
+    name.push_back((char) tolower(Get()));
     }
 
-  else if(strcmpi(name, "folder") == 0)
+  if(name.empty())
+    Fail("missing name");
+}
+
+void RegistryXMLPullParser::ReadAttributeValue(int quote, string &value)
+{
+  value.clear();
+  for(;;)
     {
-    m_FolderStack.pop_back();
+    int c = Get();
+    if(c == quote)
+      return;
+
+    switch(c)
+      {
+      case EOF:
+        Fail("unexpected end of file");
+        break;
+      case '<':
+        Fail("'<' in attribute value");
+        break;
+      case '&':
+        ReadEntity(value);
+        break;
+      case '\r':
+        // Line breaks and tabs become spaces, as in any XML parser
+        if(Peek() == '\n')
+          Get();
+        value.push_back(' ');
+        break;
+      case '\n':
+      case '\t':
+        value.push_back(' ');
+        break;
+      default:
+        value.push_back((char) c);
+        break;
+      }
     }
 }
 
-void RegistryXMLFileReader::CharacterDataHandler(const char *inData, int inLength)
+void RegistryXMLPullParser::ReadEntity(string &value)
 {
-  return;
+  char ref[12];
+  size_t n = 0;
+  int c;
+  while((c = Get()) != ';')
+    {
+    if(c == EOF || n == sizeof(ref) - 1)
+      Fail("invalid entity reference");
+    ref[n++] = (char) c;
+    }
+  ref[n] = 0;
+
+  if(!strcmp(ref, "lt"))
+    value.push_back('<');
+  else if(!strcmp(ref, "gt"))
+    value.push_back('>');
+  else if(!strcmp(ref, "amp"))
+    value.push_back('&');
+  else if(!strcmp(ref, "apos"))
+    value.push_back('\'');
+  else if(!strcmp(ref, "quot"))
+    value.push_back('"');
+  else if(ref[0] == '#' && n > 1)
+    {
+    // Character reference, stored as UTF-8
+    const char *digits = (ref[1] == 'x') ? ref + 2 : ref + 1;
+    char *end;
+    unsigned long code = strtoul(digits, &end, (ref[1] == 'x') ? 16 : 10);
+    if(*end || end == digits || code == 0 || code > 0x10ffff)
+      Fail("invalid character reference");
+
+    if(code < 0x80)
+      value.push_back((char) code);
+    else if(code < 0x800)
+      {
+      value.push_back((char) (0xc0 | (code >> 6)));
+      value.push_back((char) (0x80 | (code & 0x3f)));
+      }
+    else if(code < 0x10000)
+      {
+      value.push_back((char) (0xe0 | (code >> 12)));
+      value.push_back((char) (0x80 | ((code >> 6) & 0x3f)));
+      value.push_back((char) (0x80 | (code & 0x3f)));
+      }
+    else
+      {
+      value.push_back((char) (0xf0 | (code >> 18)));
+      value.push_back((char) (0x80 | ((code >> 12) & 0x3f)));
+      value.push_back((char) (0x80 | ((code >> 6) & 0x3f)));
+      value.push_back((char) (0x80 | (code & 0x3f)));
+      }
+    }
+  else
+    Fail("undefined entity");
 }
 
 
@@ -174,28 +443,155 @@ RegistryValue
   m_String = input;
 }
 
-RegistryValue&
-Registry::Entry(const std::string &key)
+/**
+ * The pool of interned keys, with the number of folder items that use each
+ * key. Keys are removed when their last item is removed, so keys that are
+ * unique to one workspace (array elements, metadata tags) do not pile up.
+ * Elements of an unordered_map are not moved when it rehashes, so the
+ * pointers handed out stay valid while the key is in use. The pool is never
+ * destroyed, since static registries may release their keys at exit.
+ */
+struct RegistryKeyPool
+{
+  std::unordered_map<std::string, size_t> Keys;
+  std::mutex Mutex;
+};
+
+static RegistryKeyPool &GetRegistryKeyPool()
+{
+  static RegistryKeyPool *pool = new RegistryKeyPool();
+  return *pool;
+}
+
+Registry::KeyType
+Registry::InternKey(const char *key, size_t length)
 {
-  // Get the containing folder
-  StringType::size_type iDot = key.find_first_of('.');
+  RegistryKeyPool &pool = GetRegistryKeyPool();
+  std::lock_guard<std::mutex> lock(pool.Mutex);
+  std::unordered_map<std::string, size_t>::iterator it =
+      pool.Keys.insert(std::make_pair(StringType(key, length), (size_t) 0)).first;
+  it->second++;
+  return &it->first;
+}
 
-  // There is a subfolder
-  if(iDot != key.npos)
+Registry::KeyType
+Registry::AcquireKey(KeyType key)
+{
+  RegistryKeyPool &pool = GetRegistryKeyPool();
+  std::lock_guard<std::mutex> lock(pool.Mutex);
+  pool.Keys.find(*key)->second++;
+  return key;
+}
+
+void
+Registry::ReleaseKey(KeyType key)
+{
+  RegistryKeyPool &pool = GetRegistryKeyPool();
+  std::lock_guard<std::mutex> lock(pool.Mutex);
+  std::unordered_map<std::string, size_t>::iterator it = pool.Keys.find(*key);
+  if(--it->second == 0)
+    pool.Keys.erase(it);
+}
+
+size_t
+Registry::GetNumberOfInternedKeys()
+{
+  RegistryKeyPool &pool = GetRegistryKeyPool();
+  std::lock_guard<std::mutex> lock(pool.Mutex);
+  return pool.Keys.size();
+}
+
+template <class TIndex>
+size_t
+Registry::LowerBound(const TIndex &index, const char *key, size_t length)
+{
+  size_t lo = 0, hi = index.size();
+  while(lo < hi)
     {
-    StringType child = key.substr(0,iDot);
-    StringType childKey = key.substr(iDot+1);
-    return Folder(child).Entry(childKey);
+    size_t mid = (lo + hi) / 2;
+    if(index[mid].Key->compare(0, StringType::npos, key, length) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
     }
+  return lo;
+}
+
+RegistryValue *
+Registry::FindEntry(const char *key, size_t length) const
+{
+  size_t pos = LowerBound(m_EntryIndex, key, length);
+  if(pos < m_EntryIndex.size()
+     && m_EntryIndex[pos].Key->compare(0, StringType::npos, key, length) == 0)
+    return m_EntryIndex[pos].Value;
+  return NULL;
+}
+
+Registry *
+Registry::FindFolder(const char *key, size_t length) const
+{
+  size_t pos = LowerBound(m_FolderIndex, key, length);
+  if(pos < m_FolderIndex.size()
+     && m_FolderIndex[pos].Key->compare(0, StringType::npos, key, length) == 0)
+    return m_FolderIndex[pos].Folder;
+  return NULL;
+}
 
-  // Search for the key and return it if found
-  EntryIterator it = m_EntryMap.find(key);
-  if(it != m_EntryMap.end())
-    return it->second;
+RegistryValue &
+Registry::FindOrAddEntry(const char *key, size_t length, KeyType interned)
+{
+  // Registries are written in key order, so when one is read the keys come
+  // in order and are added at the end without a search
+  size_t pos = m_EntryIndex.size();
+  if(pos && m_EntryIndex.back().Key->compare(0, StringType::npos, key, length) >= 0)
+    {
+    pos = LowerBound(m_EntryIndex, key, length);
+    if(m_EntryIndex[pos].Key->compare(0, StringType::npos, key, length) == 0)
+      return *m_EntryIndex[pos].Value;
+    }
 
   // Key was not found, create a null entry
-  m_EntryMap[key] = RegistryValue();
-  return m_EntryMap[key];
+  m_EntryStore.push_back(RegistryValue());
+  EntryRef ref;
+  ref.Key = interned ? AcquireKey(interned) : InternKey(key, length);
+  ref.Value = &m_EntryStore.back();
+  m_EntryIndex.insert(m_EntryIndex.begin() + pos, ref);
+  return *ref.Value;
+}
+
+Registry &
+Registry::FindOrAddFolder(const char *key, size_t length, KeyType interned)
+{
+  size_t pos = m_FolderIndex.size();
+  if(pos && m_FolderIndex.back().Key->compare(0, StringType::npos, key, length) >= 0)
+    {
+    pos = LowerBound(m_FolderIndex, key, length);
+    if(m_FolderIndex[pos].Key->compare(0, StringType::npos, key, length) == 0)
+      return *m_FolderIndex[pos].Folder;
+    }
+
+  // Add the folder
+  FolderRef ref;
+  ref.Key = interned ? AcquireKey(interned) : InternKey(key, length);
+  ref.Folder = new Registry();
+  ref.Folder->m_AddIfNotFound = m_AddIfNotFound;
+  m_FolderIndex.insert(m_FolderIndex.begin() + pos, ref);
+  return *ref.Folder;
+}
+
+RegistryValue&
+Registry::Entry(const std::string &key)
+{
+  // Walk down the subfolders named by the parts of the key before each dot
+  Registry *folder = this;
+  StringType::size_type iStart = 0, iDot;
+  while((iDot = key.find('.', iStart)) != key.npos)
+    {
+    folder = &folder->FindOrAddFolder(key.data() + iStart, iDot - iStart);
+    iStart = iDot + 1;
+    }
+
+  return folder->FindOrAddEntry(key.data() + iStart, key.size() - iStart);
 }
 
 Registry::StringType
@@ -219,10 +615,10 @@ Registry
 ::GetEntryKeys(StringListType &targetArray) 
 {
   // Iterate through keys in ascending order
-  for(EntryIterator it=m_EntryMap.begin();it!=m_EntryMap.end();++it)
+  for(EntryIterator it=m_EntryIndex.begin();it!=m_EntryIndex.end();++it)
     {
     // Put the key in the array
-    targetArray.push_back(it->first);
+    targetArray.push_back(*it->Key);
     }
 
   // Return the number of keys copied
@@ -234,10 +630,10 @@ Registry
 ::GetFolderKeys(StringListType &targetArray) 
 {
   // Iterate through keys in ascending order
-  for(FolderIterator it=m_FolderMap.begin();it!=m_FolderMap.end();++it)
+  for(FolderIterator it=m_FolderIndex.begin();it!=m_FolderIndex.end();++it)
     {
     // Put the key in the array
-    targetArray.push_back(it->first);
+    targetArray.push_back(*it->Key);
     }
 
   // Return the number of keys copied
@@ -246,52 +642,34 @@ Registry
 
 bool Registry::HasEntry(const Registry::StringType &key) const
 {
-  // Get the containing folder
-  StringType::size_type iDot = key.find_first_of('.');
-
-  // There is a subfolder
-  if(iDot != key.npos)
+  // Walk down the subfolders, which must all exist
+  const Registry *folder = this;
+  StringType::size_type iStart = 0, iDot;
+  while((iDot = key.find('.', iStart)) != key.npos)
     {
-    StringType child = key.substr(0,iDot);
-    StringType childKey = key.substr(iDot+1);
-
-    FolderIterator it = m_FolderMap.find(child);
-    if(it != m_FolderMap.end())
-      return it->second->HasEntry(childKey);
-    else
+    folder = folder->FindFolder(key.data() + iStart, iDot - iStart);
+    if(!folder)
       return false;
+    iStart = iDot + 1;
     }
-  else
-    {
-    // Search for the key and return it if found
-    EntryConstIterator it = m_EntryMap.find(key);
-    return it != m_EntryMap.end();
-    }
+
+  return folder->FindEntry(key.data() + iStart, key.size() - iStart) != NULL;
 }
 
 bool Registry::HasFolder(const Registry::StringType &key) const
 {
-  // Get the containing folder
-  StringType::size_type iDot = key.find_first_of('.');
-
-  // There is a subfolder
-  if(iDot != key.npos)
+  // Walk down the subfolders, which must all exist
+  const Registry *folder = this;
+  StringType::size_type iStart = 0, iDot;
+  while((iDot = key.find('.', iStart)) != key.npos)
     {
-    StringType child = key.substr(0,iDot);
-    StringType childKey = key.substr(iDot+1);
-
-    FolderIterator it = m_FolderMap.find(child);
-    if(it != m_FolderMap.end())
-      return it->second->HasFolder(childKey);
-    else
+    folder = folder->FindFolder(key.data() + iStart, iDot - iStart);
+    if(!folder)
       return false;
+    iStart = iDot + 1;
     }
-  else
-    {
-    // Search for the key and return it if found
-    FolderIterator it = m_FolderMap.find(key);
-    return it != m_FolderMap.end();
-    }
+
+  return folder->FindFolder(key.data() + iStart, key.size() - iStart) != NULL;
 }
 
 void
@@ -299,24 +677,24 @@ Registry
 ::Write(ostream &sout,const StringType &prefix)
 {
   // Write the entries in this folder
-  for(EntryIterator ite = m_EntryMap.begin();ite != m_EntryMap.end(); ++ite)
+  for(EntryIterator ite = m_EntryIndex.begin();ite != m_EntryIndex.end(); ++ite)
     {
     // Only write the non-null entries
-    if(!ite->second.IsNull())
+    if(!ite->Value->IsNull())
       {
       // Write the key = 
-      sout << prefix << Encode(ite->first) << " = ";
+      sout << prefix << Encode(*ite->Key) << " = ";
 
       // Write the encoded value
-      sout << Encode(ite->second.GetInternalString()) << endl;
+      sout << Encode(ite->Value->GetInternalString()) << '\n';
       }
     }
 
   // Write the folders
-  for(FolderIterator itf = m_FolderMap.begin(); itf != m_FolderMap.end(); ++itf)
+  for(FolderIterator itf = m_FolderIndex.begin(); itf != m_FolderIndex.end(); ++itf)
     {
     // Write the folder contents (recursive, contents prefixed with full path name)
-    itf->second->Write(sout, prefix + itf->first + "." );
+    itf->Folder->Write(sout, prefix + *itf->Key + "." );
     }  
 }
 
@@ -325,26 +703,26 @@ Registry
 ::Print(ostream &sout, StringType indent, StringType prefix)
 {
   // Print the folders
-  for(FolderIterator itf = m_FolderMap.begin(); itf != m_FolderMap.end(); ++itf)
+  for(FolderIterator itf = m_FolderIndex.begin(); itf != m_FolderIndex.end(); ++itf)
     {
     // Write the folder, python-like 
-    sout << prefix << itf->first << ":" << endl;
+    sout << prefix << *itf->Key << ":" << endl;
 
     // Print the folder contents (recursive, contents prefixed with full path name)
-    itf->second->Print(sout, indent, prefix + indent);
+    itf->Folder->Print(sout, indent, prefix + indent);
     }  
 
   // Print the entries in this folder
-  for(EntryIterator ite = m_EntryMap.begin();ite != m_EntryMap.end(); ++ite)
+  for(EntryIterator ite = m_EntryIndex.begin();ite != m_EntryIndex.end(); ++ite)
     {
     // Only write the non-null entries
-    if(!ite->second.IsNull())
+    if(!ite->Value->IsNull())
       {
       // Write the key = 
-      sout << prefix << ite->first << " = ";
+      sout << prefix << *ite->Key << " = ";
 
       // Write the encoded value
-      sout << ite->second.GetInternalString() << endl;
+      sout << ite->Value->GetInternalString() << endl;
       }
     }
 }
@@ -353,31 +731,33 @@ void
 Registry
 ::WriteXML(ostream &sout, const StringType &prefix)
 {
-  // Write the entries in this folder
-  for(EntryIterator ite = m_EntryMap.begin();ite != m_EntryMap.end(); ++ite)
+  // Lines end with '\n' rather than endl, which would flush the file after
+  // every entry
+  for(EntryIterator ite = m_EntryIndex.begin();ite != m_EntryIndex.end(); ++ite)
     {
     // Only write the non-null entries
-    if(!ite->second.IsNull())
+    if(!ite->Value->IsNull())
       {
       // Write the key
-      sout << prefix << "<entry key=\"" << EncodeXML(ite->first) << "\"";
+      sout << prefix << "<entry key=\"" << EncodeXML(*ite->Key) << "\"";
 
       // Write the encoded value
-      sout << " value=\"" << EncodeXML(ite->second.GetInternalString()) << "\" />" << endl;
+      sout << " value=\"" << EncodeXML(ite->Value->GetInternalString()) << "\" />\n";
       }
     }
 
   // Write the folders
-  for(FolderIterator itf = m_FolderMap.begin(); itf != m_FolderMap.end(); ++itf)
+  StringType childPrefix = prefix + "  ";
+  for(FolderIterator itf = m_FolderIndex.begin(); itf != m_FolderIndex.end(); ++itf)
     {
     // Write the folder tag
-    sout << prefix << "<folder key=\"" << EncodeXML(itf->first) << "\" >" << endl;
+    sout << prefix << "<folder key=\"" << EncodeXML(*itf->Key) << "\" >\n";
 
     // Write the folder contents (recursive, contents prefixed with full path name)
-    itf->second->WriteXML(sout, prefix + "  ");
+    itf->Folder->WriteXML(sout, childPrefix);
 
     // Close the folder
-    sout << prefix << "</folder>" << endl;
+    sout << prefix << "</folder>\n";
     }
 }
 
@@ -389,21 +769,25 @@ Registry
   m_AddIfNotFound = yesno;
 
   // Propagate to all the children folders
-  for(FolderIterator itf = m_FolderMap.begin(); itf != m_FolderMap.end(); ++itf)
+  for(FolderIterator itf = m_FolderIndex.begin(); itf != m_FolderIndex.end(); ++itf)
     {
-    itf->second->SetFlagAddIfNotFound(yesno);
+    itf->Folder->SetFlagAddIfNotFound(yesno);
     }
 }
 
 void Registry::CleanEmptyFolders()
 {
   // Iterate over all the subfolders
-  FolderMapType::iterator itf = m_FolderMap.begin();
-  while(itf != m_FolderMap.end())
+  FolderIndexType::iterator itf = m_FolderIndex.begin();
+  while(itf != m_FolderIndex.end())
     {
-    itf->second->CleanEmptyFolders();
-    if(itf->second->IsEmpty())
-      m_FolderMap.erase(itf++);
+    itf->Folder->CleanEmptyFolders();
+    if(itf->Folder->IsEmpty())
+      {
+      delete itf->Folder;
+      ReleaseKey(itf->Key);
+      itf = m_FolderIndex.erase(itf);
+      }
     else
       itf++;
     }
@@ -414,22 +798,26 @@ bool Registry::IsZeroSizeArray()
   return
       this->HasEntry("ArraySize") &&
       this->Entry("ArraySize")[(unsigned int) 0] == 0 &&
-      this->m_EntryMap.size() == 1 &&
-      this->m_FolderMap.size() == 0;
+      this->m_EntryIndex.size() == 1 &&
+      this->m_FolderIndex.size() == 0;
 }
 
 void Registry::CleanZeroSizeArrays()
 {
   // Iterate over all the subfolders
-  FolderMapType::iterator itf = m_FolderMap.begin();
-  while(itf != m_FolderMap.end())
+  FolderIndexType::iterator itf = m_FolderIndex.begin();
+  while(itf != m_FolderIndex.end())
     {
     // Do the recursive part
-    itf->second->CleanZeroSizeArrays();
+    itf->Folder->CleanZeroSizeArrays();
 
     // Check if it has the array size key
-    if(itf->second->IsZeroSizeArray())
-      m_FolderMap.erase(itf++);
+    if(itf->Folder->IsZeroSizeArray())
+      {
+      delete itf->Folder;
+      ReleaseKey(itf->Key);
+      itf = m_FolderIndex.erase(itf);
+      }
     else
       itf++;
     }
@@ -440,17 +828,17 @@ Registry
 ::CollectKeys(StringListType &keyList,const StringType &prefix) 
 {
   // Go through the children
-  for(FolderIterator itf = m_FolderMap.begin(); itf != m_FolderMap.end(); ++itf)
+  for(FolderIterator itf = m_FolderIndex.begin(); itf != m_FolderIndex.end(); ++itf)
     {
     // Collect the child's keys with a new prefix
-    itf->second->CollectKeys(keyList, prefix + itf->first + ".");
+    itf->Folder->CollectKeys(keyList, prefix + *itf->Key + ".");
     }
   
   // Add the keys in this folder
-  for(EntryIterator ite = m_EntryMap.begin();ite != m_EntryMap.end(); ++ite)
+  for(EntryIterator ite = m_EntryIndex.begin();ite != m_EntryIndex.end(); ++ite)
     {
     // Add the key to the collection list
-    keyList.push_back(prefix + ite->first);
+    keyList.push_back(prefix + *ite->Key);
     }
 }
 
@@ -458,20 +846,22 @@ void
 Registry
 ::Update(const Registry &reg) 
 {
-  // Go through the children
-  for(FolderIterator itf = reg.m_FolderMap.begin(); 
-    itf != reg.m_FolderMap.end(); ++itf)
+  // Go through the children. The keys are already interned
+  for(FolderIterator itf = reg.m_FolderIndex.begin(); 
+    itf != reg.m_FolderIndex.end(); ++itf)
     {
     // Update the sub-folder
-    this->Folder(itf->first).Update(*(itf->second));
+    const StringType &key = *itf->Key;
+    this->FindOrAddFolder(key.data(), key.size(), itf->Key).Update(*itf->Folder);
     }
   
   // Add the keys in this folder
-  for(EntryConstIterator ite = reg.m_EntryMap.begin();
-    ite != reg.m_EntryMap.end(); ++ite)
+  for(EntryIterator ite = reg.m_EntryIndex.begin();
+    ite != reg.m_EntryIndex.end(); ++ite)
     {
-    RegistryValue &entry = Entry(ite->first);
-    entry = ite->second;   
+    const StringType &key = *ite->Key;
+    RegistryValue &entry = FindOrAddEntry(key.data(), key.size(), ite->Key);
+    entry = *ite->Value;
     }
 }
 
@@ -483,10 +873,10 @@ Registry
 ::FindValue(const StringType& value)
 {
   // Add the keys in this folder
-  for(EntryIterator ite = m_EntryMap.begin();ite != m_EntryMap.end(); ++ite)
+  for(EntryIterator ite = m_EntryIndex.begin();ite != m_EntryIndex.end(); ++ite)
     {
-    if(ite->second.GetInternalString() == value)
-      return ite->first;
+    if(ite->Value->GetInternalString() == value)
+      return *ite->Key;
     }
   return "";
 }
@@ -496,37 +886,64 @@ Registry
 ::RemoveKeys(const char *match)
 {
   // Create a match substring
-  string sMatch = (match) ? match : 0;
+  string sMatch = (match) ? match : "";
 
-  // Search and delete from the map
-  EntryMapType newMap;
-  for(EntryIterator it=m_EntryMap.begin(); it != m_EntryMap.end(); it++)
+  // Copy the entries that are kept to new storage
+  std::deque<RegistryValue> newStore;
+  EntryIndexType newIndex;
+  for(EntryIterator it=m_EntryIndex.begin(); it != m_EntryIndex.end(); it++)
     {
-    if(it->first.find(sMatch) != 0)
-      newMap[it->first] = it->second;
+    if(it->Key->find(sMatch) != 0)
+      {
+      newStore.push_back(*it->Value);
+      EntryRef ref;
+      ref.Key = it->Key;
+      ref.Value = &newStore.back();
+      newIndex.push_back(ref);
+      }
+    else
+      {
+      ReleaseKey(it->Key);
+      }
     }
 
-  m_EntryMap = newMap;
+  m_EntryStore.swap(newStore);
+  m_EntryIndex.swap(newIndex);
 }
 
 void
 Registry
 ::Clear()
 {
-  m_EntryMap.clear();
-  m_FolderMap.clear();
+  for(FolderIterator itf = m_FolderIndex.begin(); itf != m_FolderIndex.end(); ++itf)
+    {
+    delete itf->Folder;
+    ReleaseKey(itf->Key);
+    }
+
+  for(EntryIterator ite = m_EntryIndex.begin(); ite != m_EntryIndex.end(); ++ite)
+    ReleaseKey(ite->Key);
+
+  m_FolderIndex.clear();
+  m_EntryIndex.clear();
+  m_EntryStore.clear();
 }
 
 bool Registry::IsEmpty() const
 {
-  return m_EntryMap.size() == 0 && m_FolderMap.size() == 0;
+  return m_EntryIndex.size() == 0 && m_FolderIndex.size() == 0;
 }
 
 Registry::StringType
 Registry
 ::EncodeXML(const StringType &input)
 {
-  IRISOStringStream oss;
+  // Most keys and values need no encoding
+  if(input.find_first_of("<>&'\"") == input.npos)
+    return input;
+
+  StringType result;
+  result.reserve(input.length() + 16);
   for(unsigned int i=0; i < input.length() ; i++)
     {
     // Map the character to positive integer (0..255)
@@ -536,22 +953,22 @@ Registry
     switch(c)
       {
       case '<' :
-        oss << "&lt;"; break;
+        result += "&lt;"; break;
       case '>' :
-        oss << "&gt;"; break;
+        result += "&gt;"; break;
       case '&' :
-        oss << "&amp;"; break;
+        result += "&amp;"; break;
       case '\'' :
-        oss << "&apos;"; break;
+        result += "&apos;"; break;
       case '\"' :
-        oss << "&quot;"; break;
+        result += "&quot;"; break;
       default:
-        oss << c; break;
+        result += c; break;
       }
    }
 
   // Return the resulting string
-  return oss.str();
+  return result;
 }
 
 Registry::StringType Registry::DecodeXML(const Registry::StringType &input)
@@ -699,26 +1116,17 @@ Registry &
 Registry
 ::Folder(const string &key) 
 {
-  // Find the first separator in the key string
-  StringType::size_type iDot = key.find_first_of('.');
-
-  // Recurse on the immideate folder
-  if(iDot != key.npos) 
+  // Walk down the subfolders named by the parts of the key, adding them if
+  // necessary
+  Registry *folder = this;
+  StringType::size_type iStart = 0, iDot;
+  while((iDot = key.find('.', iStart)) != key.npos)
     {
-    StringType child = key.substr(0,iDot);
-    StringType childKey = key.substr(iDot+1);
-    return Folder(child).Folder(childKey);
+    folder = &folder->FindOrAddFolder(key.data() + iStart, iDot - iStart);
+    iStart = iDot + 1;
     }
 
-  // Get the folder, adding if necessary
-  FolderIterator it = m_FolderMap.find(key);
-  if(it != m_FolderMap.end())
-    return *(it->second);
-
-  // Add the folder
-  m_FolderMap[key] = new Registry();
-  m_FolderMap[key]->m_AddIfNotFound = m_AddIfNotFound;
-  return *m_FolderMap[key];
+  return folder->FindOrAddFolder(key.data() + iStart, key.size() - iStart);
 }
 
 Registry
@@ -730,65 +1138,70 @@ Registry
 Registry
 ::Registry(const char *fname) 
 {
+  m_AddIfNotFound = false;
   ReadFromFile(fname);
 }
 
 Registry::Registry(const Registry &source)
 {
+  m_AddIfNotFound = false;
   *this = source;
 }
 
 void Registry::operator =(const Registry &source)
 {
+  // Copy into a temporary first, since the source may be one of our own
+  // subfolders, which Clear() would delete
+  Registry copy;
+  copy.Update(source);
+  copy.m_AddIfNotFound = source.m_AddIfNotFound;
+
   this->Clear();
-  this->Update(source);
-  this->m_AddIfNotFound = source.m_AddIfNotFound;
+  m_EntryStore.swap(copy.m_EntryStore);
+  m_EntryIndex.swap(copy.m_EntryIndex);
+  m_FolderIndex.swap(copy.m_FolderIndex);
+  this->m_AddIfNotFound = copy.m_AddIfNotFound;
 }
 
 
 Registry::
 ~Registry() 
 {
-  // Delete all the sub-folders
-  for(FolderIterator itf = m_FolderMap.begin(); itf != m_FolderMap.end(); ++itf)
-    delete itf->second;
+  // Delete all the sub-folders and release the keys
+  this->Clear();
 }
 
 bool Registry::operator == (const Registry &other) const
 {
-  // Compare the folders
-  if(m_FolderMap.size() != other.m_FolderMap.size())
+  // Compare the folders. Keys are interned, so equal keys have equal pointers
+  if(m_FolderIndex.size() != other.m_FolderIndex.size())
     return false;
 
-  for(FolderIterator it1 = m_FolderMap.begin(), it2 = other.m_FolderMap.begin();
-      it1 != m_FolderMap.end(); ++it1, ++it2)
+  for(FolderIterator it1 = m_FolderIndex.begin(), it2 = other.m_FolderIndex.begin();
+      it1 != m_FolderIndex.end(); ++it1, ++it2)
     {
     // Compare keys
-    const StringType &key1 = it1->first;
-    const StringType &key2 = it2->first;
-    if(key1 != key2)
+    if(it1->Key != it2->Key)
       return false;
 
     // Compare subfolder contents (recursively)
-    if(*(it1->second) != *(it2->second))
+    if(*(it1->Folder) != *(it2->Folder))
       return false;
     }
 
   // Compare the entries
-  if(m_EntryMap.size() != other.m_EntryMap.size())
+  if(m_EntryIndex.size() != other.m_EntryIndex.size())
     return false;
 
-  for(EntryConstIterator it1 = m_EntryMap.begin(), it2 = other.m_EntryMap.begin();
-      it1 != m_EntryMap.end(); ++it1, ++it2)
+  for(EntryIterator it1 = m_EntryIndex.begin(), it2 = other.m_EntryIndex.begin();
+      it1 != m_EntryIndex.end(); ++it1, ++it2)
     {
     // Compare keys
-    const StringType &key1 = it1->first;
-    const StringType &key2 = it2->first;
-    if(key1 != key2)
+    if(it1->Key != it2->Key)
       return false;
 
     // Compare subfolder contents (recursively)
-    if(it1->second != it2->second)
+    if(*(it1->Value) != *(it2->Value))
       return false;
     }
 
@@ -895,10 +1308,69 @@ void Registry
 
 void Registry::ReadFromXMLFile(const char *pathname)
 {
-  SmartPtr<RegistryXMLFileReader> reader = RegistryXMLFileReader::New();
-  reader->SetOutputObject(this);
-  reader->SetFilename(pathname);
-  reader->GenerateOutputInformation();
+  ifstream sin(pathname, std::ios::in | std::ios::binary);
+  if(!sin.good())
+    throw IRISException("Unable to open the Registry file %s", pathname);
+
+  ReadFromXMLStream(sin);
 }
 
+void Registry::ReadFromXMLStream(istream &sin)
+{
+  RegistryXMLPullParser parser(sin);
 
+  // The folder stack
+  std::vector<Registry *> stack;
+
+  RegistryXMLPullParser::TokenType token;
+  while((token = parser.Next()) != RegistryXMLPullParser::END_OF_DOCUMENT)
+    {
+    const std::string &name = parser.GetName();
+    if(token == RegistryXMLPullParser::END_ELEMENT)
+      {
+      if(name == "registry")
+        stack.clear();
+      else if(name == "folder")
+        stack.pop_back();
+      continue;
+      }
+
+    // If this is the root-level element <registry>, it can be ignored
+    if(name == "registry")
+      {
+      // Put the target registry on the stack
+      stack.push_back(this);
+      continue;
+      }
+
+    // If the stack is empty throw up
+    if(stack.size() == 0)
+      throw IRISException("Problem parsing Registry XML file. The file might not be valid.");
+
+    // Process tags
+    if(name == "folder")
+      {
+      const std::string *key = parser.GetAttribute("key");
+      if(!key)
+        throw IRISException("Missing 'key' attribute to <folder> element");
+
+      // Create a new folder and place it on the stack
+      stack.push_back(&stack.back()->Folder(*key));
+      }
+    else if(name == "entry")
+      {
+      const std::string *key = parser.GetAttribute("key");
+      if(!key)
+        throw IRISException("Missing 'key' attribute to <entry> element");
+
+      const std::string *value = parser.GetAttribute("value");
+      if(!value)
+        throw IRISException("Missing 'value' attribute to <entry> element");
+
+      // Create a new entry
+      stack.back()->Entry(*key) = RegistryValue(*value);
+      }
+    else
+      throw IRISException("Unknown XML element <%s>", name.c_str());
+    }
+}
@@ -40,6 +40,7 @@
 #endif //_MSC_VER
 
 #include <stdio.h>
+#include <deque>
 #include <iostream>
 #include <list>
 #include <map>
@@ -387,6 +388,13 @@ private:
 /**
  * \class Registry
  * \brief A tree of key-value pair maps
+ *
+ * Each folder keeps its entries and subfolders in flat arrays sorted by key,
+ * and the keys themselves are interned: every distinct key string is stored
+ * once for the whole program, so the thousands of folders in a large
+ * workspace that use the same keys ("ArraySize", "Element[0]", ...) share
+ * them. References returned by Entry() and Folder() remain valid as other
+ * entries and folders are added.
  */
 class Registry
 {
@@ -479,6 +487,10 @@ public:
   /** Read from XML file */
   void ReadFromXMLFile(const char *pathname);
 
+  /** Read XML from a stream. The XML is parsed as it is read, without
+   * building a document tree first */
+  void ReadFromXMLStream(std::istream &sin);
+
   /** Print the registry in a tab-formatted way */
   void Print(std::ostream &sout, StringType indent = "  ", StringType prefix = "");
 
@@ -535,6 +547,9 @@ public:
   /** Remove all folders that are zero-length arrays */
   void CleanZeroSizeArrays();
 
+  /** Number of distinct keys used by all the registries in the process */
+  static size_t GetNumberOfInternedKeys();
+
   /** An IO exception objects thrown by this class when reading from file*/
   class IOException : public StringType {
   public:
@@ -549,20 +564,36 @@ public:
 
 private:
 
-  // Hashtable type definition
-  typedef std::map<StringType, Registry *> FolderMapType;
-  typedef std::map<StringType, RegistryValue> EntryMapType;
+  // An interned key. Equal keys are always represented by the same pointer
+  typedef const StringType *KeyType;
+
+  // Items of the sorted folder arrays
+  struct EntryRef
+  {
+    KeyType Key;
+    RegistryValue *Value;
+  };
+
+  struct FolderRef
+  {
+    KeyType Key;
+    Registry *Folder;
+  };
 
-  // Commonly used hashtable iterators
-  typedef FolderMapType::const_iterator FolderIterator;
-  typedef EntryMapType::iterator EntryIterator;
-  typedef EntryMapType::const_iterator EntryConstIterator;
+  typedef std::vector<EntryRef> EntryIndexType;
+  typedef std::vector<FolderRef> FolderIndexType;
+  typedef EntryIndexType::const_iterator EntryIterator;
+  typedef FolderIndexType::const_iterator FolderIterator;
 
-  /** A hash table for the subfolders */
-  FolderMapType m_FolderMap;
+  /** The values of the entries. A deque does not move its elements when
+   * new ones are added at the end, so references to values stay valid */
+  std::deque<RegistryValue> m_EntryStore;
 
-  /** A hash table for the registry values */
-  EntryMapType m_EntryMap;
+  /** The entries of this folder, sorted by key */
+  EntryIndexType m_EntryIndex;
+
+  /** The subfolders, sorted by key */
+  FolderIndexType m_FolderIndex;
 
   /**
    * A flag as to whether keys and folders that are read and not found
@@ -570,6 +601,29 @@ private:
    */
   bool m_AddIfNotFound;
 
+  /** Get the interned copy of a key, adding it to the key pool if needed.
+   * This adds a reference to the key, which the item using it must release */
+  static KeyType InternKey(const char *key, size_t length);
+
+  /** Add a reference to a key that is already interned */
+  static KeyType AcquireKey(KeyType key);
+
+  /** Release a reference to a key, removing it from the pool if unused */
+  static void ReleaseKey(KeyType key);
+
+  /** Position of the first item whose key is not less than the given key */
+  template <class TIndex>
+  static size_t LowerBound(const TIndex &index, const char *key, size_t length);
+
+  /** Find an entry or subfolder of this folder (keys with no dots) or NULL */
+  RegistryValue *FindEntry(const char *key, size_t length) const;
+  Registry *FindFolder(const char *key, size_t length) const;
+
+  /** Find an entry or subfolder of this folder, adding it if missing. The
+   * interned key may be passed in if it is known */
+  RegistryValue &FindOrAddEntry(const char *key, size_t length, KeyType interned = NULL);
+  Registry &FindOrAddFolder(const char *key, size_t length, KeyType interned = NULL);
+
   /** Write this folder recursively to a stream */
   void Write(std::ostream &sout,const StringType &keyPrefix);
 
@@ -54,6 +54,7 @@
 #include "GlobalState.h"
 #include "SNAPRegistryIO.h"
 #include "HistoryManager.h"
+#include "ThumbnailService.h"
 #include "UIReporterDelegates.h"
 #include <itksys/Directory.hxx>
 #include <itksys/SystemTools.hxx>
@@ -167,6 +168,9 @@ SystemInterface
   // Initialize the history manager
   m_HistoryManager = new HistoryManager();
 
+  // Initialize the thumbnail writer
+  m_ThumbnailService = new ThumbnailService(m_SystemInfoDelegate);
+
   // Register the Image IO factories that are not part of ITK
   itk::ObjectFactoryBase::RegisterFactory( 
     itk::VoxBoCUBImageIOFactory::New() );
@@ -185,6 +189,7 @@ SystemInterface
 {
   delete m_RegistryIO;
   delete m_HistoryManager;
+  delete m_ThumbnailService;
 }
 
 string SystemInterface::GetFullPathToExecutable() const
@@ -641,10 +646,10 @@ SystemInterface
 
 void SystemInterface
 ::WriteThumbnail(
-    const char *associated_file, ThumbnailImageType *thumbnail)
+    const char *associated_file, ThumbnailImageType *slice, unsigned int maxdim)
 {
   std::string thumb_fn = this->GetThumbnailAssociatedWithFile(associated_file);
-  this->m_SystemInfoDelegate->WriteRGBAImage2D(thumb_fn, thumbnail);
+  m_ThumbnailService->RequestThumbnail(thumb_fn, slice, maxdim);
 }
 
 bool 
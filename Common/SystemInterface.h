@@ -42,6 +42,7 @@
 class IRISApplication;
 class SNAPRegistryIO;
 class HistoryManager;
+class ThumbnailService;
 class SystemInfoDelegate;
 class vtkCamera;
 
@@ -110,6 +111,9 @@ public:
   /** Get a filename history list by a particular name */
   irisGetMacro(HistoryManager, HistoryManager*);
 
+  /** Get the service that writes and caches the thumbnails */
+  irisGetMacro(ThumbnailService, ThumbnailService*);
+
   /** Find and load a registry file associated with a filename in the system.*/
   bool FindRegistryAssociatedWithFile(const char *file, 
                                       Registry &registry);
@@ -120,8 +124,13 @@ public:
   /** Get the thumbnail filename associated with an image file */
   std::string GetThumbnailAssociatedWithFile(const char *file);
 
-  /** Write a thumbnail */
-  void WriteThumbnail(const char *associated_file, ThumbnailImageType *thumbnail);
+  /**
+   * Write a thumbnail made from a display slice, with size maxdim. The thumbnail
+   * is made and written in the background, so the slice must not be modified
+   * afterwards
+   */
+  void WriteThumbnail(const char *associated_file, ThumbnailImageType *slice,
+                      unsigned int maxdim);
 
   /** A higher level method: associates current settings with the current image
    * so that the next time the image is loaded, it can be saved */
@@ -188,6 +197,9 @@ private:
   // History manager
   HistoryManager *m_HistoryManager;
 
+  // Background thumbnail writer
+  ThumbnailService *m_ThumbnailService;
+
   // Delegate
   static SystemInfoDelegate *m_SystemInfoDelegate;
 
@@ -0,0 +1,324 @@
+#include "ThumbnailService.h"
+#include "UIReporterDelegates.h"
+#include "IRISVectorTypesToITKConversion.h"
+#include <itkImageFileReader.h>
+#include <itkResampleImageFilter.h>
+#include <itkIdentityTransform.h>
+#include <itkFlipImageFilter.h>
+#include <itkUnaryFunctorImageFilter.h>
+#include <itksys/SystemTools.hxx>
+#include <iostream>
+
+struct RemoveTransparencyFunctor
+{
+  typedef ThumbnailService::PixelType PixelType;
+  PixelType operator()(const PixelType &p)
+  {
+    PixelType pnew = p;
+    pnew[3] = 255;
+    return pnew;
+  }
+};
+
+ThumbnailService::ThumbnailService(SystemInfoDelegate *delegate)
+{
+  m_Delegate = delegate;
+  m_CacheSize = 64;
+  m_Writing = false;
+  m_Stop = false;
+
+  // The background thread sleeps until there is something to write
+  m_Thread = std::thread(&ThumbnailService::Run, this);
+}
+
+ThumbnailService::~ThumbnailService()
+{
+  // The thread writes all the waiting thumbnails before it stops, so that
+  // they are not lost when the application exits
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_Wakeup.notify_all();
+  m_Thread.join();
+}
+
+void
+ThumbnailService
+::RequestThumbnail(const std::string &thumb_file, ImageType *slice, unsigned int maxdim)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // Replace an earlier request for the same file that has not been handled
+    // yet, keeping its place in the queue
+    RequestMap::iterator it = m_Pending.find(thumb_file);
+    if(it == m_Pending.end())
+      {
+      it = m_Pending.insert(std::make_pair(thumb_file, Request())).first;
+      m_Queue.push_back(thumb_file);
+      }
+
+    it->second.Slice = slice;
+    it->second.Thumbnail = NULL;
+    it->second.MaxDim = maxdim;
+  }
+  m_Wakeup.notify_all();
+}
+
+SmartPtr<ThumbnailService::ImageType>
+ThumbnailService
+::GetThumbnail(const std::string &thumb_file)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  // If the thumbnail is being rendered, wait until it is in memory
+  while(m_Current == thumb_file)
+    m_Done.wait(lock);
+
+  // A thumbnail that has not been rendered yet is rendered here rather than
+  // waiting for its turn. The background thread then only has to write it
+  RequestMap::iterator itReq = m_Pending.find(thumb_file);
+  if(itReq != m_Pending.end())
+    {
+    Request &req = itReq->second;
+    if(!req.Thumbnail)
+      {
+      try
+        {
+        req.Thumbnail = RenderThumbnail(req.Slice, req.MaxDim);
+        }
+      catch(itk::ExceptionObject &)
+        {
+        return NULL;
+        }
+      catch(std::exception &)
+        {
+        return NULL;
+        }
+      }
+    return req.Thumbnail;
+    }
+
+  // Use the thumbnail in memory unless the file was changed since, for
+  // example by another ITK-SNAP session
+  long file_time = GetFileTime(thumb_file);
+  CacheList::iterator itCache = this->FindInCache(thumb_file);
+  if(itCache != m_Cache.end()
+     && (itCache->FileTime < 0 || itCache->FileTime == file_time))
+    return itCache->Thumbnail;
+
+  // Read the thumbnail from disk
+  if(file_time < 0)
+    return NULL;
+
+  SmartPtr<ImageType> thumbnail;
+  try
+    {
+    typedef itk::ImageFileReader<ImageType> ReaderType;
+    SmartPtr<ReaderType> reader = ReaderType::New();
+    reader->SetFileName(thumb_file.c_str());
+    reader->Update();
+    thumbnail = reader->GetOutput();
+    }
+  catch(itk::ExceptionObject &)
+    {
+    return NULL;
+    }
+
+  this->PutInCache(thumb_file, thumbnail, file_time);
+  return thumbnail;
+}
+
+void ThumbnailService::Flush()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while(m_Queue.size() || m_Writing)
+    m_Done.wait(lock);
+}
+
+void ThumbnailService::SetCacheSize(unsigned int size)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_CacheSize = size;
+  while(m_Cache.size() > m_CacheSize)
+    {
+    m_CacheIndex.erase(m_Cache.back().File);
+    m_Cache.pop_back();
+    }
+}
+
+void ThumbnailService::Run()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while(true)
+    {
+    while(!m_Stop && m_Queue.empty())
+      m_Wakeup.wait(lock);
+
+    if(m_Queue.empty())
+      break;
+
+    // Take the oldest request
+    std::string file = m_Queue.front();
+    m_Queue.pop_front();
+    RequestMap::iterator it = m_Pending.find(file);
+    Request req = it->second;
+    m_Pending.erase(it);
+    m_Current = file;
+    m_Writing = true;
+
+    // Render and write the thumbnail without holding the lock. A thumbnail
+    // that fails is dropped, but the thread must carry on with the others
+    lock.unlock();
+    long file_time = -1;
+    bool rendered = false;
+    try
+      {
+      if(!req.Thumbnail)
+        req.Thumbnail = RenderThumbnail(req.Slice, req.MaxDim);
+      rendered = true;
+
+      // Make it available in memory before it is written, since writing is
+      // what takes the most time
+      lock.lock();
+      this->PutInCache(file, req.Thumbnail, -1);
+      m_Current.clear();
+      m_Done.notify_all();
+      lock.unlock();
+
+      // Write the thumbnail, and record the time of the file
+      m_Delegate->WriteRGBAImage2D(file, req.Thumbnail);
+      file_time = GetFileTime(file);
+      }
+    catch(itk::ExceptionObject &exc)
+      {
+      std::cerr << "Failed to save thumbnail " << file << ": " << exc << std::endl;
+      }
+    catch(std::exception &exc)
+      {
+      std::cerr << "Failed to save thumbnail " << file << ": " << exc.what() << std::endl;
+      }
+
+    if(!lock.owns_lock())
+      lock.lock();
+
+    // Unless the thumbnail was requested again in the meantime
+    if(rendered)
+      {
+      CacheList::iterator itCache = this->FindInCache(file);
+      if(itCache != m_Cache.end() && itCache->Thumbnail == req.Thumbnail)
+        itCache->FileTime = file_time;
+      }
+
+    m_Current.clear();
+    m_Writing = false;
+    m_Done.notify_all();
+    }
+}
+
+ThumbnailService::CacheList::iterator
+ThumbnailService::FindInCache(const std::string &file)
+{
+  CacheIndex::iterator it = m_CacheIndex.find(file);
+  if(it == m_CacheIndex.end())
+    return m_Cache.end();
+
+  // Move the entry to the front of the list
+  m_Cache.splice(m_Cache.begin(), m_Cache, it->second);
+  return it->second;
+}
+
+void
+ThumbnailService
+::PutInCache(const std::string &file, ImageType *thumbnail, long file_time)
+{
+  CacheList::iterator it = this->FindInCache(file);
+  if(it == m_Cache.end())
+    {
+    CacheEntry entry;
+    entry.File = file;
+    m_Cache.push_front(entry);
+    it = m_Cache.begin();
+    m_CacheIndex[file] = it;
+    }
+
+  it->Thumbnail = thumbnail;
+  it->FileTime = file_time;
+
+  // Drop the least recently used thumbnails
+  while(m_Cache.size() > m_CacheSize)
+    {
+    m_CacheIndex.erase(m_Cache.back().File);
+    m_Cache.pop_back();
+    }
+}
+
+long ThumbnailService::GetFileTime(const std::string &file)
+{
+  if(!itksys::SystemTools::FileExists(file.c_str(), true))
+    return -1;
+  return itksys::SystemTools::ModifiedTime(file.c_str());
+}
+
+SmartPtr<ThumbnailService::ImageType>
+ThumbnailService
+::RenderThumbnail(ImageType *slice, unsigned int maxdim)
+{
+  // The size of the slice
+  Vector2ui slice_dim = slice->GetBufferedRegion().GetSize();
+
+  // The physical extents of the slice
+  Vector2d slice_extent(slice->GetSpacing()[0] * slice_dim[0],
+                        slice->GetSpacing()[1] * slice_dim[1]);
+
+  // The output thumbnail will have the extents as the slice, but its size
+  // must be at max maxdim
+  double slice_extent_max = slice_extent.max_value();
+
+  // Create a simple square thumbnail
+  Vector2ui thumb_size(maxdim, maxdim);
+
+  // Spacing is such that the slice extent fits into the thumbnail
+  Vector2d thumb_spacing(slice_extent_max / maxdim,
+                         slice_extent_max / maxdim);
+
+  // The origin of the thumbnail is such that the centers coincide
+  Vector2d thumb_origin(0.5 * (slice_extent[0] - slice_extent_max),
+                        0.5 * (slice_extent[1] - slice_extent_max));
+
+  typedef itk::IdentityTransform<double, 2> TransformType;
+  TransformType::Pointer transform = TransformType::New();
+
+  typedef itk::ResampleImageFilter<ImageType, ImageType> ResampleFilter;
+
+  // Background color for thumbnails
+  unsigned char defrgb[] = {0,0,0,255};
+
+  SmartPtr<ResampleFilter> filter = ResampleFilter::New();
+  filter->SetInput(slice);
+  filter->SetTransform(transform);
+  filter->SetSize(to_itkSize(thumb_size));
+  filter->SetOutputSpacing(thumb_spacing.data_block());
+  filter->SetOutputOrigin(thumb_origin.data_block());
+  filter->SetDefaultPixelValue(PixelType(defrgb));
+
+  // For thumbnails, the image needs to be flipped
+  typedef itk::FlipImageFilter<ImageType> FlipFilter;
+  SmartPtr<FlipFilter> flipper = FlipFilter::New();
+  flipper->SetInput(filter->GetOutput());
+  FlipFilter::FlipAxesArrayType flipaxes;
+  flipaxes[0] = false; flipaxes[1] = true;
+  flipper->SetFlipAxes(flipaxes);
+
+  // We also need to replace the transparency
+  typedef itk::UnaryFunctorImageFilter<
+      ImageType, ImageType, RemoveTransparencyFunctor> OpaqueFilter;
+  SmartPtr<OpaqueFilter> opaquer = OpaqueFilter::New();
+  opaquer->SetInput(flipper->GetOutput());
+
+  // Return the result
+  opaquer->Update();
+  SmartPtr<ImageType> result = opaquer->GetOutput();
+  return result;
+}
@@ -0,0 +1,125 @@
+#ifndef THUMBNAILSERVICE_H
+#define THUMBNAILSERVICE_H
+
+#include "SNAPCommon.h"
+#include <itkRGBAPixel.h>
+#include <itkImage.h>
+#include <string>
+#include <list>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class SystemInfoDelegate;
+
+/**
+ * This class renders the thumbnails shown in the image history and writes
+ * them to disk in a background thread, so that loading and unloading images
+ * does not wait for the thumbnails to be written. The caller hands over a
+ * copy of a display slice, and the service scales it down to a thumbnail and
+ * saves it. If several requests for the same thumbnail file are waiting,
+ * only the most recent one is rendered and written.
+ *
+ * The service also keeps the most recently used thumbnails in memory, so the
+ * history panel does not need to read them from disk each time it is shown.
+ * Thumbnails that are waiting to be written are returned from memory too.
+ */
+class ThumbnailService
+{
+public:
+
+  typedef itk::RGBAPixel<unsigned char>                         PixelType;
+  typedef itk::Image<PixelType, 2>                              ImageType;
+
+  ThumbnailService(SystemInfoDelegate *delegate);
+
+  /** Writes the thumbnails still waiting and stops the background thread */
+  ~ThumbnailService();
+
+  /**
+   * Request a thumbnail of a display slice to be written to a file. The slice
+   * must not be modified after this call, so it should not be connected to a
+   * pipeline. The thumbnail is square, with the size of maxdim.
+   */
+  void RequestThumbnail(const std::string &thumb_file,
+                        ImageType *slice, unsigned int maxdim);
+
+  /**
+   * Get the thumbnail stored in a file. It comes from memory if the file was
+   * requested or read recently, otherwise it is read from disk. Returns NULL
+   * if there is no such thumbnail.
+   */
+  SmartPtr<ImageType> GetThumbnail(const std::string &thumb_file);
+
+  /** Block until all the requested thumbnails have been written */
+  void Flush();
+
+  /** Number of thumbnails kept in memory (default 64) */
+  void SetCacheSize(unsigned int size);
+  unsigned int GetCacheSize() const { return m_CacheSize; }
+
+  /**
+   * Scale a display slice to a square thumbnail with the size of maxdim. The
+   * slice is centered in the thumbnail, flipped for saving as an image, and
+   * made opaque.
+   */
+  static SmartPtr<ImageType> RenderThumbnail(ImageType *slice, unsigned int maxdim);
+
+protected:
+
+  // A request that has not been written yet. The thumbnail is rendered by
+  // the background thread, unless it was needed by GetThumbnail before
+  struct Request
+  {
+    SmartPtr<ImageType> Slice;
+    SmartPtr<ImageType> Thumbnail;
+    unsigned int MaxDim;
+  };
+
+  // A thumbnail in memory, with the modification time of its file when it
+  // was read or written, or -1 if it has not been written yet
+  struct CacheEntry
+  {
+    std::string File;
+    SmartPtr<ImageType> Thumbnail;
+    long FileTime;
+  };
+
+  typedef std::map<std::string, Request> RequestMap;
+  typedef std::list<CacheEntry> CacheList;
+  typedef std::map<std::string, CacheList::iterator> CacheIndex;
+
+  // Requests by file, and the order in which the files were requested. A
+  // file is in the queue once, however many times it was requested
+  RequestMap m_Pending;
+  std::list<std::string> m_Queue;
+
+  // The file being rendered by the background thread, and whether the
+  // thread is busy with a request
+  std::string m_Current;
+  bool m_Writing;
+
+  // Thumbnails in memory, most recently used first
+  CacheList m_Cache;
+  CacheIndex m_CacheIndex;
+  unsigned int m_CacheSize;
+
+  SystemInfoDelegate *m_Delegate;
+
+  std::thread m_Thread;
+  std::mutex m_Mutex;
+  std::condition_variable m_Wakeup, m_Done;
+  bool m_Stop;
+
+  // Main loop of the background thread
+  void Run();
+
+  // These must be called with the mutex held
+  CacheList::iterator FindInCache(const std::string &file);
+  void PutInCache(const std::string &file, ImageType *thumbnail, long file_time);
+
+  static long GetFileTime(const std::string &file);
+};
+
+#endif // THUMBNAILSERVICE_H
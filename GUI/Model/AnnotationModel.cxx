@@ -59,7 +59,8 @@ double AnnotationModel::GetAngleWithCurrentLine(const annot::LineSegmentAnnotati
 
 void AnnotationModel::AdjustAngleToRoundDegree(LineSegment &line, int n_degrees)
 {
-  ImageAnnotationData *adata = this->GetAnnotations();
+  ImageAnnotationData::AnnotationVector visible;
+  this->GetAnnotationsInCurrentSlice(visible);
 
   // Map the line segment from slice coordinates to window physical, where angles are
   // computed
@@ -74,13 +75,13 @@ void AnnotationModel::AdjustAngleToRoundDegree(LineSegment &line, int n_degrees)
   Vector2d p2_rot_best = p2;
   double rot_best = std::numeric_limits<double>::infinity();
 
-  // Loop over all the lines
-  for(ImageAnnotationData::AnnotationConstIterator it = adata->GetAnnotations().begin();
-      it != adata->GetAnnotations().end(); ++it)
+  // Loop over all the lines in this slice
+  for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+      it != visible.end(); ++it)
     {
     const annot::LineSegmentAnnotation *lsa =
-        dynamic_cast<const annot::LineSegmentAnnotation *>(it->GetPointer());
-    if(lsa && this->IsAnnotationVisible(lsa))
+        dynamic_cast<const annot::LineSegmentAnnotation *>(*it);
+    if(lsa)
       {
       // Normalize the annotated line
       Vector2d q1 = m_Parent->MapSliceToPhysicalWindow(
@@ -172,6 +173,13 @@ bool AnnotationModel::IsAnnotationVisible(const AnnotationModel::AbstractAnnotat
         m_Parent->GetSliceIndex());
 }
 
+void AnnotationModel::GetAnnotationsInCurrentSlice(ImageAnnotationData::AnnotationVector &out) const
+{
+  this->GetAnnotations()->GetAnnotationsInSlice(
+        m_Parent->GetSliceDirectionInImageSpace(),
+        m_Parent->GetSliceIndex(), out);
+}
+
 double AnnotationModel
 ::GetPixelDistanceToAnnotation(
     const AbstractAnnotation *annot,
@@ -201,28 +209,24 @@ double AnnotationModel
 AnnotationModel::AbstractAnnotation *
 AnnotationModel::GetAnnotationUnderCursor(const Vector3d &xSlice)
 {
-  ImageAnnotationData *adata = this->GetAnnotations();
+  ImageAnnotationData::AnnotationVector visible;
+  this->GetAnnotationsInCurrentSlice(visible);
 
   // Current best annotation
   AbstractAnnotation *asel = NULL;
   double dist_min = std::numeric_limits<double>::infinity();
   double dist_thresh = 5 * m_Parent->GetSizeReporter()->GetViewportPixelRatio();
 
-  // Loop over all annotations
-  for(ImageAnnotationData::AnnotationConstIterator it = adata->GetAnnotations().begin();
-      it != adata->GetAnnotations().end(); ++it)
+  // Loop over the annotations visible in this slice
+  for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+      it != visible.end(); ++it)
     {
     AbstractAnnotation *a = *it;
-
-    // Test if annotation is visible in this plane
-    if(this->IsAnnotationVisible(a))
+    double dist = GetPixelDistanceToAnnotation(a, xSlice);
+    if(dist < dist_thresh && dist < dist_min)
       {
-      double dist = GetPixelDistanceToAnnotation(a, xSlice);
-      if(dist < dist_thresh && dist < dist_min)
-        {
-        asel = a;
-        dist_min = dist;
-        }
+      asel = a;
+      dist_min = dist;
       }
     }
 
@@ -336,22 +340,25 @@ bool AnnotationModel::ProcessMoveEvent(const Vector3d &xSlice, bool shift_mod, b
     Vector3d p_now = m_Parent->MapSliceToImage(xSlice);
     Vector3d p_delta = p_now - p_last;
 
-    // Process the move command on selected annotations
-    for(ImageAnnotationData::AnnotationIterator it = adata->GetAnnotations().begin();
-        it != adata->GetAnnotations().end(); ++it)
+    // Process the move command on selected annotations in this slice
+    ImageAnnotationData::AnnotationVector visible;
+    this->GetAnnotationsInCurrentSlice(visible);
+    for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+        it != visible.end(); ++it)
       {
       AbstractAnnotation *a = *it;
 
-      // Test if annotation is visible in this plane
-      if(m_MovingSelectionHandle < 0 && a->GetSelected() && this->IsAnnotationVisible(a))
+      if(m_MovingSelectionHandle < 0 && a->GetSelected())
         {
         // Move the annotation by this amount
         a->MoveBy(p_delta);
+        adata->UpdateAnnotation(a);
         }
       else if(m_MovingSelectionHandle >= 0 && m_MovingSelectionHandleAnnot == a)
         {
         // Move the annotation handle by this amount
         this->MoveAnnotationHandle(a, m_MovingSelectionHandle, p_delta);
+        adata->UpdateAnnotation(a);
         }
       }
 
@@ -453,17 +460,12 @@ void AnnotationModel::CancelLine()
 
 void AnnotationModel::SelectAllOnSlice()
 {
-  ImageAnnotationData *adata = this->GetAnnotations();
-  for(ImageAnnotationData::AnnotationIterator it = adata->GetAnnotations().begin();
-      it != adata->GetAnnotations().end(); ++it)
+  ImageAnnotationData::AnnotationVector visible;
+  this->GetAnnotationsInCurrentSlice(visible);
+  for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+      it != visible.end(); ++it)
     {
-    AbstractAnnotation *a = *it;
-
-    // Test if annotation is visible in this plane
-    if(this->IsAnnotationVisible(a))
-      {
-      a->SetSelected(true);
-      }
+    (*it)->SetSelected(true);
     }
 
   this->InvokeEvent(ModelUpdateEvent());
@@ -472,18 +474,13 @@ void AnnotationModel::SelectAllOnSlice()
 void AnnotationModel::DeleteSelectedOnSlice()
 {
   ImageAnnotationData *adata = this->GetAnnotations();
-  for(ImageAnnotationData::AnnotationIterator it = adata->GetAnnotations().begin();
-      it != adata->GetAnnotations().end(); )
+  ImageAnnotationData::AnnotationVector visible;
+  this->GetAnnotationsInCurrentSlice(visible);
+  for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+      it != visible.end(); ++it)
     {
-    AbstractAnnotation *a = *it;
-
-    // Test if annotation is visible in this plane
-    if(a->GetSelected() && this->IsAnnotationVisible(a))
-      {
-      it = adata->GetAnnotations().erase(it);
-      }
-    else
-      ++it;
+    if((*it)->GetSelected())
+      adata->RemoveAnnotation(*it);
     }
 
   this->InvokeEvent(ModelUpdateEvent());
@@ -492,14 +489,15 @@ void AnnotationModel::DeleteSelectedOnSlice()
 AnnotationModel::AbstractAnnotation *
 AnnotationModel::GetSingleSelectedAnnotation() const
 {
-  ImageAnnotationData *adata = this->GetAnnotations();
+  ImageAnnotationData::AnnotationVector visible;
+  this->GetAnnotationsInCurrentSlice(visible);
   AbstractAnnotation *last_sel = NULL;
   unsigned int n_found = 0;
-  for(ImageAnnotationData::AnnotationIterator it = adata->GetAnnotations().begin();
-      it != adata->GetAnnotations().end(); it++)
+  for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+      it != visible.end(); it++)
     {
     AbstractAnnotation *a = *it;
-    if(a->GetSelected() && this->IsAnnotationVisible(a))
+    if(a->GetSelected())
       {
       n_found++;
       last_sel = a;
@@ -514,13 +512,32 @@ AnnotationModel::GetAnnotationCount(bool filter_selected, bool filter_visible) c
 {
   ImageAnnotationData *adata = this->GetAnnotations();
   unsigned int n_found = 0;
-  for(ImageAnnotationData::AnnotationIterator it = adata->GetAnnotations().begin();
+
+  // Visible annotations are looked up in the spatial index
+  if(filter_visible)
+    {
+    ImageAnnotationData::AnnotationVector visible;
+    this->GetAnnotationsInCurrentSlice(visible);
+    for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+        it != visible.end(); it++)
+      {
+      AbstractAnnotation *a = *it;
+      if(a->GetPlane() == m_Parent->GetSliceDirectionInImageSpace()
+         && (!filter_selected || a->GetSelected()))
+        {
+        n_found++;
+        }
+      }
+
+    return n_found;
+    }
+
+  for(ImageAnnotationData::AnnotationConstIterator it = adata->GetAnnotations().begin();
       it != adata->GetAnnotations().end(); it++)
     {
     AbstractAnnotation *a = *it;
     if(a->GetPlane() == m_Parent->GetSliceDirectionInImageSpace()
-       && (!filter_selected || a->GetSelected())
-       && (!filter_visible || this->IsAnnotationVisible(a)))
+       && (!filter_selected || a->GetSelected()))
       {
       n_found++;
       }
@@ -554,7 +571,7 @@ void AnnotationModel::GoToNextOrPrevAnnotation(int direction)
 
   // Iterate through the annotations
   ImageAnnotationData *adata = this->GetAnnotations();
-  for(ImageAnnotationData::AnnotationIterator it = adata->GetAnnotations().begin();
+  for(ImageAnnotationData::AnnotationConstIterator it = adata->GetAnnotations().begin();
       it != adata->GetAnnotations().end(); ++it)
     {
     AbstractAnnotation *a = *it;
@@ -643,7 +660,7 @@ void AnnotationModel::GoToNextOrPrevAnnotation(int direction)
     }
 
   // Deselect everything
-  for(ImageAnnotationData::AnnotationIterator it = adata->GetAnnotations().begin();
+  for(ImageAnnotationData::AnnotationConstIterator it = adata->GetAnnotations().begin();
       it != adata->GetAnnotations().end(); ++it)
     {
     (*it)->SetSelected(false);
@@ -787,18 +804,19 @@ void AnnotationModel::SetSelectedAnnotationColorValue(Vector3ui value)
 annot::AbstractAnnotation *
 AnnotationModel::GetSelectedHandleUnderCusror(const Vector3d &xSlice, int &out_handle)
 {
-  // Get the annotation data
-  ImageAnnotationData *adata = this->GetAnnotations();
+  // Get the annotations in this slice
+  ImageAnnotationData::AnnotationVector visible;
+  this->GetAnnotationsInCurrentSlice(visible);
 
   out_handle = -1;
-  for(ImageAnnotationData::AnnotationConstIterator it = adata->GetAnnotations().begin();
-      it != adata->GetAnnotations().end(); ++it)
+  for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+      it != visible.end(); ++it)
     {
-    if(this->IsAnnotationVisible(*it) && (*it)->GetSelected())
+    if((*it)->GetSelected())
       {
       // Draw all the line segments
       annot::LineSegmentAnnotation *lsa =
-          dynamic_cast<annot::LineSegmentAnnotation *>(it->GetPointer());
+          dynamic_cast<annot::LineSegmentAnnotation *>(*it);
       if(lsa)
         {
         // Draw the line
@@ -813,7 +831,7 @@ AnnotationModel::GetSelectedHandleUnderCusror(const Vector3d &xSlice, int &out_h
         }
 
       annot::LandmarkAnnotation *lma =
-          dynamic_cast<annot::LandmarkAnnotation *>(it->GetPointer());
+          dynamic_cast<annot::LandmarkAnnotation *>(*it);
       if(lma)
         {
         Vector3d xHeadSlice, xTailSlice;
@@ -828,7 +846,7 @@ AnnotationModel::GetSelectedHandleUnderCusror(const Vector3d &xSlice, int &out_h
         }
 
       if(out_handle >= 0)
-        return it->GetPointer();
+        return *it;
       }
     }
 
@@ -91,6 +91,9 @@ public:
   /** Test if an annotation is visible in this slice */
   bool IsAnnotationVisible(const AbstractAnnotation *annot) const;
 
+  /** Get the annotations visible in this slice, using the spatial index */
+  void GetAnnotationsInCurrentSlice(ImageAnnotationData::AnnotationVector &out) const;
+
 
   bool ProcessPushEvent(const Vector3d &xSlice, bool shift_mod);
 
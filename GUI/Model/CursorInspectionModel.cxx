@@ -35,10 +35,13 @@ CurrentVoxelInfoItemSetDomain
   // Make sure that the layer is initialized
   if(it.GetLayer()->IsInitialized())
     {
-    // Get the intensity under the cursor for this layer
+    // Get the intensity under the cursor for this layer. All layers are
+    // sampled together on the first call and cached until the cursor moves
     vnl_vector<double> v;
     ImageWrapperBase::DisplayPixelType disprgb;
-    it.GetLayer()->GetVoxelUnderCursorDisplayedValueAndAppearance(v, disprgb);
+    GenericImageData *gid = m_Driver->GetCurrentImageData();
+    if(!gid->GetLayerSampleAtCursor(it.GetLayer(), v, disprgb))
+      it.GetLayer()->GetVoxelUnderCursorDisplayedValueAndAppearance(v, disprgb);
 
     // Use good old sprintf!
     char buffer[64];
@@ -15,6 +15,7 @@
 #include "MeshOptions.h"
 #include "ImageWrapperTraits.h"
 #include "SegmentationUpdateIterator.h"
+#include <algorithm>
 
 // All the VTK stuff
 #include "vtkPolyData.h"
@@ -246,6 +247,14 @@ bool Generic3DModel::IsMeshUpdating()
   return m_MeshUpdating;
 }
 
+// Order of voxels in the image buffer, used to merge spray paint into runs
+static bool SprayVoxelBefore(const itk::Index<3> &a, const itk::Index<3> &b)
+{
+  if(a[2] != b[2]) return a[2] < b[2];
+  if(a[1] != b[1]) return a[1] < b[1];
+  return a[0] < b[0];
+}
+
 bool Generic3DModel::AcceptAction()
 {
   ToolbarMode3DType mode = m_ParentUI->GetGlobalState()->GetToolbarMode3D();
@@ -261,19 +270,42 @@ bool Generic3DModel::AcceptAction()
     // Anything to update?
     bool update = false;
 
-    // Merge all the spray points into the segmentation
+    // Find the voxels hit by the spray points, sorted in the order of the
+    // image buffer and without duplicates
+    typedef itk::Index<3> IndexType;
+    std::vector<IndexType> voxels;
+    voxels.reserve(m_SprayPoints->GetNumberOfPoints());
     for(int i = 0; i < m_SprayPoints->GetNumberOfPoints(); i++)
       {
       // Find the point in image coordinates
       double *x = m_SprayPoints->GetPoint(i);
+      IndexType idx;
+      idx[0] = static_cast<unsigned int>(x[0]);
+      idx[1] = static_cast<unsigned int>(x[1]);
+      idx[2] = static_cast<unsigned int>(x[2]);
+      voxels.push_back(idx);
+      }
+
+    std::sort(voxels.begin(), voxels.end(), SprayVoxelBefore);
+    voxels.erase(std::unique(voxels.begin(), voxels.end()), voxels.end());
+
+    // Merge the voxels into the segmentation, treating each run of adjacent
+    // voxels along a scanline as one region update
+    for(size_t i = 0; i < voxels.size(); )
+      {
+      size_t j = i + 1;
+      while(j < voxels.size() && voxels[j][2] == voxels[i][2] && voxels[j][1] == voxels[i][1]
+            && voxels[j][0] == voxels[j-1][0] + 1)
+        j++;
 
-      // Create a region around this one voxel (in the future could use other shapes)
       SegmentationUpdateIterator::RegionType region;
-      region.SetIndex(0, static_cast<unsigned int>(x[0])); region.SetSize(0, 1);
-      region.SetIndex(1, static_cast<unsigned int>(x[1])); region.SetSize(1, 1);
-      region.SetIndex(2, static_cast<unsigned int>(x[2])); region.SetSize(2, 1);
+      region.SetIndex(voxels[i]);
+      region.SetSize(0, j - i);
+      region.SetSize(1, 1);
+      region.SetSize(2, 1);
+      i = j;
 
-      // Treat each point as a region update
+      // Treat each run as a region update
       SegmentationUpdateIterator it(imSeg, region,
                                     app->GetGlobalState()->GetDrawingColorLabel(),
                                     app->GetGlobalState()->GetDrawOverFilter());
@@ -424,9 +456,9 @@ bool Generic3DModel::IntersectSegmentation(int vx, int vy, Vector3i &hit)
     RayCasterType caster;
     LabelImageHitTester tester(m_ParentUI->GetDriver()->GetColorLabelTable());
     caster.SetHitTester(tester);
+    LabelImageWrapper *seg = m_ParentUI->GetDriver()->GetSelectedSegmentationLayer();
     result = caster.FindIntersection(
-          m_ParentUI->GetDriver()->GetSelectedSegmentationLayer()->GetImage(),
-          x_image, d_image, hit);
+          seg->GetImage(), seg->GetOccupancyPyramid(), x_image, d_image, hit);
     }
 
   return (result == 1);
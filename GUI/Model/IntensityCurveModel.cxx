@@ -95,8 +95,13 @@ IntensityCurveModel
   // have to be stored in the ImageWrapper.
   if(p.IsFirstTime())
     {
-    // Set the cutoff automatically
-    const ScalarImageHistogram *hist = layer->GetHistogram(0);
+    // Set the cutoff automatically. A histogram of sampled voxels is good
+    // enough for this, so there is no need to compute the exact histogram
+    AbstractContinuousImageDisplayMappingPolicy *dmp =
+        dynamic_cast<AbstractContinuousImageDisplayMappingPolicy *>(
+          layer->GetDisplayMapping());
+    const ScalarImageHistogram *hist =
+        dmp ? dmp->GetAvailableHistogram(0) : layer->GetHistogram(0);
     p.SetHistogramCutoff(hist->GetReasonableDisplayCutoff(0.95, 0.6));
     p.SetFirstTime(false);
     }
@@ -118,13 +123,10 @@ IntensityCurveModel
 }
 
 
-const ScalarImageHistogram *
+unsigned int
 IntensityCurveModel
-::GetHistogram()
+::GetHistogramBinCount()
 {
-  AbstractContinuousImageDisplayMappingPolicy *dmp = this->GetDisplayPolicy();
-  assert(dmp);
-
   // Get the properties for the layer
   IntensityCurveLayerProperties *p = m_LayerProperties[m_Layer];
 
@@ -136,8 +138,38 @@ IntensityCurveModel
     nBins = width / p->GetHistogramBinSize();
     }
 
-  // Get the histogram
-  return dmp->GetHistogram(nBins);
+  return nBins;
+}
+
+const ScalarImageHistogram *
+IntensityCurveModel
+::GetHistogram()
+{
+  AbstractContinuousImageDisplayMappingPolicy *dmp = this->GetDisplayPolicy();
+  assert(dmp);
+
+  // Get the exact histogram if it is ready, or else the sampled histogram
+  return dmp->GetAvailableHistogram(this->GetHistogramBinCount());
+}
+
+bool
+IntensityCurveModel
+::IsHistogramApproximate()
+{
+  AbstractContinuousImageDisplayMappingPolicy *dmp = this->GetDisplayPolicy();
+  return dmp && !dmp->IsExactHistogramAvailable(this->GetHistogramBinCount());
+}
+
+void
+IntensityCurveModel
+::RefineHistogram()
+{
+  if(this->IsHistogramApproximate())
+    {
+    // Compute the exact histogram and let the renderer pick it up
+    this->GetDisplayPolicy()->GetHistogram(this->GetHistogramBinCount());
+    this->InvokeEvent(ModelUpdateEvent());
+    }
 }
 
 IntensityCurveLayerProperties::IntensityCurveLayerProperties()
@@ -128,10 +128,23 @@ public:
   bool CheckState(UIState state);
 
   /**
-    Get the histogram of the current layer
+    Get the histogram of the current layer. If the histogram has not been
+    computed yet, this returns a histogram of a sample of the voxels
     */
   const ScalarImageHistogram *GetHistogram();
 
+  /**
+    Whether the histogram returned by GetHistogram() is computed from a
+    sample of the voxels rather than from the whole image
+    */
+  bool IsHistogramApproximate();
+
+  /**
+    Compute the exact histogram if GetHistogram() currently returns an
+    approximate one, and notify the views that it has changed
+    */
+  void RefineHistogram();
+
   /**
     Process curve interaction event
     */
@@ -179,6 +192,9 @@ protected:
 
   AbstractContinuousImageDisplayMappingPolicy *GetDisplayPolicy();
 
+  // Number of histogram bins that fit into the viewport
+  unsigned int GetHistogramBinCount();
+
   // A size reporter delegate
   ViewportSizeReporter *m_ViewportReporter;
 
@@ -87,33 +87,39 @@ void InterpolateLabelModel::Interpolate()
   // Update the filter
   mci->Update();
   
-  // Apply the labels back to the segmentation
-  SegmentationUpdateIterator it_trg(liw->GetImage(), liw->GetImage()->GetBufferedRegion(),
+  // Apply the labels back to the segmentation, in parallel slabs that each
+  // cover their own run-length lines of the segmentation
+  ParallelSegmentationUpdate update(liw->GetImage(), liw->GetImage()->GetBufferedRegion(),
                                     this->GetDrawingLabel(), this->GetDrawOverFilter());
 
-  itk::ImageRegionConstIterator<GenericImageData::LabelImageType>
-      it_src(mci->GetOutput(), mci->GetOutput()->GetBufferedRegion());
+  LabelType l_interp = this->GetInterpolateLabel();
+  LabelType l_replace = this->GetDrawingLabel();
 
-  // The way we paint back into the segmentation depends on whether all labels
-  // or a specific label are being interpolated
-  if(interp_all)
-    {
-    // Just replace the segmentation by the interpolation, respecting draw-over
-    for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
-      it_trg.PaintLabel(it_src.Get());
-    }
-  else
+#pragma omp parallel for
+  for(int i = 0; i < update.GetNumberOfSlabs(); i++)
     {
-    LabelType l_interp = this->GetInterpolateLabel();
-    LabelType l_replace = this->GetDrawingLabel();
-    for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
-      if(it_src.Get() == l_interp)
-        it_trg.PaintLabelWithExtraProtection(l_interp, l_replace);
+    SegmentationUpdateIterator &it_trg = update.GetSlabIterator(i);
+    itk::ImageRegionConstIterator<GenericImageData::LabelImageType>
+        it_src(mci->GetOutput(), update.GetSlabRegion(i));
+
+    // The way we paint back into the segmentation depends on whether all labels
+    // or a specific label are being interpolated
+    if(interp_all)
+      {
+      // Just replace the segmentation by the interpolation, respecting draw-over
+      for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
+        it_trg.PaintLabel(it_src.Get());
+      }
+    else
+      {
+      for(; !it_trg.IsAtEnd(); ++it_trg, ++it_src)
+        if(it_src.Get() == l_interp)
+          it_trg.PaintLabelWithExtraProtection(l_interp, l_replace);
+      }
     }
 
   // Finish the segmentation editing and create an undo point
-  it_trg.Finalize();
-  liw->StoreUndoPoint("Interpolate label", it_trg.RelinquishDelta());
+  update.Commit(liw, "Interpolate label");
 
   // Fire event to inform GUI that segmentation has changed
   this->m_Parent->GetDriver()->InvokeEvent(SegmentationChangeEvent());
@@ -14,14 +14,31 @@
 
 
 // TODO: move this into a separate file!!!!
+/**
+ * The watershed pipeline behind the adaptive paintbrush. The watersheds are
+ * computed over a block of tiles around the brush, and the smoothed gradient
+ * and the merge tree of the watershed filter are kept between brush strokes.
+ * As long as the brush stays inside the block, and the image and smoothing
+ * do not change, a stroke only needs to re-threshold the merge tree at the
+ * current level (the watershed filter only reruns its relabeler when only
+ * the level changes), so dragging the brush costs about the same as dragging
+ * the regular brush.
+ *
+ * The level is relative to the deepest watershed merge in the whole block,
+ * not just in the brush region, so the same granularity can split or merge
+ * the segments a little differently than a pipeline restricted to the brush.
+ */
 class BrushWatershedPipeline
 {
 public:
   typedef itk::Image<GreyType, 3> GreyImageType;
-  typedef LabelImageWrapperTraits::ImageType LabelImageType;
   typedef itk::Image<float, 3> FloatImageType;
   typedef itk::Image<itk::IdentifierType, 3> WatershedImageType;
   typedef WatershedImageType::IndexType IndexType;
+  typedef itk::ImageRegion<3> RegionType;
+
+  // Size of the tiles into which the image is divided
+  static const long TileSize = 16;
 
   BrushWatershedPipeline()
     {
@@ -33,61 +50,93 @@ public:
     gmf->SetInput(adf->GetOutput());
     wf = WFType::New();
     wf->SetInput(gmf->GetOutput());
+
+    cachedGrey = NULL;
+    cachedGreyMTime = 0;
+    cachedSmoothingIter = 0;
+    wctr = 0;
     }
 
-  void PrecomputeWatersheds(
+  /**
+   * Make sure the watersheds cover the brush region, recomputing them over
+   * the block of tiles that contains the region if needed. Returns true if
+   * the watersheds were recomputed.
+   */
+  bool PrecomputeWatersheds(
     GreyImageType *grey,
-    LabelImageType *label,
-    itk::ImageRegion<3> region,
+    RegionType region,
     itk::Index<3> vcenter,
     size_t smoothing_iter)
     {
-    this->region = region;
+    bool recompute =
+        grey != cachedGrey
+        || grey->GetMTime() != cachedGreyMTime
+        || smoothing_iter != cachedSmoothingIter
+        || !block.IsInside(region);
 
-    // Get the offset of vcenter in the region
-    if(region.IsInside(vcenter))
+    if(recompute)
+      {
+      // Expand the brush region to whole tiles. Along an axis where the brush
+      // is flat (drawing in 2D), the block stays one voxel thick
+      block = region;
       for(size_t d = 0; d < 3; d++)
-        this->vcenter[d] = vcenter[d] - region.GetIndex()[d];
-    else
+        {
+        if(region.GetSize()[d] > 1)
+          {
+          long i0 = region.GetIndex()[d], i1 = i0 + (long) region.GetSize()[d];
+          i0 = TileSize * (long) floor(i0 / (double) TileSize);
+          i1 = TileSize * (long) ceil(i1 / (double) TileSize);
+          block.SetIndex(d, i0);
+          block.SetSize(d, i1 - i0);
+          }
+        }
+      block.Crop(grey->GetBufferedRegion());
+
+      // Initialize the watershed pipeline
+      roi->SetInput(grey);
+      roi->SetRegionOfInterest(block);
+      adf->SetNumberOfIterations(smoothing_iter);
+
+      // Set the initial level to lowest possible - to get all watersheds
+      wf->SetLevel(1.0);
+      wf->Update();
+
+      cachedGrey = grey;
+      cachedGreyMTime = grey->GetMTime();
+      cachedSmoothingIter = smoothing_iter;
+      }
+
+    // Get the offset of vcenter in the block
+    if(!block.IsInside(vcenter))
       for(size_t d = 0; d < 3; d++)
-        this->vcenter[d] = region.GetSize()[d] / 2;
-
-    // Create a backup of the label image
-    LROIType::Pointer lroi = LROIType::New();
-    lroi->SetInput(label);
-    lroi->SetRegionOfInterest(region);
-    lroi->Update();
-    lsrc = lroi->GetOutput();
-    lsrc->DisconnectPipeline();
-
-    // Initialize the watershed pipeline
-    roi->SetInput(grey);
-    roi->SetRegionOfInterest(region);
-    adf->SetNumberOfIterations(smoothing_iter);
-
-    // Set the initial level to lowest possible - to get all watersheds
-    wf->SetLevel(1.0);
-    wf->Update();
+        vcenter[d] = region.GetIndex()[d] + region.GetSize()[d] / 2;
+    for(size_t d = 0; d < 3; d++)
+      this->vcenter[d] = vcenter[d] - block.GetIndex()[d];
+
+    return recompute;
     }
 
   void RecomputeWatersheds(double level)
     {
-    // Reupdate the filter with new level
+    // Reupdate the filter with new level. This only relabels the existing
+    // watersheds using the merge tree, unless the input has changed
     wf->SetLevel(level);
     wf->Update();
+
+    // Get the watershed ID at the center voxel
+    wctr = wf->GetOutput()->GetPixel(vcenter);
     }
 
+  /** Test whether a voxel (in image coordinates) is in the center watershed */
   bool IsPixelInSegmentation(IndexType idx)
     {
-    // Get the watershed ID at the center voxel
-    unsigned long wctr = wf->GetOutput()->GetPixel(vcenter);
-    unsigned long widx = wf->GetOutput()->GetPixel(idx);
-    return wctr == widx;
+    for(size_t d = 0; d < 3; d++)
+      idx[d] -= block.GetIndex()[d];
+    return wf->GetOutput()->GetPixel(idx) == wctr;
     }
 
 private:
   typedef itk::RegionOfInterestImageFilter<GreyImageType, FloatImageType> ROIType;
-  typedef itk::RegionOfInterestImageFilter<LabelImageType, LabelImageType> LROIType;
   typedef itk::GradientAnisotropicDiffusionImageFilter<FloatImageType,FloatImageType> ADFType;
   typedef itk::GradientMagnitudeImageFilter<FloatImageType, FloatImageType> GMFType;
   typedef itk::WatershedImageFilter<FloatImageType> WFType;
@@ -97,9 +146,15 @@ private:
   GMFType::Pointer gmf;
   WFType::Pointer wf;
 
-  itk::ImageRegion<3> region;
-  LabelImageType::Pointer lsrc;
+  // Block of tiles over which the watersheds are computed
+  RegionType block;
   itk::Index<3> vcenter;
+  itk::IdentifierType wctr;
+
+  // The state of the inputs when the watersheds were computed
+  GreyImageType *cachedGrey;
+  itk::ModifiedTimeType cachedGreyMTime;
+  size_t cachedSmoothingIter;
 };
 
 
@@ -220,7 +275,7 @@ PaintbrushModel
     ComputeMousePosition(xSlice);
 
     // Check if the right button was pressed
-    ApplyBrush(reverse_mode, false);
+    ApplyBrush(reverse_mode);
 
     // Store the reverse mode
     m_ReverseMode = reverse_mode;
@@ -249,38 +304,34 @@ PaintbrushModel
 
   if(m_IsEngaged)
     {
-    // The behavior is different for 'fast' regular brushes and adaptive brush. For the
-    // adaptive brush, dragging is disabled.
-    if(pbs.mode != PAINTBRUSH_WATERSHED || m_ReverseMode)
+    // See how much we have moved since the last event. If we moved more than
+    // the value of the radius, we interpolate the path and place brush strokes
+    // along the path. The adaptive brush reuses its watersheds along the path
+    // until it leaves the tiles they were computed for
+    if(pixelsMoved > pbs.radius)
       {
-      // See how much we have moved since the last event. If we moved more than
-      // the value of the radius, we interpolate the path and place brush strokes
-      // along the path
-      if(pixelsMoved > pbs.radius)
+      // Break up the path into steps
+      size_t nSteps = (int) ceil(pixelsMoved / pbs.radius);
+      for(size_t i = 0; i < nSteps; i++)
         {
-        // Break up the path into steps
-        size_t nSteps = (int) ceil(pixelsMoved / pbs.radius);
-        for(size_t i = 0; i < nSteps; i++)
-          {
-          double t = (1.0 + i) / nSteps;
-          Vector3d X = t * m_LastApplyX + (1.0 - t) * xSlice;
-          ComputeMousePosition(X);
-          ApplyBrush(m_ReverseMode, true);
-          }
-        }
-      else
-        {
-        // Find the pixel under the mouse
-        ComputeMousePosition(xSlice);
-
-        // Scan convert the points into the slice
-        ApplyBrush(m_ReverseMode, true);
+        double t = (1.0 + i) / nSteps;
+        Vector3d X = t * m_LastApplyX + (1.0 - t) * xSlice;
+        ComputeMousePosition(X);
+        ApplyBrush(m_ReverseMode);
         }
+      }
+    else
+      {
+      // Find the pixel under the mouse
+      ComputeMousePosition(xSlice);
 
-      // Store this as the last apply position
-      m_LastApplyX = xSlice;
+      // Scan convert the points into the slice
+      ApplyBrush(m_ReverseMode);
       }
 
+    // Store this as the last apply position
+    m_LastApplyX = xSlice;
+
     // If the mouse is being released, we need to commit the drawing
     if(release)
       {
@@ -323,7 +374,7 @@ void PaintbrushModel::AcceptAtCursor()
 
   m_MousePosition = m_Parent->GetDriver()->GetCursorPosition();
   m_MouseInside = true;
-  ApplyBrush(false, false);
+  ApplyBrush(false);
 
   // We need to commit the drawing
   driver->GetSelectedSegmentationLayer()->StoreUndoPoint("Drawing with paintbrush");
@@ -335,7 +386,7 @@ void PaintbrushModel::AcceptAtCursor()
 }
 
 bool
-PaintbrushModel::ApplyBrush(bool reverse_mode, bool dragging)
+PaintbrushModel::ApplyBrush(bool reverse_mode)
 {
   // Get the global objects
   IRISApplication *driver = m_Parent->GetDriver();
@@ -354,8 +405,7 @@ PaintbrushModel::ApplyBrush(bool reverse_mode, bool dragging)
 
   // Whether watershed filter is used (adaptive brush)
   bool flagWatershed = (
-        pbs.mode == PAINTBRUSH_WATERSHED
-        && (!reverse_mode) && (!dragging));
+        pbs.mode == PAINTBRUSH_WATERSHED && (!reverse_mode));
 
   // Define a region of interest
   LabelImageWrapper::ImageType::RegionType xTestRegion;
@@ -391,7 +441,6 @@ PaintbrushModel::ApplyBrush(bool reverse_mode, bool dragging)
     // Precompute the watersheds
     m_Watershed->PrecomputeWatersheds(
           context_layer->GetDefaultScalarRepresentation()->GetCommonFormatImage(),
-          driver->GetSelectedSegmentationLayer()->GetImage(),
           xTestRegion, to_itkIndex(m_MousePosition), pbs.watershed.smooth_iterations);
 
     m_Watershed->RecomputeWatersheds(pbs.watershed.level);
@@ -423,9 +472,7 @@ PaintbrushModel::ApplyBrush(bool reverse_mode, bool dragging)
     // Check if the pixel is in the watershed
     if(flagWatershed)
       {
-      LabelImageWrapper::ImageType::IndexType idxoff = to_itkIndex(
-        Vector3l(idx.GetIndex()) - Vector3l(xTestRegion.GetIndex().GetIndex()));
-      if(!m_Watershed->IsPixelInSegmentation(idxoff))
+      if(!m_Watershed->IsPixelInSegmentation(idx))
         continue;
       }
 
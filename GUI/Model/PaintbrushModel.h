@@ -61,7 +61,7 @@ protected:
   Vector3d ComputeOffset();
   void ComputeMousePosition(const Vector3d &xSlice);
 
-  bool ApplyBrush(bool reverse_mode, bool dragging);
+  bool ApplyBrush(bool reverse_mode);
   bool TestInside(const Vector2d &x, const PaintbrushSettings &ps);
   bool TestInside(const Vector3d &x, const PaintbrushSettings &ps);
 
@@ -28,8 +28,9 @@ struct IPCMessage
   // 3D camera state
   CameraState camera;
 
-  // Version of the data structure
-  enum VersionEnum { VERSION = 0x1005 };
+  // Version of the data structure. This also keys the shared memory, so it
+  // is changed when the layout of the shared memory changes too
+  enum VersionEnum { VERSION = 0x1006 };
 };
 
 
@@ -217,6 +218,12 @@ void SynchronizationModel::ReadIPCState()
     }
 }
 
+unsigned int SynchronizationModel::GetIPCMessageCounter()
+{
+  return m_IPCHandler->GetMessageCounter();
+}
 
-
-
+bool SynchronizationModel::WaitForIPCMessage(unsigned int &last_seen, int timeout_ms)
+{
+  return m_IPCHandler->WaitForMessage(last_seen, timeout_ms);
+}
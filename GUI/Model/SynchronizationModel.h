@@ -31,9 +31,21 @@ public:
    * flag depending on whether the window is active or not */
   irisGetSetMacro(CanBroadcast, bool)
 
-  /** This method should be called by UI at regular intervals to read IPC state */
+  /**
+   * This method should be called by UI to read IPC state, either at regular
+   * intervals or when WaitForIPCMessage() reports a new message */
   void ReadIPCState();
 
+  /** The number of IPC messages sent so far by all sessions */
+  unsigned int GetIPCMessageCounter();
+
+  /**
+   * Block until an IPC message is sent after last_seen, or until the timeout
+   * expires. Returns true if there are new messages. This is meant to be called
+   * from a helper thread, which then asks the UI thread to call ReadIPCState()
+   */
+  bool WaitForIPCMessage(unsigned int &last_seen, int timeout_ms);
+
 protected:
 
   SynchronizationModel();
@@ -11,6 +11,7 @@
 #include "IntensityCurveVTKRenderer.h"
 
 #include <QPalette>
+#include <QTimer>
 
 ContrastInspector::ContrastInspector(QWidget *parent) :
     SNAPComponent(parent),
@@ -19,6 +20,9 @@ ContrastInspector::ContrastInspector(QWidget *parent) :
   ui->setupUi(this);
   ApplyCSS(this, ":/root/itksnap.css");
 
+  m_Model = NULL;
+  m_RefinePending = false;
+
   // Create the viewport reporter
   m_CurveBoxViewportReporter = QtViewportReporter::New();
   m_CurveBoxViewportReporter->SetClientWidget(ui->plotWidget);
@@ -94,6 +98,32 @@ void ContrastInspector::on_btnReset_clicked()
 void ContrastInspector::onModelUpdate(const EventBucket &b)
 {
   m_Model->Update();
+  this->ScheduleHistogramRefinement();
+}
+
+void ContrastInspector::showEvent(QShowEvent *event)
+{
+  SNAPComponent::showEvent(event);
+  this->ScheduleHistogramRefinement();
+}
+
+void ContrastInspector::ScheduleHistogramRefinement()
+{
+  // The plot is first drawn with the histogram of sampled voxels, and the
+  // exact histogram is computed once the event loop is idle
+  if(!m_RefinePending && m_Model && m_Model->GetLayer() && this->isVisible()
+     && m_Model->IsHistogramApproximate())
+    {
+    m_RefinePending = true;
+    QTimer::singleShot(0, this, SLOT(onRefineHistogram()));
+    }
+}
+
+void ContrastInspector::onRefineHistogram()
+{
+  m_RefinePending = false;
+  if(m_Model && m_Model->GetLayer() && this->isVisible())
+    m_Model->RefineHistogram();
 }
 
 
@@ -36,8 +36,20 @@ private slots:
 
   void on_btnAuto_clicked();
 
+  // Replace the sampled histogram with the exact one once the plot is shown
+  void onRefineHistogram();
+
+protected:
+
+  virtual void showEvent(QShowEvent *event);
+
 private:
 
+  // Schedule the computation of the exact histogram, if it is needed
+  void ScheduleHistogramRefinement();
+
+  bool m_RefinePending;
+
   IntensityCurveModel *m_Model;
 
   Ui::ContrastInspector *ui;
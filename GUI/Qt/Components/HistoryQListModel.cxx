@@ -1,6 +1,7 @@
 #include "HistoryQListModel.h"
 #include "HistoryManager.h"
 #include "SystemInterface.h"
+#include "ThumbnailService.h"
 #include "IRISApplication.h"
 #include "GlobalUIModel.h"
 #include <itksys/SystemTools.hxx>
@@ -48,10 +49,11 @@ void HistoryQListItem::setItem(
 
   // Deal with the icon later
   std::string hist_str = to_utf8(history_entry);
-  std::string thumbnail =
-      model->GetDriver()->GetSystemInterface()->GetThumbnailAssociatedWithFile(hist_str.c_str());
+  SystemInterface *si = model->GetDriver()->GetSystemInterface();
+  std::string thumbnail = si->GetThumbnailAssociatedWithFile(hist_str.c_str());
 
   m_IconFilename = from_utf8(thumbnail);
+  m_ThumbnailService = si->GetThumbnailService();
 
   // TODO: for debugging change 0 to a random number
   QTimer::singleShot(0, this, SLOT(onTimer()));
@@ -59,50 +61,32 @@ void HistoryQListItem::setItem(
 
 void HistoryQListItem::onTimer()
 {
-  // Construct a string from the filenane and the timestamp
-  QString key = QString("%1::%2")
-                .arg(m_IconFilename)
-                .arg(QFileInfo(m_IconFilename).lastModified().toString());
-  QPixmap *pixmap = QPixmapCache::find(key);
-  if(pixmap)
-    this->setIcon(QIcon(*pixmap));
-  else
+  // Get the thumbnail from the service. Recently used thumbnails, and ones
+  // that have not been written to disk yet, come from memory
+  typedef ThumbnailService::ImageType PNGSliceType;
+  typedef ThumbnailService::PixelType PNGPixelType;
+  SmartPtr<PNGSliceType> slice =
+      m_ThumbnailService->GetThumbnail(to_utf8(m_IconFilename));
+
+  if(slice)
     {
-    try
-      {
-    /*
-      // Load the icon using ITK to avoid this really annoying warning
-      // from the PNG library. The only problem is that QIcon caches
-      typedef itk::RGBAPixel<unsigned char> PNGPixelType;
-      typedef itk::Image<PNGPixelType, 2> PNGSliceType;
-      typedef itk::ImageFileReader<PNGSliceType> PNGReaderType;
-      SmartPtr<PNGReaderType> reader = PNGReaderType::New();
-      reader->SetFileName(to_utf8(m_IconFilename).c_str());
-      reader->Update();
-
-      // Need to load the icon
-      SmartPtr<PNGSliceType> slice = reader->GetOutput();
-      int w = slice->GetBufferedRegion().GetSize()[0];
-      int h = slice->GetBufferedRegion().GetSize()[1];
-      QImage image(w, h, QImage::Format_ARGB32);
-      PNGPixelType *input = slice->GetBufferPointer();
-      QRgb *output = reinterpret_cast<QRgb*>(image.bits());
-      for(int i = 0; i < slice->GetPixelContainer()->Size(); i++)
-        {
-        *output++ = qRgba(input[i].GetRed(), input[i].GetGreen(), input[i].GetBlue(), input[i].GetAlpha());
-        } */
-
-      QPixmap load_pixmap(m_IconFilename);
-      this->setIcon(QIcon(load_pixmap));
-      QPixmapCache::insert(key, load_pixmap);
-      }
-    catch(itk::ExceptionObject &)
+    int w = slice->GetBufferedRegion().GetSize()[0];
+    int h = slice->GetBufferedRegion().GetSize()[1];
+    QImage image(w, h, QImage::Format_ARGB32);
+    PNGPixelType *input = slice->GetBufferPointer();
+    for(int y = 0; y < h; y++)
       {
-      QPixmap dummy(128, 128);
-      dummy.fill(Qt::black);
-      this->setIcon(QIcon(dummy));
-      QPixmapCache::insert(key, dummy);
+      QRgb *output = reinterpret_cast<QRgb*>(image.scanLine(y));
+      for(int x = 0; x < w; x++, input++)
+        *output++ = qRgba(input->GetRed(), input->GetGreen(), input->GetBlue(), input->GetAlpha());
       }
+    this->setIcon(QIcon(QPixmap::fromImage(image)));
+    }
+  else
+    {
+    QPixmap dummy(128, 128);
+    dummy.fill(Qt::black);
+    this->setIcon(QIcon(dummy));
     }
 }
 
@@ -12,6 +12,7 @@
 
 class EventBucket;
 class GlobalUIModel;
+class ThumbnailService;
 
 class HistoryQListItem : public QObject, public QStandardItem
 {
@@ -28,6 +29,9 @@ protected:
 
   QString m_IconFilename;
 
+  // Thumbnails are read through this service, which caches them
+  ThumbnailService *m_ThumbnailService;
+
 };
 
 
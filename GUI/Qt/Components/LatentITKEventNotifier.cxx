@@ -57,6 +57,8 @@ LatentITKEventNotifierHelper
 ::LatentITKEventNotifierHelper(QObject *parent)
   : QObject(parent)
 {
+  m_DispatchPending = false;
+
   // Emitting itkEvent will result in onQueuedEvent being called when
   // control returns to the main Qt loop
   QObject::connect(this, SIGNAL(itkEvent()),
@@ -83,8 +85,14 @@ LatentITKEventNotifierHelper
   // Register this event
   m_Bucket.PutEvent(evt, object);
 
-  // Emit signal
-  emit itkEvent();
+  // Emit signal, unless it has already been emitted for the events in the
+  // bucket. Each emit posts an event to the Qt event queue, and a drag can
+  // fire thousands of ITK events between two frames
+  if(!m_DispatchPending)
+    {
+    m_DispatchPending = true;
+    emit itkEvent();
+    }
 
   // Call parent's update
   // QApplication::postEvent(this, new QEvent(QEvent::User), 1000);
@@ -95,6 +103,7 @@ LatentITKEventNotifierHelper
 ::onQueuedEvent()
 {
   static int invocation = 0;
+  m_DispatchPending = false;
   if(!m_Bucket.IsEmpty())
     {
 #ifdef SNAP_DEBUG_EVENTS
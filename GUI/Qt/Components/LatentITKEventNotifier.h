@@ -24,6 +24,11 @@ signals:
 
 protected:
   EventBucket m_Bucket;
+
+  // Whether onQueuedEvent() has been queued and not yet called. Only one call
+  // is queued at a time, so events fired until control returns to the main
+  // loop are dispatched together, once
+  bool m_DispatchPending;
 };
 
 /**
@@ -3,11 +3,44 @@
 #include "SynchronizationModel.h"
 
 
+QtIPCWaitThread::QtIPCWaitThread(SynchronizationModel *model, QObject *parent)
+  : QThread(parent)
+{
+  m_Model = model;
+}
+
+void QtIPCWaitThread::run()
+{
+  // Wake up at least every 200ms to check whether the thread should exit
+  unsigned int last_seen = m_Model->GetIPCMessageCounter();
+  while(!isInterruptionRequested())
+    {
+    if(m_Model->WaitForIPCMessage(last_seen, 200))
+      emit messageAvailable();
+    }
+}
+
+
 QtIPCManager::QtIPCManager(QWidget *parent) :
   SNAPComponent(parent)
 {
-  // Start the IPC timer at 30ms intervals
-  startTimer(30);
+  m_Model = NULL;
+  m_WaitThread = NULL;
+
+  // A slow timer is kept as a fallback, e.g., to pick up the state of the
+  // other sessions once an image is loaded
+  startTimer(500);
+}
+
+QtIPCManager::~QtIPCManager()
+{
+  // The thread uses the shared memory, so it must finish before the model
+  // is destroyed
+  if(m_WaitThread)
+    {
+    m_WaitThread->requestInterruption();
+    m_WaitThread->wait();
+    }
 }
 
 void QtIPCManager::SetModel(SynchronizationModel *model)
@@ -16,6 +49,13 @@ void QtIPCManager::SetModel(SynchronizationModel *model)
 
   // Listen to update events from the model
   connectITK(m_Model, ModelUpdateEvent());
+
+  // Read the IPC state whenever another session sends a message. The signal
+  // is delivered in the GUI thread
+  m_WaitThread = new QtIPCWaitThread(m_Model, this);
+  connect(m_WaitThread, SIGNAL(messageAvailable()), this, SLOT(onIPCMessageAvailable()),
+          Qt::QueuedConnection);
+  m_WaitThread->start();
 }
 
 void QtIPCManager::onModelUpdate(const EventBucket &bucket)
@@ -24,10 +64,14 @@ void QtIPCManager::onModelUpdate(const EventBucket &bucket)
   m_Model->Update();
 }
 
-void QtIPCManager::timerEvent(QTimerEvent *)
+void QtIPCManager::onIPCMessageAvailable()
 {
   if(!m_Model) return;
   m_Model->ReadIPCState();
 }
 
-
+void QtIPCManager::timerEvent(QTimerEvent *)
+{
+  if(!m_Model) return;
+  m_Model->ReadIPCState();
+}
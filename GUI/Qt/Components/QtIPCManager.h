@@ -2,13 +2,39 @@
 #define QTIPCMANAGER_H
 
 #include <QObject>
+#include <QThread>
 #include <SNAPComponent.h>
 
 class SynchronizationModel;
 
+/**
+ * @brief Helper thread that waits for IPC messages from other SNAP sessions
+ * and signals the GUI thread when one arrives, so that the GUI does not have
+ * to poll the shared memory.
+ */
+class QtIPCWaitThread : public QThread
+{
+  Q_OBJECT
+public:
+  explicit QtIPCWaitThread(SynchronizationModel *model, QObject *parent = 0);
+
+signals:
+
+  void messageAvailable();
+
+protected:
+
+  virtual void run();
+
+private:
+
+  SynchronizationModel *m_Model;
+};
+
 /**
  * @brief This class manages IPC communications between SNAP sessions on the
- * GUI level. It uses Qt's timers to schedule checks for IPC updates, and it
+ * GUI level. It uses a helper thread to wait for IPC updates (with a slow
+ * Qt timer as a fallback), and it
  * listens to the events from the model layer in order to send IPC messages
  * out.
  */
@@ -17,6 +43,7 @@ class QtIPCManager : public SNAPComponent
   Q_OBJECT
 public:
   explicit QtIPCManager(QWidget *parent = 0);
+  ~QtIPCManager();
 
   void SetModel(SynchronizationModel *model);
   
@@ -26,6 +53,8 @@ public slots:
 
   virtual void onModelUpdate(const EventBucket &bucket);
 
+  void onIPCMessageAvailable();
+
 protected:
 
   virtual void timerEvent(QTimerEvent *);
@@ -33,6 +62,8 @@ protected:
 private:
 
   SynchronizationModel *m_Model;
+
+  QtIPCWaitThread *m_WaitThread;
 };
 
 #endif // QTIPCMANAGER_H
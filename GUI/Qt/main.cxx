@@ -32,6 +32,7 @@
 #include "GenericSliceModel.h"
 #include "GlobalUIModel.h"
 #include "IRISImageData.h"
+#include "Rebroadcaster.h"
 
 #include "itkEventObject.h"
 #include "itkObject.h"
@@ -929,6 +930,12 @@ int main(int argc, char *argv[])
     // Get rid of the main window while the model is still alive
     delete mainwin;
 
+#ifdef SNAP_DEBUG_EVENTS
+    // Report which models fired the most events
+    if(flag_snap_debug_events)
+      Rebroadcaster::PrintEventCounts(std::cout);
+#endif
+
     // Destroy the model after the GUI is destroyed
     gui = NULL;
 
@@ -84,9 +84,6 @@ void AnnotationRenderer::paintGL()
       m_Model->GetParent()->MapWindowOffsetToSliceOffset(
         Vector2d(96 * vppr , 12 * vppr));
 
-  // Get the list of annotations
-  const ImageAnnotationData *adata = m_Model->GetAnnotations();
-
   // Push the line state
   glPushAttrib(GL_LINE_BIT | GL_COLOR_BUFFER_BIT);
 
@@ -142,151 +139,149 @@ void AnnotationRenderer::paintGL()
       }
     } // Current line valid
 
-  // Draw each annotation
-  for(ImageAnnotationData::AnnotationConstIterator it = adata->GetAnnotations().begin();
-      it != adata->GetAnnotations().end(); ++it)
+  // Draw each annotation in the current slice
+  ImageAnnotationData::AnnotationVector visible;
+  m_Model->GetAnnotationsInCurrentSlice(visible);
+  for(ImageAnnotationData::AnnotationVector::const_iterator it = visible.begin();
+      it != visible.end(); ++it)
     {
-    if(m_Model->IsAnnotationVisible(*it))
+    // Draw all the line segments
+    annot::LineSegmentAnnotation *lsa =
+        dynamic_cast<annot::LineSegmentAnnotation *>(*it);
+    if(lsa)
       {
-      // Draw all the line segments
-      annot::LineSegmentAnnotation *lsa =
-          dynamic_cast<annot::LineSegmentAnnotation *>(it->GetPointer());
-      if(lsa)
-        {
-        // Draw the line
-        Vector3d p1 = m_Model->GetParent()->MapImageToSlice(lsa->GetSegment().first);
-        Vector3d p2 = m_Model->GetParent()->MapImageToSlice(lsa->GetSegment().second);
+      // Draw the line
+      Vector3d p1 = m_Model->GetParent()->MapImageToSlice(lsa->GetSegment().first);
+      Vector3d p2 = m_Model->GetParent()->MapImageToSlice(lsa->GetSegment().second);
 
-        glColor4d(lsa->GetColor()[0], lsa->GetColor()[1], lsa->GetColor()[2], alpha);
+      glColor4d(lsa->GetColor()[0], lsa->GetColor()[1], lsa->GetColor()[2], alpha);
 
-        glBegin(GL_POINTS);
-        glVertex2d((p1[0] + p2[0]) * 0.5, (p1[1] + p2[1]) * 0.5);
-        glEnd();
+      glBegin(GL_POINTS);
+      glVertex2d((p1[0] + p2[0]) * 0.5, (p1[1] + p2[1]) * 0.5);
+      glEnd();
 
-        glBegin(GL_LINES);
-        glVertex2d(p1[0], p1[1]);
-        glVertex2d(p2[0], p2[1]);
-        glEnd();
-
-        if(lsa->GetSelected() && m_Model->IsAnnotationModeActive() &&
-           m_Model->GetAnnotationMode() == ANNOTATION_SELECT)
-          {
-          this->DrawSelectionHandle(p1);
-          this->DrawSelectionHandle(p2);
-          }
+      glBegin(GL_LINES);
+      glVertex2d(p1[0], p1[1]);
+      glVertex2d(p2[0], p2[1]);
+      glEnd();
 
-        // Draw length or angle
-        if(m_Model->IsDrawingRuler())
-          {
-          // Draw angle:
-          // Compute the dot product and no need for the third components that are zeros
-          double angle = m_Model->GetAngleWithCurrentLine(lsa);
-          std::ostringstream oss_angle;
-          oss_angle << std::setprecision(3) << angle << "°";
-
-          Vector3d line_center = m_Model->GetAnnotationCenter(lsa);
-
-          // Set up the rendering properties
-          AbstractRendererPlatformSupport::FontInfo font_info =
-                { AbstractRendererPlatformSupport::TYPEWRITER,
-                  12 * vppr,
-                  false };
-
-          // Draw the angle text
-          m_PlatformSupport->RenderTextInOpenGL(
-                oss_angle.str().c_str(),
-                line_center[0] + text_offset_slice[0], line_center[1] + text_offset_slice[1],
-              text_width_slice[0], text_width_slice[1],
-              font_info,
-              AbstractRendererPlatformSupport::LEFT, AbstractRendererPlatformSupport::TOP,
-              lsa->GetColor(), alpha);
-          }
-        else
-          {
-          this->DrawLineLength(p1, p2, lsa->GetColor(),alpha);
-          }
+      if(lsa->GetSelected() && m_Model->IsAnnotationModeActive() &&
+         m_Model->GetAnnotationMode() == ANNOTATION_SELECT)
+        {
+        this->DrawSelectionHandle(p1);
+        this->DrawSelectionHandle(p2);
         }
 
-      annot::LandmarkAnnotation *lma =
-          dynamic_cast<annot::LandmarkAnnotation *>(it->GetPointer());
-      if(lma)
+      // Draw length or angle
+      if(m_Model->IsDrawingRuler())
         {
-        // Get the head and tail coordinate in slice units
-        Vector3d xHeadSlice, xTailSlice;
-        m_Model->GetLandmarkArrowPoints(lma->GetLandmark(), xHeadSlice, xTailSlice);
+        // Draw angle:
+        // Compute the dot product and no need for the third components that are zeros
+        double angle = m_Model->GetAngleWithCurrentLine(lsa);
+        std::ostringstream oss_angle;
+        oss_angle << std::setprecision(3) << angle << "°";
+
+        Vector3d line_center = m_Model->GetAnnotationCenter(lsa);
+
+        // Set up the rendering properties
+        AbstractRendererPlatformSupport::FontInfo font_info =
+              { AbstractRendererPlatformSupport::TYPEWRITER,
+                12 * vppr,
+                false };
+
+        // Draw the angle text
+        m_PlatformSupport->RenderTextInOpenGL(
+              oss_angle.str().c_str(),
+              line_center[0] + text_offset_slice[0], line_center[1] + text_offset_slice[1],
+            text_width_slice[0], text_width_slice[1],
+            font_info,
+            AbstractRendererPlatformSupport::LEFT, AbstractRendererPlatformSupport::TOP,
+            lsa->GetColor(), alpha);
+        }
+      else
+        {
+        this->DrawLineLength(p1, p2, lsa->GetColor(),alpha);
+        }
+      }
 
-        std::string text = lma->GetLandmark().Text;
+    annot::LandmarkAnnotation *lma =
+        dynamic_cast<annot::LandmarkAnnotation *>(*it);
+    if(lma)
+      {
+      // Get the head and tail coordinate in slice units
+      Vector3d xHeadSlice, xTailSlice;
+      m_Model->GetLandmarkArrowPoints(lma->GetLandmark(), xHeadSlice, xTailSlice);
 
-        glColor4d(lma->GetColor()[0], lma->GetColor()[1], lma->GetColor()[2], alpha);
+      std::string text = lma->GetLandmark().Text;
 
-        glBegin(GL_LINES);
-        glVertex2d(xHeadSlice[0], xHeadSlice[1]);
-        glVertex2d(xTailSlice[0], xTailSlice[1]);
-        glEnd();
+      glColor4d(lma->GetColor()[0], lma->GetColor()[1], lma->GetColor()[2], alpha);
 
-        if(lma->GetSelected() && m_Model->IsAnnotationModeActive() &&
-           m_Model->GetAnnotationMode() == ANNOTATION_SELECT)
-          {
-          this->DrawSelectionHandle(xHeadSlice);
-          this->DrawSelectionHandle(xTailSlice);
-          }
+      glBegin(GL_LINES);
+      glVertex2d(xHeadSlice[0], xHeadSlice[1]);
+      glVertex2d(xTailSlice[0], xTailSlice[1]);
+      glEnd();
+
+      if(lma->GetSelected() && m_Model->IsAnnotationModeActive() &&
+         m_Model->GetAnnotationMode() == ANNOTATION_SELECT)
+        {
+        this->DrawSelectionHandle(xHeadSlice);
+        this->DrawSelectionHandle(xTailSlice);
+        }
 
-        // Font properties
-        AbstractRendererPlatformSupport::FontInfo fi;
-        fi.type = AbstractRendererPlatformSupport::SANS;
-        fi.pixel_size = 12 * vppr;
-        fi.bold = false;
+      // Font properties
+      AbstractRendererPlatformSupport::FontInfo fi;
+      fi.type = AbstractRendererPlatformSupport::SANS;
+      fi.pixel_size = 12 * vppr;
+      fi.bold = false;
 
-        // Text box size in screen pixels
-        Vector2d xTextSizeWin;
-        xTextSizeWin[0] = this->m_PlatformSupport->MeasureTextWidth(text.c_str(), fi);
-        xTextSizeWin[1] = fi.pixel_size * vppr;
+      // Text box size in screen pixels
+      Vector2d xTextSizeWin;
+      xTextSizeWin[0] = this->m_PlatformSupport->MeasureTextWidth(text.c_str(), fi);
+      xTextSizeWin[1] = fi.pixel_size * vppr;
 
-        // Text box size in slice coordinate units
-        Vector3d xTextSizeSlice = m_Model->GetParent()->MapWindowOffsetToSliceOffset(xTextSizeWin);
+      // Text box size in slice coordinate units
+      Vector3d xTextSizeSlice = m_Model->GetParent()->MapWindowOffsetToSliceOffset(xTextSizeWin);
 
-        // How to position the text
-        double xbox, ybox;
-        int align_horiz, align_vert;
-        if(fabs(lma->GetLandmark().Offset[0]) >= fabs(lma->GetLandmark().Offset[1]))
+      // How to position the text
+      double xbox, ybox;
+      int align_horiz, align_vert;
+      if(fabs(lma->GetLandmark().Offset[0]) >= fabs(lma->GetLandmark().Offset[1]))
+        {
+        align_vert = AbstractRendererPlatformSupport::VCENTER;
+        ybox = xTailSlice[1] - xTextSizeSlice[1] / 2;
+        if(lma->GetLandmark().Offset[0] >= 0)
           {
-          align_vert = AbstractRendererPlatformSupport::VCENTER;
-          ybox = xTailSlice[1] - xTextSizeSlice[1] / 2;
-          if(lma->GetLandmark().Offset[0] >= 0)
-            {
-            align_horiz = AbstractRendererPlatformSupport::LEFT;
-            xbox = xTailSlice[0];
-            }
-          else
-            {
-            align_horiz = AbstractRendererPlatformSupport::RIGHT;
-            xbox = xTailSlice[0] - xTextSizeSlice[0];
-            }
+          align_horiz = AbstractRendererPlatformSupport::LEFT;
+          xbox = xTailSlice[0];
           }
         else
           {
-          align_horiz = AbstractRendererPlatformSupport::HCENTER;
-          xbox = xTailSlice[0] - xTextSizeSlice[0] / 2;
-          if(lma->GetLandmark().Offset[1] >= 0)
-            {
-            align_vert = AbstractRendererPlatformSupport::BOTTOM;
-            ybox = xTailSlice[1];
-            }
-          else
-            {
-            align_vert = AbstractRendererPlatformSupport::TOP;
-            ybox = xTailSlice[1] - xTextSizeSlice[1];
-            }
+          align_horiz = AbstractRendererPlatformSupport::RIGHT;
+          xbox = xTailSlice[0] - xTextSizeSlice[0];
+          }
+        }
+      else
+        {
+        align_horiz = AbstractRendererPlatformSupport::HCENTER;
+        xbox = xTailSlice[0] - xTextSizeSlice[0] / 2;
+        if(lma->GetLandmark().Offset[1] >= 0)
+          {
+          align_vert = AbstractRendererPlatformSupport::BOTTOM;
+          ybox = xTailSlice[1];
+          }
+        else
+          {
+          align_vert = AbstractRendererPlatformSupport::TOP;
+          ybox = xTailSlice[1] - xTextSizeSlice[1];
           }
-
-        // Draw the text at the right location
-        this->m_PlatformSupport->RenderTextInOpenGL(text.c_str(),
-                                                    xbox, ybox,
-                                                    xTextSizeSlice[0], xTextSizeSlice[1], fi,
-                                                    align_horiz, align_vert,
-                                                    lma->GetColor(), alpha);
         }
 
+      // Draw the text at the right location
+      this->m_PlatformSupport->RenderTextInOpenGL(text.c_str(),
+                                                  xbox, ybox,
+                                                  xTextSizeSlice[0], xTextSizeSlice[1], fi,
+                                                  align_horiz, align_vert,
+                                                  lma->GetColor(), alpha);
       }
     }
 
@@ -9,6 +9,7 @@
 #include "LayerHistogramPlotAssembly.h"
 #include "SNAPCommon.h"
 #include "ScalarImageHistogram.h"
+#include "DisplayMappingPolicy.h"
 
 #include <vtkChartXY.h>
 #include <vtkPlot.h>
@@ -85,8 +86,13 @@ void GMMRenderer::UpdatePlotValues()
     // Remove all plots from the chart
     m_Chart->ClearPlots();
 
-    // Add and set up the histogram plot
-    const ScalarImageHistogram *hist = cw->GetHistogram(0);
+    // Add and set up the histogram plot, using the sampled histogram until
+    // the exact one has been computed
+    AbstractContinuousImageDisplayMappingPolicy *dmp =
+        dynamic_cast<AbstractContinuousImageDisplayMappingPolicy *>(
+          cw->GetDisplayMapping());
+    const ScalarImageHistogram *hist =
+        dmp ? dmp->GetAvailableHistogram(0) : cw->GetHistogram(0);
     m_HistogramAssembly->AddToChart(m_Chart);
     double ymax = m_HistogramAssembly->PlotAsEmpiricalDensity(hist);
 
@@ -45,6 +45,9 @@ GenericSliceRenderer
   this->m_DrawingZoomThumbnail = false;
   this->m_DrawingLayerThumbnail = false;
   this->m_DrawingViewportIndex = -1;
+  this->m_CompositeLayersOnCPU = true;
+  this->m_SegmentationComposited = false;
+  this->m_BytesUploadedLastFrame = 0;
 }
 
 void
@@ -126,6 +129,9 @@ GenericSliceRenderer
   Vector2ui vp_full = m_Model->GetSizeReporter()->GetViewportSize();
   int vppr = m_Model->GetSizeReporter()->GetViewportPixelRatio();
 
+  // Count the texture bytes uploaded during this frame
+  unsigned long bytes_uploaded = Texture::GetTotalBytesUploaded();
+
   // Set up lighting attributes
   glPushAttrib(GL_LIGHTING_BIT | GL_DEPTH_BUFFER_BIT |
                GL_PIXEL_MODE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
@@ -196,7 +202,8 @@ GenericSliceRenderer
 
         // We don't want to draw segmentation over the speed image and other
         // SNAP-mode layers.
-        this->DrawSegmentationTexture();
+        if(!m_SegmentationComposited)
+          this->DrawSegmentationTexture();
 
         // Draw the overlays
         if(as->GetOverallVisibility())
@@ -330,6 +337,8 @@ GenericSliceRenderer
 
   // Display!
   glFlush();
+
+  m_BytesUploadedLastFrame = Texture::GetTotalBytesUploaded() - bytes_uploaded;
 }
 
 const GenericSliceRenderer::ViewportType *
@@ -363,6 +372,8 @@ bool GenericSliceRenderer::DrawImageLayers(ImageWrapperBase *base_layer, const V
   // Get the image data
   GenericImageData *id = m_Model->GetImageData();
 
+  m_SegmentationComposited = false;
+
   // If drawing the thumbnail, only draw the main layer
   if(m_DrawingZoomThumbnail)
     {
@@ -370,52 +381,46 @@ bool GenericSliceRenderer::DrawImageLayers(ImageWrapperBase *base_layer, const V
     return true;
     }
 
-  // Is the display partitioned into rows and columns?
-  if(!this->IsTiledMode())
+  // Find the sticky layers that are drawn on top of the base layer. If the
+  // display is partitioned into rows and columns, these are the sticky
+  // non-main layers, otherwise all the sticky non-label layers
+  std::vector<ImageWrapperBase *> overlays;
+  if(!vp.isThumbnail)
     {
-    // Draw the base layer without transparency
-    DrawTextureForLayer(base_layer, vp, false);
-
-    // Now draw all the sticky layers on top
-    if(!vp.isThumbnail)
+    bool tiled = this->IsTiledMode();
+    for(LayerIterator it(id); !it.IsAtEnd(); ++it)
       {
-        for(LayerIterator it(id); !it.IsAtEnd(); ++it)
+      ImageWrapperBase *layer = it.GetLayer();
+      if(it.GetRole() != (tiled ? MAIN_ROLE : LABEL_ROLE)
+         && layer->IsDrawable()
+         && layer->IsSticky()
+         && layer->GetAlpha() > 0)
         {
-        ImageWrapperBase *layer = it.GetLayer();
-        if(it.GetRole() != LABEL_ROLE
-           && layer->IsDrawable()
-           && layer->IsSticky()
-           && layer->GetAlpha() > 0)
-          {
-          DrawTextureForLayer(layer, vp, true);
-          }
+        overlays.push_back(layer);
         }
       }
-
-    return true;
     }
-  else
-    {
-    // Draw the particular layer
-    DrawTextureForLayer(base_layer, vp, false);
 
-    // Now draw all the non-sticky layers
-    if(!vp.isThumbnail)
+  // Try to blend the layers, including the segmentation, on the CPU
+  if(m_CompositeLayersOnCPU)
+    {
+    double seg_alpha;
+    ImageWrapperBase *seg_layer = this->GetDrawnSegmentationLayer(seg_alpha);
+    if(this->DrawCompositedLayers(base_layer, vp, overlays, seg_layer, seg_alpha))
       {
-      for(LayerIterator itov(id); !itov.IsAtEnd(); ++itov)
-        {
-        if(itov.GetRole() != MAIN_ROLE
-           && itov.GetLayer()->IsSticky()
-           && itov.GetLayer()->IsDrawable()
-           && itov.GetLayer()->GetAlpha() > 0)
-          {
-          DrawTextureForLayer(itov.GetLayer(), vp, true);
-          }
-        }
+      m_SegmentationComposited = true;
+      return true;
       }
+    }
 
-    return true;
-  }
+  // Draw the base layer without transparency
+  DrawTextureForLayer(base_layer, vp, false);
+
+  // Now draw all the sticky layers on top
+  for(unsigned int i = 0; i < overlays.size(); i++)
+    DrawTextureForLayer(overlays[i], vp, true);
+
+  return true;
 }
 
 bool GenericSliceRenderer::IsTiledMode() const
@@ -442,12 +447,20 @@ GenericSliceRenderer
   if(!layer->IsInitialized())
     return NULL;
 
-  // Retrieve the texture
-  SmartPtr<Texture> tex = static_cast<Texture *>(layer->GetUserData(user_data_id));
-
   // Get the image that should be associated with the texture
   Texture::ImageType *slice = layer->GetDisplaySlice(m_Model->GetId()).GetPointer();
 
+  return this->GetTextureForSlice(layer, user_data_id, slice);
+}
+
+GenericSliceRenderer::Texture *
+GenericSliceRenderer
+::GetTextureForSlice(ImageWrapperBase *layer, const char *user_data_id,
+                     Texture::ImageType *slice)
+{
+  // Retrieve the texture
+  SmartPtr<Texture> tex = static_cast<Texture *>(layer->GetUserData(user_data_id));
+
   // If the texture does not exist - or if the image has changed for some reason, update it
   if(!tex || tex->GetImage() != slice)
     {
@@ -725,24 +738,122 @@ void GenericSliceRenderer::DrawTextureForLayer(
 }
 
 
-void GenericSliceRenderer::DrawSegmentationTexture()
-  {
+ImageWrapperBase *GenericSliceRenderer::GetDrawnSegmentationLayer(double &alpha)
+{
   GenericImageData *id = m_Model->GetImageData();
-  double alpha = m_Model->GetParentUI()->GetDriver()->GetGlobalState()->GetSegmentationAlpha();
+  alpha = m_Model->GetParentUI()->GetDriver()->GetGlobalState()->GetSegmentationAlpha();
 
-  if (alpha > 0)
+  if(alpha > 0)
     {
-    // Search for the texture to draw
-    ImageWrapperBase *seg_layer =
-        id->FindLayer(m_Model->GetParentUI()->GetGlobalState()->GetSelectedSegmentationLayerId(), false, LABEL_ROLE);
-    if(seg_layer)
-      {
-      Texture *texture = this->GetTextureForLayer(seg_layer);
-      texture->DrawTransparent(alpha);
-      }
+    return id->FindLayer(
+          m_Model->GetParentUI()->GetGlobalState()->GetSelectedSegmentationLayerId(),
+          false, LABEL_ROLE);
+    }
+
+  return NULL;
+}
+
+void GenericSliceRenderer::DrawSegmentationTexture()
+  {
+  // Search for the texture to draw
+  double alpha;
+  ImageWrapperBase *seg_layer = this->GetDrawnSegmentationLayer(alpha);
+  if(seg_layer)
+    {
+    Texture *texture = this->GetTextureForLayer(seg_layer);
+    texture->DrawTransparent(alpha);
     }
   }
 
+bool GenericSliceRenderer::CanCompositeLayer(
+    ImageWrapperBase *layer, ImageWrapperBase *base_layer)
+{
+  // Obliquely sliced layers are drawn with their own transform
+  if(!layer->IsInitialized() || !layer->IsSlicingOrthogonal())
+    return false;
+
+  // Layers rendered as a grid draw lines over their texture
+  AbstractMultiChannelDisplayMappingPolicy *dp = dynamic_cast<
+      AbstractMultiChannelDisplayMappingPolicy *>(layer->GetDisplayMapping());
+  if(dp && dp->GetDisplayMode().RenderAsGrid)
+    return false;
+
+  // The slices must line up pixel for pixel
+  ImageWrapperBase::DisplaySliceType *slice =
+      layer->GetDisplaySlice(m_Model->GetId());
+  ImageWrapperBase::DisplaySliceType *base_slice =
+      base_layer->GetDisplaySlice(m_Model->GetId());
+  slice->UpdateOutputInformation();
+  base_slice->UpdateOutputInformation();
+
+  return slice->GetLargestPossibleRegion() == base_slice->GetLargestPossibleRegion();
+}
+
+bool GenericSliceRenderer::DrawCompositedLayers(
+    ImageWrapperBase *base_layer, const ViewportType &vp,
+    const std::vector<ImageWrapperBase *> &overlays,
+    ImageWrapperBase *seg_layer, double seg_alpha)
+{
+  // In stacked mode the base layer is drawn both in the main viewport, with
+  // the overlays, and as a layer thumbnail, without them. Each gets its own
+  // compositor and texture, so that neither is recomposited on every frame
+  const char *user_data_ids[2][3] = {
+    { "SliceLayerCompositor[0]",
+      "SliceLayerCompositor[1]",
+      "SliceLayerCompositor[2]" },
+    { "SliceLayerCompositorThumb[0]",
+      "SliceLayerCompositorThumb[1]",
+      "SliceLayerCompositorThumb[2]" }
+  };
+  const char *texture_data_ids[2][3] = {
+    { "CompositeTexture[0]",
+      "CompositeTexture[1]",
+      "CompositeTexture[2]" },
+    { "CompositeTextureThumb[0]",
+      "CompositeTextureThumb[1]",
+      "CompositeTextureThumb[2]" }
+  };
+  int id = m_Model->GetId();
+  int thumb = vp.isThumbnail ? 1 : 0;
+  const char *user_data_id = user_data_ids[thumb][id];
+
+  // Check that all the layers can be blended
+  if(!this->CanCompositeLayer(base_layer, base_layer))
+    return false;
+
+  for(unsigned int i = 0; i < overlays.size(); i++)
+    if(!this->CanCompositeLayer(overlays[i], base_layer))
+      return false;
+
+  if(seg_layer && !this->CanCompositeLayer(seg_layer, base_layer))
+    return false;
+
+  // The compositor and its texture are associated with the base layer
+  SmartPtr<SliceLayerCompositor> compositor =
+      static_cast<SliceLayerCompositor *>(base_layer->GetUserData(user_data_id));
+  if(!compositor)
+    {
+    compositor = SliceLayerCompositor::New();
+    base_layer->SetUserData(user_data_id, compositor.GetPointer());
+    }
+
+  // Assign the layers. This only modifies the compositor if something changed
+  compositor->SetNumberOfLayers(1 + overlays.size() + (seg_layer ? 1 : 0));
+  compositor->SetLayer(0, base_layer->GetDisplaySlice(id));
+  for(unsigned int i = 0; i < overlays.size(); i++)
+    compositor->SetLayer(i + 1, overlays[i]->GetDisplaySlice(id), overlays[i]->GetAlpha());
+  if(seg_layer)
+    compositor->SetLayer(overlays.size() + 1, seg_layer->GetDisplaySlice(id), seg_alpha);
+
+  // Get the texture for the composited slice
+  Texture *tex = this->GetTextureForSlice(
+        base_layer, texture_data_ids[thumb][id], compositor->GetOutput());
+
+  // The composited slice is opaque, so it is drawn without blending
+  tex->Draw(Vector3d(1.0));
+  return true;
+}
+
 void GenericSliceRenderer::DrawThumbnail()
   {
   // Get the thumbnail appearance properties
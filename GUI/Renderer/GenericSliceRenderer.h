@@ -34,6 +34,7 @@
 #include <SNAPOpenGL.h>
 #include <list>
 #include <LayerAssociation.h>
+#include <SliceLayerCompositor.h>
 
 class GenericSliceRenderer;
 
@@ -74,6 +75,17 @@ public:
   /** This flag is on while the layer thumbnail is being painted */
   irisIsMacro(DrawingLayerThumbnail)
 
+  /**
+   * Whether the layers shown in a cell should be blended on the CPU and
+   * drawn as a single texture, rather than drawn one texture at a time and
+   * blended by OpenGL. This is on by default. Layers that cannot be blended
+   * this way (e.g., sliced obliquely) are still drawn separately.
+   */
+  irisGetSetMacro(CompositeLayersOnCPU, bool)
+
+  /** Number of bytes of texture data sent to the graphics card in the last frame */
+  irisGetMacro(BytesUploadedLastFrame, unsigned long)
+
   // Viewport object
   typedef SliceViewportLayout::SubViewport ViewportType;
 
@@ -133,6 +145,25 @@ protected:
   // This method can be used by the renderer delegates to draw a texture
   void DrawTextureForLayer(ImageWrapperBase *layer, const ViewportType &vp, bool use_transparency);
 
+  // Blend the base layer, the overlays and the segmentation (if not NULL) on
+  // the CPU and draw the result. Returns false without drawing anything if
+  // the layers cannot be blended on the CPU
+  bool DrawCompositedLayers(ImageWrapperBase *base_layer,
+                            const ViewportType &vp,
+                            const std::vector<ImageWrapperBase *> &overlays,
+                            ImageWrapperBase *seg_layer, double seg_alpha);
+
+  // Whether a layer can be included in a CPU blend with the given base layer
+  bool CanCompositeLayer(ImageWrapperBase *layer, ImageWrapperBase *base_layer);
+
+  // Get (creating if necessary) and configure a texture for a slice that is
+  // stored in the given layer under the given name
+  Texture *GetTextureForSlice(ImageWrapperBase *layer, const char *user_data_id,
+                              Texture::ImageType *slice);
+
+  // Get the segmentation layer that is drawn over the image layers, if any
+  ImageWrapperBase *GetDrawnSegmentationLayer(double &alpha);
+
   bool IsTiledMode() const;
 
   GenericSliceModel *m_Model;
@@ -143,6 +174,15 @@ protected:
   // The index of the viewport that is currently being drawn - for use in child renderers
   int m_DrawingViewportIndex;
 
+  // Whether to blend layers on the CPU
+  bool m_CompositeLayersOnCPU;
+
+  // Set by DrawImageLayers when the segmentation was blended with the layers
+  bool m_SegmentationComposited;
+
+  // Texture bytes uploaded in the last call to paintGL
+  unsigned long m_BytesUploadedLastFrame;
+
   // A list of overlays that the user can configure
   RendererDelegateList m_TiledOverlays, m_GlobalOverlays;
 
@@ -35,6 +35,8 @@
 #include "OpenGLSliceTexture.h"
 #include "ImageWrapper.h"
 
+template<class TPixel>
+unsigned long OpenGLSliceTexture<TPixel>::m_TotalBytesUploaded = 0;
 
 template<class TPixel>
 OpenGLSliceTexture<TPixel>
@@ -51,6 +53,7 @@ OpenGLSliceTexture<TPixel>
   m_GlFormat = GL_LUMINANCE;
   m_GlType = GL_UNSIGNED_BYTE;
   m_InterpolationMode = GL_NEAREST;
+  m_BytesUploaded = 0;
 }
 
 template<class TPixel>
@@ -106,12 +109,23 @@ OpenGLSliceTexture<TPixel>
 
   // Promote the image dimensions to powers of 2
   itk::Size<2> szImage = m_Image->GetLargestPossibleRegion().GetSize();
-  m_TextureSize = Vector2ui(1);
+  Vector2ui szTexture(1);
 
   // Use shift to quickly double the coordinates
   for (unsigned int i=0;i<2;i++)
-    while (m_TextureSize(i) < szImage[i])
-      m_TextureSize(i) <<= 1;
+    while (szTexture(i) < szImage[i])
+      szTexture(i) <<= 1;
+
+  // The texture must be reallocated the first time, when the size changes and
+  // when the texture settings change (which sets the update time to zero).
+  // Otherwise only the part of the image that changed is uploaded.
+  bool realloc = !m_IsTextureInitalized || m_UpdateTime == 0
+                 || szTexture != m_TextureSize;
+  if(realloc)
+    m_UpdateRegionTracker.Reset();
+
+  itk::ImageRegion<2> rgnUpload = m_UpdateRegionTracker.Update(m_Image);
+  m_TextureSize = szTexture;
 
   // Create the texture index if necessary
   if(!m_IsTextureInitalized)
@@ -124,27 +138,52 @@ OpenGLSliceTexture<TPixel>
   // Select the texture for pixel pumping
   glBindTexture(GL_TEXTURE_2D,m_TextureIndex);
 
-  // Properties for the texture
-  glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
-  glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_InterpolationMode );
-  glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, m_InterpolationMode );
-
-  // TODO: figure out how this can be applied in a fully compatible way
-  // glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-  // glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-
   // Turn off modulo-4 rounding in GL
   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   glPixelStorei(GL_PACK_ALIGNMENT, 1);
 
-  // Allocate texture of slightly bigger size
-  glTexImage2D(GL_TEXTURE_2D, 0, m_GlComponents,
-    m_TextureSize(0), m_TextureSize(1),
-    0, m_GlFormat, m_GlType, NULL);
+  if(realloc)
+    {
+    // Properties for the texture
+    glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_InterpolationMode );
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, m_InterpolationMode );
+
+    // TODO: figure out how this can be applied in a fully compatible way
+    // glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+    // glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+
+    // Allocate texture of slightly bigger size
+    glTexImage2D(GL_TEXTURE_2D, 0, m_GlComponents,
+      m_TextureSize(0), m_TextureSize(1),
+      0, m_GlFormat, m_GlType, NULL);
+    }
 
-  // Copy a subtexture of correct size into the image
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, szImage[0], szImage[1],
-                  m_GlFormat, m_GlType, m_Image->GetBufferPointer());
+  // Copy the changed rectangle of the image into the texture. The unpack
+  // settings select the rectangle from the image buffer
+  if(rgnUpload.GetNumberOfPixels() > 0)
+    {
+    const itk::ImageRegion<2> &rgnBuffer = m_Image->GetBufferedRegion();
+    int idx[2];
+    for(int d = 0; d < 2; d++)
+      idx[d] = rgnUpload.GetIndex(d) - rgnBuffer.GetIndex(d);
+    itk::Size<2> sz = rgnUpload.GetSize();
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, rgnBuffer.GetSize(0));
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, idx[0]);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, idx[1]);
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, idx[0], idx[1], sz[0], sz[1],
+                    m_GlFormat, m_GlType, m_Image->GetBufferPointer());
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    unsigned long bytes = rgnUpload.GetNumberOfPixels() * sizeof(TPixel);
+    m_BytesUploaded += bytes;
+    m_TotalBytesUploaded += bytes;
+    }
 
   // Remember the image's timestamp
   m_UpdateTime = m_Image->GetPipelineMTime();
@@ -45,6 +45,7 @@
 #endif
 
 #include "itkImage.h"
+#include "SliceUpdateRegionTracker.h"
 
 /**
  * \class OpenGLSliceTexture
@@ -52,6 +53,8 @@
  * into a GL texture.  
  *
  * The calls to Update will make sure that the texture is up to date.  
+ * When the image changes but keeps its size, only the rectangle of pixels
+ * that changed is sent to the texture.
  */
 template <class TPixel>
 class OpenGLSliceTexture : public itk::Object
@@ -97,6 +100,15 @@ public:
    */
   void Update();
 
+  /** Number of bytes of image data sent to this texture */
+  irisGetMacro(BytesUploaded, unsigned long)
+
+  /**
+   * Number of bytes of image data sent to all textures of this type. This
+   * can be used to measure the bytes uploaded per frame.
+   */
+  static unsigned long GetTotalBytesUploaded() { return m_TotalBytesUploaded; }
+
   /**
    * Set the interpolation mode for the texture. If the interpolation mode
    * is changed, Update() will be called on the next Draw() command. The value
@@ -156,6 +168,13 @@ private:
 
   // Interpolation mode
   GLenum m_InterpolationMode;
+
+  // Finds the part of the image that changed since the last upload
+  SliceUpdateRegionTracker<TPixel> m_UpdateRegionTracker;
+
+  // Bytes uploaded by this texture and by all textures
+  unsigned long m_BytesUploaded;
+  static unsigned long m_TotalBytesUploaded;
 };
 
 #endif // __OpenGLSliceTexture_h_
@@ -35,65 +35,210 @@
 #ifndef __PolygonScanConvert_h_
 #define __PolygonScanConvert_h_
 
-#include "SNAPOpenGL.h"
 #include "itkImage.h"
-#include "itkImageRegionIteratorWithIndex.h"
-#include <vtkPolygon.h>
-#include <vtkPoints.h>
-#include <vtkSmartPointer.h>
-
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Scan conversion of a closed polygon into a 2D image, using the classic
+ * scanline algorithm with an edge table and an active edge list. A pixel
+ * is inside the polygon if its center, (x + 0.5, y + 0.5), is inside the
+ * polygon according to the fill rule. Crossings are computed with a half-open
+ * test on the y extent of each edge, so that pixels on a shared vertex are
+ * counted exactly once.
+ *
+ * The interior is produced as horizontal spans of pixels, which are either
+ * written into the image (RasterizeFilled) or passed on to a visitor, so that
+ * the caller can write them straight into the segmentation.
+ */
 template<class TImage, class TVertex, class TVertexIterator>
 class PolygonScanConvert
 {
 public:
-  static void RasterizeFilled(TVertexIterator first, unsigned int n, TImage *image)
-  {
-    // Create a vtkPolygol
-    vtkSmartPointer<vtkPolygon> polygon = vtkPolygon::New();
 
+  /** Rule that determines which pixels are inside a self-intersecting polygon */
+  enum FillRule { EVEN_ODD, NONZERO };
 
-    // typedef itk::PolyLineParametricPath<TImage::ImageDimension> InputPolylineType;
-    // typedef typename InputPolylineType::VertexType VertexType;
-    // SmartPtr<InputPolylineType> path = InputPolylineType::New();
+  typedef itk::ImageRegion<2> RegionType;
 
-    // Get the image region
-    // itk::ImageRegion<2> region = image->GetBufferedRegion();
+  /**
+   * Call visitor(y, x0, x1) for each run of pixels [x0, x1) on row y that
+   * are inside the polygon and inside the region. The runs are visited in
+   * order of increasing y and x. Returns the number of pixels in all runs.
+   */
+  template <class TSpanVisitor>
+  static unsigned long ScanSpans(TVertexIterator first, unsigned int n,
+                                 const RegionType &region, FillRule rule,
+                                 TSpanVisitor &visitor)
+  {
+    unsigned long nPixels = 0;
+    if(n < 3 || region.GetNumberOfPixels() == 0)
+      return nPixels;
 
-    // Add points to the path
+    // Copy the vertices, since the iterator may be single pass
+    std::vector<double> vx(n), vy(n);
     for (unsigned int i = 0; i < n; ++i, ++first)
-      polygon->GetPoints()->InsertNextPoint((*first)[0], (*first)[1], 0.0);
+      {
+      vx[i] = (*first)[0];
+      vy[i] = (*first)[1];
+      }
 
-    // Get the raw point data
-    double *point_data =
-        static_cast<double*>(polygon->GetPoints()->GetData()->GetVoidPointer(0));
-    int np = polygon->GetPoints()->GetNumberOfPoints();
+    // Build the edge table. Horizontal edges never cross a scanline
+    long rx0 = region.GetIndex()[0], rx1 = rx0 + (long) region.GetSize()[0];
+    long ry0 = region.GetIndex()[1], ry1 = ry0 + (long) region.GetSize()[1];
+    std::vector<Edge> edges;
+    edges.reserve(n);
+    for (unsigned int i = 0; i < n; ++i)
+      {
+      unsigned int j = (i + 1) % n;
+      if(vy[i] == vy[j])
+        continue;
+
+      Edge e;
+      e.winding = (vy[j] > vy[i]) ? 1 : -1;
+      double xa = vx[i], ya = vy[i], xb = vx[j], yb = vy[j];
+      if(ya > yb)
+        {
+        std::swap(xa, xb);
+        std::swap(ya, yb);
+        }
+
+      // Rows whose centers satisfy ya <= y + 0.5 < yb
+      e.yFirst = (long) std::ceil(ya - 0.5);
+      e.yEnd = (long) std::ceil(yb - 0.5);
+      e.yFirst = std::max(e.yFirst, ry0);
+      e.yEnd = std::min(e.yEnd, ry1);
+      if(e.yFirst >= e.yEnd)
+        continue;
+
+      e.dxdy = (xb - xa) / (yb - ya);
+      e.x0 = xa - ya * e.dxdy;
+      edges.push_back(e);
+      }
 
-    // Get the normal and bounds
-    double normal[3];
-    polygon->ComputeNormal(np, point_data, normal);
+    if(edges.empty())
+      return nPixels;
 
-    double bounds[6];
-    polygon->GetPoints()->GetBounds(bounds);
+    std::sort(edges.begin(), edges.end(), EdgeStartsBefore);
 
-    // Go through the image and test each point
-    typedef itk::ImageRegionIteratorWithIndex<TImage> IteratorType;
-    IteratorType it(image, image->GetBufferedRegion());
-    for(; !it.IsAtEnd(); ++it)
+    // Walk down the scanlines, maintaining the list of active edges
+    std::vector<const Edge *> active;
+    std::vector<Crossing> crossings;
+    size_t iNext = 0;
+    for (long y = edges.front().yFirst; y < ry1; ++y)
       {
-      double x[3];
-      x[0] = it.GetIndex()[0] + 0.5;
-      x[1] = it.GetIndex()[1] + 0.5;
-      x[2] = 0.0;
-
-      if(polygon->PointInPolygon(x, np, point_data, bounds, normal) == 1)
-        it.Set(1);
-      else
-        it.Set(0);
+      // Retire the edges that ended, and activate the ones that start here
+      size_t k = 0;
+      for (size_t i = 0; i < active.size(); ++i)
+        if(active[i]->yEnd > y)
+          active[k++] = active[i];
+      active.resize(k);
+
+      while(iNext < edges.size() && edges[iNext].yFirst == y)
+        active.push_back(&edges[iNext++]);
+
+      if(active.empty())
+        {
+        if(iNext == edges.size())
+          break;
+        y = edges[iNext].yFirst - 1;
+        continue;
+        }
+
+      // Intersect the active edges with the row center and sort them
+      double yc = y + 0.5;
+      crossings.resize(active.size());
+      for (size_t i = 0; i < active.size(); ++i)
+        {
+        crossings[i].x = active[i]->x0 + yc * active[i]->dxdy;
+        crossings[i].winding = active[i]->winding;
+        }
+      std::sort(crossings.begin(), crossings.end(), CrossingBefore);
+
+      // Emit the spans between crossings where the fill rule is satisfied
+      int wind = 0;
+      for (size_t i = 0; i + 1 < crossings.size(); ++i)
+        {
+        wind += crossings[i].winding;
+        bool inside = (rule == EVEN_ODD) ? ((i & 1) == 0) : (wind != 0);
+        if(!inside)
+          continue;
+
+        // Pixels whose centers satisfy xa <= x + 0.5 < xb
+        long x0 = std::max((long) std::ceil(crossings[i].x - 0.5), rx0);
+        long x1 = std::min((long) std::ceil(crossings[i+1].x - 0.5), rx1);
+        if(x0 < x1)
+          {
+          visitor(y, x0, x1);
+          nPixels += x1 - x0;
+          }
+        }
       }
+
+    return nPixels;
+  }
+
+  /**
+   * Set the pixels of the image inside the polygon to 1 and the rest to 0.
+   * Returns the number of pixels set to 1.
+   */
+  static unsigned long RasterizeFilled(TVertexIterator first, unsigned int n,
+                                       TImage *image, FillRule rule = EVEN_ODD)
+  {
+    image->FillBuffer(0);
+    SpanWriter writer(image);
+    return ScanSpans(first, n, image->GetBufferedRegion(), rule, writer);
   }
+
+protected:
+
+  // An edge of the polygon, with x expressed as a linear function of y
+  struct Edge
+  {
+    long yFirst, yEnd;
+    double x0, dxdy;
+    int winding;
+  };
+
+  // The intersection of an active edge with the current scanline
+  struct Crossing
+  {
+    double x;
+    int winding;
+  };
+
+  static bool EdgeStartsBefore(const Edge &a, const Edge &b)
+    { return a.yFirst < b.yFirst; }
+
+  static bool CrossingBefore(const Crossing &a, const Crossing &b)
+    { return a.x < b.x; }
+
+  // Fills the spans in the buffer of an image
+  class SpanWriter
+  {
+  public:
+    SpanWriter(TImage *image) : m_Image(image)
+    {
+      m_Region = image->GetBufferedRegion();
+      m_Buffer = image->GetBufferPointer();
+    }
+
+    void operator() (long y, long x0, long x1)
+    {
+      long stride = m_Region.GetSize()[0];
+      typename TImage::PixelType *row = m_Buffer
+          + (y - m_Region.GetIndex()[1]) * stride - m_Region.GetIndex()[0];
+      std::fill(row + x0, row + x1, 1);
+    }
+
+  protected:
+    TImage *m_Image;
+    RegionType m_Region;
+    typename TImage::PixelType *m_Buffer;
+  };
 };
 
 
 
 #endif
-
@@ -11,6 +11,7 @@
 #include "LayerHistogramPlotAssembly.h"
 #include "ImageWrapperBase.h"
 #include "ScalarImageHistogram.h"
+#include "DisplayMappingPolicy.h"
 
 #include <vtkRenderWindow.h>
 #include <vtkRenderWindowInteractor.h>
@@ -92,8 +93,13 @@ void ThresholdSettingsRenderer::UpdatePlotValues()
                                        m_DataX->GetPointer(0),
                                        m_DataY->GetPointer(0));
 
+    // Use the sampled histogram until the exact one has been computed
     ScalarImageWrapperBase *layer = m_Model->GetActiveScalarLayer(PREPROCESS_THRESHOLD);
-    const ScalarImageHistogram *hist = layer->GetHistogram(0);
+    AbstractContinuousImageDisplayMappingPolicy *dmp =
+        dynamic_cast<AbstractContinuousImageDisplayMappingPolicy *>(
+          layer->GetDisplayMapping());
+    const ScalarImageHistogram *hist =
+        dmp ? dmp->GetAvailableHistogram(0) : layer->GetHistogram(0);
     m_HistogramAssembly->PlotWithFixedLimits(hist, 0.0, 1.0);
 
     m_Plot->GetXAxis()->SetRange(
@@ -85,7 +85,8 @@ double Window3DPicker::IntersectWithLine(
     LabelImageHitTester tester(app->GetColorLabelTable());
     finder.SetHitTester(tester);
 
-    result = finder.FindIntersection(layer->GetImage(), x0, x1 - x0, pos);
+    result = finder.FindIntersection(
+          layer->GetImage(), layer->GetOccupancyPyramid(), x0, x1 - x0, pos);
     }
 
   // Apply
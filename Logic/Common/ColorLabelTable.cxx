@@ -4,6 +4,7 @@
 #include <iomanip>
 #include <fstream>
 #include <string>
+#include <cstring>
 
 using namespace std;
 
@@ -452,6 +453,43 @@ const ColorLabel ColorLabelTable::GetColorLabel(size_t id) const
     return it->second;
 }
 
+const unsigned char *ColorLabelTable::GetFlatRGBATable() const
+{
+  if(m_FlatRGBATable.size() && m_FlatRGBATableTime.GetMTime() >= this->GetMTime())
+    return &m_FlatRGBATable[0];
+
+  size_t n = MAX_COLOR_LABELS + 1;
+  m_FlatRGBATable.resize(4 * n);
+  unsigned char *table = &m_FlatRGBATable[0];
+
+  // Labels that are not in the table have default colors, which repeat
+  // through the color list (see GetDefaultColorLabel)
+  std::vector<unsigned char> palette(4 * m_ColorListSize);
+  for(size_t i = 0; i < m_ColorListSize; i++)
+    {
+    parse_color(m_ColorList[i], palette[4*i], palette[4*i+1], palette[4*i+2]);
+    palette[4*i+3] = 255;
+    }
+
+  GetDefaultColorLabel(0).GetRGBAVector(table);
+  for(size_t id = 1; id < n; id++)
+    memcpy(table + 4 * id, &palette[4 * ((id - 1) % m_ColorListSize)], 4);
+
+  // Labels in the table, with the invisible ones mapped to the clear label
+  unsigned char clear[4];
+  this->GetColorLabel(0).GetRGBAVector(clear);
+  for(ValidLabelConstIterator it = m_LabelMap.begin(); it != m_LabelMap.end(); ++it)
+    {
+    if(it->second.IsVisible())
+      it->second.GetRGBAVector(table + 4 * it->first);
+    else
+      memcpy(table + 4 * it->first, clear, 4);
+    }
+
+  m_FlatRGBATableTime.Modified();
+  return table;
+}
+
 LabelType ColorLabelTable::GetFirstValidLabel() const
 {
   if(m_LabelMap.size() > 1)
@@ -42,6 +42,7 @@
 #include "SNAPEvents.h"
 #include "itkObjectFactory.h"
 #include "itkTimeStamp.h"
+#include <vector>
 
 /**
  * \class ColorLabelTable
@@ -118,6 +119,13 @@ public:
   /** Get the collection of defined/valid labels */
   const ValidLabelMap &GetValidLabels() const { return m_LabelMap; }
 
+  /**
+   * Get a flat table with the RGBA color (four bytes) of every possible label
+   * value, valid or not. Labels that are not visible have the color of the
+   * clear label. The table is only rebuilt after the color table changes.
+   */
+  const unsigned char *GetFlatRGBATable() const;
+
 protected:
 
   ColorLabelTable();
@@ -131,6 +139,10 @@ protected:
 
   static const char *m_ColorList[];
   static const size_t m_ColorListSize;
+
+  // Flat RGBA table for all labels and the time it was built
+  mutable std::vector<unsigned char> m_FlatRGBATable;
+  mutable itk::TimeStamp m_FlatRGBATableTime;
 };
 
 
@@ -66,7 +66,24 @@ public:
    */
   int FindIntersection(ImageType *image,Vector3d xRayStart,
                        Vector3d xRayVector,Vector3i &xHitIndex) const;
+
+  /**
+   * Same as above, but the ray skips over the bricks of an occupancy
+   * pyramid (e.g., RLEOccupancyPyramid) in which no value in the brick's
+   * [min, max] range satisfies the hit tester. The pyramid must be up to date
+   * with the image. The ray is traversed exactly, one voxel or one brick at a
+   * time, so large empty parts of the image are crossed in a few steps.
+   */
+  template <class TOccupancy>
+  int FindIntersection(ImageType *image, const TOccupancy *occupancy,
+                       Vector3d xRayStart, Vector3d xRayVector,
+                       Vector3i &xHitIndex) const;
+
 private:
+  /** Whether no value in the range [vmin, vmax] is a hit */
+  template <class TValue>
+  bool IsRangeMissed(TValue vmin, TValue vmax) const;
+
   /** The hit tester used internally */
   THitTester m_HitTester;
 };
@@ -34,6 +34,9 @@
 =========================================================================*/
 
 #include "itkImage.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 
 template <class TImage, class THitTester>
 int
@@ -176,3 +179,152 @@ ImageRayIntersectionFinder<TImage, THitTester>
   return 0;
 }
 
+
+template <class TImage, class THitTester>
+template <class TValue>
+bool
+ImageRayIntersectionFinder<TImage, THitTester>
+::IsRangeMissed(TValue vmin, TValue vmax) const
+{
+  // Wide ranges are not worth testing one value at a time
+  if(vmax < vmin || vmax - vmin > 255)
+    return false;
+
+  for(TValue v = vmin; ; ++v)
+    {
+    if(m_HitTester(v))
+      return false;
+    if(v == vmax)
+      return true;
+    }
+}
+
+template <class TImage, class THitTester>
+template <class TOccupancy>
+int
+ImageRayIntersectionFinder<TImage, THitTester>
+::FindIntersection(TImage *image, const TOccupancy *occupancy,
+                   Vector3d point, Vector3d ray, Vector3i &hit) const
+{
+  typedef typename TOccupancy::PixelType OccupancyValueType;
+  typename ImageType::IndexType lIndex;
+  typename ImageType::SizeType size =
+    image->GetLargestPossibleRegion().GetSize();
+
+  double rayLen = ray.two_norm();
+  if(rayLen == 0)
+    return -1;
+  ray /= rayLen;
+
+  // As above, the offset puts the borders of the voxels at integer values,
+  // so that the voxel containing p is floor(p)
+  Vector3d p0;
+  for(int d = 0; d < 3; d++)
+    p0[d] = point[d] + 0.5;
+
+  // Clip the ray (t >= 0) to the image box
+  double tEnter = 0.0, tLeave = DBL_MAX;
+  for(int d = 0; d < 3; d++)
+    {
+    if(ray[d] == 0)
+      {
+      if(p0[d] < 0 || p0[d] >= size[d])
+        return -1;
+      }
+    else
+      {
+      double ta = -p0[d] / ray[d], tb = (size[d] - p0[d]) / ray[d];
+      tEnter = std::max(tEnter, std::min(ta, tb));
+      tLeave = std::min(tLeave, std::max(ta, tb));
+      }
+    }
+  if(tEnter >= tLeave)
+    return -1;
+
+  // The voxel where the ray enters the image. On a voxel border, the ray
+  // belongs to the voxel it is heading into
+  long idx[3];
+  for(int d = 0; d < 3; d++)
+    {
+    double x = p0[d] + tEnter * ray[d];
+    double fx = floor(x);
+    idx[d] = (long) ((ray[d] < 0 && fx == x) ? fx - 1 : fx);
+    idx[d] = std::max(0L, std::min(idx[d], (long) size[d] - 1));
+    }
+
+  double t = tEnter;
+  while(true)
+    {
+    for(int d = 0; d < 3; d++)
+      lIndex[d] = idx[d];
+
+    // Find the coarsest brick around the voxel that the ray can skip, or
+    // else test the voxel itself
+    long lo[3] = { idx[0], idx[1], idx[2] };
+    long hi[3] = { idx[0] + 1, idx[1] + 1, idx[2] + 1 };
+    bool skip = false;
+    for(int level = (int) occupancy->GetNumberOfLevels() - 1; level >= 0 && !skip; level--)
+      {
+      OccupancyValueType vmin, vmax;
+      occupancy->GetBrickRange(level, lIndex, vmin, vmax);
+      if(this->IsRangeMissed(vmin, vmax))
+        {
+        long bs = (long) occupancy->GetBrickSize(level);
+        for(int d = 0; d < 3; d++)
+          {
+          lo[d] = idx[d] / bs * bs;
+          hi[d] = std::min(lo[d] + bs, (long) size[d]);
+          }
+        skip = true;
+        }
+      }
+
+    if(!skip && m_HitTester(image->GetPixel(lIndex)))
+      {
+      hit[0] = lIndex[0];
+      hit[1] = lIndex[1];
+      hit[2] = lIndex[2];
+      return 1;
+      }
+
+    // Move to where the ray leaves the box [lo, hi)
+    double tExit = DBL_MAX;
+    int axis = -1;
+    for(int d = 0; d < 3; d++)
+      {
+      double td;
+      if(ray[d] > 0)
+        td = (hi[d] - p0[d]) / ray[d];
+      else if(ray[d] < 0)
+        td = (lo[d] - p0[d]) / ray[d];
+      else
+        continue;
+      if(td < tExit)
+        {
+        tExit = td;
+        axis = d;
+        }
+      }
+
+    // The neighbor across the exit face, which may be outside of the image
+    long next = (ray[axis] > 0) ? hi[axis] : lo[axis] - 1;
+    if(next < 0 || next >= (long) size[axis])
+      return 0;
+
+    t = std::max(t, tExit);
+    for(int d = 0; d < 3; d++)
+      {
+      if(d == axis)
+        {
+        idx[d] = next;
+        }
+      else
+        {
+        double x = p0[d] + t * ray[d];
+        double fx = floor(x);
+        long i = (long) ((ray[d] < 0 && fx == x) ? fx - 1 : fx);
+        idx[d] = std::max(lo[d], std::min(i, hi[d] - 1));
+        }
+      }
+    }
+}
@@ -428,6 +428,8 @@ void SNAPRegistryIO::BuildEnums()
   m_EnumMapSolver.AddPair(SnakeParameters::NARROW_BAND_SOLVER,"NarrowBand");
   m_EnumMapSolver.AddPair(SnakeParameters::PARALLEL_SPARSE_FIELD_SOLVER,
                               "ParallelSparseField");
+  m_EnumMapSolver.AddPair(SnakeParameters::BLOCKED_NARROW_BAND_SOLVER,
+                              "BlockedNarrowBand");
 
   m_EnumMapSnakeType.AddPair(SnakeParameters::EDGE_SNAKE,"EdgeStopping");
   m_EnumMapSnakeType.AddPair(SnakeParameters::REGION_SNAKE,"RegionCompetition");
@@ -77,6 +77,11 @@ GenericImageData
   m_DisplayViewportGeometry[0] = ImageBaseType::New();
   m_DisplayViewportGeometry[1] = ImageBaseType::New();
   m_DisplayViewportGeometry[2] = ImageBaseType::New();
+
+  // Cached samples at the cursor become invalid when the layers change
+  m_CursorSamplesValid = false;
+  AddListener(this, LayerChangeEvent(), this, &Self::InvalidateCursorSamples);
+  AddListener(this, WrapperChangeEvent(), this, &Self::InvalidateCursorSamples);
 }
 
 GenericImageData
@@ -451,6 +456,83 @@ GenericImageData
   return m_MainImageWrapper->GetBufferedRegion();
 }
 
+void
+GenericImageData
+::SampleLayers(const Vector3ui &pos, const SamplingStencil &stencil,
+               int role_filter, LayerSampleMap &out)
+{
+  out.clear();
+  if(!this->IsMainLoaded())
+    return;
+
+  // Compute the sampling locations in reference space
+  RegionType region = this->GetImageRegion();
+  unsigned int n = stencil.size() ? stencil.size() : 1;
+  std::vector< itk::Index<3> > index(n);
+  for(unsigned int i = 0; i < n; i++)
+    {
+    for(int d = 0; d < 3; d++)
+      {
+      long x = pos[d] + (stencil.size() ? stencil[i][d] : 0);
+      long x_min = region.GetIndex(d), x_max = x_min + region.GetSize(d) - 1;
+      index[i][d] = std::min(std::max(x, x_min), x_max);
+      }
+    }
+
+  // Sample each layer at all the locations at once
+  for(LayerIterator it(this, role_filter); !it.IsAtEnd(); ++it)
+    {
+    ImageWrapperBase *layer = it.GetLayer();
+    if(layer && layer->IsInitialized())
+      {
+      LayerSample &sample = out[layer->GetUniqueId()];
+      sample.Value.resize(n);
+      sample.Appearance.resize(n);
+      layer->SampleDisplayedValueAndAppearance(
+            &index[0], n, &sample.Value[0], &sample.Appearance[0]);
+      }
+    }
+}
+
+bool
+GenericImageData
+::GetLayerSampleAtCursor(ImageWrapperBase *layer,
+                         vnl_vector<double> &out_value,
+                         ImageWrapperBase::DisplayPixelType &out_appearance)
+{
+  if(!layer || !layer->IsInitialized() || !this->IsMainLoaded())
+    return false;
+
+  // The samples must be for the current cursor position, and the layer's
+  // image (e.g., by painting) and appearance must not have been modified since
+  Vector3ui pos = m_MainImageWrapper->GetSliceIndex();
+  itk::ModifiedTimeType t_samples = m_CursorSamplesTime.GetMTime();
+  LayerSampleMap::const_iterator it = m_CursorSamples.find(layer->GetUniqueId());
+  if(!m_CursorSamplesValid || pos != m_CursorSamplesPosition || it == m_CursorSamples.end()
+     || layer->GetImageBase()->GetMTime() > t_samples
+     || layer->GetDisplayMapping()->GetMTime() > t_samples
+     || m_Parent->GetColorLabelTable()->GetMTime() > t_samples)
+    {
+    this->SampleLayers(pos, SamplingStencil(), ALL_ROLES, m_CursorSamples);
+    m_CursorSamplesPosition = pos;
+    m_CursorSamplesTime.Modified();
+    m_CursorSamplesValid = true;
+
+    it = m_CursorSamples.find(layer->GetUniqueId());
+    if(it == m_CursorSamples.end())
+      return false;
+    }
+
+  out_value = it->second.Value.front();
+  out_appearance = it->second.Appearance.front();
+  return true;
+}
+
+void GenericImageData::InvalidateCursorSamples()
+{
+  m_CursorSamplesValid = false;
+}
+
 
 unsigned int GenericImageData::GetNumberOfLayers(int role_filter)
 {
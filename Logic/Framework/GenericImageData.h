@@ -52,6 +52,7 @@
 #include "GlobalState.h"
 #include "ImageCoordinateGeometry.h"
 #include <string>
+#include <map>
 #include "LayerIterator.h"
 
 class IRISApplication;
@@ -316,6 +317,39 @@ public:
   /** Clear all segmentation undo points in this layer collection */
   void ClearUndoPoints();
 
+  /** Displayed values and appearance of a layer at the points of a stencil */
+  struct LayerSample
+  {
+    std::vector< vnl_vector<double> > Value;
+    std::vector<ImageWrapperBase::DisplayPixelType> Appearance;
+  };
+
+  /** Offsets, in voxels, from the location at which the layers are sampled */
+  typedef std::vector< itk::Offset<3> > SamplingStencil;
+
+  /** Samples of a set of layers, indexed by the layer unique id */
+  typedef std::map<unsigned long, LayerSample> LayerSampleMap;
+
+  /**
+   * Sample the initialized layers that match the role filter at a location
+   * in reference space, and at a stencil of offsets around it (clamped to the
+   * image). If the stencil is empty, only the location itself is sampled.
+   * Each layer is sampled in a single call, so that its slicing pipeline is
+   * updated and its transform to reference space is resolved only once.
+   */
+  void SampleLayers(const Vector3ui &pos, const SamplingStencil &stencil,
+                    int role_filter, LayerSampleMap &out);
+
+  /**
+   * Get the displayed value and appearance of a layer at the cursor. The
+   * first call after the cursor moves, or after the layers change, samples
+   * all the layers at once and caches the result; later calls for the other
+   * layers are just lookups. Returns false if the layer is not initialized.
+   */
+  bool GetLayerSampleAtCursor(ImageWrapperBase *layer,
+                              vnl_vector<double> &out_value,
+                              ImageWrapperBase::DisplayPixelType &out_appearance);
+
 protected:
 
   GenericImageData();
@@ -352,6 +386,16 @@ protected:
   // this role is generated. The counters are reset when the main image is reloaded
   std::map<LayerRole, int> m_NicknameCounter;
 
+  // Samples of all the layers at the cursor position, the position and time
+  // at which they were taken, and whether they are still valid
+  LayerSampleMap m_CursorSamples;
+  Vector3ui m_CursorSamplesPosition;
+  itk::TimeStamp m_CursorSamplesTime;
+  bool m_CursorSamplesValid;
+
+  // Called when layers are added, removed or modified
+  void InvalidateCursorSamples();
+
   friend class SNAPImageData;
   friend class LayerIterator;
 
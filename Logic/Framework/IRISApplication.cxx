@@ -51,6 +51,8 @@
 #include "RLEImageRegionIterator.h"
 #include "RLERegionOfInterestImageFilter.h"
 #include "itkPasteImageFilter.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkMinimumMaximumImageCalculator.h"
 #include "itkIdentityTransform.h"
 #include "itkResampleImageFilter.h"
 #include "itkNearestNeighborInterpolateImageFunction.h"
@@ -86,9 +88,11 @@
 #include "ImageAnnotationData.h"
 #include "SegmentationUpdateIterator.h"
 #include "AffineTransformHelper.h"
+#include "itkMultiThreader.h"
 
 #include <stdio.h>
 #include <sstream>
+#include <algorithm>
 #include <iomanip>
 
 IRISApplication
@@ -577,8 +581,38 @@ IRISApplication
   // Get the segmentation image
   LabelImageType *seg = this->GetSelectedSegmentationLayer()->GetImage();
 
-  // Turn the 2D region of the drawing into a 3D region in the segmentation
+  // Drawing parameters
+  bool invert = m_GlobalState->GetPolygonInvert();
+
+  // Unless the drawing is inverted, only the bounding box of its nonzero
+  // pixels can change the segmentation
   IRISApplication::SliceBinaryImageType::RegionType r_draw = drawing->GetBufferedRegion();
+  const SliceBinaryImageType::PixelType *drawBuffer = drawing->GetBufferPointer();
+  long drawStride = r_draw.GetSize()[0];
+  if(!invert)
+    {
+    long x0 = r_draw.GetSize()[0], x1 = -1, y0 = r_draw.GetSize()[1], y1 = -1;
+    for(long y = 0; y < (long) r_draw.GetSize()[1]; y++)
+      {
+      const SliceBinaryImageType::PixelType *row = drawBuffer + y * drawStride;
+      for(long x = 0; x < drawStride; x++)
+        {
+        if(row[x])
+          {
+          x0 = std::min(x0, x); x1 = std::max(x1, x);
+          y0 = std::min(y0, y); y1 = std::max(y1, y);
+          }
+        }
+      }
+
+    if(x1 < 0)
+      return 0;
+
+    itk::Index<2> idx_bb = {{ r_draw.GetIndex()[0] + x0, r_draw.GetIndex()[1] + y0 }};
+    itk::Size<2> sz_bb = {{ (itk::SizeValueType) (x1 - x0 + 1),
+                            (itk::SizeValueType) (y1 - y0 + 1) }};
+    r_draw = SliceBinaryImageType::RegionType(idx_bb, sz_bb);
+    }
 
   // Array of corners of the drawing region
   Vector2ui corners[4];
@@ -626,30 +660,52 @@ IRISApplication
                                    m_GlobalState->GetDrawingColorLabel(),
                                    m_GlobalState->GetDrawOverFilter());
 
-  // Drawing parameters
-  bool invert = m_GlobalState->GetPolygonInvert();
-
   // Inverse transform
   ImageCoordinateTransform::Pointer xfmImageToSlice = ImageCoordinateTransform::New();
   xfmSliceToImage->ComputeInverse(xfmImageToSlice);
 
-  // Iterate over the volume region
-  for(; !itVol.IsAtEnd(); ++itVol)
-    {
-    // Find the coordinate of the voxel in the slice
-    itk::Index<3> idx_vol = itVol.GetIndex();
-    Vector3d x_slice = xfmImageToSlice->TransformPoint(
-                         Vector3d(idx_vol[0] + 0.5, idx_vol[1] + 0.5, idx_vol[2] + 0.5));
-    itk::Index<2> idx_slice;
-    idx_slice[0] = (int) x_slice[0];
-    idx_slice[1] = (int) x_slice[1];
-
-    // Check value
-    SliceBinaryImageType::PixelType px = drawing->GetPixel(idx_slice);
-    if((px != 0) ^ invert)
-      itVol.PaintAsForeground();
+  // The transform is a permutation and flip of the axes, so each image axis
+  // maps to a single slice axis. Tabulate the slice coordinate of every image
+  // index in the region instead of transforming each voxel. The offset into
+  // the drawing buffer is tabulated for the two in-plane axes, and zero for
+  // the axis normal to the slice
+  std::vector<long> drawOffset[3];
+  for(int a = 0; a < 3; a++)
+    {
+    Vector3d ea(0.0); ea[a] = 1.0;
+    Vector3d va = xfmImageToSlice->TransformVector(ea);
+    int d = 0;
+    for(int k = 1; k < 3; k++)
+      if(std::fabs(va[k]) > std::fabs(va[d]))
+        d = k;
+
+    long start = r_vol.GetIndex()[a];
+    drawOffset[a].resize(r_vol.GetSize()[a], 0);
+    if(d == 2)
+      continue;
 
+    for(long i = 0; i < (long) r_vol.GetSize()[a]; i++)
+      {
+      Vector3d x_img(0.0); x_img[a] = start + i + 0.5;
+      long x_slice = (long) xfmImageToSlice->TransformPoint(x_img)[d]
+                     - drawing->GetBufferedRegion().GetIndex()[d];
+      drawOffset[a][i] = (d == 0) ? x_slice : x_slice * drawStride;
+      }
+    }
 
+  // Iterate over the volume region in the order of the iterator
+  for(long k = 0; k < (long) r_vol.GetSize()[2]; k++)
+    {
+    for(long j = 0; j < (long) r_vol.GetSize()[1]; j++)
+      {
+      const SliceBinaryImageType::PixelType *drawLine =
+          drawBuffer + drawOffset[1][j] + drawOffset[2][k];
+      for(long i = 0; i < (long) r_vol.GetSize()[0]; i++, ++itVol)
+        {
+        if((drawLine[drawOffset[0][i]] != 0) ^ invert)
+          itVol.PaintAsForeground();
+        }
+      }
     }
 
   // Finalize
@@ -758,40 +814,48 @@ IRISApplication
     source = fltSample->GetOutput();
     }  
 
-  // Creat the source iterator
-  typedef itk::ImageRegionConstIterator<SourceImageType> SourceIteratorType;
-  SourceIteratorType itSource(source,source->GetLargestPossibleRegion());
+  // The result is pasted in parallel slabs. The source region of each slab
+  // is offset from its target region by the position of the ROI
+  SourceImageType::RegionType rSource = source->GetLargestPossibleRegion();
+  itk::Offset<3> offSource = rSource.GetIndex() - roi.GetROI().GetIndex();
 
-  // Create the smart target iterator
-  SegmentationUpdateIterator itTarget(
+  ParallelSegmentationUpdate update(
         target, roi.GetROI(),
         m_GlobalState->GetDrawingColorLabel(), m_GlobalState->GetDrawOverFilter());
 
   // Inversion state
   bool invert = m_GlobalState->GetPolygonInvert();
 
-  // Go through both iterators, copy the new over the old
-  while(!itSource.IsAtEnd())
+#pragma omp parallel for
+  for(int iSlab = 0; iSlab < update.GetNumberOfSlabs(); iSlab++)
     {
-    // Get the level set value
-    float voxSNAP = itSource.Value();
-    if((!invert && voxSNAP <= 0) || (invert && voxSNAP >= 0))
-      itTarget.PaintAsForeground();
-    else
-      itTarget.PaintAsBackground();
+    // Create the source iterator
+    SourceImageType::RegionType rSlabSource = update.GetSlabRegion(iSlab);
+    rSlabSource.SetIndex(rSlabSource.GetIndex() + offSource);
+    itk::ImageRegionConstIterator<SourceImageType> itSource(source, rSlabSource);
 
-    // Iterate
-    ++itSource;
-    ++itTarget;
-    }
+    // The smart target iterator
+    SegmentationUpdateIterator &itTarget = update.GetSlabIterator(iSlab);
 
-  // Finalize the segmentation
-  itTarget.Finalize();
+    // Go through both iterators, copy the new over the old
+    while(!itSource.IsAtEnd())
+      {
+      // Get the level set value
+      float voxSNAP = itSource.Value();
+      if((!invert && voxSNAP <= 0) || (invert && voxSNAP >= 0))
+        itTarget.PaintAsForeground();
+      else
+        itTarget.PaintAsBackground();
 
-  // Store the undo delta
-  if(itTarget.GetNumberOfChangedVoxels() > 0)
+      // Iterate
+      ++itSource;
+      ++itTarget;
+      }
+    }
+
+  // Store the undo deltas of the slabs as a single undo point
+  if(update.Commit(iris_seg, "Automatic Segmentation") > 0)
     {
-    iris_seg->StoreUndoPoint("Automatic Segmentation", itTarget.RelinquishDelta());
     RecordCurrentLabelUse();
     InvokeEvent(SegmentationChangeEvent());
     }
@@ -1223,51 +1287,101 @@ IRISApplication
 }
 
 
+// Signed distance of a voxel to the cut plane, as used by the scalpel
+static inline double CutPlaneDistance(long x, long y, long z,
+                               const Vector3d &normal, double intercept)
+{
+  return x * normal[0] + y * normal[1] + z * normal[2] - intercept;
+}
+
+void
+IRISApplication
+::ComputeCutPlaneSpan(long y, long z, long xMin, long xMax,
+                      const Vector3d &normal, double intercept,
+                      long &x0, long &x1)
+{
+  // The span is computed analytically and then nudged so that it agrees
+  // exactly with the per-voxel distance test
+  double c = y * normal[1] + z * normal[2] - intercept;
+  if(normal[0] == 0.0)
+    {
+    x0 = xMin; x1 = (c > 0) ? xMax : xMin;
+    return;
+    }
+
+  // The plane crosses the scanline at x = t
+  double t = -c / normal[0];
+  double tc = std::max((double) xMin - 1.0, std::min((double) xMax + 1.0, t));
+  if(normal[0] > 0)
+    {
+    x0 = std::max(xMin, (long) std::floor(tc) + 1); x1 = xMax;
+    while(x0 > xMin && CutPlaneDistance(x0 - 1, y, z, normal, intercept) > 0) x0--;
+    while(x0 < x1 && !(CutPlaneDistance(x0, y, z, normal, intercept) > 0)) x0++;
+    }
+  else
+    {
+    x0 = xMin; x1 = std::min(xMax, (long) std::ceil(tc));
+    while(x1 < xMax && CutPlaneDistance(x1, y, z, normal, intercept) > 0) x1++;
+    while(x1 > x0 && !(CutPlaneDistance(x1 - 1, y, z, normal, intercept) > 0)) x1--;
+    }
+
+  // If the plane crosses the scanline outside of [xMin, xMax), the span is
+  // empty, and it must still lie within the scanline
+  x0 = std::min(x0, xMax);
+  x1 = std::max(x1, x0);
+}
+
 int
 IRISApplication
 ::RelabelSegmentationWithCutPlane(const Vector3d &normal, double intercept) 
 {
   // Get the label image
-  LabelImageWrapper::ImageType *imgLabel = this->GetSelectedSegmentationLayer()->GetImage();
-  
-  // Create the smart target iterator
-  SegmentationUpdateIterator it(
-        imgLabel, imgLabel->GetBufferedRegion(),
-        m_GlobalState->GetDrawingColorLabel(), m_GlobalState->GetDrawOverFilter());
+  LabelImageWrapper *wrapper = this->GetSelectedSegmentationLayer();
+  LabelImageWrapper::ImageType *imgLabel = wrapper->GetImage();
+  LabelImageWrapper::ImageType::RegionType region = imgLabel->GetBufferedRegion();
 
   // Adjust the intercept by 0.5 for voxel offset
   intercept -= 0.5 * (normal[0] + normal[1] + normal[2]);
 
-  // Iterate over the image, relabeling labels on one side of the plane
-  while(!it.IsAtEnd())
-    {
-    // Compute the distance to the plane
-    itk::Index<3> index = it.GetIndex();
-    double distance = 
-      index[0]*normal[0] + 
-      index[1]*normal[1] + 
-      index[2]*normal[2] - intercept;
+  // The image is split into slabs that are relabeled in parallel, each with
+  // its own set of run-length lines and its own undo delta
+  ParallelSegmentationUpdate update(
+        imgLabel, region,
+        m_GlobalState->GetDrawingColorLabel(), m_GlobalState->GetDrawOverFilter());
 
-    // Check the side of the plane
-    if(distance > 0)
-      it.PaintAsForegroundPreserveClear();
+  long xMin = region.GetIndex()[0], xMax = xMin + (long) region.GetSize()[0];
 
-    // Next voxel
-    ++it;
-    }
+#pragma omp parallel for
+  for(int iSlab = 0; iSlab < update.GetNumberOfSlabs(); iSlab++)
+    {
+    const LabelImageWrapper::ImageType::RegionType &rSlab = update.GetSlabRegion(iSlab);
+    SegmentationUpdateIterator &it = update.GetSlabIterator(iSlab);
 
-  // Finalize
-  it.Finalize();
+    // Relabel the span of each scanline that is on the positive side of the
+    // plane. The runs of the line are relabeled directly, and the lines that
+    // the plane does not cut are skipped in one step
+    long y0 = rSlab.GetIndex()[1], y1 = y0 + (long) rSlab.GetSize()[1];
+    long z0 = rSlab.GetIndex()[2], z1 = z0 + (long) rSlab.GetSize()[2];
+    for(long z = z0; z < z1; z++)
+      {
+      for(long y = y0; y < y1; y++)
+        {
+        long xs0, xs1;
+        ComputeCutPlaneSpan(y, z, xMin, xMax, normal, intercept, xs0, xs1);
+        it.PaintSpanAsForegroundPreserveClear(xs0, xs1);
+        }
+      }
+    }
 
-  // Store the undo point if needed
-  if(it.GetNumberOfChangedVoxels() > 0)
+  // Store the deltas of the slabs as a single undo point
+  unsigned long nChanged = update.Commit(wrapper, "3D scalpel");
+  if(nChanged > 0)
     {
-    this->GetSelectedSegmentationLayer()->StoreUndoPoint("3D scalpel", it.RelinquishDelta());
     RecordCurrentLabelUse();
     InvokeEvent(SegmentationChangeEvent());
     }
 
-  return it.GetNumberOfChangedVoxels();
+  return nChanged;
 }
 
 int 
@@ -1637,9 +1751,10 @@ IRISApplication
     AutoContrastLayerOnLoad(layer);
 
   // Save the thumbnail for the current image. This ensures that a thumbnail
-  // is created even if the application crashes or is killed.
-  ImageWrapperBase::DisplaySlicePointer thumbnail = layer->MakeThumbnail(128);
-  m_SystemInterface->WriteThumbnail(io->GetFileNameOfNativeImage().c_str(), thumbnail);
+  // is created even if the application crashes or is killed. The thumbnail
+  // is made from a copy of the slice and written in the background
+  ImageWrapperBase::DisplaySlicePointer thumb_slice = layer->GetThumbnailSlice();
+  m_SystemInterface->WriteThumbnail(io->GetFileNameOfNativeImage().c_str(), thumb_slice, 128);
 
   // We also want to reset the label history at this point, as these are
   // very different labels
@@ -1767,9 +1882,10 @@ IRISApplication
     // Write the image-level and project-level associations
     SaveMetaDataAssociatedWithLayer(main_image, MAIN_ROLE);
 
-    // Create a thumbnail from the one of the image slices
-    ImageWrapperBase::DisplaySlicePointer thumbnail = main_image->MakeThumbnail(128);
-    m_SystemInterface->WriteThumbnail(fnMain, thumbnail);
+    // Create a thumbnail from the one of the image slices. This only copies
+    // the slice, the thumbnail is made and written in the background
+    ImageWrapperBase::DisplaySlicePointer thumb_slice = main_image->GetThumbnailSlice();
+    m_SystemInterface->WriteThumbnail(fnMain, thumb_slice, 128);
 
     // Do likewise for the project if one exists
     if(m_GlobalState->GetProjectFilename().length())
@@ -1777,7 +1893,7 @@ IRISApplication
       // TODO: it would look nicer if we actually saved the state of the SNAP
       // windows rather than just the image in its current colormap. But this
       // would require doing this elsewhere
-      m_SystemInterface->WriteThumbnail(m_GlobalState->GetProjectFilename().c_str(), thumbnail);
+      m_SystemInterface->WriteThumbnail(m_GlobalState->GetProjectFilename().c_str(), thumb_slice, 128);
       }
     }
 
@@ -2756,6 +2872,200 @@ IRISApplication
     }
 }
 
+/**
+ * Helper for ComputeSpeedVolumesForROIs: create an image that shares the
+ * buffer of the source image but is not connected to its pipeline, so that
+ * several filters can read it from different threads
+ */
+template <class TImage>
+static SmartPtr<TImage> CreateDisconnectedImageView(TImage *source)
+{
+  SmartPtr<TImage> view = TImage::New();
+  view->CopyInformation(source);
+  view->SetRegions(source->GetBufferedRegion());
+  view->SetPixelContainer(source->GetPixelContainer());
+  return view;
+}
+
+/**
+ * Helper for ComputeSpeedVolumesForROIs: re-index the buffered region of a
+ * filter output so that it starts at zero, with the origin moved to the first
+ * voxel. This is the geometry produced by RegionOfInterestImageFilter. The
+ * pixel buffer is shared, not copied.
+ */
+template <class TImage>
+static SmartPtr<TImage> CreateZeroBasedImageView(TImage *source)
+{
+  typename TImage::RegionType region = source->GetBufferedRegion();
+  typename TImage::PointType origin;
+  source->TransformIndexToPhysicalPoint(region.GetIndex(), origin);
+
+  SmartPtr<TImage> view = TImage::New();
+  view->CopyInformation(source);
+  view->SetOrigin(origin);
+  view->SetRegions(region.GetSize());
+  view->SetPixelContainer(source->GetPixelContainer());
+  return view;
+}
+
+void
+IRISApplication
+::ComputeSpeedVolumesForROIs(
+    const std::vector<SNAPSegmentationROISettings> &rois,
+    PreprocessingMode mode, SpeedImageList &speedImages)
+{
+  typedef ScalarImageWrapperBase::CommonFormatImageType GreyImageType;
+  typedef SmoothBinaryThresholdImageFilter<GreyImageType, SpeedImageType> ThresholdFilter;
+  typedef EdgePreprocessingImageFilter<GreyImageType, SpeedImageType> EdgeFilter;
+  typedef itk::ImageToImageFilter<GreyImageType, SpeedImageType> SpeedFilter;
+  typedef itk::RegionOfInterestImageFilter<GreyImageType, GreyImageType> CropFilter;
+  typedef itk::MinimumMaximumImageCalculator<GreyImageType> RangeCalculator;
+
+  assert(m_IRISImageData->IsMainLoaded());
+
+  if(mode != PREPROCESS_THRESHOLD && mode != PREPROCESS_EDGE)
+    throw IRISException("Batch speed image computation is only supported "
+                        "for thresholding and edge preprocessing");
+
+  // The speed image is computed from the default scalar representation of the
+  // main image, as in the interactive preprocessing pipeline
+  ImageWrapperBase *main = m_IRISImageData->GetMain();
+  ScalarImageWrapperBase *scalar = main->GetDefaultScalarRepresentation();
+
+  // Threshold settings are associated with the layer
+  ThresholdSettings *ts = NULL;
+  if(mode == PREPROCESS_THRESHOLD)
+    {
+    ts = dynamic_cast<ThresholdSettings *>(scalar->GetUserData("ThresholdSettings"));
+    if(!ts)
+      throw IRISException("Threshold settings are missing for the main image");
+    if(!ts->GetInitialized())
+      ts->InitializeToDefaultForImage(scalar);
+    }
+
+  // Bring the full-resolution image up to date once. All regions that are not
+  // resampled read from this buffer
+  GreyImageType *grey = scalar->GetCommonFormatImage();
+  grey->UpdateOutputInformation();
+  grey->SetRequestedRegionToLargestPossibleRegion();
+  grey->Update();
+
+  // Set up the filters. This is done serially because the pipeline and the
+  // object factories are not thread-safe. Each filter gets its own view of the
+  // input and its own copy of the settings, so that the filters do not share
+  // any pipeline objects when they execute in parallel
+  int nroi = (int) rois.size();
+  std::vector<SmartPtr<SpeedFilter> > filters(nroi);
+  std::vector<SmartPtr<ImageWrapperBase> > resampled(nroi);
+  std::vector<SmartPtr<RangeCalculator> > ranges(nroi);
+  for(int i = 0; i < nroi; i++)
+    {
+    SmartPtr<GreyImageType> input;
+    itk::ImageRegion<3> region;
+    if(rois[i].IsResampling() || !main->IsSlicingOrthogonal())
+      {
+      // Resampled regions have to be extracted, the same way as in SNAP mode
+      resampled[i] = main->ExtractROI(rois[i], NULL);
+      GreyImageType *roiGrey =
+          resampled[i]->GetDefaultScalarRepresentation()->GetCommonFormatImage();
+      roiGrey->Update();
+      input = CreateDisconnectedImageView(roiGrey);
+      region = roiGrey->GetBufferedRegion();
+      }
+    else if(mode == PREPROCESS_EDGE)
+      {
+      // The edge filter smooths the image, and in SNAP mode the smoothing
+      // does not see past the ROI. So only the ROI is copied from the buffer
+      SmartPtr<CropFilter> crop = CropFilter::New();
+      crop->SetInput(CreateDisconnectedImageView(grey));
+      crop->SetRegionOfInterest(rois[i].GetROI());
+      crop->UpdateOutputInformation();
+      input = crop->GetOutput();
+      region = input->GetLargestPossibleRegion();
+      }
+    else
+      {
+      input = CreateDisconnectedImageView(grey);
+      region = rois[i].GetROI();
+      }
+
+    // In SNAP mode, the intensity range used by the filters is that of the
+    // ROI, so it is computed for each region
+    ranges[i] = RangeCalculator::New();
+    ranges[i]->SetImage(resampled[i] ? input.GetPointer() : grey);
+    ranges[i]->SetRegion(resampled[i] ? region : rois[i].GetROI());
+
+    if(mode == PREPROCESS_THRESHOLD)
+      {
+      SmartPtr<ThresholdFilter> filter = ThresholdFilter::New();
+      filter->SetInput(input);
+      filter->SetParameters(ts);
+      filters[i] = filter.GetPointer();
+      }
+    else
+      {
+      SmartPtr<EdgePreprocessingSettings> eps = EdgePreprocessingSettings::New();
+      eps->SetGaussianBlurScale(m_EdgePreprocessingSettings->GetGaussianBlurScale());
+      eps->SetRemappingSteepness(m_EdgePreprocessingSettings->GetRemappingSteepness());
+      eps->SetRemappingExponent(m_EdgePreprocessingSettings->GetRemappingExponent());
+
+      SmartPtr<EdgeFilter> filter = EdgeFilter::New();
+      filter->SetInput(input);
+      filter->SetParameters(eps);
+      filters[i] = filter.GetPointer();
+      }
+
+    // Only the region of interest is computed
+    filters[i]->UpdateOutputInformation();
+    filters[i]->GetOutput()->SetRequestedRegion(region);
+    }
+
+  // Split the available threads between the regions
+  int nThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  int nFilterThreads = std::max(1, nThreads / std::max(1, nroi));
+
+  // Run the filters concurrently. Exceptions can not propagate out of the
+  // parallel loop, so we record them and throw after the loop
+  std::vector<std::string> errors(nroi);
+  speedImages.assign(nroi, SmartPtr<SpeedImageType>());
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int i = 0; i < nroi; i++)
+    {
+    try
+      {
+      ranges[i]->Compute();
+      double imin = ranges[i]->GetMinimum(), imax = ranges[i]->GetMaximum();
+      if(mode == PREPROCESS_THRESHOLD)
+        {
+        ThresholdFilter *filter = static_cast<ThresholdFilter *>(filters[i].GetPointer());
+        filter->SetInputImageMinimum(imin);
+        filter->SetInputImageMaximum(imax);
+        }
+      else
+        {
+        EdgeFilter *filter = static_cast<EdgeFilter *>(filters[i].GetPointer());
+        filter->SetInputImageMaximumGradientMagnitude(imax - imin);
+        }
+
+      filters[i]->SetNumberOfThreads(nFilterThreads);
+      filters[i]->Update();
+      speedImages[i] = CreateZeroBasedImageView(filters[i]->GetOutput());
+      }
+    catch(std::exception &exc)
+      {
+      errors[i] = exc.what();
+      }
+    }
+
+  for(int i = 0; i < nroi; i++)
+    {
+    if(errors[i].size())
+      throw IRISException("Speed image computation failed for region %d: %s",
+                          i, errors[i].c_str());
+    }
+}
+
 IRISApplication::BubbleArray&
 IRISApplication::GetBubbleArray()
 {
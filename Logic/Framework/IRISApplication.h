@@ -384,6 +384,24 @@ public:
     */
   void ApplyCurrentPreprocessingModeToSpeedVolume(itk::Command *progress = 0);
 
+  /** A list of speed images, one per region of interest */
+  typedef std::vector<SmartPtr<SpeedImageType> > SpeedImageList;
+
+  /**
+    Compute speed images for a batch of regions of interest in the main image,
+    without entering SNAP mode. The current settings of the given preprocessing
+    mode are used; only PREPROCESS_THRESHOLD and PREPROCESS_EDGE are supported.
+    The regions are processed concurrently. For thresholding, regions that are
+    not resampled read the buffer of the main image rather than copying it;
+    edge preprocessing copies just the ROI, since smoothing must not look past
+    it. Each speed image is the same as the one computed in SNAP mode for that
+    ROI, and has the geometry of the image that InitializeSNAPImageData would
+    create, so it can be passed to UpdateSNAPSpeedImage or saved to disk.
+    */
+  void ComputeSpeedVolumesForROIs(
+      const std::vector<SNAPSegmentationROISettings> &rois,
+      PreprocessingMode mode, SpeedImageList &speedImages);
+
   /**
     Get the current preprocessing mode
     */
@@ -516,6 +534,17 @@ public:
   int RelabelSegmentationWithCutPlane(
     const Vector3d &normal, double intercept);
 
+  /**
+   * Find the span [x0, x1) of voxels on the scanline (y, z) between xMin and
+   * xMax (exclusive) for which index * normal - intercept > 0. The span always
+   * satisfies xMin <= x0 <= x1 <= xMax, and is empty if the plane does not
+   * cut the scanline. Used by the scalpel to relabel whole scanlines without
+   * testing every voxel.
+   */
+  static void ComputeCutPlaneSpan(long y, long z, long xMin, long xMax,
+                                  const Vector3d &normal, double intercept,
+                                  long &x0, long &x1);
+
   /**
    * Compute the intersection of the segmentation with a ray
    */
@@ -1,6 +1,7 @@
 #include "ImageAnnotationData.h"
 #include "Registry.h"
 #include "IRISException.h"
+#include <algorithm>
 
 namespace annot
 {
@@ -156,15 +157,135 @@ void LandmarkAnnotation::Load(Registry &folder)
 
 }
 
+void ImageAnnotationData::ComputeSliceKeys(const AbstractAnnotation *annot, int slice[3])
+{
+  // This follows the logic of AbstractAnnotation::IsVisible
+  for(int d = 0; d < 3; d++)
+    {
+    if(!annot->GetVisibleInAllPlanes() && d != annot->GetPlane())
+      slice[d] = NOT_INDEXED;
+    else if(annot->GetVisibleInAllSlices())
+      slice[d] = ALL_SLICES;
+    else
+      slice[d] = annot->GetSliceIndex(d);
+    }
+}
+
+void ImageAnnotationData::AddToBuckets(const IndexEntry &entry, const int slice[3])
+{
+  for(int d = 0; d < 3; d++)
+    {
+    if(slice[d] == NOT_INDEXED)
+      continue;
+
+    // New annotations go to the end of the bucket, moved ones are inserted
+    // by sequence number
+    SliceBucket &bucket = m_SliceBuckets[d][slice[d]];
+    if(bucket.empty() || bucket.back() < entry)
+      bucket.push_back(entry);
+    else
+      bucket.insert(std::lower_bound(bucket.begin(), bucket.end(), entry), entry);
+    }
+}
+
+void ImageAnnotationData::RemoveFromBuckets(const IndexEntry &entry, const int slice[3])
+{
+  for(int d = 0; d < 3; d++)
+    {
+    if(slice[d] == NOT_INDEXED)
+      continue;
+
+    SliceBucketMap::iterator itb = m_SliceBuckets[d].find(slice[d]);
+    if(itb == m_SliceBuckets[d].end())
+      continue;
+
+    SliceBucket &bucket = itb->second;
+    SliceBucket::iterator it = std::lower_bound(bucket.begin(), bucket.end(), entry);
+    if(it != bucket.end() && it->Annotation == entry.Annotation)
+      bucket.erase(it);
+
+    if(bucket.empty())
+      m_SliceBuckets[d].erase(itb);
+    }
+}
+
 void ImageAnnotationData::AddAnnotation(ImageAnnotationData::AbstractAnnotation *annot)
 {
   SmartPtr<AbstractAnnotation> myannot = annot;
   m_Annotations.push_back(myannot);
+
+  IndexRecord &rec = m_IndexRecords[annot];
+  rec.Sequence = m_NextSequence++;
+  rec.ListPosition = --m_Annotations.end();
+  ComputeSliceKeys(annot, rec.Slice);
+
+  IndexEntry entry = { rec.Sequence, annot };
+  AddToBuckets(entry, rec.Slice);
+}
+
+void ImageAnnotationData::RemoveAnnotation(ImageAnnotationData::AbstractAnnotation *annot)
+{
+  IndexRecordMap::iterator it = m_IndexRecords.find(annot);
+  if(it == m_IndexRecords.end())
+    return;
+
+  IndexEntry entry = { it->second.Sequence, annot };
+  RemoveFromBuckets(entry, it->second.Slice);
+
+  // Erasing from the list may delete the annotation, so do it last
+  AnnotationIterator pos = it->second.ListPosition;
+  m_IndexRecords.erase(it);
+  m_Annotations.erase(pos);
+}
+
+void ImageAnnotationData::UpdateAnnotation(ImageAnnotationData::AbstractAnnotation *annot)
+{
+  IndexRecordMap::iterator it = m_IndexRecords.find(annot);
+  if(it == m_IndexRecords.end())
+    return;
+
+  IndexRecord &rec = it->second;
+  int slice[3];
+  ComputeSliceKeys(annot, slice);
+  if(slice[0] == rec.Slice[0] && slice[1] == rec.Slice[1] && slice[2] == rec.Slice[2])
+    return;
+
+  IndexEntry entry = { rec.Sequence, annot };
+  RemoveFromBuckets(entry, rec.Slice);
+  AddToBuckets(entry, slice);
+  std::copy(slice, slice + 3, rec.Slice);
+}
+
+void ImageAnnotationData::GetAnnotationsInSlice(int plane, int slice, AnnotationVector &out) const
+{
+  out.clear();
+
+  static const SliceBucket empty_bucket;
+  const SliceBucketMap &buckets = m_SliceBuckets[plane];
+  SliceBucketMap::const_iterator it_slice = buckets.find(slice);
+  SliceBucketMap::const_iterator it_all = buckets.find(ALL_SLICES);
+  const SliceBucket &b1 = (it_slice == buckets.end()) ? empty_bucket : it_slice->second;
+  const SliceBucket &b2 = (it_all == buckets.end()) ? empty_bucket : it_all->second;
+
+  // Merge the two buckets in list order
+  out.reserve(b1.size() + b2.size());
+  SliceBucket::const_iterator i1 = b1.begin(), i2 = b2.begin();
+  while(i1 != b1.end() || i2 != b2.end())
+    {
+    if(i2 == b2.end() || (i1 != b1.end() && *i1 < *i2))
+      out.push_back((i1++)->Annotation);
+    else
+      out.push_back((i2++)->Annotation);
+    }
 }
 
 void ImageAnnotationData::Reset()
 {
+  for(int d = 0; d < 3; d++)
+    m_SliceBuckets[d].clear();
+  m_IndexRecords.clear();
   m_Annotations.clear();
+  m_NextSequence = 0;
 }
 
 void ImageAnnotationData::SaveAnnotations(Registry &reg)
@@ -176,13 +297,14 @@ void ImageAnnotationData::SaveAnnotations(Registry &reg)
   // the format changes in drastic ways, this allows the future code to recover.
   reg["FormatDate"] << "20150624";
 
-  // Save the array of annotations
-  reg["Annotations.ArraySize"] << m_Annotations.size();
+  // Save the array of annotations, looking up the array folder only once
+  Registry &arr = reg.Folder("Annotations");
+  arr["ArraySize"] << m_Annotations.size();
   int i = 0;
   for(AnnotationConstIterator it = m_Annotations.begin(); it != m_Annotations.end(); it++, i++)
     {
     AbstractAnnotation *ann = *it;
-    Registry &folder = reg.Folder(reg.Key("Annotations.Element[%d]", i));
+    Registry &folder = arr.Folder(Registry::Key("Element[%d]", i));
     ann->Save(folder);
     }
 }
@@ -197,13 +319,14 @@ void ImageAnnotationData::LoadAnnotations(Registry &reg)
     throw IRISException("Annotation file is not in the correct format.");
 
   // Clear the annotations
-  m_Annotations.clear();
+  this->Reset();
 
   // Read the list of annotations
-  int n_annot = reg["Annotations.ArraySize"][0];
+  Registry &arr = reg.Folder("Annotations");
+  int n_annot = arr["ArraySize"][0];
   for(int i = 0; i < n_annot; i++)
     {
-    Registry &folder = reg.Folder(reg.Key("Annotations.Element[%d]", i));
+    Registry &folder = arr.Folder(Registry::Key("Element[%d]", i));
 
     // Factory code
     std::string type = folder["Type"][""];
@@ -223,7 +346,7 @@ void ImageAnnotationData::LoadAnnotations(Registry &reg)
     if(ann)
       {
       ann->Load(folder);
-      m_Annotations.push_back(ann);
+      this->AddAnnotation(ann);
       }
     }
 }
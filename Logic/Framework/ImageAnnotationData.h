@@ -5,6 +5,8 @@
 #include <utility>
 #include <string>
 #include <list>
+#include <map>
+#include <vector>
 #include "itkDataObject.h"
 #include "itkObjectFactory.h"
 #include "TagList.h"
@@ -184,6 +186,14 @@ protected:
  * Image annotations are defined in voxel coordinate space. This helps keep the
  * annotations in place when header information changes. It also makes the internal
  * logic simpler.
+ *
+ * Besides the list of annotations, the class keeps a spatial index that files
+ * each annotation, for each image axis, under the slice in which it is
+ * visible (or as visible in all slices). Drawing and picking in a slice view
+ * then only look at the annotations in the displayed slice, which matters
+ * when there are tens of thousands of landmarks. The index is updated when
+ * annotations are added and removed; code that moves an annotation or
+ * changes its plane or visibility must call UpdateAnnotation().
  */
 class ImageAnnotationData : public itk::DataObject
 {
@@ -193,25 +203,76 @@ public:
   typedef std::list<AnnotationPtr> AnnotationList;
   typedef AnnotationList::iterator AnnotationIterator;
   typedef AnnotationList::const_iterator AnnotationConstIterator;
+  typedef std::vector<AbstractAnnotation *> AnnotationVector;
 
   irisITKObjectMacro(ImageAnnotationData, itk::DataObject)
 
   irisGetMacro(Annotations, const AnnotationList &)
 
-  AnnotationList &GetAnnotations() { return m_Annotations; }
-
   void AddAnnotation(AbstractAnnotation *annot);
 
+  /** Remove an annotation from the collection */
+  void RemoveAnnotation(AbstractAnnotation *annot);
+
+  /**
+   * Update the spatial index for an annotation that has moved, or whose
+   * plane or visibility settings have changed
+   */
+  void UpdateAnnotation(AbstractAnnotation *annot);
+
+  /**
+   * Get the annotations visible in a slice perpendicular to an image axis,
+   * in the same order as in the list of annotations
+   */
+  void GetAnnotationsInSlice(int plane, int slice, AnnotationVector &out) const;
+
   void Reset();
 
   void SaveAnnotations(Registry &reg);
   void LoadAnnotations(Registry &reg);
 
 protected:
-  ImageAnnotationData() {}
+  ImageAnnotationData() : m_NextSequence(0) {}
   ~ImageAnnotationData() {}
 
   AnnotationList m_Annotations;
+
+  // Index key of annotations that are not visible in a plane, and of
+  // annotations that are visible in all slices
+  enum { NOT_INDEXED = -0x7fffffff, ALL_SLICES = 0x7fffffff };
+
+  // An annotation in a slice bucket. The sequence number gives the position
+  // of the annotation in the list, so the buckets are sorted by it
+  struct IndexEntry
+  {
+    unsigned long Sequence;
+    AbstractAnnotation *Annotation;
+    bool operator < (const IndexEntry &other) const { return Sequence < other.Sequence; }
+  };
+
+  typedef std::vector<IndexEntry> SliceBucket;
+  typedef std::map<int, SliceBucket> SliceBucketMap;
+
+  // Where an annotation is in the list and in the index
+  struct IndexRecord
+  {
+    unsigned long Sequence;
+    AnnotationIterator ListPosition;
+    int Slice[3];
+  };
+
+  typedef std::map<const AbstractAnnotation *, IndexRecord> IndexRecordMap;
+
+  // Buckets for each image axis, keyed by slice index
+  SliceBucketMap m_SliceBuckets[3];
+  IndexRecordMap m_IndexRecords;
+  unsigned long m_NextSequence;
+
+  // Compute the index keys of an annotation
+  static void ComputeSliceKeys(const AbstractAnnotation *annot, int slice[3]);
+
+  void AddToBuckets(const IndexEntry &entry, const int slice[3]);
+  void RemoveFromBuckets(const IndexEntry &entry, const int slice[3]);
 };
 
 /** Iterator that searches for annotations */
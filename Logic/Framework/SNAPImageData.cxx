@@ -46,6 +46,7 @@
 #include "itkSubtractImageFilter.h"
 #include "itkUnaryFunctorImageFilter.h"
 #include "itkFastMutexLock.h"
+#include "itkMultiThreader.h"
 
 #include "SmoothBinaryThresholdImageFilter.h"
 #include "GlobalState.h"
@@ -525,15 +526,60 @@ void SNAPImageData::SwapLabelImageWithCompressedAlternative()
   // Clear the undo manager
   liw->ClearUndoPoints();
 
-  // Decompress the currently saved alternative
+  // Decompress the currently saved alternative. The image is split into slabs
+  // that do not share any run-length lines, and each slab is decompressed by
+  // a separate thread, one whole line at a time
   if(m_CompressedAlternateLabelImage)
     {
-    LabelImageWrapper::Iterator it_write(liw->GetImage(), liw->GetBufferedRegion());
-    for(size_t i = 0; i < m_CompressedAlternateLabelImage->GetNumberOfRLEs(); ++i)
+    CompressedLabelImageType *alt = m_CompressedAlternateLabelImage;
+    LabelImageType *seg = liw->GetImage();
+    LabelImageType::RegionType region = seg->GetBufferedRegion();
+
+    std::vector<LabelImageType::RegionType> slabs;
+    int nSlabs = LabelImageType::SplitRegionByLines(
+          region, itk::MultiThreader::GetGlobalDefaultNumberOfThreads(), slabs);
+
+    // Find the run in which each slab starts, and the position in that run
+    std::vector<size_t> slabRun(nSlabs), slabSkip(nSlabs);
+    size_t iRun = 0, runStart = 0;
+    for(int s = 0; s < nSlabs; s++)
       {
-      LabelType value = m_CompressedAlternateLabelImage->GetRLEValue(i);
-      for(size_t j = 0; j < m_CompressedAlternateLabelImage->GetRLELength(i); ++j, ++it_write)
-        it_write.Set(value);
+      size_t offset = 0, stride = 1;
+      for(int d = 0; d < 3; d++)
+        {
+        offset += (slabs[s].GetIndex(d) - region.GetIndex(d)) * stride;
+        stride *= region.GetSize(d);
+        }
+      while(iRun < alt->GetNumberOfRLEs() && runStart + alt->GetRLELength(iRun) <= offset)
+        runStart += alt->GetRLELength(iRun++);
+      slabRun[s] = iRun;
+      slabSkip[s] = offset - runStart;
+      }
+
+#pragma omp parallel for
+    for(int s = 0; s < nSlabs; s++)
+      {
+      const LabelImageType::RegionType &slab = slabs[s];
+      size_t nx = slab.GetSize(0);
+      std::vector<LabelType> line(nx);
+
+      size_t i = slabRun[s];
+      size_t left = (i < alt->GetNumberOfRLEs()) ? alt->GetRLELength(i) - slabSkip[s] : 0;
+
+      LabelImageType::IndexType idx = slab.GetIndex();
+      for(idx[2] = slab.GetIndex(2); idx[2] < (long) (slab.GetIndex(2) + slab.GetSize(2)); idx[2]++)
+        {
+        for(idx[1] = slab.GetIndex(1); idx[1] < (long) (slab.GetIndex(1) + slab.GetSize(1)); idx[1]++)
+          {
+          for(size_t x = 0; x < nx; x++, left--)
+            {
+            while(left == 0)
+              left = alt->GetRLELength(++i);
+            line[x] = alt->GetRLEValue(i);
+            }
+          seg->AssignLine(idx, nx, &line[0]);
+          }
+        }
       }
     }
   else
@@ -46,6 +46,10 @@
 #include "SNAPCommon.h"
 #include "ImageWrapperTraits.h"
 #include "UndoDataManager.h"
+#include "LabelImageWrapper.h"
+#include <itkMultiThreader.h>
+#include <vector>
+#include <algorithm>
 
 
 /**
@@ -162,6 +166,82 @@ public:
 
 
 
+  /**
+   * Span version of PaintAsForegroundPreserveClear. The iterator must be at the
+   * start of a line of the region. The voxels with x in [x0, x1) on this line
+   * are painted, and the iterator moves to the start of the next line. The
+   * label line and the undo delta are updated one run at a time, so the cost
+   * depends on the number of runs, not on the number of voxels, and a line
+   * with an empty span is skipped in one step.
+   */
+  void PaintSpanAsForegroundPreserveClear(long x0, long x1)
+  {
+    typedef LabelImageType::RLLine RLLine;
+    typedef LabelImageType::RLSegment RLSegment;
+
+    // Clip the span to the line of the region
+    long rx0 = m_Region.GetIndex(0), rx1 = rx0 + (long) m_Region.GetSize(0);
+    x0 = std::max(x0, rx0);
+    x1 = std::max(x0, std::min(x1, rx1));
+
+    // Voxels before the span are not changed
+    m_Delta->EncodeRun(0, x0 - rx0);
+
+    if(x0 < x1)
+      {
+      const LabelImageType *image = m_Iterator.GetImage();
+      RLLine &line = image->GetBuffer()->GetPixel(
+            LabelImageType::truncateIndex(m_Iterator.GetIndex()));
+
+      // Rebuild the line, splitting the runs at the ends of the span
+      std::vector<RLSegment> out;
+      out.reserve(line.size() + 2);
+      bool changed = false;
+      long t = image->GetBufferedRegion().GetIndex(0);
+      for(size_t i = 0; i < line.size(); i++)
+        {
+        long a = t, b = t + line[i].first;
+        LabelType lOld = line[i].second;
+        t = b;
+
+        long s0 = std::max(a, x0), s1 = std::min(b, x1);
+        if(s0 >= s1)
+          {
+          AppendRun(out, b - a, lOld);
+          continue;
+          }
+
+        bool paint = lOld != 0 && lOld != m_ActiveLabel &&
+            (m_DrawOver.CoverageMode == PAINT_OVER_ALL ||
+             (m_DrawOver.CoverageMode == PAINT_OVER_ONE && lOld == m_DrawOver.DrawOverLabel) ||
+             m_DrawOver.CoverageMode == PAINT_OVER_VISIBLE);
+
+        AppendRun(out, s0 - a, lOld);
+        if(paint)
+          {
+          AppendRun(out, s1 - s0, m_ActiveLabel);
+          m_Delta->EncodeRun((LabelType)(m_ActiveLabel - lOld), s1 - s0);
+          m_ChangedVoxels += s1 - s0;
+          changed = true;
+          }
+        else
+          {
+          AppendRun(out, s1 - s0, lOld);
+          m_Delta->EncodeRun(0, s1 - s0);
+          }
+        AppendRun(out, b - s1, lOld);
+        }
+
+      // A line in the arena is rewritten in place if the new runs fit
+      if(changed)
+        line.assign(out.begin(), out.end());
+      }
+
+    // Voxels after the span are not changed
+    m_Delta->EncodeRun(0, rx1 - x1);
+    m_Iterator.NextLine();
+  }
+
   /**
    * Reverse painting mode - applies clear label over active label (paintbrush RMB click)
    */
@@ -258,6 +338,18 @@ public:
 
 protected:
 
+  // Append a run to a line that is being rebuilt, merging equal neighbors
+  template <class TSegment>
+  static void AppendRun(std::vector<TSegment> &line, long n, LabelType value)
+  {
+    if(n <= 0)
+      return;
+    if(!line.empty() && line.back().second == value)
+      line.back().first += n;
+    else
+      line.push_back(TSegment(n, value));
+  }
+
   // Name of the segmentation update (for undo tracking)
   std::string m_Title;
 
@@ -284,4 +376,100 @@ protected:
 };
 
 
+/**
+ * \class ParallelSegmentationUpdate
+ * \brief Splits an update of the segmentation image into slabs that can be
+ * painted by different threads, each with its own SegmentationUpdateIterator.
+ *
+ * The slabs come from RLEImage::SplitRegionByLines, so no two slabs share a
+ * run-length line of the label image (see the thread safety notes in
+ * RLEImage). The iterators are created up front, so the threads only need
+ * to call GetSlabIterator(). Each slab has its own undo delta, and Commit()
+ * stores all of them as a single undo point.
+ */
+class ParallelSegmentationUpdate
+{
+public:
+  typedef SegmentationUpdateIterator::RegionType               RegionType;
+  typedef SegmentationUpdateIterator::LabelImageType           LabelImageType;
+
+  /**
+   * Split the region into at most nSlabs slabs. By default, there is one
+   * slab per thread.
+   */
+  ParallelSegmentationUpdate(LabelImageType *labelImage,
+                             const RegionType &region,
+                             LabelType active_label,
+                             DrawOverFilter draw_over,
+                             unsigned int nSlabs = 0)
+  {
+    if(nSlabs == 0)
+      nSlabs = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+    LabelImageType::SplitRegionByLines(region, nSlabs, m_SlabRegions);
+    for(size_t i = 0; i < m_SlabRegions.size(); i++)
+      m_Slabs.push_back(new SegmentationUpdateIterator(
+                          labelImage, m_SlabRegions[i], active_label, draw_over));
+  }
+
+  ~ParallelSegmentationUpdate()
+  {
+    for(size_t i = 0; i < m_Slabs.size(); i++)
+      delete m_Slabs[i];
+  }
+
+  int GetNumberOfSlabs() const
+  {
+    return (int) m_Slabs.size();
+  }
+
+  const RegionType &GetSlabRegion(int i) const
+  {
+    return m_SlabRegions[i];
+  }
+
+  SegmentationUpdateIterator &GetSlabIterator(int i)
+  {
+    return *m_Slabs[i];
+  }
+
+  /**
+   * Finalize the slabs once all threads are done, and store their deltas in
+   * the label layer as a single undo point. Returns the number of voxels
+   * that were changed; no undo point is created if there are none.
+   */
+  unsigned long Commit(LabelImageWrapper *wrapper, const char *title)
+  {
+    unsigned long nChanged = 0;
+    for(size_t i = 0; i < m_Slabs.size(); i++)
+      {
+      SegmentationUpdateIterator *it = m_Slabs[i];
+      it->Finalize();
+      if(it->GetNumberOfChangedVoxels() > 0)
+        {
+        nChanged += it->GetNumberOfChangedVoxels();
+        wrapper->StoreIntermediateUndoDelta(it->RelinquishDelta());
+        }
+      }
+
+    if(nChanged > 0)
+      wrapper->StoreUndoPoint(title);
+
+    return nChanged;
+  }
+
+protected:
+
+  // The regions of the slabs
+  std::vector<RegionType> m_SlabRegions;
+
+  // An update iterator for each slab
+  std::vector<SegmentationUpdateIterator *> m_Slabs;
+
+private:
+  ParallelSegmentationUpdate(const ParallelSegmentationUpdate &); // not implemented
+  void operator=(const ParallelSegmentationUpdate &); // not implemented
+};
+
+
 #endif // SegmentationUpdateIterator
@@ -0,0 +1,285 @@
+#include "SliceMontageRenderer.h"
+#include "IRISApplication.h"
+#include "GenericImageData.h"
+#include "GlobalState.h"
+#include "LayerIterator.h"
+#include "SliceLayerCompositor.h"
+#include "IRISException.h"
+#include <itkImageFileWriter.h>
+#include <algorithm>
+#include <cstring>
+
+SliceMontageRenderer::SliceMontageRenderer()
+{
+  m_Driver = NULL;
+  m_NumberOfColumns = 4;
+  m_TileSpacing = 2;
+  m_BackgroundColor.fill(0);
+  m_DrawSegmentation = true;
+
+  for(int i = 0; i < 3; i++)
+    m_Compositor[i] = SliceLayerCompositor::New();
+}
+
+SliceMontageRenderer::~SliceMontageRenderer()
+{
+}
+
+void
+SliceMontageRenderer
+::SetDriver(IRISApplication *driver)
+{
+  m_Driver = driver;
+  m_Tiles.clear();
+}
+
+unsigned int
+SliceMontageRenderer
+::GetNumberOfSlices(AnatomicalDirection view) const
+{
+  if(!m_Driver || !m_Driver->IsMainImageLoaded())
+    return 0;
+
+  int axis = m_Driver->GetImageDirectionForAnatomicalDirection(view);
+  return m_Driver->GetCurrentImageData()->GetMain()->GetSize()[axis];
+}
+
+void
+SliceMontageRenderer
+::ClearTiles()
+{
+  m_Tiles.clear();
+}
+
+void
+SliceMontageRenderer
+::AddTile(AnatomicalDirection view, unsigned int slice)
+{
+  Tile tile;
+  tile.view = view;
+  tile.slice = slice;
+  m_Tiles.push_back(tile);
+}
+
+void
+SliceMontageRenderer
+::AddEvenlySpacedTiles(AnatomicalDirection view, unsigned int n)
+{
+  // Place the slices in the middle of n equal parts of the volume
+  unsigned int ns = this->GetNumberOfSlices(view);
+  for(unsigned int i = 0; i < n; i++)
+    this->AddTile(view, (unsigned int) ((i + 0.5) * ns / n));
+}
+
+SmartPtr<SliceMontageRenderer::SliceType>
+SliceMontageRenderer
+::CompositeDisplayWindow(int window)
+{
+  GenericImageData *id = m_Driver->GetCurrentImageData();
+  GlobalState *gs = m_Driver->GetGlobalState();
+  ImageWrapperBase *main = id->GetMain();
+
+  SliceType *base = main->GetDisplaySlice(window);
+  base->UpdateOutputInformation();
+
+  // The layers drawn over the main image, in the order that the slice
+  // views draw them
+  std::vector<SliceType *> slices;
+  std::vector<double> alphas;
+  slices.push_back(base);
+  alphas.push_back(1.0);
+
+  std::vector<ImageWrapperBase *> layers;
+  for(LayerIterator it(id); !it.IsAtEnd(); ++it)
+    {
+    ImageWrapperBase *layer = it.GetLayer();
+    if(layer != main
+       && it.GetRole() != LABEL_ROLE
+       && layer->IsDrawable()
+       && layer->IsSticky()
+       && layer->GetAlpha() > 0)
+      {
+      slices.push_back(layer->GetDisplaySlice(window));
+      alphas.push_back(layer->GetAlpha());
+      }
+    }
+
+  if(m_DrawSegmentation && gs->GetSegmentationAlpha() > 0)
+    {
+    ImageWrapperBase *seg = id->FindLayer(
+          gs->GetSelectedSegmentationLayerId(), false, LABEL_ROLE);
+    if(seg)
+      {
+      slices.push_back(seg->GetDisplaySlice(window));
+      alphas.push_back(gs->GetSegmentationAlpha());
+      }
+    }
+
+  // Layers that are not sliced on the grid of the main image are left out
+  SliceLayerCompositor *compositor = m_Compositor[window];
+  compositor->SetNumberOfLayers(1);
+  compositor->SetLayer(0, base);
+  for(size_t i = 1; i < slices.size(); i++)
+    {
+    slices[i]->UpdateOutputInformation();
+    if(slices[i]->GetLargestPossibleRegion() == base->GetLargestPossibleRegion())
+      {
+      unsigned int k = compositor->GetNumberOfLayers();
+      compositor->SetNumberOfLayers(k + 1);
+      compositor->SetLayer(k, slices[i], alphas[i]);
+      }
+    }
+
+  compositor->Update();
+
+  // Copy the result, flipping it so that the first row is at the top
+  SliceType *comp = compositor->GetOutput();
+  SmartPtr<SliceType> snapshot = SliceType::New();
+  snapshot->SetRegions(comp->GetBufferedRegion().GetSize());
+  snapshot->Allocate();
+
+  size_t nx = comp->GetBufferedRegion().GetSize()[0];
+  size_t ny = comp->GetBufferedRegion().GetSize()[1];
+  for(size_t y = 0; y < ny; y++)
+    {
+    memcpy(snapshot->GetBufferPointer() + (ny - 1 - y) * nx,
+           comp->GetBufferPointer() + y * nx, nx * sizeof(SliceType::PixelType));
+    }
+
+  return snapshot;
+}
+
+void
+SliceMontageRenderer
+::RenderTiles(std::vector< SmartPtr<SliceType> > &snapshots)
+{
+  if(!m_Driver || !m_Driver->IsMainImageLoaded())
+    throw IRISException("Rendering snapshots requires a main image");
+
+  snapshots.clear();
+  snapshots.resize(m_Tiles.size());
+
+  Vector3ui cursor_saved = m_Driver->GetCursorPosition();
+  Vector3ui size = m_Driver->GetCurrentImageData()->GetMain()->GetSize();
+
+  // Tiles that slice along different image axes can be rendered from the
+  // same cursor position, so consecutive tiles are grouped that way
+  size_t first = 0;
+  while(first < m_Tiles.size())
+    {
+    Vector3ui cursor = cursor_saved;
+    bool used[] = { false, false, false };
+    size_t last = first;
+    for(; last < m_Tiles.size(); last++)
+      {
+      int axis = m_Driver->GetImageDirectionForAnatomicalDirection(m_Tiles[last].view);
+      if(used[axis])
+        break;
+      used[axis] = true;
+      cursor[axis] = std::min(m_Tiles[last].slice, size[axis] - 1);
+      }
+
+    m_Driver->SetCursorPosition(cursor);
+    for(size_t i = first; i < last; i++)
+      {
+      int window = m_Driver->GetDisplayWindowForAnatomicalDirection(m_Tiles[i].view);
+      snapshots[i] = this->CompositeDisplayWindow(window);
+      }
+
+    first = last;
+    }
+
+  m_Driver->SetCursorPosition(cursor_saved);
+}
+
+SmartPtr<SliceMontageRenderer::SliceType>
+SliceMontageRenderer
+::RenderSlice(AnatomicalDirection view, unsigned int slice)
+{
+  std::vector<Tile> tiles_saved = m_Tiles;
+  m_Tiles.clear();
+  this->AddTile(view, slice);
+
+  std::vector< SmartPtr<SliceType> > snapshots;
+  try
+    {
+    this->RenderTiles(snapshots);
+    }
+  catch(...)
+    {
+    m_Tiles = tiles_saved;
+    throw;
+    }
+
+  m_Tiles = tiles_saved;
+  return snapshots.front();
+}
+
+SmartPtr<SliceMontageRenderer::SliceType>
+SliceMontageRenderer
+::RenderMontage()
+{
+  if(m_Tiles.empty())
+    throw IRISException("No slices have been added to the montage");
+
+  std::vector< SmartPtr<SliceType> > snapshots;
+  this->RenderTiles(snapshots);
+
+  // All cells of the montage have the size of the largest tile
+  size_t cw = 0, ch = 0;
+  for(size_t i = 0; i < snapshots.size(); i++)
+    {
+    cw = std::max(cw, (size_t) snapshots[i]->GetBufferedRegion().GetSize()[0]);
+    ch = std::max(ch, (size_t) snapshots[i]->GetBufferedRegion().GetSize()[1]);
+    }
+
+  size_t ncols = std::min((size_t) std::max(m_NumberOfColumns, 1u), snapshots.size());
+  size_t nrows = (snapshots.size() + ncols - 1) / ncols;
+  size_t sp = m_TileSpacing;
+
+  SmartPtr<SliceType> montage = SliceType::New();
+  SliceType::SizeType msize;
+  msize[0] = ncols * cw + (ncols + 1) * sp;
+  msize[1] = nrows * ch + (nrows + 1) * sp;
+  montage->SetRegions(msize);
+  montage->Allocate();
+
+  SliceType::PixelType bg;
+  bg[0] = m_BackgroundColor[0]; bg[1] = m_BackgroundColor[1];
+  bg[2] = m_BackgroundColor[2]; bg[3] = 255;
+  montage->FillBuffer(bg);
+
+  // Copy the tiles into their cells, centered. The copies are independent
+  int ntiles = (int) snapshots.size();
+  size_t mw = msize[0];
+
+#pragma omp parallel for
+  for(int i = 0; i < ntiles; i++)
+    {
+    SliceType *tile = snapshots[i];
+    size_t tw = tile->GetBufferedRegion().GetSize()[0];
+    size_t th = tile->GetBufferedRegion().GetSize()[1];
+    size_t x0 = sp + (i % ncols) * (cw + sp) + (cw - tw) / 2;
+    size_t y0 = sp + (i / ncols) * (ch + sp) + (ch - th) / 2;
+    for(size_t y = 0; y < th; y++)
+      {
+      memcpy(montage->GetBufferPointer() + (y0 + y) * mw + x0,
+             tile->GetBufferPointer() + y * tw, tw * sizeof(SliceType::PixelType));
+      }
+    }
+
+  return montage;
+}
+
+void
+SliceMontageRenderer
+::WriteMontage(const char *filename)
+{
+  SmartPtr<SliceType> montage = this->RenderMontage();
+
+  typedef itk::ImageFileWriter<SliceType> WriterType;
+  SmartPtr<WriterType> writer = WriterType::New();
+  writer->SetInput(montage);
+  writer->SetFileName(filename);
+  writer->Update();
+}
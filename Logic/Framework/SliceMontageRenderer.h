@@ -0,0 +1,105 @@
+#ifndef SLICEMONTAGERENDERER_H
+#define SLICEMONTAGERENDERER_H
+
+#include "SNAPCommon.h"
+#include "ImageWrapperBase.h"
+#include <itkObject.h>
+#include <itkObjectFactory.h>
+#include <vector>
+
+class IRISApplication;
+class SliceLayerCompositor;
+
+/**
+ * This class renders slice snapshots of the data loaded in IRISApplication
+ * without a display, OpenGL or Qt, e.g., for batch quality control.
+ *
+ * Each snapshot shows a slice of the main image in one of the anatomical
+ * views, with the sticky overlays and the selected segmentation drawn over
+ * it, as in the slice views of the GUI. The layers are color-mapped by
+ * their display mapping policies (color maps, contrast, label table), and
+ * blended by SliceLayerCompositor. Slices are flipped so that the top of
+ * the snapshot is the top of the slice view, as in ExportSlice.
+ *
+ * Snapshots are arranged into a montage of tiles, row by row, and can be
+ * written to PNG. The display slices are produced by the pipelines of the
+ * image layers, which follow the cursor, so the cursor is moved to each
+ * slice in turn and restored afterwards. One cursor position serves tiles
+ * of up to three different views.
+ */
+class SliceMontageRenderer : public itk::Object
+{
+public:
+  irisITKObjectMacro(SliceMontageRenderer, itk::Object)
+
+  typedef ImageWrapperBase::DisplaySliceType SliceType;
+
+  /** A tile of the montage: a view and a slice index in that view */
+  struct Tile
+  {
+    AnatomicalDirection view;
+    unsigned int slice;
+  };
+
+  /** Set the application whose layers are rendered */
+  void SetDriver(IRISApplication *driver);
+
+  /** Number of columns in the montage (default 4) */
+  irisGetSetMacro(NumberOfColumns, unsigned int)
+
+  /** Spacing between tiles, in pixels (default 2) */
+  irisGetSetMacro(TileSpacing, unsigned int)
+
+  /** Background color of the montage (default black) */
+  irisGetSetMacro(BackgroundColor, Vector3ui)
+
+  /** Whether the segmentation is drawn over the slices (default on) */
+  irisGetSetMacro(DrawSegmentation, bool)
+
+  /** Number of slices along a view */
+  unsigned int GetNumberOfSlices(AnatomicalDirection view) const;
+
+  /** Remove all tiles */
+  void ClearTiles();
+
+  /** Add a tile to the montage */
+  void AddTile(AnatomicalDirection view, unsigned int slice);
+
+  /** Add n tiles for slices evenly spaced through a view */
+  void AddEvenlySpacedTiles(AnatomicalDirection view, unsigned int n);
+
+  /** Get the tiles */
+  const std::vector<Tile> &GetTiles() const { return m_Tiles; }
+
+  /** Render a single slice with its overlays and segmentation */
+  SmartPtr<SliceType> RenderSlice(AnatomicalDirection view, unsigned int slice);
+
+  /** Render all the tiles into a montage */
+  SmartPtr<SliceType> RenderMontage();
+
+  /** Render the montage and write it to a file (e.g., PNG) */
+  void WriteMontage(const char *filename);
+
+protected:
+  SliceMontageRenderer();
+  virtual ~SliceMontageRenderer();
+
+  // Blend the display slices of the layers in a display window
+  SmartPtr<SliceType> CompositeDisplayWindow(int window);
+
+  // Render the snapshots for the tiles
+  void RenderTiles(std::vector< SmartPtr<SliceType> > &snapshots);
+
+  IRISApplication *m_Driver;
+
+  unsigned int m_NumberOfColumns, m_TileSpacing;
+  Vector3ui m_BackgroundColor;
+  bool m_DrawSegmentation;
+
+  std::vector<Tile> m_Tiles;
+
+  // A compositor for each display window
+  SmartPtr<SliceLayerCompositor> m_Compositor[3];
+};
+
+#endif // SLICEMONTAGERENDERER_H
@@ -61,6 +61,9 @@ public:
 
   void Encode(const TPixel &value);
 
+  // Encode n consecutive voxels with the same value
+  void EncodeRun(const TPixel &value, size_t n);
+
   void FinishEncoding();
 
   size_t GetNumberOfRLEs()
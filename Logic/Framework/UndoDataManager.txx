@@ -65,6 +65,31 @@ UndoDelta<TPixel>
     }
 }
 
+template<typename TPixel>
+void
+UndoDelta<TPixel>
+::EncodeRun(const TPixel &value, size_t n)
+{
+  if(n == 0)
+    return;
+
+  if(m_CurrentLength == 0)
+    {
+    m_LastValue = value;
+    m_CurrentLength = n;
+    }
+  else if(value == m_LastValue)
+    {
+    m_CurrentLength += n;
+    }
+  else
+    {
+    m_Array.push_back(std::make_pair(m_CurrentLength, m_LastValue));
+    m_CurrentLength = n;
+    m_LastValue = value;
+    }
+}
+
 template<typename TPixel>
 void
 UndoDelta<TPixel>
@@ -8,6 +8,7 @@
 #include "RGBALookupTableIntensityMappingFilter.h"
 #include "ColorMap.h"
 #include "ScalarImageHistogram.h"
+#include "SampledIntensityStatistics.h"
 #include "itkMinimumMaximumImageFilter.h"
 #include "itkVectorImageToImageAdaptor.h"
 #include "IRISException.h"
@@ -164,14 +165,14 @@ CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
   m_LookupTableFilter->SetInput(m_Wrapper->GetImage());
 
   // Hook up the min/max filters
-  m_LookupTableFilter->SetImageMinInput(m_Wrapper->GetMinMaxFilter()->GetMinimumOutput());
-  m_LookupTableFilter->SetImageMaxInput(m_Wrapper->GetMinMaxFilter()->GetMaximumOutput());
+  m_LookupTableFilter->SetImageMinInput(m_Wrapper->GetImageMinObject());
+  m_LookupTableFilter->SetImageMaxInput(m_Wrapper->GetImageMaxObject());
 
   for(unsigned int i=0; i<3; i++)
     {
     m_IntensityFilter[i]->SetInput(m_Wrapper->GetSlice(i));
-    m_IntensityFilter[i]->SetImageMinInput(m_Wrapper->GetMinMaxFilter()->GetMinimumOutput());
-    m_IntensityFilter[i]->SetImageMaxInput(m_Wrapper->GetMinMaxFilter()->GetMaximumOutput());
+    m_IntensityFilter[i]->SetImageMinInput(m_Wrapper->GetImageMinObject());
+    m_IntensityFilter[i]->SetImageMaxInput(m_Wrapper->GetImageMaxObject());
     }
 }
 
@@ -211,8 +212,8 @@ void
 CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
 ::ClearReferenceIntensityRange()
 {
-  m_LookupTableFilter->SetImageMinInput(m_Wrapper->GetMinMaxFilter()->GetMinimumOutput());
-  m_LookupTableFilter->SetImageMaxInput(m_Wrapper->GetMinMaxFilter()->GetMaximumOutput());
+  m_LookupTableFilter->SetImageMinInput(m_Wrapper->GetImageMinObject());
+  m_LookupTableFilter->SetImageMaxInput(m_Wrapper->GetImageMaxObject());
 }
 
 template<class TWrapperTraits>
@@ -247,6 +248,14 @@ CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
   return m_Wrapper->GetHistogram(nBins);
 }
 
+template<class TWrapperTraits>
+ImageWrapperBase *
+CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
+::GetHistogramSource()
+{
+  return m_Wrapper;
+}
+
 template<class TWrapperTraits>
 typename CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>::DisplaySlicePointer
 CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
@@ -339,48 +348,57 @@ CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
     AbstractContinuousImageDisplayMappingPolicy implementation
    =============================================================== */
 
-void
 AbstractContinuousImageDisplayMappingPolicy
-::AutoFitContrast()
+::AbstractContinuousImageDisplayMappingPolicy()
 {
-  // Get the histogram with the current number of bins
-  const ScalarImageHistogram *hist = this->GetHistogram(0);
+  m_SampledStatistics = SampledIntensityStatistics::New();
+}
 
-  // Integrate the histogram until reaching 0.1%
-  double imin = hist->GetBinMin(0);
-  double ilow = imin;
-  size_t accum = 0;
-  size_t accum_goal = hist->GetTotalSamples() / 1000;
-  for(size_t i = 0; i < hist->GetSize(); i++)
-    {
-    if(accum + hist->GetFrequency(i) < accum_goal)
-      {
-      accum += hist->GetFrequency(i);
-      ilow = hist->GetBinMax(i);
-      }
-    else break;
-    }
+AbstractContinuousImageDisplayMappingPolicy
+::~AbstractContinuousImageDisplayMappingPolicy()
+{
+}
 
-  // Same, but from above
-  double imax = hist->GetBinMax(hist->GetSize() - 1);
-  double ihigh = imax;
-  accum = 0;
-  for(int i = (int) hist->GetSize() - 1; i >= 0; i--)
-    {
-    if(accum + hist->GetFrequency(i) < accum_goal)
-      {
-      accum += hist->GetFrequency(i);
-      ihigh = hist->GetBinMin(i);
-      }
-    else break;
-    }
+SampledIntensityStatistics *
+AbstractContinuousImageDisplayMappingPolicy
+::GetSampledStatistics()
+{
+  m_SampledStatistics->Update(this->GetHistogramSource());
+  return m_SampledStatistics;
+}
+
+bool
+AbstractContinuousImageDisplayMappingPolicy
+::IsExactHistogramAvailable(int nBins)
+{
+  return this->GetHistogramSource()->IsHistogramUpToDate(nBins);
+}
+
+const ScalarImageHistogram *
+AbstractContinuousImageDisplayMappingPolicy
+::GetAvailableHistogram(int nBins)
+{
+  if(this->IsExactHistogramAvailable(nBins))
+    return this->GetHistogram(nBins);
+
+  return this->GetSampledStatistics()->GetHistogram(nBins);
+}
+
+void
+AbstractContinuousImageDisplayMappingPolicy
+::AutoFitContrast()
+{
+  // Estimate the 0.1% and 99.9% quantiles from the sampled voxels
+  SampledIntensityStatistics *stats = this->GetSampledStatistics();
+  double ilow = stats->GetQuantile(0.001);
+  double ihigh = stats->GetQuantile(0.999);
 
   // If for some reason the window is off, we set everything to max/min
+  Vector2d irange = this->GetNativeImageRangeForCurve();
   if(ilow >= ihigh)
-    { ilow = imin; ihigh = imax; }
+    { ilow = irange[0]; ihigh = irange[1]; }
 
   // Compute the unit coordinate values that correspond to min and max
-  Vector2d irange = this->GetNativeImageRangeForCurve();
   double factor = 1.0 / (irange[1] - irange[0]);
   double t0 = factor * (ilow - irange[0]);
   double t1 = factor * (ihigh - irange[0]);
@@ -743,6 +761,11 @@ typename MultiChannelDisplayMappingPolicy<TWrapperTraits>::DisplaySlicePointer
 MultiChannelDisplayMappingPolicy<TWrapperTraits>
 ::GetDisplaySlice(unsigned int slice)
 {
+  // When a derived quantity is shown, have the wrapper keep its values in
+  // memory. This is a no-op unless the image has changed
+  if(m_ScalarRepresentation && m_DisplayMode.SelectedScalarRep != SCALAR_REP_COMPONENT)
+    m_Wrapper->MaterializeDerivedQuantity(m_DisplayMode.SelectedScalarRep);
+
   return m_DisplaySliceSelector[slice]->GetOutput();
 }
 
@@ -857,6 +880,18 @@ MultiChannelDisplayMappingPolicy<TWrapperTraits>
 
 }
 
+template<class TWrapperTraits>
+ImageWrapperBase *
+MultiChannelDisplayMappingPolicy<TWrapperTraits>
+::GetHistogramSource()
+{
+  // Same logic as in GetHistogram()
+  if(m_DisplayMode.UseRGB || m_DisplayMode.RenderAsGrid)
+    return m_Wrapper;
+  else
+    return m_ScalarRepresentation;
+}
+
 
 template<class TWrapperTraits>
 void
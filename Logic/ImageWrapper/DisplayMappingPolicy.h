@@ -8,6 +8,7 @@
 #include "MultiChannelDisplayMode.h"
 
 class ColorLabelTable;
+class SampledIntensityStatistics;
 class LabelToRGBAFilter;
 class IntensityCurveVTK;
 class Registry;
@@ -138,14 +139,40 @@ public:
    */
   virtual const ScalarImageHistogram *GetHistogram(int nBins) = 0;
 
+  /**
+   * @brief Get the layer whose intensities are summarized by GetHistogram(),
+   * i.e., the layer itself or, for multi-component layers that are displayed
+   * one component at a time, the current scalar representation
+   */
+  virtual ImageWrapperBase *GetHistogramSource() = 0;
+
+  /**
+   * @brief Check if the histogram returned by GetHistogram() has already been
+   * computed, i.e., if calling it would not require a pass through the image
+   */
+  bool IsExactHistogramAvailable(int nBins);
+
+  /**
+   * @brief Get the histogram if it has already been computed, and otherwise
+   * a histogram of a sample of the voxels (with the same bins), which takes
+   * a small fraction of the time to compute. This is meant for displaying the
+   * histogram while the exact histogram is not yet needed.
+   */
+  const ScalarImageHistogram *GetAvailableHistogram(int nBins);
+
+  /**
+   * @brief Get the statistics of a sample of the voxels of the histogram
+   * source. These are recomputed as needed when the source changes.
+   */
+  SampledIntensityStatistics *GetSampledStatistics();
+
   virtual void SetColorMap(ColorMap *map) = 0;
 
   /**
    * Automatically fit the contrast mapping based on the percentiles of
-   * the image histogram.
-   * TODO: the accuracy of this is currently limited by the bin size in
-   * the histogram. At some point, it may make sense to have separate
-   * histograms for display and for auto-fitting.
+   * the image intensity. The percentiles are estimated from a sample of the
+   * voxels (see GetSampledStatistics), so this does not require the histogram
+   * of the image to be computed, and is not limited by the bin size.
    */
   virtual void AutoFitContrast();
 
@@ -159,6 +186,13 @@ public:
    */
   Vector2d GetCurveMinMaxNative();
 
+protected:
+
+  AbstractContinuousImageDisplayMappingPolicy();
+  virtual ~AbstractContinuousImageDisplayMappingPolicy();
+
+  // Statistics of the sampled voxels
+  SmartPtr<SampledIntensityStatistics> m_SampledStatistics;
 };
 
 class AbstractCachingAndColorMapDisplayMappingPolicy
@@ -228,6 +262,8 @@ public:
 
   virtual const ScalarImageHistogram *GetHistogram(int nBins) ITK_OVERRIDE;
 
+  virtual ImageWrapperBase *GetHistogramSource() ITK_OVERRIDE;
+
 
   /**
    * Get the display slice in a given direction.  To change the
@@ -452,6 +488,7 @@ public:
 
   Vector2d GetNativeImageRangeForCurve() ITK_OVERRIDE;
   virtual const ScalarImageHistogram *GetHistogram(int nBins) ITK_OVERRIDE;
+  virtual ImageWrapperBase *GetHistogramSource() ITK_OVERRIDE;
 
   /**
    * @brief Returns true when the display mode is such that the image min, max
@@ -55,8 +55,7 @@
 #include <itkImageFileWriter.h>
 #include <itkResampleImageFilter.h>
 #include <itkIdentityTransform.h>
-#include <itkFlipImageFilter.h>
-#include <itkUnaryFunctorImageFilter.h>
+#include <itkImageDuplicator.h>
 #include "ImageWrapperTraits.h"
 #include "itkNearestNeighborInterpolateImageFunction.h"
 #include "itkBSplineInterpolateImageFunction.h"
@@ -72,6 +71,7 @@
 #include "itkTransform.h"
 #include "itkExtractImageFilter.h"
 #include "AffineTransformHelper.h"
+#include "ThumbnailService.h"
 
 
 #include <vnl/vnl_inverse.h>
@@ -1575,21 +1575,10 @@ ImageWrapper<TTraits,TBase>
 }
 
 
-struct RemoveTransparencyFunctor
-{
-  typedef ImageWrapperBase::DisplayPixelType PixelType;
-  PixelType operator()(const PixelType &p)
-  {
-    PixelType pnew = p;
-    pnew[3] = 255;
-    return pnew;
-  }
-};
-
 template<class TTraits, class TBase>
 typename ImageWrapper<TTraits,TBase>::DisplaySlicePointer
 ImageWrapper<TTraits,TBase>
-::MakeThumbnail(unsigned int maxdim)
+::GetThumbnailSlice()
 {
   // For images with extreme aspect ratios (greater than 1:2) we
   // choose the direction in which the aspect ratio is closest to
@@ -1628,65 +1617,25 @@ ImageWrapper<TTraits,TBase>
   DisplaySliceType *slice = this->GetDisplaySlice(thumb_axis);
   slice->GetSource()->UpdateLargestPossibleRegion();
 
-  // The size of the slice
-  Vector2ui slice_dim = slice->GetBufferedRegion().GetSize();
-
-  // The physical extents of the slice
-  Vector2d slice_extent(slice->GetSpacing()[0] * slice_dim[0],
-                        slice->GetSpacing()[1] * slice_dim[1]);
-
-  // The output thumbnail will have the extents as the slice, but its size
-  // must be at max maxdim
-  double slice_extent_max = slice_extent.max_value();
-
-  // Create a simple square thumbnail
-  Vector2ui thumb_size(maxdim, maxdim);
-
-  // Spacing is such that the slice extent fits into the thumbnail
-  Vector2d thumb_spacing(slice_extent_max / maxdim,
-                         slice_extent_max / maxdim);
-
-  // The origin of the thumbnail is such that the centers coincide
-  Vector2d thumb_origin(0.5 * (slice_extent[0] - slice_extent_max),
-                        0.5 * (slice_extent[1] - slice_extent_max));
-
-  typedef typename itk::IdentityTransform<double, 2> TransformType;
-  TransformType::Pointer transform = TransformType::New();
-
-  typedef typename itk::ResampleImageFilter<
-      DisplaySliceType, DisplaySliceType> ResampleFilter;
-
-  // Background color for thumbnails
-  unsigned char defrgb[] = {0,0,0,255};
-
-  SmartPtr<ResampleFilter> filter = ResampleFilter::New();
-  filter->SetInput(slice);
-  filter->SetTransform(transform);
-  filter->SetSize(to_itkSize(thumb_size));
-  filter->SetOutputSpacing(thumb_spacing.data_block());
-  filter->SetOutputOrigin(thumb_origin.data_block());
-  filter->SetDefaultPixelValue(DisplayPixelType(defrgb));
-
-  // For thumbnails, the image needs to be flipped
-  typedef itk::FlipImageFilter<DisplaySliceType> FlipFilter;
-  SmartPtr<FlipFilter> flipper = FlipFilter::New();
-  flipper->SetInput(filter->GetOutput());
-  typename FlipFilter::FlipAxesArrayType flipaxes;
-  flipaxes[0] = false; flipaxes[1] = true;
-  flipper->SetFlipAxes(flipaxes);
-
-  // We also need to replace the transparency
-  typedef itk::UnaryFunctorImageFilter<
-      DisplaySliceType, DisplaySliceType, RemoveTransparencyFunctor> OpaqueFilter;
-  SmartPtr<OpaqueFilter> opaquer = OpaqueFilter::New();
-  opaquer->SetInput(flipper->GetOutput());
-
-  // Return the result
-  opaquer->Update();
-  DisplaySlicePointer result = opaquer->GetOutput();
+  // Copy the slice, so that the thumbnail can be made from it after the
+  // pipeline has moved on or the image has been unloaded
+  typedef itk::ImageDuplicator<DisplaySliceType> DuplicatorType;
+  SmartPtr<DuplicatorType> duplicator = DuplicatorType::New();
+  duplicator->SetInputImage(slice);
+  duplicator->Update();
+  DisplaySlicePointer result = duplicator->GetOutput();
   return result;
 }
 
+template<class TTraits, class TBase>
+typename ImageWrapper<TTraits,TBase>::DisplaySlicePointer
+ImageWrapper<TTraits,TBase>
+::MakeThumbnail(unsigned int maxdim)
+{
+  DisplaySlicePointer slice = this->GetThumbnailSlice();
+  return ThumbnailService::RenderThumbnail(slice, maxdim);
+}
+
 template<class TTraits, class TBase>
 void
 ImageWrapper<TTraits,TBase>
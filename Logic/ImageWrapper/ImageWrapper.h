@@ -544,6 +544,11 @@ public:
    */
   DisplaySlicePointer MakeThumbnail(unsigned int maxdim) ITK_OVERRIDE;
 
+  /**
+   * Get a copy of the display slice used for thumbnails
+   */
+  DisplaySlicePointer GetThumbnailSlice() ITK_OVERRIDE;
+
   /**
    * Save metadata to a Registry file. The metadata are data that are not
    * contained in the image header are need to be restored when the image
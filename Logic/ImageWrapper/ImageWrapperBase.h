@@ -313,6 +313,14 @@ public:
     */
   virtual const ScalarImageHistogram *GetHistogram(size_t nBins) = 0;
 
+  /**
+    Check whether the histogram with the given number of bins (or with the
+    current number of bins, if nBins is 0) has already been computed for the
+    current state of the image, so that GetHistogram() would return it without
+    making a pass through the image.
+    */
+  virtual bool IsHistogramUpToDate(size_t nBins) = 0;
+
   /** Compute statistics over a run of voxels in the image starting at the index
    * startIdx. Appends the statistics to a running sum and sum of squared. The
    * statistics are returned in internal (not native mapped) format */
@@ -333,6 +341,16 @@ public:
   virtual void GetVoxelUnderCursorDisplayedValueAndAppearance(
       vnl_vector<double> &out_value, DisplayPixelType &out_appearance) = 0;
 
+  /**
+   * Batched version of the method above: get the displayed value and the
+   * appearance at a set of voxels in reference space. The slicing pipeline
+   * is updated, and the transform to the reference space is resolved, once
+   * for all the voxels.
+   */
+  virtual void SampleDisplayedValueAndAppearance(
+      const itk::Index<3> *index, unsigned int n,
+      vnl_vector<double> *out_value, DisplayPixelType *out_appearance) = 0;
+
   /** Clear the data associated with storing an image */
   virtual void Reset() = 0;
 
@@ -380,6 +398,13 @@ public:
     */
   virtual DisplaySlicePointer MakeThumbnail(unsigned int maxdim) = 0;
 
+  /**
+    Get a copy of the display slice that thumbnails are made from. The copy
+    is not connected to the pipeline, so the thumbnail can be made from it
+    later, or in another thread.
+    */
+  virtual DisplaySlicePointer GetThumbnailSlice() = 0;
+
   /**
    * Access the "IO hints" registry associated with this wrapper. The IO hints
    * are used to help read the image when the filename alone is not sufficient.
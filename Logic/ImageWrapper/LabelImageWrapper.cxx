@@ -47,19 +47,36 @@
 LabelImageWrapper::LabelImageWrapper()
 {
   m_UndoManager = new UndoManagerType(4, 200000);
+  m_OccupancyPyramid = OccupancyPyramidType::New();
+  m_UnaccountedModifications = 0;
+  m_ImageModifiedObserverTag = 0;
 }
 
 LabelImageWrapper::~LabelImageWrapper()
 {
+  if(this->m_Image && m_ImageModifiedObserverTag)
+    this->m_Image->RemoveObserver(m_ImageModifiedObserverTag);
   delete m_UndoManager;
 }
 
 void LabelImageWrapper::UpdateImagePointer(
     ImageType *image, ImageBaseType *refSpace, ITKTransformType *tran)
 {
+  if(this->m_Image && m_ImageModifiedObserverTag)
+    this->m_Image->RemoveObserver(m_ImageModifiedObserverTag);
+
   Superclass::UpdateImagePointer(image, refSpace, tran);
   m_UndoManager->Clear();
 
+  // The occupancy pyramid will be built for the new image when needed
+  m_OccupancyPyramid = OccupancyPyramidType::New();
+  m_UnaccountedModifications = 0;
+
+  typedef itk::SimpleMemberCommand<Self> CommandType;
+  CommandType::Pointer cmd = CommandType::New();
+  cmd->SetCallbackFunction(this, &Self::OnImageModified);
+  m_ImageModifiedObserverTag = image->AddObserver(itk::ModifiedEvent(), cmd);
+
   // Modified event on the image is rebroadcast as the WrapperImageChangeEvent
   Rebroadcaster::Rebroadcast(image, itk::ModifiedEvent(),
                              this, WrapperImageChangeEvent());
@@ -67,6 +84,7 @@ void LabelImageWrapper::UpdateImagePointer(
 
 void LabelImageWrapper::StoreIntermediateUndoDelta(UndoManagerDelta *delta)
 {
+  this->UpdateOccupancyPyramid(delta->GetRegion(), 1);
   m_UndoManager->AddDeltaToStaging(delta);
 }
 
@@ -74,7 +92,10 @@ void LabelImageWrapper::StoreUndoPoint(const char *text, UndoManagerDelta *delta
 {
   // If there is a delta, add it to staging
   if(delta)
+    {
+    this->UpdateOccupancyPyramid(delta->GetRegion(), 1);
     m_UndoManager->AddDeltaToStaging(delta);
+    }
 
   // Commit the deltas
   m_UndoManager->CommitStaging(text);
@@ -125,6 +146,10 @@ void LabelImageWrapper::Undo()
 
   // Set modified flags
   imSeg->Modified();
+
+  // The deltas of the commit account for the modification
+  for(dit = commit.GetDeltas().rbegin(); dit != commit.GetDeltas().rend(); ++dit)
+    this->UpdateOccupancyPyramid((*dit)->GetRegion(), dit == commit.GetDeltas().rbegin() ? 1 : 0);
 }
 
 bool LabelImageWrapper::IsRedoPossible()
@@ -167,6 +192,10 @@ void LabelImageWrapper::Redo()
 
   // Set modified flags
   imSeg->Modified();
+
+  // The deltas of the commit account for the modification
+  for(dit = commit.GetDeltas().begin(); dit != commit.GetDeltas().end(); ++dit)
+    this->UpdateOccupancyPyramid((*dit)->GetRegion(), dit == commit.GetDeltas().begin() ? 1 : 0);
 }
 
 LabelImageWrapper::UndoManagerDelta *
@@ -182,3 +211,32 @@ LabelImageWrapper::CompressImage() const
   new_cumulative->FinishEncoding();
   return new_cumulative;
 }
+
+const LabelImageWrapper::OccupancyPyramidType *
+LabelImageWrapper::GetOccupancyPyramid()
+{
+  if(!m_OccupancyPyramid->IsBuilt() || m_UnaccountedModifications > 0)
+    {
+    m_OccupancyPyramid->Build(this->GetImage());
+    m_UnaccountedModifications = 0;
+    }
+  return m_OccupancyPyramid;
+}
+
+void LabelImageWrapper::OnImageModified()
+{
+  m_UnaccountedModifications++;
+}
+
+void LabelImageWrapper::UpdateOccupancyPyramid(
+    const RegionType &region, unsigned int nModifications)
+{
+  if(m_UnaccountedModifications > nModifications)
+    m_UnaccountedModifications -= nModifications;
+  else
+    m_UnaccountedModifications = 0;
+
+  // A pyramid that is out of date will be built again anyway
+  if(m_OccupancyPyramid->IsBuilt() && m_UnaccountedModifications == 0)
+    m_OccupancyPyramid->Update(this->GetImage(), region);
+}
@@ -3,6 +3,7 @@
 
 #include "ImageWrapperTraits.h"
 #include "ScalarImageWrapper.h"
+#include "RLEOccupancyPyramid.h"
 
 template <typename TPixel> class UndoDataManager;
 template <typename TPixel> class UndoDelta;
@@ -30,6 +31,10 @@ public:
   typedef UndoDataManager<PixelType> UndoManagerType;
   typedef UndoDelta<PixelType>       UndoManagerDelta;
 
+  // Occupancy pyramid typedefs
+  typedef RLEOccupancyPyramid<ImageType> OccupancyPyramidType;
+  typedef itk::ImageRegion<3> RegionType;
+
   /**
    * We override the SetImage method to reset the undo manager when an image is
    * assigned to the segmentation.
@@ -76,15 +81,40 @@ public:
    * array created in this call. */
   UndoManagerDelta *CompressImage() const;
 
+  /**
+   * Get the min/max occupancy pyramid of the label image, which can be used to
+   * skip over parts of the image that do not contain labels of interest. The
+   * pyramid is built on first use. After that, it is updated from the undo
+   * deltas of the edits to the segmentation, and built again if the image has
+   * been modified in any other way.
+   */
+  const OccupancyPyramidType *GetOccupancyPyramid();
+
 protected:
 
   LabelImageWrapper();
   ~LabelImageWrapper();
 
+  // Called when the label image is modified
+  void OnImageModified();
+
+  // Update the occupancy pyramid after the voxels in a region have been
+  // edited. The edit accounts for nModifications modified events of the image
+  void UpdateOccupancyPyramid(const RegionType &region, unsigned int nModifications);
+
   // Undo data manager, stores 'deltas', i.e., differences between states of the segmentation
   // image. These deltas are compressed, allowing us to store a bunch of
   // undo steps with little cost in performance or memory
   UndoManagerType *m_UndoManager;
+
+  // Min/max occupancy pyramid of the label image
+  SmartPtr<OccupancyPyramidType> m_OccupancyPyramid;
+
+  // Number of times the image has been modified since the pyramid was last
+  // updated. When not zero, the pyramid must be built again
+  unsigned long m_UnaccountedModifications;
+
+  unsigned long m_ImageModifiedObserverTag;
 };
 
 #endif // LABELIMAGEWRAPPER_H
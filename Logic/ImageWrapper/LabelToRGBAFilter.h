@@ -23,10 +23,15 @@
 
 #include <itkRGBAPixel.h>
 #include <itkNumericTraitsRGBAPixel.h>
+#include <algorithm>
 
 /**
  * \class LabelToRGBAFilter
  * \brief Simple filter that maps label image to RGB color image
+ *
+ * The colors come from the flat RGBA table of the ColorLabelTable, which
+ * has an entry for every label value and is only rebuilt when the labels
+ * change.
  */
 class LabelToRGBAFilter: 
   public itk::ImageToImageFilter<
@@ -53,6 +58,8 @@ public:
   /** Method for creation through the object factory. */
   itkNewMacro(Self)
     
+  typedef Superclass::OutputImageRegionType            OutputImageRegionType;
+
   /** Image dimension. */
   itkStaticConstMacro(ImageDimension, unsigned int,
                       InputImageType::ImageDimension);
@@ -75,52 +82,50 @@ protected:
   void PrintSelf(std::ostream& os, itk::Indent indent) const ITK_OVERRIDE
     { os << indent << "LabelToRGBAFilter"; }
   
+  /** Get the flat color table for this update */
+  void BeforeThreadedGenerateData() ITK_OVERRIDE
+    {
+    m_FlatTable = reinterpret_cast<const OutputPixelType *>(
+          m_ColorTable->GetFlatRGBATable());
+    }
+
   /** Generate Data */
-  void GenerateData( void ) ITK_OVERRIDE
+  void ThreadedGenerateData(const OutputImageRegionType &region,
+                            itk::ThreadIdType itkNotUsed(threadId)) ITK_OVERRIDE
     {
     // Here's the input and output
-    InputImageType::ConstPointer inputPtr = this->GetInput();
-    OutputImageType::Pointer outputPtr = this->GetOutput();
-
-    // Get the number of pixels in the input
-    size_t n = inputPtr->GetBufferedRegion().GetNumberOfPixels();
-
-    // Allocate output if needed
-    if(outputPtr->GetBufferedRegion().GetNumberOfPixels() != n)
+    const InputImageType *inputPtr = this->GetInput();
+    OutputImageType *outputPtr = this->GetOutput();
+
+    // The region is a band of whole rows, so it is contiguous in memory
+    size_t n = region.GetNumberOfPixels();
+    const LabelType *xin = inputPtr->GetBufferPointer()
+        + inputPtr->ComputeOffset(region.GetIndex());
+    const LabelType *xinend = xin + n;
+    OutputPixelType *xout = outputPtr->GetBufferPointer()
+        + outputPtr->ComputeOffset(region.GetIndex());
+
+    // Segmentations are homogeneous, so the slice consists of long runs of
+    // the same label. Each run is filled with one color from the flat table
+    while(xin < xinend)
       {
-      outputPtr->SetBufferedRegion(inputPtr->GetBufferedRegion());
-      outputPtr->Allocate();
-      }
-
-    // Get the clear label
-    const ColorLabel &clear = m_ColorTable->GetColorLabel(0);
-    const ColorLabel *cllast = &clear;
-
-    // Keep track of the last pixel - this reduces the amount of color label
-    // lookups, taking advantage of the fact that segmentations are homogeneous
-    InputPixelType last_pixel = 0;
-
-    // Simple loop
-    const LabelType *xin = inputPtr->GetBufferPointer(), *xinend = xin + n;
-    OutputPixelType *xout = outputPtr->GetBufferPointer();
-    for(; xin < xinend; ++xin, ++xout)
-      {
-      if(*xin != last_pixel)
-        {
-        last_pixel = *xin;
-        const ColorLabel &cl = m_ColorTable->GetColorLabel(last_pixel);
-        if(cl.IsVisible())
-          cllast = &cl;
-        else
-          cllast = &clear;
-        }
-
-      cllast->GetRGBAVector(xout->GetDataPointer());
+      LabelType label = *xin;
+      const LabelType *runend = xin + 1;
+      while(runend < xinend && *runend == label)
+        ++runend;
+
+      size_t len = runend - xin;
+      std::fill(xout, xout + len, m_FlatTable[label]);
+      xin = runend;
+      xout += len;
       }
     }
 
 private:
   ColorLabelTable *m_ColorTable;
+
+  // RGBA color of every label, with visibility folded in
+  const OutputPixelType *m_FlatTable;
 };
 
 #endif
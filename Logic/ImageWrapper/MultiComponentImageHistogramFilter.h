@@ -0,0 +1,126 @@
+#ifndef MULTICOMPONENTIMAGEHISTOGRAMFILTER_H
+#define MULTICOMPONENTIMAGEHISTOGRAMFILTER_H
+
+#include <itkImageToImageFilter.h>
+#include <ScalarImageHistogram.h>
+#include "MultiComponentImageStatisticsFilter.h"
+
+/**
+ * This ITK-style filter computes the histograms of a multi-component image
+ * (itk::VectorImage) for all the channels of MultiComponentImageStatisticsFilter:
+ * each component, each derived quantity, and all the components pooled
+ * together. It is meant to be used with that filter, whose range outputs are
+ * inputs of this filter and determine the extent of the histogram bins. Like
+ * ThreadedHistogramImageFilter, it is only executed when one of its histograms
+ * is updated, so images whose histograms are never shown do not pay for them.
+ *
+ * The image is processed in one multi-threaded pass over the interleaved
+ * buffer, with each thread filling its own histograms.
+ */
+template <class TInputImage>
+class MultiComponentImageHistogramFilter :
+    public itk::ImageToImageFilter<TInputImage, TInputImage>
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef MultiComponentImageHistogramFilter                  Self;
+  typedef itk::ImageToImageFilter< TInputImage, TInputImage > Superclass;
+  typedef itk::SmartPointer< Self >                           Pointer;
+  typedef itk::SmartPointer< const Self >                     ConstPointer;
+
+  /** Image related typedefs. */
+  typedef TInputImage                                   InputImageType;
+  typedef typename TInputImage::Pointer                 InputImagePointer;
+  typedef typename TInputImage::RegionType              RegionType;
+  typedef typename TInputImage::InternalPixelType       ComponentType;
+
+  /** The filter that provides the ranges */
+  typedef MultiComponentImageStatisticsFilter<TInputImage> RangeFilterType;
+
+  /** Histogram typedefs */
+  typedef ScalarImageHistogram HistogramType;
+  typedef SmartPtr<HistogramType> HistogramPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self)
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MultiComponentImageHistogramFilter, ImageToImageFilter)
+
+  /**
+   * Set the filter that computes the ranges of the channels. Its range
+   * outputs become inputs of this filter, so they are updated through the
+   * pipeline mechanism. This also creates the histogram outputs, so it must
+   * be called again if the number of components of the image changes.
+   */
+  void SetRangeInputs(RangeFilterType *rangeFilter);
+
+  /** Histograms of a component, a derived quantity, and of all components */
+  HistogramType *GetComponentHistogramOutput(unsigned int comp);
+  HistogramType *GetDerivedHistogramOutput(ScalarRepresentation rep);
+  HistogramType *GetHistogramOutput();
+
+  /** Set the number of bins used by all the histograms */
+  void SetNumberOfBins(int nBins);
+
+  /**
+   * Set the transform applied to the range of the component histograms and of
+   * the pooled histogram, as in ThreadedHistogramImageFilter. This should be
+   * the native intensity mapping of the image. The derived quantities are
+   * already in native units, so it is not applied to their histograms.
+   */
+  void SetIntensityTransform(double scale, double shift);
+
+protected:
+
+  MultiComponentImageHistogramFilter();
+  virtual ~MultiComponentImageHistogramFilter() {}
+  void PrintSelf(std::ostream & os, itk::Indent indent) const ITK_OVERRIDE;
+
+  /** Pass the input through unmodified by grafting it to the output */
+  void AllocateOutputs() ITK_OVERRIDE;
+
+  /** Initialize the per-thread histograms from the input ranges */
+  void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  /** Process a region of the image */
+  void ThreadedGenerateData(const RegionType &outputRegionForThread,
+                            itk::ThreadIdType threadId) ITK_OVERRIDE;
+
+  /** Add up the per-thread histograms */
+  void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+  // Override since the filter needs all the data for the algorithm
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  // Override since the filter produces all of its output
+  void EnlargeOutputRequestedRegion(itk::DataObject *data) ITK_OVERRIDE;
+
+private:
+
+  MultiComponentImageHistogramFilter(const Self &); //purposely not implemented
+  void operator=(const Self &);                     //purposely not implemented
+
+  // Inputs
+  SmartPtr<RangeFilterType> m_RangeFilter;
+
+  // Parameter: number of bins
+  unsigned int m_Bins;
+
+  // Intensity transform
+  double m_TransformScale, m_TransformShift;
+
+  // Per-thread histograms, indexed by thread, then by channel
+  std::vector< std::vector<HistogramPointer> > m_ThreadHistogram;
+
+  // The output histograms, one per channel of the range filter
+  std::vector<HistogramPointer> m_OutputHistogram;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "MultiComponentImageHistogramFilter.hxx"
+#endif
+
+
+#endif // MULTICOMPONENTIMAGEHISTOGRAMFILTER_H
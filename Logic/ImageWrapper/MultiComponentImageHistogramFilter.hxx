@@ -0,0 +1,238 @@
+#ifndef MULTICOMPONENTIMAGEHISTOGRAMFILTER_HXX
+#define MULTICOMPONENTIMAGEHISTOGRAMFILTER_HXX
+
+#include "MultiComponentImageHistogramFilter.h"
+#include <itkImageScanlineConstIterator.h>
+
+template <class TInputImage>
+MultiComponentImageHistogramFilter<TInputImage>
+::MultiComponentImageHistogramFilter()
+{
+  this->SetNumberOfRequiredInputs(1);
+
+  m_Bins = DEFAULT_HISTOGRAM_BINS;
+  m_TransformScale = 1.0;
+  m_TransformShift = 0.0;
+}
+
+template <class TInputImage>
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::SetRangeInputs(RangeFilterType *rangeFilter)
+{
+  m_RangeFilter = rangeFilter;
+
+  // Input 0 is the image, followed by the min and max of each channel
+  unsigned int nChannels = rangeFilter->GetNumberOfChannels();
+  this->SetNumberOfRequiredInputs(1 + 2 * nChannels);
+  for(unsigned int c = 0; c < nChannels; c++)
+    {
+    this->SetNthInput(1 + 2 * c, rangeFilter->GetChannelMinimumOutput(c));
+    this->SetNthInput(2 + 2 * c, rangeFilter->GetChannelMaximumOutput(c));
+    }
+
+  // Output 0 is the pass-through image, followed by the histogram of each
+  // channel
+  if(m_OutputHistogram.size() != nChannels)
+    {
+    this->SetNumberOfRequiredOutputs(1 + nChannels);
+    m_OutputHistogram.resize(nChannels);
+    for(unsigned int c = 0; c < nChannels; c++)
+      {
+      m_OutputHistogram[c] = HistogramType::New();
+      this->SetNthOutput(1 + c, m_OutputHistogram[c]);
+      }
+    }
+
+  this->Modified();
+}
+
+template <class TInputImage>
+typename MultiComponentImageHistogramFilter<TInputImage>::HistogramType *
+MultiComponentImageHistogramFilter<TInputImage>
+::GetComponentHistogramOutput(unsigned int comp)
+{
+  assert(comp < m_RangeFilter->GetNumberOfComponents());
+  return m_OutputHistogram[comp];
+}
+
+template <class TInputImage>
+typename MultiComponentImageHistogramFilter<TInputImage>::HistogramType *
+MultiComponentImageHistogramFilter<TInputImage>
+::GetDerivedHistogramOutput(ScalarRepresentation rep)
+{
+  return m_OutputHistogram[m_RangeFilter->GetDerivedChannel(rep)];
+}
+
+template <class TInputImage>
+typename MultiComponentImageHistogramFilter<TInputImage>::HistogramType *
+MultiComponentImageHistogramFilter<TInputImage>
+::GetHistogramOutput()
+{
+  return m_OutputHistogram[m_RangeFilter->GetPooledChannel()];
+}
+
+template <class TInputImage>
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::SetNumberOfBins(int nBins)
+{
+  if(m_Bins != (unsigned int) nBins)
+    {
+    m_Bins = nBins;
+    this->Modified();
+    }
+}
+
+template <class TInputImage>
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::SetIntensityTransform(double scale, double shift)
+{
+  if(m_TransformScale != scale || m_TransformShift != shift)
+    {
+    m_TransformScale = scale;
+    m_TransformShift = shift;
+    this->Modified();
+    }
+}
+
+template <class TInputImage>
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+  if ( this->GetInput() )
+    {
+    InputImagePointer image =
+      const_cast< typename Superclass::InputImageType * >( this->GetInput() );
+    image->SetRequestedRegionToLargestPossibleRegion();
+    }
+}
+
+template <class TInputImage>
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::EnlargeOutputRequestedRegion(itk::DataObject *data)
+{
+  Superclass::EnlargeOutputRequestedRegion(data);
+  data->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <class TInputImage>
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::AllocateOutputs()
+{
+  // Pass the input through as the output
+  InputImagePointer image =
+    const_cast< TInputImage * >( this->GetInput() );
+
+  this->GraftOutput(image);
+
+  // Nothing to be done for the histogram outputs
+}
+
+template <class TInputImage>
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::BeforeThreadedGenerateData()
+{
+  unsigned int nChannels = m_OutputHistogram.size();
+  if(this->GetInput()->GetNumberOfComponentsPerPixel() != m_RangeFilter->GetNumberOfComponents()
+     || m_RangeFilter->GetNumberOfChannels() != nChannels)
+    itkExceptionMacro(<< "Number of components changed since the range inputs were set");
+
+  // The bins span the ranges of the channels, which have been updated by the
+  // pipeline before this filter executes
+  unsigned int nThreads = this->GetNumberOfThreads();
+  m_ThreadHistogram.assign(nThreads, std::vector<HistogramPointer>(nChannels));
+  for(unsigned int c = 0; c < nChannels; c++)
+    {
+    double hmin = m_RangeFilter->GetChannelMinimum(c);
+    double hmax = m_RangeFilter->GetChannelMaximum(c);
+    m_OutputHistogram[c]->Initialize(hmin, hmax, m_Bins);
+    for(unsigned int t = 0; t < nThreads; t++)
+      {
+      m_ThreadHistogram[t][c] = HistogramType::New();
+      m_ThreadHistogram[t][c]->Initialize(hmin, hmax, m_Bins);
+      }
+    }
+}
+
+template< class TInputImage >
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::ThreadedGenerateData(const RegionType &outputRegionForThread,
+                       itk::ThreadIdType threadId)
+{
+  if ( outputRegionForThread.GetNumberOfPixels() == 0 )
+    return;
+
+  const InputImageType *input = this->GetInput();
+  const ComponentType *buffer = input->GetBufferPointer();
+  const unsigned int nc = input->GetNumberOfComponentsPerPixel();
+  const unsigned int cMag = m_RangeFilter->GetDerivedChannel(SCALAR_REP_MAGNITUDE);
+  const unsigned int cMax = m_RangeFilter->GetDerivedChannel(SCALAR_REP_MAX);
+  const unsigned int cMean = m_RangeFilter->GetDerivedChannel(SCALAR_REP_AVERAGE);
+  const unsigned int cAll = m_RangeFilter->GetPooledChannel();
+  const long lineLength = outputRegionForThread.GetSize(0);
+
+  // The derived quantities are computed as by the range filter
+  const typename RangeFilterType::MagnitudeFunctor &fMag = m_RangeFilter->GetMagnitudeFunctor();
+  const typename RangeFilterType::MaxFunctor &fMax = m_RangeFilter->GetMaxFunctor();
+  const typename RangeFilterType::MeanFunctor &fMean = m_RangeFilter->GetMeanFunctor();
+
+  // Iterate over the lines in the region. Along each line, the components of
+  // consecutive voxels are contiguous in memory
+  std::vector<HistogramPointer> &hist = m_ThreadHistogram[threadId];
+  itk::ImageScanlineConstIterator<InputImageType> it(input, outputRegionForThread);
+  for(; !it.IsAtEnd(); it.NextLine())
+    {
+    const ComponentType *p = buffer + input->ComputeOffset(it.GetIndex()) * nc;
+    for(long i = 0; i < lineLength; i++, p += nc)
+      {
+      for(unsigned int c = 0; c < nc; c++)
+        {
+        hist[c]->AddSample(p[c]);
+        hist[cAll]->AddSample(p[c]);
+        }
+
+      hist[cMag]->AddSample(fMag.Get(p, nc));
+      hist[cMax]->AddSample(fMax.Get(p, nc));
+      hist[cMean]->AddSample(fMean.Get(p, nc));
+      }
+    }
+}
+
+template< class TInputImage >
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::AfterThreadedGenerateData()
+{
+  // Add up the partial histograms, and apply the native intensity transform
+  // to the histograms of the components
+  for(unsigned int c = 0; c < m_OutputHistogram.size(); c++)
+    {
+    for(unsigned int t = 0; t < m_ThreadHistogram.size(); t++)
+      m_OutputHistogram[c]->AddCompatibleHistogram(*m_ThreadHistogram[t][c]);
+
+    if(m_RangeFilter->IsComponentChannel(c))
+      m_OutputHistogram[c]->ApplyIntensityTransform(m_TransformScale, m_TransformShift);
+    }
+
+  // Release the per-thread storage
+  m_ThreadHistogram.clear();
+}
+
+template< class TInputImage >
+void
+MultiComponentImageHistogramFilter<TInputImage>
+::PrintSelf(std::ostream &os, itk::Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfBins: " << m_Bins << std::endl;
+}
+
+#endif // MULTICOMPONENTIMAGEHISTOGRAMFILTER_HXX
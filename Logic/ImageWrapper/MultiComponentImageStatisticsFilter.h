@@ -0,0 +1,179 @@
+#ifndef MULTICOMPONENTIMAGESTATISTICSFILTER_H
+#define MULTICOMPONENTIMAGESTATISTICSFILTER_H
+
+#include <itkImageToImageFilter.h>
+#include <itkSimpleDataObjectDecorator.h>
+#include <itkNumericTraits.h>
+#include "ImageWrapperBase.h"
+#include "VectorToScalarImageAccessor.h"
+
+/**
+ * This ITK-style filter computes the intensity ranges of a multi-component
+ * image (itk::VectorImage) that are needed by the scalar representations of
+ * the image: the minimum and maximum of each component, of the derived
+ * quantities (magnitude, maximum and mean of the components), and of all the
+ * components pooled together.
+ *
+ * Computing these ranges with a separate min/max filter for each scalar
+ * representation requires a strided pass through the image for every one of
+ * them, which is very slow for images with hundreds of components (e.g., 4D
+ * time series). This filter instead makes one multi-threaded pass over the
+ * interleaved buffer to find all of the ranges. Each thread processes whole
+ * image lines, reading the components of each voxel contiguously.
+ *
+ * The ranges are available as pipeline outputs, so they can be used in place
+ * of the outputs of itk::MinimumMaximumImageFilter. The histograms, whose
+ * bins depend on the ranges, are computed by MultiComponentImageHistogramFilter,
+ * which takes the range outputs of this filter as inputs. This way the
+ * histograms are only computed when they are needed, and the ranges are not
+ * recomputed when only the histogram parameters change. The outputs are
+ * created when the input is set, since their number depends on the number of
+ * components.
+ */
+template <class TInputImage>
+class MultiComponentImageStatisticsFilter :
+    public itk::ImageToImageFilter<TInputImage, TInputImage>
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef MultiComponentImageStatisticsFilter                 Self;
+  typedef itk::ImageToImageFilter< TInputImage, TInputImage > Superclass;
+  typedef itk::SmartPointer< Self >                           Pointer;
+  typedef itk::SmartPointer< const Self >                     ConstPointer;
+
+  /** Image related typedefs. */
+  typedef TInputImage                                   InputImageType;
+  typedef typename TInputImage::Pointer                 InputImagePointer;
+  typedef typename TInputImage::RegionType              RegionType;
+  typedef typename TInputImage::InternalPixelType       ComponentType;
+
+  /** Functors that compute the derived quantities */
+  typedef VectorToScalarMagnitudeFunctor<ComponentType, float> MagnitudeFunctor;
+  typedef VectorToScalarMaxFunctor<ComponentType, float>       MaxFunctor;
+  typedef VectorToScalarMeanFunctor<ComponentType, float>      MeanFunctor;
+
+  /** Type of DataObjects used for the ranges of components and derived quantities */
+  typedef itk::SimpleDataObjectDecorator<ComponentType>   ComponentObjectType;
+  typedef itk::SimpleDataObjectDecorator<float>             DerivedObjectType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self)
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MultiComponentImageStatisticsFilter, ImageToImageFilter)
+
+  /** Set the input image. This also creates the outputs for its components */
+  using Superclass::SetInput;
+  virtual void SetInput(const InputImageType *image) ITK_OVERRIDE;
+
+  /** Range of a single component */
+  ComponentObjectType *GetComponentMinimumOutput(unsigned int comp);
+  ComponentObjectType *GetComponentMaximumOutput(unsigned int comp);
+
+  /** Range of a derived quantity (SCALAR_REP_MAGNITUDE, _MAX or _AVERAGE) */
+  DerivedObjectType *GetDerivedMinimumOutput(ScalarRepresentation rep);
+  DerivedObjectType *GetDerivedMaximumOutput(ScalarRepresentation rep);
+
+  /** Range over all the components */
+  ComponentObjectType *GetMinimumOutput();
+  ComponentObjectType *GetMaximumOutput();
+
+  /**
+   * The ranges are computed for a number of channels: the components come
+   * first, followed by the derived quantities and the pooled components. The
+   * range of the components and of the pooled components is stored in the
+   * component type, and the range of the derived quantities as float.
+   */
+  unsigned int GetNumberOfComponents() const { return m_NumberOfComponents; }
+  unsigned int GetNumberOfChannels() const
+    { return m_NumberOfComponents + NUMBER_OF_DERIVED_CHANNELS; }
+  unsigned int GetDerivedChannel(ScalarRepresentation rep) const;
+  unsigned int GetPooledChannel() const
+    { return m_NumberOfComponents + CHANNEL_ALL; }
+  bool IsComponentChannel(unsigned int channel) const
+    { return channel < m_NumberOfComponents || channel == this->GetPooledChannel(); }
+
+  /** The range outputs of a channel */
+  itk::DataObject *GetChannelMinimumOutput(unsigned int channel);
+  itk::DataObject *GetChannelMaximumOutput(unsigned int channel);
+
+  /** The range of a channel found by the last update */
+  double GetChannelMinimum(unsigned int channel) const { return m_ChannelMin[channel]; }
+  double GetChannelMaximum(unsigned int channel) const { return m_ChannelMax[channel]; }
+
+  /**
+   * Set the mapping from the internal to the native intensities used to
+   * compute the derived quantities (see VectorToScalarImageAccessor).
+   */
+  void SetSourceNativeMapping(double scale, double shift);
+
+  /** Functors that compute the derived quantities */
+  const MagnitudeFunctor &GetMagnitudeFunctor() const { return m_MagnitudeFunctor; }
+  const MaxFunctor &GetMaxFunctor() const { return m_MaxFunctor; }
+  const MeanFunctor &GetMeanFunctor() const { return m_MeanFunctor; }
+
+protected:
+
+  MultiComponentImageStatisticsFilter();
+  virtual ~MultiComponentImageStatisticsFilter() {}
+  void PrintSelf(std::ostream & os, itk::Indent indent) const ITK_OVERRIDE;
+
+  /** Pass the input through unmodified by grafting it to the output */
+  void AllocateOutputs() ITK_OVERRIDE;
+
+  /** Initialize the per-thread ranges */
+  void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  /** Process a region of the image */
+  void ThreadedGenerateData(const RegionType &outputRegionForThread,
+                            itk::ThreadIdType threadId) ITK_OVERRIDE;
+
+  /** Combine the per-thread ranges and store them in the outputs */
+  void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+  // Override since the filter needs all the data for the algorithm
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  // Override since the filter produces all of its output
+  void EnlargeOutputRequestedRegion(itk::DataObject *data) ITK_OVERRIDE;
+
+private:
+
+  MultiComponentImageStatisticsFilter(const Self &); //purposely not implemented
+  void operator=(const Self &);                      //purposely not implemented
+
+  // Channels for which ranges are computed, after the components
+  enum DerivedChannel {
+    CHANNEL_MAGNITUDE = 0, CHANNEL_MAX, CHANNEL_MEAN, CHANNEL_ALL,
+    NUMBER_OF_DERIVED_CHANNELS
+  };
+
+  // Output index of the minimum of a channel (the maximum follows it)
+  unsigned int GetRangeOutputIndex(unsigned int channel) const
+    { return 1 + 2 * channel; }
+
+  // Create the outputs for a given number of components
+  void CreateOutputs(unsigned int nComponents);
+
+  // Number of components for which outputs have been created
+  unsigned int m_NumberOfComponents;
+
+  // Functors for the derived quantities
+  MagnitudeFunctor m_MagnitudeFunctor;
+  MaxFunctor m_MaxFunctor;
+  MeanFunctor m_MeanFunctor;
+
+  // Per-thread ranges, indexed by thread, then by channel
+  std::vector< std::vector<double> > m_ThreadMin, m_ThreadMax;
+
+  // Ranges of all channels
+  std::vector<double> m_ChannelMin, m_ChannelMax;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "MultiComponentImageStatisticsFilter.hxx"
+#endif
+
+
+#endif // MULTICOMPONENTIMAGESTATISTICSFILTER_H
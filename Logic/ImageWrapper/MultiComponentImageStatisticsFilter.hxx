@@ -0,0 +1,357 @@
+#ifndef MULTICOMPONENTIMAGESTATISTICSFILTER_HXX
+#define MULTICOMPONENTIMAGESTATISTICSFILTER_HXX
+
+#include "MultiComponentImageStatisticsFilter.h"
+#include <itkImageScanlineConstIterator.h>
+#include <limits>
+
+template <class TInputImage>
+MultiComponentImageStatisticsFilter<TInputImage>
+::MultiComponentImageStatisticsFilter()
+{
+  this->SetNumberOfRequiredInputs(1);
+  m_NumberOfComponents = 0;
+}
+
+template <class TInputImage>
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::SetInput(const InputImageType *image)
+{
+  Superclass::SetInput(image);
+  if(image)
+    this->CreateOutputs(image->GetNumberOfComponentsPerPixel());
+}
+
+template <class TInputImage>
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::CreateOutputs(unsigned int nComponents)
+{
+  if(nComponents == m_NumberOfComponents && m_ChannelMin.size())
+    return;
+
+  m_NumberOfComponents = nComponents;
+  unsigned int nChannels = nComponents + NUMBER_OF_DERIVED_CHANNELS;
+
+  // Output 0 is the pass-through image, followed by the min and max of each
+  // channel
+  this->SetNumberOfRequiredOutputs(1 + 2 * nChannels);
+  for(unsigned int c = 0; c < nChannels; c++)
+    {
+    if(c < nComponents || c == nComponents + CHANNEL_ALL)
+      {
+      typename ComponentObjectType::Pointer omin = ComponentObjectType::New();
+      typename ComponentObjectType::Pointer omax = ComponentObjectType::New();
+      omin->Set(itk::NumericTraits<ComponentType>::max());
+      omax->Set(itk::NumericTraits<ComponentType>::NonpositiveMin());
+      this->SetNthOutput(this->GetRangeOutputIndex(c), omin);
+      this->SetNthOutput(this->GetRangeOutputIndex(c) + 1, omax);
+      }
+    else
+      {
+      typename DerivedObjectType::Pointer omin = DerivedObjectType::New();
+      typename DerivedObjectType::Pointer omax = DerivedObjectType::New();
+      omin->Set(itk::NumericTraits<float>::max());
+      omax->Set(itk::NumericTraits<float>::NonpositiveMin());
+      this->SetNthOutput(this->GetRangeOutputIndex(c), omin);
+      this->SetNthOutput(this->GetRangeOutputIndex(c) + 1, omax);
+      }
+    }
+
+  m_ChannelMin.assign(nChannels, std::numeric_limits<double>::max());
+  m_ChannelMax.assign(nChannels, -std::numeric_limits<double>::max());
+
+  this->Modified();
+}
+
+template <class TInputImage>
+unsigned int
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetDerivedChannel(ScalarRepresentation rep) const
+{
+  unsigned int channel = 0;
+  switch(rep)
+    {
+    case SCALAR_REP_MAGNITUDE: channel = CHANNEL_MAGNITUDE; break;
+    case SCALAR_REP_MAX: channel = CHANNEL_MAX; break;
+    case SCALAR_REP_AVERAGE: channel = CHANNEL_MEAN; break;
+    default:
+      itkExceptionMacro(<< "Scalar representation " << rep << " is not a derived quantity");
+    }
+  return m_NumberOfComponents + channel;
+}
+
+template <class TInputImage>
+typename MultiComponentImageStatisticsFilter<TInputImage>::ComponentObjectType *
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetComponentMinimumOutput(unsigned int comp)
+{
+  assert(comp < m_NumberOfComponents);
+  return static_cast<ComponentObjectType *>(
+        this->itk::ProcessObject::GetOutput(this->GetRangeOutputIndex(comp)));
+}
+
+template <class TInputImage>
+typename MultiComponentImageStatisticsFilter<TInputImage>::ComponentObjectType *
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetComponentMaximumOutput(unsigned int comp)
+{
+  assert(comp < m_NumberOfComponents);
+  return static_cast<ComponentObjectType *>(
+        this->itk::ProcessObject::GetOutput(this->GetRangeOutputIndex(comp) + 1));
+}
+
+template <class TInputImage>
+typename MultiComponentImageStatisticsFilter<TInputImage>::DerivedObjectType *
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetDerivedMinimumOutput(ScalarRepresentation rep)
+{
+  unsigned int c = this->GetDerivedChannel(rep);
+  return static_cast<DerivedObjectType *>(
+        this->itk::ProcessObject::GetOutput(this->GetRangeOutputIndex(c)));
+}
+
+template <class TInputImage>
+typename MultiComponentImageStatisticsFilter<TInputImage>::DerivedObjectType *
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetDerivedMaximumOutput(ScalarRepresentation rep)
+{
+  unsigned int c = this->GetDerivedChannel(rep);
+  return static_cast<DerivedObjectType *>(
+        this->itk::ProcessObject::GetOutput(this->GetRangeOutputIndex(c) + 1));
+}
+
+template <class TInputImage>
+typename MultiComponentImageStatisticsFilter<TInputImage>::ComponentObjectType *
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetMinimumOutput()
+{
+  unsigned int c = m_NumberOfComponents + CHANNEL_ALL;
+  return static_cast<ComponentObjectType *>(
+        this->itk::ProcessObject::GetOutput(this->GetRangeOutputIndex(c)));
+}
+
+template <class TInputImage>
+typename MultiComponentImageStatisticsFilter<TInputImage>::ComponentObjectType *
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetMaximumOutput()
+{
+  unsigned int c = m_NumberOfComponents + CHANNEL_ALL;
+  return static_cast<ComponentObjectType *>(
+        this->itk::ProcessObject::GetOutput(this->GetRangeOutputIndex(c) + 1));
+}
+
+template <class TInputImage>
+itk::DataObject *
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetChannelMinimumOutput(unsigned int channel)
+{
+  assert(channel < this->GetNumberOfChannels());
+  return this->itk::ProcessObject::GetOutput(this->GetRangeOutputIndex(channel));
+}
+
+template <class TInputImage>
+itk::DataObject *
+MultiComponentImageStatisticsFilter<TInputImage>
+::GetChannelMaximumOutput(unsigned int channel)
+{
+  assert(channel < this->GetNumberOfChannels());
+  return this->itk::ProcessObject::GetOutput(this->GetRangeOutputIndex(channel) + 1);
+}
+
+template <class TInputImage>
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::SetSourceNativeMapping(double scale, double shift)
+{
+  m_MagnitudeFunctor.SetSourceNativeMapping(scale, shift);
+  m_MaxFunctor.SetSourceNativeMapping(scale, shift);
+  m_MeanFunctor.SetSourceNativeMapping(scale, shift);
+  this->Modified();
+}
+
+template <class TInputImage>
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+  if ( this->GetInput() )
+    {
+    InputImagePointer image =
+      const_cast< typename Superclass::InputImageType * >( this->GetInput() );
+    image->SetRequestedRegionToLargestPossibleRegion();
+    }
+}
+
+template <class TInputImage>
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::EnlargeOutputRequestedRegion(itk::DataObject *data)
+{
+  Superclass::EnlargeOutputRequestedRegion(data);
+  data->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <class TInputImage>
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::AllocateOutputs()
+{
+  // Pass the input through as the output
+  InputImagePointer image =
+    const_cast< TInputImage * >( this->GetInput() );
+
+  this->GraftOutput(image);
+
+  // Nothing to be done for the other outputs
+}
+
+template <class TInputImage>
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::BeforeThreadedGenerateData()
+{
+  const InputImageType *input = this->GetInput();
+  unsigned int nc = input->GetNumberOfComponentsPerPixel();
+  if(nc != m_NumberOfComponents)
+    itkExceptionMacro(<< "Number of components changed since the input was set");
+
+  unsigned int nChannels = this->GetNumberOfChannels();
+  unsigned int nThreads = this->GetNumberOfThreads();
+
+  m_MagnitudeFunctor.SetVectorLength(nc);
+  m_MaxFunctor.SetVectorLength(nc);
+  m_MeanFunctor.SetVectorLength(nc);
+
+  m_ThreadMin.assign(nThreads, std::vector<double>(nChannels, std::numeric_limits<double>::max()));
+  m_ThreadMax.assign(nThreads, std::vector<double>(nChannels, -std::numeric_limits<double>::max()));
+}
+
+template <class TInputImage>
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::AfterThreadedGenerateData()
+{
+  unsigned int nc = m_NumberOfComponents;
+  unsigned int nChannels = this->GetNumberOfChannels();
+
+  m_ChannelMin.assign(nChannels, std::numeric_limits<double>::max());
+  m_ChannelMax.assign(nChannels, -std::numeric_limits<double>::max());
+  for(unsigned int t = 0; t < m_ThreadMin.size(); t++)
+    {
+    for(unsigned int c = 0; c < nChannels; c++)
+      {
+      m_ChannelMin[c] = std::min(m_ChannelMin[c], m_ThreadMin[t][c]);
+      m_ChannelMax[c] = std::max(m_ChannelMax[c], m_ThreadMax[t][c]);
+      }
+    }
+
+  // The pooled range is the range of the component ranges
+  unsigned int cAll = this->GetPooledChannel();
+  for(unsigned int c = 0; c < nc; c++)
+    {
+    m_ChannelMin[cAll] = std::min(m_ChannelMin[cAll], m_ChannelMin[c]);
+    m_ChannelMax[cAll] = std::max(m_ChannelMax[cAll], m_ChannelMax[c]);
+    }
+
+  // Store the ranges in the outputs
+  for(unsigned int c = 0; c < nChannels; c++)
+    {
+    itk::DataObject *omin = this->GetChannelMinimumOutput(c);
+    itk::DataObject *omax = this->GetChannelMaximumOutput(c);
+    if(this->IsComponentChannel(c))
+      {
+      static_cast<ComponentObjectType *>(omin)->Set(static_cast<ComponentType>(m_ChannelMin[c]));
+      static_cast<ComponentObjectType *>(omax)->Set(static_cast<ComponentType>(m_ChannelMax[c]));
+      }
+    else
+      {
+      static_cast<DerivedObjectType *>(omin)->Set(static_cast<float>(m_ChannelMin[c]));
+      static_cast<DerivedObjectType *>(omax)->Set(static_cast<float>(m_ChannelMax[c]));
+      }
+    }
+
+  // Release the per-thread storage
+  m_ThreadMin.clear();
+  m_ThreadMax.clear();
+}
+
+template< class TInputImage >
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::ThreadedGenerateData(const RegionType &outputRegionForThread,
+                       itk::ThreadIdType threadId)
+{
+  if ( outputRegionForThread.GetNumberOfPixels() == 0 )
+    return;
+
+  const InputImageType *input = this->GetInput();
+  const ComponentType *buffer = input->GetBufferPointer();
+  const unsigned int nc = input->GetNumberOfComponentsPerPixel();
+  const unsigned int cMag = nc + CHANNEL_MAGNITUDE, cMax = nc + CHANNEL_MAX;
+  const unsigned int cMean = nc + CHANNEL_MEAN;
+  const long lineLength = outputRegionForThread.GetSize(0);
+
+  // Iterate over the lines in the region. Along each line, the components of
+  // consecutive voxels are contiguous in memory
+  itk::ImageScanlineConstIterator<InputImageType> it(input, outputRegionForThread);
+  double *tmin = &m_ThreadMin[threadId][0];
+  double *tmax = &m_ThreadMax[threadId][0];
+
+  // Keep the running component ranges in the component type
+  std::vector<ComponentType> cmin(nc), cmax(nc);
+  for(unsigned int c = 0; c < nc; c++)
+    {
+    cmin[c] = itk::NumericTraits<ComponentType>::max();
+    cmax[c] = itk::NumericTraits<ComponentType>::NonpositiveMin();
+    }
+
+  float dmin[3], dmax[3];
+  for(int k = 0; k < 3; k++)
+    {
+    dmin[k] = itk::NumericTraits<float>::max();
+    dmax[k] = itk::NumericTraits<float>::NonpositiveMin();
+    }
+
+  for(; !it.IsAtEnd(); it.NextLine())
+    {
+    const ComponentType *p = buffer + input->ComputeOffset(it.GetIndex()) * nc;
+    for(long i = 0; i < lineLength; i++, p += nc)
+      {
+      for(unsigned int c = 0; c < nc; c++)
+        {
+        cmin[c] = std::min(cmin[c], p[c]);
+        cmax[c] = std::max(cmax[c], p[c]);
+        }
+
+      float vmag = m_MagnitudeFunctor.Get(p, nc);
+      float vmax = m_MaxFunctor.Get(p, nc);
+      float vmean = m_MeanFunctor.Get(p, nc);
+      dmin[0] = std::min(dmin[0], vmag); dmax[0] = std::max(dmax[0], vmag);
+      dmin[1] = std::min(dmin[1], vmax); dmax[1] = std::max(dmax[1], vmax);
+      dmin[2] = std::min(dmin[2], vmean); dmax[2] = std::max(dmax[2], vmean);
+      }
+    }
+
+  for(unsigned int c = 0; c < nc; c++)
+    {
+    tmin[c] = cmin[c];
+    tmax[c] = cmax[c];
+    }
+  tmin[cMag] = dmin[0]; tmax[cMag] = dmax[0];
+  tmin[cMax] = dmin[1]; tmax[cMax] = dmax[1];
+  tmin[cMean] = dmin[2]; tmax[cMean] = dmax[2];
+}
+
+template< class TInputImage >
+void
+MultiComponentImageStatisticsFilter<TInputImage>
+::PrintSelf(std::ostream &os, itk::Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfComponents: " << m_NumberOfComponents << std::endl;
+}
+
+#endif // MULTICOMPONENTIMAGESTATISTICSFILTER_HXX
@@ -0,0 +1,201 @@
+#include "QuantileSketch.h"
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+QuantileSketch::QuantileSketch(unsigned int k)
+{
+  m_K = std::max(k, 8u);
+  this->Clear();
+}
+
+void
+QuantileSketch
+::Clear()
+{
+  m_Levels.assign(1, std::vector<double>());
+  m_Parity.assign(1, false);
+  m_Count = 0;
+  m_Minimum = 0;
+  m_Maximum = 0;
+}
+
+size_t
+QuantileSketch
+::GetLevelCapacity(size_t level) const
+{
+  // Capacities shrink by a factor of 2/3 from the top level down
+  size_t depth = m_Levels.size() - 1 - level;
+  double cap = std::ceil(m_K * std::pow(2.0 / 3.0, (double) depth));
+  return std::max((size_t) cap, (size_t) 2);
+}
+
+size_t
+QuantileSketch
+::GetTotalCapacity() const
+{
+  size_t total = 0;
+  for(size_t h = 0; h < m_Levels.size(); h++)
+    total += this->GetLevelCapacity(h);
+  return total;
+}
+
+size_t
+QuantileSketch
+::GetNumberOfRetainedValues() const
+{
+  size_t total = 0;
+  for(size_t h = 0; h < m_Levels.size(); h++)
+    total += m_Levels[h].size();
+  return total;
+}
+
+void
+QuantileSketch
+::Add(double value)
+{
+  if(m_Count == 0)
+    {
+    m_Minimum = m_Maximum = value;
+    }
+  else
+    {
+    m_Minimum = std::min(m_Minimum, value);
+    m_Maximum = std::max(m_Maximum, value);
+    }
+
+  m_Count++;
+  m_Levels[0].push_back(value);
+
+  // Only the lowest level has grown, so it is the one to check
+  if(m_Levels[0].size() >= this->GetLevelCapacity(0))
+    this->Compress();
+}
+
+void
+QuantileSketch
+::Compress()
+{
+  while(this->GetNumberOfRetainedValues() > this->GetTotalCapacity()
+        || m_Levels[0].size() >= this->GetLevelCapacity(0))
+    {
+    // Find the lowest level that is at capacity
+    size_t h = 0;
+    while(h < m_Levels.size() && m_Levels[h].size() < this->GetLevelCapacity(h))
+      h++;
+
+    // This can only happen when the total is over capacity because of merging
+    if(h == m_Levels.size())
+      {
+      h = 0;
+      while(m_Levels[h].size() < 2)
+        h++;
+      }
+
+    // Add a level on top if needed
+    if(h + 1 == m_Levels.size())
+      {
+      m_Levels.push_back(std::vector<double>());
+      m_Parity.push_back(false);
+      }
+
+    // Sort the level and promote every other value. If the number of values
+    // is odd, the largest value stays in the level
+    std::vector<double> &level = m_Levels[h];
+    std::sort(level.begin(), level.end());
+
+    size_t n = level.size() & ~((size_t) 1);
+    size_t offset = m_Parity[h] ? 1 : 0;
+    m_Parity[h] = !m_Parity[h];
+
+    std::vector<double> &next = m_Levels[h + 1];
+    for(size_t i = offset; i < n; i += 2)
+      next.push_back(level[i]);
+
+    if(level.size() > n)
+      {
+      double leftover = level.back();
+      level.clear();
+      level.push_back(leftover);
+      }
+    else
+      {
+      level.clear();
+      }
+    }
+}
+
+void
+QuantileSketch
+::Merge(const QuantileSketch &other)
+{
+  if(other.m_Count == 0)
+    return;
+
+  if(m_Count == 0)
+    {
+    m_Minimum = other.m_Minimum;
+    m_Maximum = other.m_Maximum;
+    }
+  else
+    {
+    m_Minimum = std::min(m_Minimum, other.m_Minimum);
+    m_Maximum = std::max(m_Maximum, other.m_Maximum);
+    }
+
+  m_Count += other.m_Count;
+
+  // Append the buffers level by level
+  if(m_Levels.size() < other.m_Levels.size())
+    {
+    m_Levels.resize(other.m_Levels.size());
+    m_Parity.resize(other.m_Levels.size(), false);
+    }
+
+  for(size_t h = 0; h < other.m_Levels.size(); h++)
+    m_Levels[h].insert(m_Levels[h].end(),
+                       other.m_Levels[h].begin(), other.m_Levels[h].end());
+
+  this->Compress();
+}
+
+double
+QuantileSketch
+::GetQuantile(double q) const
+{
+  if(m_Count == 0)
+    return 0.0;
+
+  if(q <= 0.0)
+    return m_Minimum;
+  if(q >= 1.0)
+    return m_Maximum;
+
+  // Collect the retained values with their weights
+  typedef std::pair<double, unsigned long> WeightedValue;
+  std::vector<WeightedValue> values;
+  values.reserve(this->GetNumberOfRetainedValues());
+
+  unsigned long total = 0;
+  for(size_t h = 0; h < m_Levels.size(); h++)
+    {
+    unsigned long weight = 1ul << h;
+    for(size_t i = 0; i < m_Levels[h].size(); i++)
+      values.push_back(std::make_pair(m_Levels[h][i], weight));
+    total += weight * m_Levels[h].size();
+    }
+
+  std::sort(values.begin(), values.end());
+
+  // Find the first value whose cumulative weight reaches the quantile
+  double target = q * total;
+  unsigned long accum = 0;
+  for(size_t i = 0; i < values.size(); i++)
+    {
+    accum += values[i].second;
+    if(accum >= target)
+      return values[i].first;
+    }
+
+  return m_Maximum;
+}
@@ -0,0 +1,81 @@
+#ifndef QUANTILESKETCH_H
+#define QUANTILESKETCH_H
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * A mergeable summary of a stream of values that can be used to estimate
+ * their quantiles, i.e., a KLL sketch (Karnin, Lang and Liberty, 2016).
+ *
+ * The values are kept in a stack of buffers (compactors). Each value in the
+ * buffer at level h stands for 2^h of the original values. When the buffers
+ * exceed their capacity, the lowest full buffer is sorted and every other
+ * value in it is promoted to the next level. The capacity of the buffers
+ * decreases geometrically from the top level down, so that the memory used
+ * is O(k) regardless of the number of values, and the rank error is O(1/k).
+ *
+ * Sketches built from different parts of the data, e.g., by different
+ * threads, can be combined with Merge(). Unlike the original algorithm, the
+ * choice of the values promoted during compaction is made by alternating
+ * between the odd and the even values, so the sketch is deterministic.
+ */
+class QuantileSketch
+{
+public:
+
+  /** Create a sketch with the given accuracy parameter */
+  QuantileSketch(unsigned int k = 200);
+
+  /** Remove all values from the sketch */
+  void Clear();
+
+  /** Add a value to the sketch */
+  void Add(double value);
+
+  /** Merge the contents of another sketch into this one */
+  void Merge(const QuantileSketch &other);
+
+  /**
+   * Estimate the value at the given quantile, with q between 0 and 1. The
+   * quantiles 0 and 1 return the exact minimum and maximum. Returns zero if
+   * the sketch is empty.
+   */
+  double GetQuantile(double q) const;
+
+  /** Number of values added to the sketch */
+  unsigned long GetCount() const { return m_Count; }
+
+  /** Exact range of the values added to the sketch */
+  double GetMinimum() const { return m_Minimum; }
+  double GetMaximum() const { return m_Maximum; }
+
+  /** Number of values currently stored in the sketch */
+  size_t GetNumberOfRetainedValues() const;
+
+protected:
+
+  // Capacity of the buffer at a given level
+  size_t GetLevelCapacity(size_t level) const;
+
+  // Total capacity of all the buffers
+  size_t GetTotalCapacity() const;
+
+  // Compact buffers until the sketch is within its capacity
+  void Compress();
+
+  // Accuracy parameter (capacity of the top level)
+  unsigned int m_K;
+
+  // The buffers, from the lowest level up
+  std::vector< std::vector<double> > m_Levels;
+
+  // Parity of the next compaction at each level
+  std::vector<bool> m_Parity;
+
+  // Number of values added and their range
+  unsigned long m_Count;
+  double m_Minimum, m_Maximum;
+};
+
+#endif // QUANTILESKETCH_H
@@ -0,0 +1,107 @@
+#include "SampledIntensityStatistics.h"
+#include "ImageWrapperBase.h"
+#include "ScalarImageHistogram.h"
+#include "NativeIntensityMappingPolicy.h"
+#include <itkImageBase.h>
+#include <algorithm>
+
+SampledIntensityStatistics::SampledIntensityStatistics()
+  : m_Sketch(2000)
+{
+  m_MaximumNumberOfSamples = 65536;
+  m_Wrapper = NULL;
+  m_ImageMTime = 0;
+  m_NativeScale = 1.0;
+  m_NativeShift = 0.0;
+  m_Histogram = ScalarImageHistogram::New();
+  m_HistogramValid = false;
+}
+
+SampledIntensityStatistics::~SampledIntensityStatistics()
+{
+}
+
+void
+SampledIntensityStatistics
+::Update(ImageWrapperBase *wrapper)
+{
+  assert(wrapper);
+
+  // The samples are in native units, so they must be drawn again if the
+  // native mapping changes, as well as when the image is modified
+  const AbstractNativeIntensityMapping *nim = wrapper->GetNativeIntensityMapping();
+  double scale = nim->GetScale(), shift = nim->GetShift();
+  itk::ModifiedTimeType mtime = wrapper->GetImageBase()->GetMTime();
+
+  if(wrapper == m_Wrapper && mtime == m_ImageMTime
+     && scale == m_NativeScale && shift == m_NativeShift)
+    return;
+
+  m_Wrapper = wrapper;
+  m_ImageMTime = mtime;
+  m_NativeScale = scale;
+  m_NativeShift = shift;
+  m_HistogramValid = false;
+
+  // Figure out how many voxels to sample
+  Vector3ui size = wrapper->GetSize();
+  size_t nVoxels = wrapper->GetNumberOfVoxels();
+  size_t nComp = wrapper->GetNumberOfComponents();
+  size_t nSampled = std::max((size_t) 1, (size_t) m_MaximumNumberOfSamples / nComp);
+  nSampled = std::min(nSampled, nVoxels);
+
+  m_Samples.clear();
+  m_Samples.reserve(nSampled * nComp);
+  m_Sketch.Clear();
+
+  // Sample one voxel from each cell of a regular grid over the buffer. The
+  // position in the cell comes from a fixed-seed linear congruential generator
+  double stride = (double) nVoxels / nSampled;
+  unsigned long seed = 12345;
+  std::vector<double> voxel(nComp);
+  for(size_t i = 0; i < nSampled; i++)
+    {
+    seed = seed * 1103515245ul + 12345ul;
+    double jitter = ((seed >> 16) & 0x7fff) / 32768.0;
+    size_t offset = std::min((size_t) ((i + jitter) * stride), nVoxels - 1);
+
+    itk::Index<3> idx;
+    idx[0] = offset % size[0];
+    idx[1] = (offset / size[0]) % size[1];
+    idx[2] = offset / ((size_t) size[0] * size[1]);
+
+    wrapper->GetVoxelMappedToNative(idx, &voxel[0]);
+    for(size_t c = 0; c < nComp; c++)
+      {
+      m_Samples.push_back(voxel[c]);
+      m_Sketch.Add(voxel[c]);
+      }
+    }
+
+  this->Modified();
+}
+
+const ScalarImageHistogram *
+SampledIntensityStatistics
+::GetHistogram(size_t nBins)
+{
+  if(nBins == 0)
+    nBins = m_Histogram->GetSize() ? m_Histogram->GetSize() : 128;
+
+  if(!m_HistogramValid || nBins != m_Histogram->GetSize())
+    {
+    // The bins span the range of the samples, so that no full pass through
+    // the image is needed to find the range of the layer
+    double hmin = m_Sketch.GetMinimum(), hmax = m_Sketch.GetMaximum();
+    if(!(hmax > hmin))
+      hmax = hmin + 1.0;
+    m_Histogram->Initialize(hmin, hmax, nBins);
+    for(size_t i = 0; i < m_Samples.size(); i++)
+      m_Histogram->AddSample(m_Samples[i]);
+
+    m_Histogram->Modified();
+    m_HistogramValid = true;
+    }
+
+  return m_Histogram;
+}
@@ -0,0 +1,78 @@
+#ifndef SAMPLEDINTENSITYSTATISTICS_H
+#define SAMPLEDINTENSITYSTATISTICS_H
+
+#include "SNAPCommon.h"
+#include "QuantileSketch.h"
+#include <itkObject.h>
+#include <itkObjectFactory.h>
+#include <vector>
+
+class ImageWrapperBase;
+class ScalarImageHistogram;
+
+/**
+ * Approximate intensity statistics of an image layer, computed from a
+ * sample of its voxels. This is the fast counterpart to the histogram that
+ * the layer computes from all of its voxels (ImageWrapperBase::GetHistogram),
+ * and is meant to be used where that histogram is needed before it has been
+ * computed, e.g., to set the contrast of a layer when it is loaded.
+ *
+ * The voxels are sampled on a regular grid in the voxel buffer with a random
+ * (but reproducible) jitter within each grid cell. For multi-component
+ * layers, all the components of the sampled voxels are pooled, as in the
+ * pooled histogram. The samples are summarized by a QuantileSketch, and can
+ * also be binned into a histogram over the range of the samples.
+ *
+ * The samples are only drawn again when the layer, its image or its native
+ * intensity mapping changes. This is checked without touching the voxels or
+ * the statistics of the layer, which may not have been computed yet.
+ */
+class SampledIntensityStatistics : public itk::Object
+{
+public:
+  irisITKObjectMacro(SampledIntensityStatistics, itk::Object)
+
+  /** Number of intensity values to sample (default 65536) */
+  irisGetSetMacro(MaximumNumberOfSamples, unsigned long)
+
+  /** Sample the layer, unless it has not changed since the last call */
+  void Update(ImageWrapperBase *wrapper);
+
+  /** Get the sketch of the sampled intensities (in native units) */
+  const QuantileSketch &GetSketch() const { return m_Sketch; }
+
+  /** Estimate an intensity quantile of the layer, q between 0 and 1 */
+  double GetQuantile(double q) const { return m_Sketch.GetQuantile(q); }
+
+  /** Number of intensity values sampled */
+  unsigned long GetNumberOfSamples() const { return m_Samples.size(); }
+
+  /**
+   * Get the histogram of the samples. The histogram spans the range of the
+   * sampled intensities, which is within the native intensity range of the
+   * layer. If nBins is zero, the number of bins of the last call is used (or
+   * the default of 128).
+   */
+  const ScalarImageHistogram *GetHistogram(size_t nBins);
+
+protected:
+  SampledIntensityStatistics();
+  virtual ~SampledIntensityStatistics();
+
+  unsigned long m_MaximumNumberOfSamples;
+
+  // The layer that was sampled, and its state at the time
+  ImageWrapperBase *m_Wrapper;
+  itk::ModifiedTimeType m_ImageMTime;
+  double m_NativeScale, m_NativeShift;
+
+  // The sampled intensities and their summary
+  std::vector<double> m_Samples;
+  QuantileSketch m_Sketch;
+
+  // Histogram of the samples, and whether it is current
+  SmartPtr<ScalarImageHistogram> m_Histogram;
+  bool m_HistogramValid;
+};
+
+#endif // SAMPLEDINTENSITYSTATISTICS_H
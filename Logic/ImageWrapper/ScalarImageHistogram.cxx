@@ -120,7 +120,11 @@ double ScalarImageHistogram::GetReasonableDisplayCutoff(double quantile, double
   return cutoff_rnd;
 }
 
-
-
-
-
+bool
+ScalarImageHistogram
+::IsUpToDate()
+{
+  // This computes the pipeline time without generating any data
+  this->UpdateOutputInformation();
+  return m_TotalSamples > 0 && this->GetUpdateMTime() >= this->GetPipelineMTime();
+}
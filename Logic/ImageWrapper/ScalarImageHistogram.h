@@ -51,6 +51,14 @@ public:
    */
   double GetReasonableDisplayCutoff(double quantile=0.95, double quantile_height=0.80) const;
 
+  /**
+   * Check whether the histogram is current with respect to the pipeline that
+   * produces it, i.e., whether calling Update() would not execute any of the
+   * filters. Only the modification times are propagated up the pipeline, so
+   * this is cheap to call.
+   */
+  bool IsUpToDate();
+
   irisGetMacro(MaxFrequency, unsigned long)
   irisGetMacro(TotalSamples, unsigned long)
   irisGetMacro(BinWidth, double)
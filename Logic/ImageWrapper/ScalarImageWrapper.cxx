@@ -121,8 +121,8 @@ ScalarImageWrapper<TTraits,TBase>
 
   // Update the histogram mini-pipeline
   m_HistogramFilter->SetInput(newImage);
-  m_HistogramFilter->SetRangeInputs(m_MinMaxFilter->GetMinimumOutput(),
-                                    m_MinMaxFilter->GetMaximumOutput());
+  m_HistogramFilter->SetRangeInputs(this->GetImageMinObject(),
+                                    this->GetImageMaxObject());
 
   // Set the number of bins to default
   m_HistogramFilter->SetNumberOfBins(DEFAULT_HISTOGRAM_BINS);
@@ -156,8 +156,11 @@ ScalarImageWrapper<TTraits,TBase>
 
   // Check if the image has been updated since the last time that
   // the min/max has been computed
-  m_MinMaxFilter->Update();
-  m_ImageScaleFactor = 1.0 / (m_MinMaxFilter->GetMaximum() - m_MinMaxFilter->GetMinimum());
+  ComponentTypeObject *imin = this->GetImageMinObject();
+  ComponentTypeObject *imax = this->GetImageMaxObject();
+  imin->Update();
+  imax->Update();
+  m_ImageScaleFactor = 1.0 / (imax->Get() - imin->Get());
 }
 
 template<class TTraits, class TBase>
@@ -165,6 +168,8 @@ typename ScalarImageWrapper<TTraits,TBase>::ComponentTypeObject *
 ScalarImageWrapper<TTraits,TBase>
 ::GetImageMinObject() const
 {
+  if(m_ExternalMin)
+    return m_ExternalMin;
   return m_MinMaxFilter->GetMinimumOutput();
 }
 
@@ -173,9 +178,23 @@ typename ScalarImageWrapper<TTraits,TBase>::ComponentTypeObject *
 ScalarImageWrapper<TTraits,TBase>
 ::GetImageMaxObject() const
 {
+  if(m_ExternalMax)
+    return m_ExternalMax;
   return m_MinMaxFilter->GetMaximumOutput();
 }
 
+template<class TTraits, class TBase>
+void
+ScalarImageWrapper<TTraits,TBase>
+::SetExternalStatistics(ComponentTypeObject *imageMin,
+                        ComponentTypeObject *imageMax,
+                        ScalarImageHistogram *histogram)
+{
+  m_ExternalMin = imageMin;
+  m_ExternalMax = imageMax;
+  m_ExternalHistogram = histogram;
+}
+
 template<class TTraits, class TBase>
 double
 ScalarImageWrapper<TTraits,TBase>
@@ -187,7 +206,7 @@ ScalarImageWrapper<TTraits,TBase>
   // wrappers that wrap around ImageAdapter objects.
   //
   // I hope this does not cause too much trouble...
-  return m_MinMaxFilter->GetMaximum() - m_MinMaxFilter->GetMinimum();
+  return this->GetImageMaxObject()->Get() - this->GetImageMinObject()->Get();
 }
 
 template<class TTraits, class TBase>
@@ -414,6 +433,29 @@ ScalarImageWrapper<TTraits,TBase>
   out_appearance = this->m_DisplayMapping->MapPixel(pix_raw);
 }
 
+template<class TTraits, class TBase>
+void
+ScalarImageWrapper<TTraits,TBase>
+::SampleDisplayedValueAndAppearance(
+    const itk::Index<3> *index, unsigned int n,
+    vnl_vector<double> *out_value, DisplayPixelType *out_appearance)
+{
+  if(n == 0)
+    return;
+
+  // Look up all the intensities at once
+  std::vector<typename SlicerType::OutputPixelType> pix_raw(n);
+  this->m_Slicer[0]->LookupIntensitiesAtReferenceIndices(
+        this->m_ReferenceSpace, index, n, &pix_raw[0]);
+
+  for(unsigned int i = 0; i < n; i++)
+    {
+    out_value[i].set_size(1);
+    out_value[i][0] = this->m_NativeMapping(pix_raw[i]);
+    out_appearance[i] = this->m_DisplayMapping->MapPixel(pix_raw[i]);
+    }
+}
+
 //template<class TTraits, class TBase>
 //void
 //ScalarImageWrapper<TTraits,TBase>
@@ -491,6 +533,14 @@ const ScalarImageHistogram *
 ScalarImageWrapper<TTraits,TBase>
 ::GetHistogram(size_t nBins)
 {
+  // Use the shared histogram if it has the requested number of bins
+  if(m_ExternalHistogram)
+    {
+    m_ExternalHistogram->Update();
+    if(nBins == 0 || nBins == m_ExternalHistogram->GetSize())
+      return m_ExternalHistogram;
+    }
+
   // If the user passes in a non-zero number of bins, we pass that as a
   // parameter to the filter
   if(nBins > 0)
@@ -500,6 +550,23 @@ ScalarImageWrapper<TTraits,TBase>
   return m_HistogramFilter->GetHistogramOutput();
 }
 
+template<class TTraits, class TBase>
+bool
+ScalarImageWrapper<TTraits,TBase>
+::IsHistogramUpToDate(size_t nBins)
+{
+  // The shared histogram is used if it has the requested number of bins
+  if(m_ExternalHistogram && m_ExternalHistogram->IsUpToDate()
+     && (nBins == 0 || nBins == m_ExternalHistogram->GetSize()))
+    return true;
+
+  ScalarImageHistogram *hist = m_HistogramFilter->GetHistogramOutput();
+  if(nBins > 0 && nBins != hist->GetSize())
+    return false;
+
+  return hist->IsUpToDate();
+}
+
 template<class TTraits, class TBase>
 void
 ScalarImageWrapper<TTraits, TBase>
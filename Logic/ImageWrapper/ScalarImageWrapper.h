@@ -197,10 +197,25 @@ public:
   virtual void GetVoxelUnderCursorDisplayedValueAndAppearance(
       vnl_vector<double> &out_value, DisplayPixelType &out_appearance) ITK_OVERRIDE;
 
+  virtual void SampleDisplayedValueAndAppearance(
+      const itk::Index<3> *index, unsigned int n,
+      vnl_vector<double> *out_value, DisplayPixelType *out_appearance) ITK_OVERRIDE;
+
   virtual ComponentTypeObject *GetImageMinObject() const ITK_OVERRIDE;
 
   virtual ComponentTypeObject *GetImageMaxObject() const ITK_OVERRIDE;
 
+  /**
+   * Use the intensity range and histogram computed by another filter instead
+   * of the wrapper's own min/max and histogram filters. This is used for the
+   * scalar representations of multi-component images, whose statistics are
+   * all computed at once by MultiComponentImageStatisticsFilter. Must be
+   * called before the image is assigned to the wrapper.
+   */
+  void SetExternalStatistics(ComponentTypeObject *imageMin,
+                             ComponentTypeObject *imageMax,
+                             ScalarImageHistogram *histogram);
+
   /**
     Compute the image histogram. The histogram is cached inside of the
     object, so repeated calls to this function with the same nBins parameter
@@ -215,6 +230,9 @@ public:
     */
   const ScalarImageHistogram *GetHistogram(size_t nBins = 0) ITK_OVERRIDE;
 
+  /** Check whether the histogram has been computed for the current image */
+  bool IsHistogramUpToDate(size_t nBins) ITK_OVERRIDE;
+
   /**
     Get the maximum possible value of the gradient magnitude. This will
     compute the gradient magnitude of the image (without Gaussian smoothing)
@@ -298,6 +316,14 @@ protected:
    */
   SmartPtr<HistogramFilterType> m_HistogramFilter;
 
+  /**
+   * Range and histogram provided by SetExternalStatistics(), if any. The
+   * histogram filter above is still used when a histogram with a different
+   * number of bins is requested.
+   */
+  SmartPtr<ComponentTypeObject> m_ExternalMin, m_ExternalMax;
+  SmartPtr<ScalarImageHistogram> m_ExternalHistogram;
+
   // The policy used to extract a common representation image
   typedef typename TTraits::CommonRepresentationPolicy CommonRepresentationPolicy;
   CommonRepresentationPolicy m_CommonRepresentationPolicy;
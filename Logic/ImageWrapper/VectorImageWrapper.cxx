@@ -25,8 +25,8 @@
 #include "itkCommand.h"
 #include "ImageWrapperTraits.h"
 #include "itkVectorImageToImageAdaptor.h"
-#include "itkMinimumMaximumImageFilter.h"
-#include "ThreadedHistogramImageFilter.h"
+#include "MultiComponentImageStatisticsFilter.h"
+#include "MultiComponentImageHistogramFilter.h"
 #include "ScalarImageHistogram.h"
 #include "Rebroadcaster.h"
 #include "UnaryFunctorVectorImageFilter.h"
@@ -42,18 +42,23 @@ template <class TTraits, class TBase>
 VectorImageWrapper<TTraits,TBase>
 ::VectorImageWrapper()
 {
-  // Initialize the flattened image
-  m_FlatImage = NULL;
-
-  // Initialize the filters
-  m_MinMaxFilter = MinMaxFilterType::New();
+  // Initialize the statistics filters
+  m_StatisticsFilter = StatisticsFilterType::New();
   m_HistogramFilter = HistogramFilterType::New();
+
+  // Materialize derived quantities that take up to 1GB
+  m_MaterializationMemoryLimit = 1024ul * 1024ul * 1024ul;
+  m_ImageModifiedObserverTag = 0;
+  for(int i = 0; i < NUMBER_OF_SCALAR_REPS; i++)
+    m_MaterializedMTime[i] = 0;
 }
 
 template <class TTraits, class TBase>
 VectorImageWrapper<TTraits,TBase>
 ::~VectorImageWrapper()
 {
+  if(this->m_Image && m_ImageModifiedObserverTag)
+    this->m_Image->RemoveObserver(m_ImageModifiedObserverTag);
 }
 
 
@@ -135,6 +140,42 @@ VectorImageWrapper<TTraits,TBase>
     }
 }
 
+template<class TTraits, class TBase>
+void
+VectorImageWrapper<TTraits,TBase>
+::SampleDisplayedValueAndAppearance(
+    const itk::Index<3> *index, unsigned int n,
+    vnl_vector<double> *out_value, DisplayPixelType *out_appearance)
+{
+  if(n == 0)
+    return;
+
+  // Same logic as in GetVoxelUnderCursorDisplayedValueAndAppearance
+  MultiChannelDisplayMode mode = this->m_DisplayMapping->GetDisplayMode();
+  if(mode.UseRGB || mode.RenderAsGrid)
+    {
+    // Look up all the intensities at once
+    std::vector<typename SlicerType::OutputPixelType> pixel_value(n);
+    this->m_Slicer[0]->LookupIntensitiesAtReferenceIndices(
+          this->m_ReferenceSpace, index, n, &pixel_value[0]);
+
+    for(unsigned int j = 0; j < n; j++)
+      {
+      out_value[j].set_size(this->GetNumberOfComponents());
+      for(int i = 0; i < this->GetNumberOfComponents(); i++)
+        out_value[j][i] = this->m_NativeMapping(pixel_value[j][i]);
+      out_appearance[j] = this->m_DisplayMapping->MapPixel(pixel_value[j]);
+      }
+    }
+  else
+    {
+    // Just delegate to the scalar wrapper
+    ScalarImageWrapperBase *siw =
+        this->GetScalarRepresentation(mode.SelectedScalarRep, mode.SelectedComponent);
+    siw->SampleDisplayedValueAndAppearance(index, n, out_value, out_appearance);
+    }
+}
+
 
 template <class TTraits, class TBase>
 void
@@ -143,8 +184,12 @@ VectorImageWrapper<TTraits,TBase>
 {
   Superclass::SetNativeMapping(mapping);
 
-  // Propagate the mapping to the histogram
+  // The materialized derived quantities depend on the mapping
+  this->OnImageModified();
+
+  // Propagate the mapping to the histograms and to the derived quantities
   m_HistogramFilter->SetIntensityTransform(mapping.GetScale(), mapping.GetShift());
+  m_StatisticsFilter->SetSourceNativeMapping(mapping.GetScale(), mapping.GetShift());
 
   // Propagate to owned scalar wrappers
   for(ScalarRepIterator it = m_ScalarReps.begin(); it != m_ScalarReps.end(); ++it)
@@ -202,7 +247,8 @@ template <class TTraits, class TBase>
 template <class TFunctor>
 SmartPtr<ScalarImageWrapperBase>
 VectorImageWrapper<TTraits,TBase>
-::CreateDerivedWrapper(ImageType *image, ImageBaseType *refSpace, ITKTransformType *transform)
+::CreateDerivedWrapper(ScalarRepresentation rep, ImageType *image,
+                       ImageBaseType *refSpace, ITKTransformType *transform)
 {
   typedef VectorDerivedQuantityImageWrapperTraits<TFunctor> WrapperTraits;
   typedef typename WrapperTraits::WrapperType DerivedWrapper;
@@ -212,6 +258,12 @@ VectorImageWrapper<TTraits,TBase>
   adaptor->SetImage(image);
 
   SmartPtr<DerivedWrapper> wrapper = DerivedWrapper::New();
+
+  // The statistics of the derived quantity are computed by the shared filter
+  wrapper->SetExternalStatistics(m_StatisticsFilter->GetDerivedMinimumOutput(rep),
+                                 m_StatisticsFilter->GetDerivedMaximumOutput(rep),
+                                 m_HistogramFilter->GetDerivedHistogramOutput(rep));
+
   wrapper->InitializeToWrapper(this, adaptor, refSpace, transform);
 
   // Assign a parent wrapper to the derived wrapper
@@ -230,14 +282,119 @@ VectorImageWrapper<TTraits,TBase>
   return ptrout;
 }
 
+template <class TTraits, class TBase>
+template <class TFunctor>
+void
+VectorImageWrapper<TTraits,TBase>
+::ConnectMaterializedDerivedQuantity(
+    ScalarImageWrapperBase *w, MaterializedDerivedQuantity<TFunctor> *mdq)
+{
+  typedef VectorDerivedQuantityImageWrapperTraits<TFunctor> WrapperTraits;
+  typedef typename WrapperTraits::WrapperType DerivedWrapper;
+
+  DerivedWrapper *dw = dynamic_cast<DerivedWrapper *>(w);
+  dw->GetImage()->GetPixelAccessor().SetMaterialized(mdq);
+}
+
+template <class TTraits, class TBase>
+template <class TFunctor>
+void
+VectorImageWrapper<TTraits,TBase>
+::UpdateMaterializedDerivedQuantity(
+    ScalarRepresentation rep, MaterializedDerivedQuantity<TFunctor> &mdq)
+{
+  typedef VectorDerivedQuantityImageWrapperTraits<TFunctor> WrapperTraits;
+  typedef typename WrapperTraits::WrapperType DerivedWrapper;
+
+  // Nothing to do if the values are current
+  ImageType *image = this->m_Image;
+  if(mdq.IsValid() && m_MaterializedMTime[rep] == image->GetMTime())
+    return;
+
+  // Check that the values fit into the memory limit
+  size_t nVoxels = image->GetBufferedRegion().GetNumberOfPixels();
+  if(nVoxels * sizeof(typename TFunctor::OutputPixelType) > m_MaterializationMemoryLimit)
+    {
+    mdq.Release();
+    return;
+    }
+
+  // Compute using the functor of the derived wrapper's accessor, which has
+  // the vector length and the native mapping of this image
+  DerivedWrapper *dw = dynamic_cast<DerivedWrapper *>(
+        this->GetScalarRepresentation(rep, 0));
+  mdq.Compute(dw->GetImage()->GetPixelAccessor().GetFunctor(),
+              image->GetBufferPointer(),
+              image->GetNumberOfComponentsPerPixel(), nVoxels);
+
+  m_MaterializedMTime[rep] = image->GetMTime();
+}
+
+template <class TTraits, class TBase>
+void
+VectorImageWrapper<TTraits,TBase>
+::MaterializeDerivedQuantity(ScalarRepresentation rep)
+{
+  // Keep only the requested quantity in memory
+  if(rep != SCALAR_REP_MAGNITUDE)
+    m_MaterializedMagnitude.Release();
+  if(rep != SCALAR_REP_MAX)
+    m_MaterializedMax.Release();
+  if(rep != SCALAR_REP_AVERAGE)
+    m_MaterializedMean.Release();
+
+  if(!this->IsInitialized())
+    return;
+
+  if(rep == SCALAR_REP_MAGNITUDE)
+    this->UpdateMaterializedDerivedQuantity(rep, m_MaterializedMagnitude);
+  else if(rep == SCALAR_REP_MAX)
+    this->UpdateMaterializedDerivedQuantity(rep, m_MaterializedMax);
+  else if(rep == SCALAR_REP_AVERAGE)
+    this->UpdateMaterializedDerivedQuantity(rep, m_MaterializedMean);
+}
+
+template <class TTraits, class TBase>
+void
+VectorImageWrapper<TTraits,TBase>
+::ReleaseMaterializedDerivedQuantities()
+{
+  m_MaterializedMagnitude.Release();
+  m_MaterializedMax.Release();
+  m_MaterializedMean.Release();
+}
+
+template <class TTraits, class TBase>
+void
+VectorImageWrapper<TTraits,TBase>
+::OnImageModified()
+{
+  // Keep the memory, since the values will likely be recomputed
+  m_MaterializedMagnitude.Invalidate();
+  m_MaterializedMax.Invalidate();
+  m_MaterializedMean.Invalidate();
+}
+
 template <class TTraits, class TBase>
 void
 VectorImageWrapper<TTraits,TBase>
 ::UpdateImagePointer(ImageType *newImage, ImageBaseType *referenceSpace, ITKTransformType *transform)
 {
+  // The materialized derived quantities belong to the old image
+  if(this->m_Image && m_ImageModifiedObserverTag)
+    this->m_Image->RemoveObserver(m_ImageModifiedObserverTag);
+  this->ReleaseMaterializedDerivedQuantities();
+
   // Create the component wrappers before calling the parent's method.
   int nc = newImage->GetNumberOfComponentsPerPixel();
 
+  // Connect the statistics filters first, since this creates the outputs that
+  // the component and derived wrappers use for their ranges and histograms
+  m_StatisticsFilter->SetInput(newImage);
+  m_HistogramFilter->SetInput(newImage);
+  m_HistogramFilter->SetRangeInputs(m_StatisticsFilter);
+  m_HistogramFilter->SetNumberOfBins(DEFAULT_HISTOGRAM_BINS);
+
   // The first component image will serve as the reference for the other
   // component images
   ComponentWrapperType *cref = NULL;
@@ -253,6 +410,11 @@ VectorImageWrapper<TTraits,TBase>
     // Create a wrapper for this image and assign the component image
     SmartPtr<ComponentWrapperType> cw = ComponentWrapperType::New();
 
+    // The statistics of the component are computed by the shared filter
+    cw->SetExternalStatistics(m_StatisticsFilter->GetComponentMinimumOutput(i),
+                              m_StatisticsFilter->GetComponentMaximumOutput(i),
+                              m_HistogramFilter->GetComponentHistogramOutput(i));
+
     // Pass the display geometry to the component wrapper
     for(int k = 0; k < 3; k++)
       cw->SetDisplayViewportGeometry(k, this->GetDisplayViewportGeometry(k));
@@ -272,31 +434,30 @@ VectorImageWrapper<TTraits,TBase>
     }
 
   m_ScalarReps[std::make_pair(SCALAR_REP_MAGNITUDE, 0)]
-      = this->template CreateDerivedWrapper<MagnitudeFunctor>(newImage, referenceSpace, transform);
+      = this->template CreateDerivedWrapper<MagnitudeFunctor>(
+          SCALAR_REP_MAGNITUDE, newImage, referenceSpace, transform);
 
   m_ScalarReps[std::make_pair(SCALAR_REP_MAX, 0)]
-      = this->template CreateDerivedWrapper<MaxFunctor>(newImage, referenceSpace, transform);
+      = this->template CreateDerivedWrapper<MaxFunctor>(
+          SCALAR_REP_MAX, newImage, referenceSpace, transform);
 
   m_ScalarReps[std::make_pair(SCALAR_REP_AVERAGE, 0)]
-      = this->template CreateDerivedWrapper<MeanFunctor>(newImage, referenceSpace, transform);
-
-  // Create a flat representation of the image
-  m_FlatImage = FlatImageType::New();
-  typename FlatImageType::SizeType flatsize;
-  flatsize[0] = newImage->GetPixelContainer()->Size();
-  m_FlatImage->SetRegions(flatsize);
-  m_FlatImage->SetPixelContainer(newImage->GetPixelContainer());
-
-  // Connect the flat image to the min/max computer
-  m_MinMaxFilter->SetInput(m_FlatImage);
-
-  // Hook up the histogram computer to the flat image and min/max filter
-  m_HistogramFilter->SetInput(m_FlatImage);
-  m_HistogramFilter->SetRangeInputs(m_MinMaxFilter->GetMinimumOutput(),
-                                    m_MinMaxFilter->GetMaximumOutput());
-
-  // Set the number of bins (TODO - how to do this smartly?)
-  m_HistogramFilter->SetNumberOfBins(DEFAULT_HISTOGRAM_BINS);
+      = this->template CreateDerivedWrapper<MeanFunctor>(
+          SCALAR_REP_AVERAGE, newImage, referenceSpace, transform);
+
+  // Let the derived wrappers read the materialized values when available
+  this->ConnectMaterializedDerivedQuantity(
+        m_ScalarReps[std::make_pair(SCALAR_REP_MAGNITUDE, 0)], &m_MaterializedMagnitude);
+  this->ConnectMaterializedDerivedQuantity(
+        m_ScalarReps[std::make_pair(SCALAR_REP_MAX, 0)], &m_MaterializedMax);
+  this->ConnectMaterializedDerivedQuantity(
+        m_ScalarReps[std::make_pair(SCALAR_REP_AVERAGE, 0)], &m_MaterializedMean);
+
+  // Any change to the image makes the materialized values out of date
+  typedef itk::SimpleMemberCommand<Self> CommandType;
+  typename CommandType::Pointer cmd = CommandType::New();
+  cmd->SetCallbackFunction(this, &Self::OnImageModified);
+  m_ImageModifiedObserverTag = newImage->AddObserver(itk::ModifiedEvent(), cmd);
 
   /*
 
@@ -372,6 +533,18 @@ VectorImageWrapper<TTraits,TBase>
   return m_HistogramFilter->GetHistogramOutput();
 }
 
+template<class TTraits, class TBase>
+bool
+VectorImageWrapper<TTraits,TBase>
+::IsHistogramUpToDate(size_t nBins)
+{
+  ScalarImageHistogram *hist = m_HistogramFilter->GetHistogramOutput();
+  if(nBins > 0 && nBins != hist->GetSize())
+    return false;
+
+  return hist->IsUpToDate();
+}
+
 
 template <class TTraits, class TBase>
 inline ScalarImageWrapperBase *
@@ -486,7 +659,7 @@ typename VectorImageWrapper<TTraits,TBase>::ComponentTypeObject *
 VectorImageWrapper<TTraits,TBase>
 ::GetImageMinObject() const
 {
-  return m_MinMaxFilter->GetMinimumOutput();
+  return m_StatisticsFilter->GetMinimumOutput();
 }
 
 template<class TTraits, class TBase>
@@ -494,7 +667,7 @@ typename VectorImageWrapper<TTraits,TBase>::ComponentTypeObject *
 VectorImageWrapper<TTraits,TBase>
 ::GetImageMaxObject() const
 {
-  return m_MinMaxFilter->GetMaximumOutput();
+  return m_StatisticsFilter->GetMaximumOutput();
 }
 
 
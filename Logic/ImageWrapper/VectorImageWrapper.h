@@ -23,11 +23,8 @@
 #include "itkImageAdaptor.h"
 #include "VectorToScalarImageAccessor.h"
 
-template<class TIn> class ThreadedHistogramImageFilter;
-namespace itk
-{
-template<class TIn> class MinimumMaximumImageFilter;
-}
+template<class TIn> class MultiComponentImageStatisticsFilter;
+template<class TIn> class MultiComponentImageHistogramFilter;
 
 /**
  * \class VectorImageWrapper
@@ -214,6 +211,10 @@ public:
   virtual void GetVoxelUnderCursorDisplayedValueAndAppearance(
       vnl_vector<double> &out_value, DisplayPixelType &out_appearance) ITK_OVERRIDE;
 
+  virtual void SampleDisplayedValueAndAppearance(
+      const itk::Index<3> *index, unsigned int n,
+      vnl_vector<double> *out_value, DisplayPixelType *out_appearance) ITK_OVERRIDE;
+
   virtual void SetNativeMapping(NativeIntensityMapping mapping) ITK_OVERRIDE;
 
   virtual void SetSliceIndex(const Vector3ui &cursor) ITK_OVERRIDE;
@@ -240,6 +241,29 @@ public:
     */
   const ScalarImageHistogram *GetHistogram(size_t nBins = 0) ITK_OVERRIDE;
 
+  /** Check whether the histogram has been computed for the current image */
+  bool IsHistogramUpToDate(size_t nBins) ITK_OVERRIDE;
+
+  /**
+    Compute a derived quantity (SCALAR_REP_MAGNITUDE, _MAX or _AVERAGE) for
+    all voxels and keep it in memory, so that the derived wrapper reads these
+    values instead of computing them from the components on every access.
+    This is meant to be called whenever the derived quantity is about to be
+    displayed: the values are only recomputed if the image has changed since
+    the last call. Only one derived quantity is kept in memory at a time, and
+    none if it would take more memory than MaterializationMemoryLimit.
+    */
+  void MaterializeDerivedQuantity(ScalarRepresentation rep);
+
+  /** Free the memory held by the materialized derived quantities */
+  void ReleaseMaterializedDerivedQuantities();
+
+  /**
+    Largest amount of memory, in bytes, used for a materialized derived
+    quantity. Setting this to zero disables materialization.
+    */
+  irisGetSetMacro(MaterializationMemoryLimit, size_t)
+
 
   /**
     This method creates an ITK mini-pipeline that can be used to cast the internal
@@ -292,7 +316,8 @@ protected:
   /** Create a derived wrapper of a certain type */
   template <class TFunctor>
   SmartPtr<ScalarImageWrapperBase> CreateDerivedWrapper(
-      ImageType *image, ImageBaseType *refSpace, ITKTransformType *transform);
+      ScalarRepresentation rep, ImageType *image,
+      ImageBaseType *refSpace, ITKTransformType *transform);
 
   template <class TFunctor>
   void SetNativeMappingInDerivedWrapper(
@@ -307,19 +332,14 @@ protected:
   typedef typename ScalarRepMap::const_iterator ScalarRepConstIterator;
   ScalarRepMap m_ScalarReps;
 
-  // For computing image statistics, we can represent the image as a one-dimensional
-  // image of size n_voxels * n_components. This image can then be fed as input to
-  // the min/max and histogram computation filters. Of course the flat image
-  // shares the buffer with the 3D image so there is no memory waste
-  typedef itk::Image<InternalPixelType, 1>                       FlatImageType;
-  SmartPtr<FlatImageType> m_FlatImage;
-
-  // Min/max filter
-  typedef itk::MinimumMaximumImageFilter<FlatImageType> MinMaxFilterType;
-  SmartPtr<MinMaxFilterType> m_MinMaxFilter;
-
-  // Histogram filter
-  typedef ThreadedHistogramImageFilter<FlatImageType> HistogramFilterType;
+  // Filters that compute the range and the histogram of every component, of
+  // the derived quantities, and of all the components pooled, each in a single
+  // pass through the image. The scalar representations use their outputs
+  // instead of computing their own statistics. The histograms are only
+  // computed when one of them is requested
+  typedef MultiComponentImageStatisticsFilter<ImageType> StatisticsFilterType;
+  typedef MultiComponentImageHistogramFilter<ImageType> HistogramFilterType;
+  SmartPtr<StatisticsFilterType> m_StatisticsFilter;
   SmartPtr<HistogramFilterType> m_HistogramFilter;
 
   // Other derived wrappers
@@ -327,6 +347,32 @@ protected:
   typedef VectorToScalarMaxFunctor<InternalPixelType, float> MaxFunctor;
   typedef VectorToScalarMeanFunctor<InternalPixelType,float> MeanFunctor;
 
+  // Precomputed values of the derived quantities, shared with the accessors
+  // of the derived wrappers' adaptors
+  MaterializedDerivedQuantity<MagnitudeFunctor> m_MaterializedMagnitude;
+  MaterializedDerivedQuantity<MaxFunctor> m_MaterializedMax;
+  MaterializedDerivedQuantity<MeanFunctor> m_MaterializedMean;
+
+  // Modification time of the image when the derived quantity was computed
+  itk::ModifiedTimeType m_MaterializedMTime[NUMBER_OF_SCALAR_REPS];
+
+  size_t m_MaterializationMemoryLimit;
+
+  // Observer tag for the image modifications
+  unsigned long m_ImageModifiedObserverTag;
+
+  // Invalidate the materialized quantities when the image is modified
+  void OnImageModified();
+
+  // Compute one of the derived quantities, if it is out of date
+  template <class TFunctor>
+  void UpdateMaterializedDerivedQuantity(
+      ScalarRepresentation rep, MaterializedDerivedQuantity<TFunctor> &mdq);
+
+  // Connect the derived wrapper's accessor to the materialized values
+  template <class TFunctor>
+  void ConnectMaterializedDerivedQuantity(
+      ScalarImageWrapperBase *w, MaterializedDerivedQuantity<TFunctor> *mdq);
 };
 
 #endif // __VectorImageWrapper_h_
@@ -2,6 +2,8 @@
 #define VECTORTOSCALARIMAGEACCESSOR_H
 
 #include "itkDefaultVectorPixelAccessor.h"
+#include <vector>
+#include <cstddef>
 
 namespace itk
 {
@@ -9,6 +11,90 @@ template <class TImage, class TAccessor> class ImageAdaptor;
 template <class TPixel, unsigned int Vdim> class VectorImage;
 }
 
+/**
+ * The values of a derived quantity (e.g., magnitude) computed ahead of time
+ * for every voxel of a vector image buffer. When such an object is assigned to
+ * the accessor below and is valid, the accessor looks up the values instead
+ * of computing them from the components, so that slicing and voxel access
+ * cost the same as for a scalar image.
+ *
+ * The object does not track changes to the source image. Its owner must call
+ * Invalidate() or Release() when the image or the functor parameters change.
+ */
+template <class TFunctor>
+class MaterializedDerivedQuantity
+{
+public:
+  typedef typename TFunctor::InputPixelType InternalType;
+  typedef typename TFunctor::OutputPixelType ExternalType;
+
+  MaterializedDerivedQuantity()
+    : m_Source(NULL), m_Length(1), m_InverseLength(1.0), m_Valid(false) {}
+
+  /**
+   * Compute the quantity for each voxel of a buffer holding nVoxels vectors
+   * of the given length. The computation is parallelized with OpenMP.
+   */
+  void Compute(const TFunctor &functor, const InternalType *source,
+               unsigned int length, size_t nVoxels)
+    {
+    m_Values.resize(nVoxels);
+    ExternalType *out = m_Values.empty() ? NULL : &m_Values[0];
+
+#pragma omp parallel for
+    for(long i = 0; i < (long) nVoxels; i++)
+      out[i] = functor.Get(source + i * length, length);
+
+    m_Source = source;
+    m_Length = length;
+    m_InverseLength = 1.0 / length;
+    m_Valid = true;
+    }
+
+  /** Mark the values as out of date, keeping the memory for reuse */
+  void Invalidate() { m_Valid = false; }
+
+  /** Mark the values as out of date and free the memory */
+  void Release()
+    {
+    m_Valid = false;
+    std::vector<ExternalType>().swap(m_Values);
+    }
+
+  bool IsValid() const { return m_Valid; }
+
+  /** Memory used by the values, in bytes */
+  size_t GetMemorySize() const { return m_Values.capacity() * sizeof(ExternalType); }
+
+  /**
+   * Look up the value of the voxel whose first component is at address p.
+   * Returns false if p does not point to a voxel in the source buffer (e.g.,
+   * for an interpolated vector)
+   */
+  inline bool Get(const InternalType *p, ExternalType &value) const
+    {
+    std::ptrdiff_t d = p - m_Source;
+    if(d < 0)
+      return false;
+
+    // The offset is an exact multiple of the length, so rounding the product
+    // with the reciprocal is exact and avoids an integer division
+    size_t k = static_cast<size_t>(d * m_InverseLength + 0.5);
+    if(k >= m_Values.size() || k * m_Length != (size_t) d)
+      return false;
+
+    value = m_Values[k];
+    return true;
+    }
+
+protected:
+  std::vector<ExternalType> m_Values;
+  const InternalType *m_Source;
+  unsigned int m_Length;
+  double m_InverseLength;
+  bool m_Valid;
+};
+
 /**
  * An accessor very similar to itk::VectorImageToImageAccessor that allows us
  * to extract certain computed quantities from the vectors, such as magnitude
@@ -24,6 +110,9 @@ public:
   typedef itk::SizeValueType SizeValueType;
   typedef itk::VariableLengthVector<ExternalType> ActualPixelType;
   typedef unsigned int VectorLengthType;
+  typedef MaterializedDerivedQuantity<TFunctor> MaterializedType;
+
+  VectorToScalarImageAccessor() : m_Materialized(NULL) {}
 
   inline void Set(ActualPixelType output, const ExternalType &input) const
     { output.Fill(input); }
@@ -33,14 +122,29 @@ public:
     { Set( Superclass::Get(output, offset), input); }
 
   inline ExternalType Get(const ActualPixelType &input) const
-    { return m_Functor.Get(input); }
+    {
+    ExternalType value;
+    if(m_Materialized && m_Materialized->IsValid()
+       && m_Materialized->Get(input.GetDataPointer(), value))
+      return value;
+    return m_Functor.Get(input);
+    }
 
   inline ExternalType Get(const InternalType *incomp) const
     { return m_Functor.Get(incomp, Superclass::GetVectorLength()); }
 
   inline ExternalType Get(const InternalType &input,
                           const SizeValueType offset) const
-    { return Get(Superclass::Get(input, offset)); }
+    {
+    // This is the access path used by iterators and the slicer. The vector
+    // returned by the parent class points into the image buffer, so the
+    // components can be passed to the functor without making a copy
+    const InternalType *p = Superclass::Get(input, offset).GetDataPointer();
+    ExternalType value;
+    if(m_Materialized && m_Materialized->IsValid() && m_Materialized->Get(p, value))
+      return value;
+    return m_Functor.Get(p, Superclass::GetVectorLength());
+    }
 
   void SetVectorLength(VectorLengthType l)
     {
@@ -62,8 +166,19 @@ public:
     m_Functor.SetSourceNativeMapping(scale, shift);
   }
 
+  /** Get the functor that computes the derived quantity */
+  const TFunctor &GetFunctor() const { return m_Functor; }
+
+  /**
+   * Set the precomputed values of the derived quantity, or NULL to always
+   * compute the quantity from the components. The object must outlive the
+   * accessor and its copies.
+   */
+  void SetMaterialized(const MaterializedType *m) { m_Materialized = m; }
+
 protected:
   TFunctor m_Functor;
+  const MaterializedType *m_Materialized;
 };
 
 /**
@@ -0,0 +1,215 @@
+/*=========================================================================
+
+  Program:   ITK-SNAP
+  Language:  C++
+  Copyright (c) 2007 Paul A. Yushkevich
+
+  This file is part of ITK-SNAP
+
+  ITK-SNAP is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+=========================================================================*/
+#ifndef __SNAPBlockedNarrowBandLevelSetFilter_h_
+#define __SNAPBlockedNarrowBandLevelSetFilter_h_
+
+#include "itkFiniteDifferenceImageFilter.h"
+#include "SNAPLevelSetFunction.h"
+#include <vector>
+#include <utility>
+
+/**
+ * \class SNAPBlockedNarrowBandLevelSetFilter
+ * \brief A level set solver that evolves a sparse field narrow band stored
+ * in fixed-size blocks, evaluating the SNAP level set equation in batches.
+ *
+ * The filter follows the sparse field method of Whitaker, as implemented in
+ * itk::ParallelSparseFieldLevelSetImageFilter: the equation is solved on the
+ * active layer (the voxels nearest to the zero level set), and a number of
+ * layers on either side of it are kept at approximate signed distance values.
+ *
+ * The difference is in how the narrow band is organized and evaluated. The
+ * image is divided into blocks of BlockSize voxels along each dimension, and
+ * each block keeps the list of its active layer voxels. Blocks are processed
+ * in parallel. Within a block, the finite differences for all active voxels
+ * are first gathered into structure-of-arrays buffers, and the curvature,
+ * advection, propagation and Laplacian terms are then computed in a single
+ * loop over these buffers. The speed and advection images are read directly
+ * from the SNAPLevelSetFunction, so there are no virtual calls per voxel.
+ *
+ * Moves of voxels between layers are done in a fixed number of block-parallel
+ * passes per iteration, and the layers are rebuilt from the active layer
+ * after each update. Results agree with ParallelSparseFieldLevelSetImageFilter
+ * up to the order in which conflicting moves of neighboring active voxels are
+ * resolved: here, two neighbors moving in opposite directions both stay put.
+ */
+template <class TImage, class TSpeedImage>
+class ITK_EXPORT SNAPBlockedNarrowBandLevelSetFilter
+  : public itk::FiniteDifferenceImageFilter<TImage, TImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef SNAPBlockedNarrowBandLevelSetFilter                   Self;
+  typedef itk::FiniteDifferenceImageFilter<TImage, TImage> Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                 ConstPointer;
+
+  /** Run-time type information. */
+  itkTypeMacro(SNAPBlockedNarrowBandLevelSetFilter,
+               itk::FiniteDifferenceImageFilter)
+
+  /** New object of this type */
+  itkNewMacro(Self)
+
+  /** Image dimension */
+  itkStaticConstMacro(ImageDimension, unsigned int, TImage::ImageDimension);
+
+  /** Image types */
+  typedef TImage                                             ImageType;
+  typedef typename ImageType::PixelType                      ValueType;
+  typedef TSpeedImage                                   SpeedImageType;
+
+  /** The level set function whose parameters are used by this filter */
+  typedef SNAPLevelSetFunction<SpeedImageType, ImageType>
+                                                  LevelSetFunctionType;
+  typedef typename LevelSetFunctionType::VectorImageType
+                                                       VectorImageType;
+  typedef typename LevelSetFunctionType::VectorType         VectorType;
+
+  typedef typename Superclass::TimeStepType               TimeStepType;
+
+  /** Number of voxels along each side of a block */
+  itkStaticConstMacro(BlockSize, unsigned int, 8);
+
+  /** Set the level set function. This also sets the difference function of
+    the parent class, which is used to compute the time step */
+  void SetLevelSetFunction(LevelSetFunctionType *function);
+
+  /** Set the number of layers on each side of the active layer */
+  itkSetMacro(NumberOfLayers, unsigned int)
+  itkGetConstMacro(NumberOfLayers, unsigned int)
+
+protected:
+  SNAPBlockedNarrowBandLevelSetFilter();
+  ~SNAPBlockedNarrowBandLevelSetFilter() {}
+  void PrintSelf(std::ostream &s, itk::Indent indent) const ITK_OVERRIDE;
+
+  /** The filter always produces the entire output */
+  void EnlargeOutputRequestedRegion(itk::DataObject *output) ITK_OVERRIDE;
+
+  /** Copy the initial level set to the output */
+  void CopyInputToOutput() ITK_OVERRIDE;
+
+  /** Construct the active layer and the layers around it */
+  void Initialize() ITK_OVERRIDE;
+
+  /** Updates are stored per block, so there is no update buffer */
+  void AllocateUpdateBuffer() ITK_OVERRIDE {}
+
+  /** Compute the update for each active layer voxel, return the time step */
+  TimeStepType CalculateChange() ITK_OVERRIDE;
+
+  /** Apply the updates and rebuild the layers */
+  void ApplyUpdate(const TimeStepType &dt) ITK_OVERRIDE;
+
+private:
+  SNAPBlockedNarrowBandLevelSetFilter(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+
+  // Status codes stored for each voxel. Layers are numbered by their distance
+  // from the active layer, positive outside and negative inside
+  enum StatusCode {
+    STATUS_ACTIVE = 0,
+    STATUS_CHANGING_UP = 100,
+    STATUS_CHANGING_DOWN = -100,
+    STATUS_UNASSIGNED = 127
+  };
+
+  // Data kept for each block of the image
+  struct Block
+  {
+    // Block-local indices of the active layer voxels
+    std::vector<unsigned short> m_Active;
+
+    // Update for each active voxel, replaced by its new value in ApplyUpdate
+    std::vector<ValueType> m_Update;
+
+    // Direction in which each active voxel is leaving the active layer
+    std::vector<signed char> m_Move;
+
+    // Voxels whose status changes in the current pass, with their values
+    std::vector<std::pair<unsigned short, ValueType> > m_Pending;
+
+    // Largest change due to each term of the equation
+    double m_MaxCurvatureChange, m_MaxAdvectionChange, m_MaxPropagationChange;
+
+    // Statistics for the RMS change
+    double m_SumSquaredChange;
+    long m_UpdateCount;
+  };
+
+  // Geometry of the image and of the block grid
+  long m_Size[ImageDimension], m_Stride[ImageDimension];
+  long m_BlockGridSize[ImageDimension], m_NumberOfBlocks;
+
+  // Derivative scaling factors (inverse spacing, or one)
+  ValueType m_Scale[ImageDimension];
+
+  // Status of each voxel
+  std::vector<signed char> m_Status;
+
+  // The blocks, and the list of blocks that make up the narrow band
+  std::vector<Block> m_Blocks;
+  std::vector<long> m_BandBlocks;
+  std::vector<char> m_BlockFlag;
+
+  // The function that supplies the speed and the weights
+  typename LevelSetFunctionType::Pointer m_LevelSetFunction;
+
+  unsigned int m_NumberOfLayers;
+
+  /** Compute the image coordinates and the buffer offset of a voxel given by
+    its block and its block-local index. Returns false if the voxel is outside
+    of the image (blocks on the edge of the image are partially filled) */
+  bool GetVoxel(long block, unsigned int local, long *coord, long &offset) const;
+
+  /** Compute the updates for the active voxels in one block */
+  void ComputeBlockUpdate(long block, std::vector<ValueType> &scratch);
+
+  /** Find the blocks that contain active voxels, together with their
+    neighbors, and rebuild the layers in these blocks */
+  void RebuildLayers();
+
+  /** Raise the speed to the exponent of one of the terms */
+  static ValueType SpeedPower(ValueType speed, int exponent)
+    {
+    switch(exponent)
+      {
+      case 0 : return 1;
+      case 1 : return speed;
+      case 2 : return speed * speed;
+      case 3 : return speed * speed * speed;
+      default : return static_cast<ValueType>(pow(speed, exponent));
+      }
+    }
+
+  /** Apply the pending changes in a block, setting the status of the voxels
+    to the given value and appending them to the active list if it is zero */
+  void ApplyPending(long block, int status);
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "SNAPBlockedNarrowBandLevelSetFilter.txx"
+#endif
+
+#endif // __SNAPBlockedNarrowBandLevelSetFilter_h_
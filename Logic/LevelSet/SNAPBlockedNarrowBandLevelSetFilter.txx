@@ -0,0 +1,881 @@
+/*=========================================================================
+
+  Program:   ITK-SNAP
+  Language:  C++
+  Copyright (c) 2007 Paul A. Yushkevich
+
+  This file is part of ITK-SNAP
+
+  ITK-SNAP is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+=========================================================================*/
+#ifndef __SNAPBlockedNarrowBandLevelSetFilter_txx_
+#define __SNAPBlockedNarrowBandLevelSetFilter_txx_
+
+#include "SNAPBlockedNarrowBandLevelSetFilter.h"
+#include <algorithm>
+#include <cmath>
+
+template <class TImage, class TSpeedImage>
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::SNAPBlockedNarrowBandLevelSetFilter()
+{
+  m_NumberOfLayers = 3;
+  m_NumberOfBlocks = 0;
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    {
+    m_Size[d] = m_Stride[d] = m_BlockGridSize[d] = 0;
+    m_Scale[d] = 1;
+    }
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::SetLevelSetFunction(LevelSetFunctionType *function)
+{
+  m_LevelSetFunction = function;
+  this->SetDifferenceFunction(function);
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::EnlargeOutputRequestedRegion(itk::DataObject *output)
+{
+  // The level set is always computed over the whole image
+  Superclass::EnlargeOutputRequestedRegion(output);
+  ImageType *image = dynamic_cast<ImageType *>(output);
+  if(image)
+    image->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::CopyInputToOutput()
+{
+  const ImageType *input = this->GetInput();
+  ImageType *output = this->GetOutput();
+
+  // Copy the input buffer; the regions of input and output are the same
+  const ValueType *src = input->GetBufferPointer();
+  std::copy(src, src + input->GetBufferedRegion().GetNumberOfPixels(),
+            output->GetBufferPointer());
+}
+
+template <class TImage, class TSpeedImage>
+inline bool
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::GetVoxel(long block, unsigned int local, long *coord, long &offset) const
+{
+  offset = 0;
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    {
+    long bd = block % m_BlockGridSize[d];
+    block /= m_BlockGridSize[d];
+    coord[d] = bd * BlockSize + ((local >> (3 * d)) & (BlockSize - 1));
+    if(coord[d] >= m_Size[d])
+      return false;
+    offset += coord[d] * m_Stride[d];
+    }
+  return true;
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::Initialize()
+{
+  ImageType *output = this->GetOutput();
+  ValueType *phi = output->GetBufferPointer();
+
+  // Image and block geometry. The block-local index uses three bits per
+  // dimension, so BlockSize must remain 8
+  long nVoxels = 1;
+  m_NumberOfBlocks = 1;
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    {
+    m_Size[d] = output->GetBufferedRegion().GetSize()[d];
+    m_Stride[d] = nVoxels;
+    nVoxels *= m_Size[d];
+    m_BlockGridSize[d] = (m_Size[d] + BlockSize - 1) / BlockSize;
+    m_NumberOfBlocks *= m_BlockGridSize[d];
+    m_Scale[d] = this->GetUseImageSpacing()
+        ? static_cast<ValueType>(1.0 / output->GetSpacing()[d]) : 1;
+    }
+
+  unsigned int blockVolume = 1;
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    blockVolume *= BlockSize;
+
+  m_Blocks.clear();
+  m_Blocks.resize(m_NumberOfBlocks);
+  m_BlockFlag.assign(m_NumberOfBlocks, 0);
+  m_BandBlocks.clear();
+  m_Status.assign(nVoxels, 0);
+
+  const ValueType CHANGE_FACTOR = 0.5;
+  ValueType MIN_NORM = 1.0e-6;
+  if(this->GetUseImageSpacing())
+    {
+    double minSpacing = output->GetSpacing()[0];
+    for(unsigned int d = 1; d < ImageDimension; d++)
+      minSpacing = std::min(minSpacing, (double) output->GetSpacing()[d]);
+    MIN_NORM *= minSpacing;
+    }
+
+  // Find the voxels at the zero crossing of the initial level set. The rule
+  // for breaking ties between voxels of equal magnitude and opposite sign
+  // is the same as in itk::ZeroCrossingImageFilter: the voxel is on the zero
+  // crossing if its opposite neighbor lies in the positive direction. The
+  // value of each such voxel is its distance to the zero crossing, estimated
+  // as in the sparse field filters. This pass only reads the level set.
+  int nThreads = this->GetNumberOfThreads();
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long b = 0; b < m_NumberOfBlocks; b++)
+    {
+    Block &block = m_Blocks[b];
+    long coord[ImageDimension], o;
+    for(unsigned int l = 0; l < blockVolume; l++)
+      {
+      if(!GetVoxel(b, l, coord, o))
+        continue;
+
+      ValueType center = phi[o];
+      bool crossing = false;
+      for(unsigned int i = 0; i < 2 * ImageDimension && !crossing; i++)
+        {
+        unsigned int d = i % ImageDimension;
+        bool fwd = i >= ImageDimension;
+        if(fwd ? coord[d] + 1 >= m_Size[d] : coord[d] == 0)
+          continue;
+        ValueType that = phi[fwd ? o + m_Stride[d] : o - m_Stride[d]];
+        if((center < 0 && that > 0) || (center > 0 && that < 0)
+           || (center == 0 && that != 0) || (center != 0 && that == 0))
+          {
+          ValueType a = std::fabs(center), b = std::fabs(that);
+          if(a < b || (a == b && fwd))
+            crossing = true;
+          }
+        }
+
+      if(crossing)
+        {
+        ValueType length = 0;
+        for(unsigned int d = 0; d < ImageDimension; d++)
+          {
+          ValueType vf = coord[d] + 1 < m_Size[d] ? phi[o + m_Stride[d]] : center;
+          ValueType vb = coord[d] > 0 ? phi[o - m_Stride[d]] : center;
+          ValueType dxf = (vf - center) * m_Scale[d];
+          ValueType dxb = (center - vb) * m_Scale[d];
+          length += std::fabs(dxf) > std::fabs(dxb) ? dxf * dxf : dxb * dxb;
+          }
+        length = std::sqrt(length) + MIN_NORM;
+        ValueType dist = std::min(std::max(-CHANGE_FACTOR, center / length), CHANGE_FACTOR);
+        block.m_Pending.push_back(std::make_pair((unsigned short) l, dist));
+        }
+      }
+    }
+
+  // Set all voxels to the background values outside of the layers
+  ValueType farValue = static_cast<ValueType>(m_NumberOfLayers + 1);
+  signed char farStatus = static_cast<signed char>(m_NumberOfLayers + 1);
+  #pragma omp parallel for num_threads(nThreads)
+  for(long i = 0; i < nVoxels; i++)
+    {
+    bool outside = phi[i] > 0;
+    phi[i] = outside ? farValue : -farValue;
+    m_Status[i] = outside ? farStatus : -farStatus;
+    }
+
+  // Make the zero crossing voxels active
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long b = 0; b < m_NumberOfBlocks; b++)
+    ApplyPending(b, 0);
+
+  // Construct the layers
+  this->RebuildLayers();
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::ApplyPending(long b, int layer)
+{
+  Block &block = m_Blocks[b];
+  ValueType *phi = this->GetOutput()->GetBufferPointer();
+  long coord[ImageDimension], o;
+  for(size_t i = 0; i < block.m_Pending.size(); i++)
+    {
+    unsigned int l = block.m_Pending[i].first;
+    ValueType value = block.m_Pending[i].second;
+    GetVoxel(b, l, coord, o);
+    phi[o] = value;
+    if(layer == 0)
+      {
+      m_Status[o] = STATUS_ACTIVE;
+      block.m_Active.push_back((unsigned short) l);
+      }
+    else
+      {
+      m_Status[o] = static_cast<signed char>(value > 0 ? layer : -layer);
+      }
+    }
+  block.m_Pending.clear();
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::ComputeBlockUpdate(long b, std::vector<ValueType> &scratch)
+{
+  const unsigned int D = ImageDimension;
+  const unsigned int P = D * (D - 1) / 2;
+
+  Block &block = m_Blocks[b];
+  block.m_MaxCurvatureChange = 0;
+  block.m_MaxAdvectionChange = 0;
+  block.m_MaxPropagationChange = 0;
+
+  size_t n = block.m_Active.size();
+  block.m_Update.resize(n);
+  if(n == 0)
+    return;
+
+  const ValueType *phi = this->GetOutput()->GetBufferPointer();
+  LevelSetFunctionType *f = m_LevelSetFunction;
+
+  // Weights of the terms
+  const ValueType wCurv = f->GetCurvatureWeight();
+  const ValueType wAdv = f->GetAdvectionWeight();
+  const ValueType wProp = f->GetPropagationWeight();
+  const ValueType wLap = f->GetLaplacianSmoothingWeight();
+  const int eCurv = f->GetCurvatureSpeedExponent();
+  const int eProp = f->GetPropagationSpeedExponent();
+  const int eLap = f->GetLaplacianSmoothingSpeedExponent();
+  const ValueType speedScale = f->GetSpeedScaleFactor();
+
+  const SpeedImageType *speedImage = f->GetSpeedImage();
+  const typename SpeedImageType::PixelType *speed = speedImage->GetBufferPointer();
+  const VectorImageType *advImage = f->GetAdvectionField();
+  const VectorType *adv = (wAdv != 0 && advImage) ? advImage->GetBufferPointer() : NULL;
+
+  // Structure-of-arrays buffers for the gathered values
+  unsigned int nArrays = 1 + 2 * D + 4 * P + 1 + D;
+  scratch.resize(nArrays * n);
+  ValueType *sCenter = &scratch[0];
+  ValueType *sFwd = sCenter + n;              // D arrays
+  ValueType *sBwd = sFwd + D * n;             // D arrays
+  ValueType *sDiag = sBwd + D * n;            // 4 * P arrays
+  ValueType *sSpeed = sDiag + 4 * P * n;      // 1 array
+  ValueType *sAdv = sSpeed + n;               // D arrays
+
+  // Gather pass: neighborhood values, speed and advection for each voxel.
+  // Neighbors outside of the image are replaced by the nearest voxel inside
+  const ValueType MIN_NORM = 1.0e-6;
+  for(size_t i = 0; i < n; i++)
+    {
+    long c[D], o;
+    GetVoxel(b, block.m_Active[i], c, o);
+
+    long om[D], op[D];
+    ValueType center = phi[o];
+    sCenter[i] = center;
+    for(unsigned int d = 0; d < D; d++)
+      {
+      om[d] = c[d] > 0 ? -m_Stride[d] : 0;
+      op[d] = c[d] + 1 < m_Size[d] ? m_Stride[d] : 0;
+      sFwd[d * n + i] = phi[o + op[d]];
+      sBwd[d * n + i] = phi[o + om[d]];
+      }
+
+    for(unsigned int d1 = 0, p = 0; d1 < D; d1++)
+      {
+      for(unsigned int d2 = d1 + 1; d2 < D; d2++, p++)
+        {
+        sDiag[(4 * p + 0) * n + i] = phi[o + om[d1] + om[d2]];
+        sDiag[(4 * p + 1) * n + i] = phi[o + om[d1] + op[d2]];
+        sDiag[(4 * p + 2) * n + i] = phi[o + op[d1] + om[d2]];
+        sDiag[(4 * p + 3) * n + i] = phi[o + op[d1] + op[d2]];
+        }
+      }
+
+    // Location of the zero level set relative to the voxel, as computed by the
+    // sparse field filters when interpolating the surface location
+    double cdx[D];
+    bool inside = true;
+    if(center != 0)
+      {
+      ValueType off[D], norm2 = 0;
+      for(unsigned int d = 0; d < D; d++)
+        {
+        ValueType vf = sFwd[d * n + i], vb = sBwd[d * n + i];
+        if(vf * vb >= 0)
+          {
+          ValueType dxf = (vf - center) * m_Scale[d], dxb = (center - vb) * m_Scale[d];
+          off[d] = std::fabs(dxf) > std::fabs(dxb) ? dxf : dxb;
+          }
+        else
+          {
+          off[d] = (vf * center < 0 ? vf - center : center - vb) * m_Scale[d];
+          }
+        norm2 += off[d] * off[d];
+        }
+      for(unsigned int d = 0; d < D; d++)
+        {
+        cdx[d] = c[d] - (off[d] * center) / (norm2 + MIN_NORM);
+        inside = inside && cdx[d] >= -0.5 && cdx[d] < m_Size[d] - 0.5;
+        }
+      }
+    else
+      {
+      for(unsigned int d = 0; d < D; d++)
+        cdx[d] = c[d];
+      }
+
+    // Linear interpolation of the speed and advection images at the zero level
+    // set. If the location is outside of the image, the voxel value is used
+    double g = 0, a[D];
+    for(unsigned int d = 0; d < D; d++)
+      a[d] = 0;
+
+    if(inside)
+      {
+      long base[D];
+      double frac[D];
+      for(unsigned int d = 0; d < D; d++)
+        {
+        double fl = std::floor(cdx[d]);
+        base[d] = (long) fl;
+        frac[d] = cdx[d] - fl;
+        }
+
+      for(unsigned int corner = 0; corner < (1u << D); corner++)
+        {
+        double w = 1;
+        long oc = 0;
+        for(unsigned int d = 0; d < D; d++)
+          {
+          bool upper = (corner >> d) & 1;
+          long k = std::min(std::max(base[d] + (upper ? 1 : 0), 0L), m_Size[d] - 1);
+          w *= upper ? frac[d] : 1 - frac[d];
+          oc += k * m_Stride[d];
+          }
+        if(w == 0)
+          continue;
+        g += w * speed[oc];
+        if(adv)
+          for(unsigned int d = 0; d < D; d++)
+            a[d] += w * adv[oc][d];
+        }
+      }
+    else
+      {
+      g = speed[o];
+      if(adv)
+        for(unsigned int d = 0; d < D; d++)
+          a[d] = adv[o][d];
+      }
+
+    sSpeed[i] = static_cast<ValueType>(speedScale * g);
+    for(unsigned int d = 0; d < D; d++)
+      sAdv[d * n + i] = static_cast<ValueType>(speedScale * a[d]);
+    }
+
+  // Compute pass: the terms of the level set equation, following the
+  // expressions in itk::LevelSetFunction::ComputeUpdate
+  ValueType maxCurv = 0, maxAdv = 0, maxProp = 0;
+  for(size_t i = 0; i < n; i++)
+    {
+    ValueType center = sCenter[i];
+    ValueType dx[D], dxf[D], dxb[D], dxx[D], dxy[P > 0 ? P : 1];
+    ValueType gradMagSqr = 1.0e-6;
+    for(unsigned int d = 0; d < D; d++)
+      {
+      ValueType vf = sFwd[d * n + i], vb = sBwd[d * n + i];
+      dx[d] = 0.5f * (vf - vb) * m_Scale[d];
+      dxx[d] = (vf + vb - 2.0f * center) * m_Scale[d] * m_Scale[d];
+      dxf[d] = (vf - center) * m_Scale[d];
+      dxb[d] = (center - vb) * m_Scale[d];
+      gradMagSqr += dx[d] * dx[d];
+      }
+
+    for(unsigned int d1 = 0, p = 0; d1 < D; d1++)
+      {
+      for(unsigned int d2 = d1 + 1; d2 < D; d2++, p++)
+        {
+        dxy[p] = 0.25f * (sDiag[(4 * p + 0) * n + i] - sDiag[(4 * p + 1) * n + i]
+                          - sDiag[(4 * p + 2) * n + i] + sDiag[(4 * p + 3) * n + i])
+            * m_Scale[d1] * m_Scale[d2];
+        }
+      }
+
+    ValueType g = sSpeed[i];
+    ValueType update = 0;
+
+    // Mean curvature term
+    if(wCurv != 0)
+      {
+      ValueType curv = 0;
+      for(unsigned int d1 = 0, p = 0; d1 < D; d1++)
+        {
+        for(unsigned int d2 = d1 + 1; d2 < D; d2++, p++)
+          {
+          curv -= 2 * dx[d1] * dx[d2] * dxy[p];
+          curv += dxx[d2] * dx[d1] * dx[d1] + dxx[d1] * dx[d2] * dx[d2];
+          }
+        }
+      ValueType term = (curv / gradMagSqr) * wCurv * SpeedPower(g, eCurv);
+      maxCurv = std::max(maxCurv, std::fabs(term));
+      update += term;
+      }
+
+    // Upwind advection term
+    if(adv)
+      {
+      ValueType term = 0;
+      for(unsigned int d = 0; d < D; d++)
+        {
+        ValueType av = sAdv[d * n + i];
+        ValueType energy = wAdv * av;
+        term += av * (energy > 0 ? dxb[d] : dxf[d]);
+        maxAdv = std::max(maxAdv, std::fabs(energy));
+        }
+      update -= term * wAdv;
+      }
+
+    // Upwind propagation term
+    if(wProp != 0)
+      {
+      const ValueType zero = 0;
+      ValueType prop = wProp * SpeedPower(g, eProp);
+      ValueType grad = 0;
+      for(unsigned int d = 0; d < D; d++)
+        {
+        ValueType gb = prop > 0 ? std::max(dxb[d], zero) : std::min(dxb[d], zero);
+        ValueType gf = prop > 0 ? std::min(dxf[d], zero) : std::max(dxf[d], zero);
+        grad += gb * gb + gf * gf;
+        }
+      maxProp = std::max(maxProp, std::fabs(prop));
+      update -= prop * std::sqrt(grad);
+      }
+
+    // Laplacian smoothing term
+    if(wLap != 0)
+      {
+      ValueType lap = 0;
+      for(unsigned int d = 0; d < D; d++)
+        lap += dxx[d];
+      update -= lap * wLap * SpeedPower(g, eLap);
+      }
+
+    block.m_Update[i] = update;
+    }
+
+  block.m_MaxCurvatureChange = maxCurv;
+  block.m_MaxAdvectionChange = maxAdv;
+  block.m_MaxPropagationChange = maxProp;
+}
+
+template <class TImage, class TSpeedImage>
+typename SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>::TimeStepType
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::CalculateChange()
+{
+  // Compute the updates in all blocks of the narrow band
+  long nBand = (long) m_BandBlocks.size();
+  int nThreads = this->GetNumberOfThreads();
+  #pragma omp parallel num_threads(nThreads)
+    {
+    std::vector<ValueType> scratch;
+    #pragma omp for schedule(dynamic)
+    for(long k = 0; k < nBand; k++)
+      ComputeBlockUpdate(m_BandBlocks[k], scratch);
+    }
+
+  // Combine the largest changes over the blocks, and let the function compute
+  // the time step from them, as the sparse field filters do
+  typedef typename LevelSetFunctionType::GlobalDataStruct GlobalDataStruct;
+  void *globalData = m_LevelSetFunction->GetGlobalDataPointer();
+  GlobalDataStruct *gd = static_cast<GlobalDataStruct *>(globalData);
+  gd->m_MaxCurvatureChange = 0;
+  gd->m_MaxAdvectionChange = 0;
+  gd->m_MaxPropagationChange = 0;
+  for(long k = 0; k < nBand; k++)
+    {
+    const Block &block = m_Blocks[m_BandBlocks[k]];
+    if(block.m_Active.empty())
+      continue;
+    gd->m_MaxCurvatureChange = std::max(gd->m_MaxCurvatureChange,
+                                        (ValueType) block.m_MaxCurvatureChange);
+    gd->m_MaxAdvectionChange = std::max(gd->m_MaxAdvectionChange,
+                                        (ValueType) block.m_MaxAdvectionChange);
+    gd->m_MaxPropagationChange = std::max(gd->m_MaxPropagationChange,
+                                          (ValueType) block.m_MaxPropagationChange);
+    }
+
+  TimeStepType dt = m_LevelSetFunction->ComputeGlobalTimeStep(globalData);
+  m_LevelSetFunction->ReleaseGlobalDataPointer(globalData);
+  return dt;
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::ApplyUpdate(const TimeStepType &dt)
+{
+  const ValueType LOWER_ACTIVE_THRESHOLD = -0.5, UPPER_ACTIVE_THRESHOLD = 0.5;
+  ValueType *phi = this->GetOutput()->GetBufferPointer();
+  long nBand = (long) m_BandBlocks.size();
+  int nThreads = this->GetNumberOfThreads();
+
+  // Compute the new values of the active voxels, and mark the voxels that are
+  // leaving the active layer
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long k = 0; k < nBand; k++)
+    {
+    long b = m_BandBlocks[k];
+    Block &block = m_Blocks[b];
+    size_t n = block.m_Active.size();
+    block.m_Move.assign(n, 0);
+    for(size_t i = 0; i < n; i++)
+      {
+      long c[ImageDimension], o;
+      GetVoxel(b, block.m_Active[i], c, o);
+      ValueType v = static_cast<ValueType>(phi[o] + dt * block.m_Update[i]);
+      block.m_Update[i] = v;
+      if(v >= UPPER_ACTIVE_THRESHOLD)
+        {
+        block.m_Move[i] = 1;
+        m_Status[o] = STATUS_CHANGING_UP;
+        }
+      else if(v < LOWER_ACTIVE_THRESHOLD)
+        {
+        block.m_Move[i] = -1;
+        m_Status[o] = STATUS_CHANGING_DOWN;
+        }
+      }
+    }
+
+  // Neighboring active voxels may not leave the active layer in opposite
+  // directions, since that would create a hole in the active layer. Such
+  // voxels keep their old value. All other voxels receive the new value.
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long k = 0; k < nBand; k++)
+    {
+    long b = m_BandBlocks[k];
+    Block &block = m_Blocks[b];
+    block.m_SumSquaredChange = 0;
+    block.m_UpdateCount = 0;
+    for(size_t i = 0; i < block.m_Active.size(); i++)
+      {
+      long c[ImageDimension], o;
+      GetVoxel(b, block.m_Active[i], c, o);
+      if(block.m_Move[i])
+        {
+        signed char opposite = block.m_Move[i] > 0
+            ? (signed char) STATUS_CHANGING_DOWN : (signed char) STATUS_CHANGING_UP;
+        bool blocked = false;
+        for(unsigned int d = 0; d < ImageDimension && !blocked; d++)
+          {
+          if(c[d] > 0 && m_Status[o - m_Stride[d]] == opposite)
+            blocked = true;
+          if(c[d] + 1 < m_Size[d] && m_Status[o + m_Stride[d]] == opposite)
+            blocked = true;
+          }
+        if(blocked)
+          {
+          block.m_Move[i] = 2;
+          continue;
+          }
+        }
+
+      ValueType v = block.m_Update[i];
+      block.m_SumSquaredChange += (v - phi[o]) * (v - phi[o]);
+      block.m_UpdateCount++;
+      phi[o] = v;
+      }
+    }
+
+  // Voxels that were blocked stay in the active layer
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long k = 0; k < nBand; k++)
+    {
+    long b = m_BandBlocks[k];
+    Block &block = m_Blocks[b];
+    for(size_t i = 0; i < block.m_Active.size(); i++)
+      {
+      if(block.m_Move[i] == 2)
+        {
+        long c[ImageDimension], o;
+        GetVoxel(b, block.m_Active[i], c, o);
+        m_Status[o] = STATUS_ACTIVE;
+        block.m_Move[i] = 0;
+        }
+      }
+    }
+
+  // Voxels in the first layer on the other side of a voxel leaving the active
+  // layer take its place. Among several such neighbors, the value closest to
+  // the zero level set is kept. Moving voxels are in the band blocks, so their
+  // neighbors are in the band blocks or adjacent to them; all band blocks are
+  // within one block of an active voxel, so scanning the band suffices.
+  unsigned int blockVolume = 1;
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    blockVolume *= BlockSize;
+
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long k = 0; k < nBand; k++)
+    {
+    long b = m_BandBlocks[k];
+    Block &block = m_Blocks[b];
+    long c[ImageDimension], o;
+    for(unsigned int l = 0; l < blockVolume; l++)
+      {
+      if(!GetVoxel(b, l, c, o))
+        continue;
+
+      signed char s = m_Status[o];
+      if(s != 1 && s != -1)
+        continue;
+
+      // Inside voxels are pulled up by voxels moving up, and vice versa
+      signed char mover = s < 0
+          ? (signed char) STATUS_CHANGING_UP : (signed char) STATUS_CHANGING_DOWN;
+      ValueType value = phi[o];
+      bool found = false;
+      for(unsigned int d = 0; d < ImageDimension; d++)
+        {
+        for(int dir = -1; dir <= 1; dir += 2)
+          {
+          if(dir < 0 ? c[d] == 0 : c[d] + 1 >= m_Size[d])
+            continue;
+          long on = o + dir * m_Stride[d];
+          if(m_Status[on] != mover)
+            continue;
+          ValueType temp = s < 0 ? phi[on] - 1 : phi[on] + 1;
+          bool stale = s < 0 ? value < LOWER_ACTIVE_THRESHOLD : value >= UPPER_ACTIVE_THRESHOLD;
+          if(stale || std::fabs(temp) < std::fabs(value))
+            {
+            value = temp;
+            found = true;
+            }
+          }
+        }
+
+      if(found)
+        block.m_Pending.push_back(std::make_pair((unsigned short) l, value));
+      }
+    }
+
+  // Remove the moving voxels from the active lists and add the new voxels
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long k = 0; k < nBand; k++)
+    {
+    long b = m_BandBlocks[k];
+    Block &block = m_Blocks[b];
+    size_t j = 0;
+    for(size_t i = 0; i < block.m_Active.size(); i++)
+      {
+      if(block.m_Move[i])
+        {
+        long c[ImageDimension], o;
+        GetVoxel(b, block.m_Active[i], c, o);
+        m_Status[o] = block.m_Move[i] > 0 ? 1 : -1;
+        }
+      else
+        {
+        block.m_Active[j++] = block.m_Active[i];
+        }
+      }
+    block.m_Active.resize(j);
+    ApplyPending(b, 0);
+    }
+
+  // Compute the RMS change over the updated voxels
+  double sum = 0;
+  long count = 0;
+  for(long k = 0; k < nBand; k++)
+    {
+    sum += m_Blocks[m_BandBlocks[k]].m_SumSquaredChange;
+    count += m_Blocks[m_BandBlocks[k]].m_UpdateCount;
+    }
+  this->SetRMSChange(count ? std::sqrt(sum / count) : 0.0);
+
+  // Recompute the values in the layers around the active layer
+  this->RebuildLayers();
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::RebuildLayers()
+{
+  ValueType *phi = this->GetOutput()->GetBufferPointer();
+  int nThreads = this->GetNumberOfThreads();
+  const int L = (int) m_NumberOfLayers;
+  const signed char farStatus = static_cast<signed char>(L + 1);
+  const ValueType farValue = static_cast<ValueType>(L + 1);
+
+  unsigned int blockVolume = 1;
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    blockVolume *= BlockSize;
+
+  // Flag the blocks in the previous band with 1 and the blocks in the new band
+  // (blocks with active voxels and their neighbors) with 2. Since the layers
+  // are at most NumberOfLayers < BlockSize voxels from the active layer, they
+  // are contained in the new band.
+  for(size_t k = 0; k < m_BandBlocks.size(); k++)
+    m_BlockFlag[m_BandBlocks[k]] = 1;
+
+  for(long b = 0; b < m_NumberOfBlocks; b++)
+    {
+    if(m_Blocks[b].m_Active.empty())
+      continue;
+
+    long bc[ImageDimension], rem = b;
+    for(unsigned int d = 0; d < ImageDimension; d++)
+      {
+      bc[d] = rem % m_BlockGridSize[d];
+      rem /= m_BlockGridSize[d];
+      }
+
+    // Visit the 3^D neighborhood of the block
+    unsigned int nNbr = 1;
+    for(unsigned int d = 0; d < ImageDimension; d++)
+      nNbr *= 3;
+    for(unsigned int j = 0; j < nNbr; j++)
+      {
+      long nb = 0, mult = 1;
+      bool valid = true;
+      for(unsigned int d = 0, jj = j; d < ImageDimension; d++, jj /= 3)
+        {
+        long x = bc[d] + (long) (jj % 3) - 1;
+        if(x < 0 || x >= m_BlockGridSize[d])
+          {
+          valid = false;
+          break;
+          }
+        nb += x * mult;
+        mult *= m_BlockGridSize[d];
+        }
+      if(valid)
+        m_BlockFlag[nb] |= 2;
+      }
+    }
+
+  // The working set is the union of the old and new bands
+  std::vector<long> work;
+  std::vector<long> band;
+  for(size_t k = 0; k < m_BandBlocks.size(); k++)
+    if(m_BlockFlag[m_BandBlocks[k]] == 1)
+      work.push_back(m_BandBlocks[k]);
+  for(long b = 0; b < m_NumberOfBlocks; b++)
+    if(m_BlockFlag[b] & 2)
+      {
+      work.push_back(b);
+      band.push_back(b);
+      }
+  long nWork = (long) work.size();
+
+  // Clear the layers in the working set
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long k = 0; k < nWork; k++)
+    {
+    long b = work[k], c[ImageDimension], o;
+    for(unsigned int l = 0; l < blockVolume; l++)
+      if(GetVoxel(b, l, c, o) && m_Status[o] != STATUS_ACTIVE)
+        m_Status[o] = STATUS_UNASSIGNED;
+    }
+
+  // Assign the layers one at a time. A voxel joins layer k if it is next to
+  // a voxel in layer k-1 on the same side of the zero level set, and takes the
+  // value closest to zero among these neighbors, plus or minus one
+  for(int layer = 1; layer <= L; layer++)
+    {
+    #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+    for(long k = 0; k < nWork; k++)
+      {
+      long b = work[k], c[ImageDimension], o;
+      Block &block = m_Blocks[b];
+      for(unsigned int l = 0; l < blockVolume; l++)
+        {
+        if(!GetVoxel(b, l, c, o) || m_Status[o] != STATUS_UNASSIGNED)
+          continue;
+
+        bool outside = phi[o] > 0;
+        signed char from = static_cast<signed char>(outside ? layer - 1 : 1 - layer);
+        bool found = false;
+        ValueType best = 0;
+        for(unsigned int d = 0; d < ImageDimension; d++)
+          {
+          for(int dir = -1; dir <= 1; dir += 2)
+            {
+            if(dir < 0 ? c[d] == 0 : c[d] + 1 >= m_Size[d])
+              continue;
+            long on = o + dir * m_Stride[d];
+            if(m_Status[on] != from)
+              continue;
+            ValueType v = phi[on];
+            if(!found || (outside ? v < best : v > best))
+              best = v;
+            found = true;
+            }
+          }
+
+        if(found)
+          block.m_Pending.push_back(std::make_pair(
+                                      (unsigned short) l, outside ? best + 1 : best - 1));
+        }
+      }
+
+    #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+    for(long k = 0; k < nWork; k++)
+      ApplyPending(work[k], layer);
+    }
+
+  // Voxels that are not in any layer are set to the background values
+  #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+  for(long k = 0; k < nWork; k++)
+    {
+    long b = work[k], c[ImageDimension], o;
+    for(unsigned int l = 0; l < blockVolume; l++)
+      {
+      if(GetVoxel(b, l, c, o) && m_Status[o] == STATUS_UNASSIGNED)
+        {
+        bool outside = phi[o] > 0;
+        phi[o] = outside ? farValue : -farValue;
+        m_Status[o] = outside ? farStatus : -farStatus;
+        }
+      }
+    }
+
+  // Store the new band and clear the flags
+  for(long k = 0; k < nWork; k++)
+    m_BlockFlag[work[k]] = 0;
+  m_BandBlocks.swap(band);
+}
+
+template <class TImage, class TSpeedImage>
+void
+SNAPBlockedNarrowBandLevelSetFilter<TImage, TSpeedImage>
+::PrintSelf(std::ostream &os, itk::Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfLayers: " << m_NumberOfLayers << std::endl;
+  os << indent << "NumberOfBandBlocks: " << m_BandBlocks.size() << std::endl;
+}
+
+#endif
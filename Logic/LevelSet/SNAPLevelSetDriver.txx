@@ -51,6 +51,7 @@
 #include "LevelSetExtensionFilter.h"
 
 #include "itkParallelSparseFieldLevelSetImageFilter.h"
+#include "SNAPBlockedNarrowBandLevelSetFilter.h"
 
 // Disable some windows debug length messages
 #if defined(_MSC_VER)
@@ -200,6 +201,19 @@ SNAPLevelSetDriver<VDimension>
     filter->SetDifferenceFunction(m_LevelSetFunction);
     filter->InPlaceOn();
     }
+  else if(m_Parameters.GetSolver() == SnakeParameters::BLOCKED_NARROW_BAND_SOLVER)
+    {
+    // Sparse field solver that evaluates the equation block by block
+    typedef SNAPBlockedNarrowBandLevelSetFilter<
+        FloatImageType, ShortImageType> LevelSetFilterType;
+
+    typename LevelSetFilterType::Pointer filter = LevelSetFilterType::New();
+    m_LevelSetFilter = filter.GetPointer();
+
+    filter->SetInput(m_InitializationImage);
+    filter->SetNumberOfLayers(3);
+    filter->SetLevelSetFunction(m_LevelSetFunction);
+    }
 /*
   else if(m_Parameters.GetSolver() == SnakeParameters::NARROW_BAND_SOLVER)
     {
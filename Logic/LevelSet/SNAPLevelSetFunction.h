@@ -180,6 +180,11 @@ public:
     m_AdvectionField = pointer;
     }
 
+  /** Get the advection field (computed from the speed image by
+   * CalculateInternalImages unless an external field was supplied) */
+  virtual VectorImageType *GetAdvectionField() const
+    { return m_AdvectionField; }
+
   /** Compute speed and advection images from feature image. */
   virtual void CalculateInternalImages();
 
@@ -38,20 +38,7 @@
 #include "itkCommand.h"
 #include "itkImageToImageFilter.h"
 #include "EdgePreprocessingSettings.h"
-
-#include "GPUSettings.h"
-#ifdef SNAP_USE_GPU
-#include "CPUImageToGPUImageFilter.h"
-#include <itkGPUDiscreteGaussianImageFilter.h>
-#endif
-
-namespace itk {
-  template <class TIn, class TOut> class DiscreteGaussianImageFilter;
-  template <class TIn, class TOut> class GradientMagnitudeImageFilter;
-  template <class TIn, class TOut, class Fun> class UnaryFunctorImageFilter;
-  template <class TIn, class TOut> class StreamingImageFilter;
-  template <class TIn, class TOut> class CastImageFilter;
-}
+#include <vector>
 
 
 /**
@@ -107,6 +94,20 @@ private:
  * 
  * This functor implements a Gaussian blur, followed by a gradient magnitude
  * operator, followed by a 'contrast enhancement' intensity remapping filter.
+ *
+ * The three stages are fused into a single kernel that runs on small tiles
+ * of the output region. For each tile, the input is gathered with a halo
+ * that covers the Gaussian kernel and the central difference stencil, the
+ * separable blur is applied along x, y and z in a pair of tile-sized
+ * buffers, and the remapped gradient magnitude is written directly to the
+ * output. No full-size float intermediates are allocated, so the memory
+ * footprint is that of the output plus a few tiles per thread, and the
+ * filter streams: only the requested region (padded by the halo) of the
+ * input is needed.
+ *
+ * The results match the former DiscreteGaussianImageFilter (no image
+ * spacing, maximum error 0.1) -> GradientMagnitudeImageFilter (with image
+ * spacing) pipeline, including its zero-flux Neumann boundary handling.
  */
 template <typename TInputImage,typename TOutputImage>
 class EdgePreprocessingImageFilter: 
@@ -131,17 +132,10 @@ public:
   typedef typename Superclass::OutputImageRegionType
                                                   OutputImageRegionType;
 
+  typedef typename OutputImageType::PixelType           OutputPixelType;
+
   /** Type used for internal calculations */
   typedef float                                                RealType;
-  typedef itk::Image<RealType,3>                      InternalImageType;
-  typedef itk::SmartPointer<InternalImageType>     InternalImagePointer;
-
-#ifdef SNAP_USE_GPU
-  typedef typename itk::GPUTraits<InternalImageType>::Type
-                                                   GPUInternalImageType;
-  typedef itk::SmartPointer<GPUInternalImageType> 
-                                                GPUInternalImagePointer;
-#endif
 
   /** Functor type used for thresholding */
   typedef EdgeRemappingFunctor<RealType>                    FunctorType;
@@ -170,8 +164,12 @@ protected:
   virtual ~EdgePreprocessingImageFilter() {}
   void PrintSelf(std::ostream& os, itk::Indent indent) const ITK_OVERRIDE;
   
-  /** Generate Data */
-  void GenerateData() ITK_OVERRIDE;
+  /** Set up the Gaussian kernel and the remapping functor */
+  void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  /** Run the fused blur / gradient / remapping kernel on a region */
+  void ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread,
+                            itk::ThreadIdType threadId) ITK_OVERRIDE;
 
   /** 
    * This method maps an input region to an output region.  It's necessary to
@@ -181,37 +179,23 @@ protected:
 
 private:
 
-  double m_InputImageMaximumGradientMagnitude;
-
-  typedef itk::CastImageFilter<InputImageType, InternalImageType>   CastFilter;
-
-  typedef itk::DiscreteGaussianImageFilter<InternalImageType,
-                                           InternalImageType>       BlurFilter;
-
-#ifdef SNAP_USE_GPU
-  typedef CPUImageToGPUImageFilter<GPUInternalImageType>        GPUImageSource;
-  typedef itk::GPUDiscreteGaussianImageFilter<GPUInternalImageType,
-                                              GPUInternalImageType>
-                                                                 GPUBlurFilter;
-#endif
+  /** Compute the 1D Gaussian kernel from the current settings */
+  void UpdateKernel();
 
-  typedef itk::GradientMagnitudeImageFilter<InternalImageType,
-                                            InternalImageType>   GradMagFilter;
+  /** Convolve a tile buffer with the Gaussian kernel along one axis. The
+    output has the same size as the input, minus the kernel width along
+    the axis of convolution */
+  void ConvolveAlongAxis(const RealType *in, const long *size, int axis,
+                         RealType *out) const;
 
-  typedef itk::UnaryFunctorImageFilter<InternalImageType,
-                                       OutputImageType,
-                                       FunctorType>                RemapFilter;
-
-  SmartPtr<CastFilter> m_CastFilter;
-  SmartPtr<BlurFilter> m_BlurFilter;
-  SmartPtr<GradMagFilter> m_GradMagFilter;
-  SmartPtr<RemapFilter> m_RemapFilter;
+  double m_InputImageMaximumGradientMagnitude;
 
-#ifdef SNAP_USE_GPU
-  SmartPtr<GPUImageSource> m_GPUImageSource;
-  SmartPtr<GPUBlurFilter>  m_GPUBlurFilter;
-#endif
+  // The 1D Gaussian kernel, of size 2 * m_KernelRadius + 1
+  std::vector<RealType> m_Kernel;
+  int m_KernelRadius;
 
+  // The remapping functor, copied by each thread
+  FunctorType m_Functor;
 };
 
 #ifndef ITK_MANUAL_INSTANTIATION
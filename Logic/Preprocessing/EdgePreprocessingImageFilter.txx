@@ -34,13 +34,11 @@
 =========================================================================*/
 
 #include <EdgePreprocessingSettings.h>
-#include <itkProgressAccumulator.h>
-
-#include <itkCastImageFilter.h>
-#include <itkDiscreteGaussianImageFilter.h>
-#include <itkGradientMagnitudeImageFilter.h>
-#include <itkUnaryFunctorImageFilter.h>
+#include <itkGaussianOperator.h>
+#include <itkProgressReporter.h>
 #include <IRISException.h>
+#include <algorithm>
+#include <cmath>
 
 template<typename TInputImage,typename TOutputImage>
 EdgePreprocessingImageFilter<TInputImage,TOutputImage>
@@ -52,57 +50,16 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
   // Set the gradient magnitude to default value
   m_InputImageMaximumGradientMagnitude = 0.0;
 
-  // Initialize the mini-pipeline
-  m_CastFilter = CastFilter::New();
-  m_CastFilter->ReleaseDataFlagOn();
-
-#ifndef SNAP_USE_GPU
-  m_BlurFilter = BlurFilter::New();
-  m_BlurFilter->SetInput(m_CastFilter->GetOutput());
-  m_BlurFilter->ReleaseDataFlagOn();
-
-  // Prevent streaming inside the Gaussian filter because we will be streaming
-  // anyway. Too much streaming increases execution time unnecessarilty
-  m_BlurFilter->SetInternalNumberOfStreamDivisions(1);
-  m_BlurFilter->SetMaximumError(0.1);
-
-  m_GradMagFilter = GradMagFilter::New();
-  m_GradMagFilter->SetInput(m_BlurFilter->GetOutput());
-  m_GradMagFilter->ReleaseDataFlagOn();
-#else
-  m_GPUImageSource = GPUImageSource::New();
-  m_GPUImageSource->SetInput(m_CastFilter->GetOutput());
-
-  m_GPUBlurFilter = GPUBlurFilter::New();
-  m_GPUBlurFilter->SetInput(m_GPUImageSource->GetOutput());
-  m_GPUBlurFilter->ReleaseDataFlagOn();
-
-  // Prevent streaming inside the Gaussian filter because we will be streaming
-  // anyway. Too much streaming increases execution time unnecessarilty
-  m_GPUBlurFilter->SetInternalNumberOfStreamDivisions(1);
-  m_GPUBlurFilter->SetMaximumError(0.1);
-  //m_ROIFilter = ROIFilter::New();
-  //m_ROIFilter->SetInput(m_GPUBlurFilter->GetOutput());
-
-  m_GradMagFilter = GradMagFilter::New();
-  m_GradMagFilter->SetInput(m_GPUBlurFilter->GetOutput());
-  //m_GradMagFilter->SetInput(m_ROIFilter->GetOutput());
-  m_GradMagFilter->ReleaseDataFlagOn();
-#endif
-
-  m_RemapFilter = RemapFilter::New();
-  m_RemapFilter->SetInput(m_GradMagFilter->GetOutput());
+  // The kernel is computed once the parameters are known
+  m_KernelRadius = 0;
+  m_Kernel.assign(1, 1.0f);
 }
 
 template<typename TInputImage,typename TOutputImage>
 void
 EdgePreprocessingImageFilter<TInputImage,TOutputImage>
-::GenerateData()
+::UpdateKernel()
 {
-  // Get the input and output pointers
-  const typename InputImageType::ConstPointer inputImage = this->GetInput();
-  typename OutputImageType::Pointer outputImage = this->GetOutput();
-
   // Get the settings
   EdgePreprocessingSettings *settings = this->GetParameters();
 
@@ -110,45 +67,228 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
   if(!settings)
     throw IRISException("Parameters not set in EdgePreprocessingImageFilter");
 
-  itk::ProgressAccumulator::Pointer pac = itk::ProgressAccumulator::New();
-  pac->SetMiniPipelineFilter(this);
+  // Generate the kernel the same way that DiscreteGaussianImageFilter does
+  // with image spacing turned off and a maximum error of 0.1
+  double scale = settings->GetGaussianBlurScale();
+  itk::GaussianOperator<double, 3> op;
+  op.SetDirection(0);
+  op.SetVariance(scale * scale);
+  op.SetMaximumError(0.1);
+  op.SetMaximumKernelWidth(32);
+  op.CreateDirectional();
+
+  unsigned int width = op.GetSize(0);
+  m_Kernel.resize(width);
+  for(unsigned int i = 0; i < width; i++)
+    m_Kernel[i] = static_cast<RealType>(op[i]);
+  m_KernelRadius = (width - 1) / 2;
+}
+
+template<typename TInputImage,typename TOutputImage>
+void
+EdgePreprocessingImageFilter<TInputImage,TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  // Compute the Gaussian kernel
+  this->UpdateKernel();
 
-#ifndef SNAP_USE_GPU
-  pac->RegisterInternalFilter(m_BlurFilter, 0.8);
-#else
-  pac->RegisterInternalFilter(m_GPUBlurFilter, 0.8);
-#endif
+  // Construct the functor
+  EdgePreprocessingSettings *settings = this->GetParameters();
+  m_Functor.SetParameters(0.0, m_InputImageMaximumGradientMagnitude,
+                          settings->GetRemappingExponent(),
+                          settings->GetRemappingSteepness());
+}
 
-    pac->RegisterInternalFilter(m_RemapFilter, 0.2);
+template<typename TInputImage,typename TOutputImage>
+void
+EdgePreprocessingImageFilter<TInputImage,TOutputImage>
+::ConvolveAlongAxis(const RealType *in, const long *size, int axis,
+                    RealType *out) const
+{
+  const RealType *kernel = &m_Kernel[0];
+  long width = static_cast<long>(m_Kernel.size());
 
-  // Configure the pipeline
-  m_CastFilter->SetInput(inputImage);
+  // Size of the output buffer and strides of both buffers
+  long osize[3] = { size[0], size[1], size[2] };
+  osize[axis] -= width - 1;
 
-  // Configure the Gaussian
-#ifndef SNAP_USE_GPU
-  m_BlurFilter->SetUseImageSpacingOff();
-  m_BlurFilter->SetVariance(
-        settings->GetGaussianBlurScale() * settings->GetGaussianBlurScale());
-#else
-  m_GPUBlurFilter->SetUseImageSpacingOff();
-  m_GPUBlurFilter->SetVariance(
-        settings->GetGaussianBlurScale() * settings->GetGaussianBlurScale());
-#endif
+  long istride[3] = { 1, size[0], size[0] * size[1] };
+  long ostride[3] = { 1, osize[0], osize[0] * osize[1] };
 
-  // Construct the functor
-  // TODO: fixme!
-  FunctorType functor;
-  functor.SetParameters(0.0, m_InputImageMaximumGradientMagnitude,
-                        settings->GetRemappingExponent(),
-                        settings->GetRemappingSteepness());
-
-  // Configure the remapping filter
-  m_RemapFilter->SetFunctor(functor);
-
-  // Graft outputs and update the filter
-  m_RemapFilter->GraftOutput(outputImage);
-  m_RemapFilter->Update();
-  this->GraftOutput(m_RemapFilter->GetOutput());
+  for(long z = 0; z < osize[2]; z++)
+    {
+    for(long y = 0; y < osize[1]; y++)
+      {
+      const RealType *pin = in + y * istride[1] + z * istride[2];
+      RealType *pout = out + y * ostride[1] + z * ostride[2];
+
+      if(axis == 0)
+        {
+        // Inner product along the contiguous direction
+        for(long x = 0; x < osize[0]; x++)
+          {
+          RealType sum = 0.0f;
+          for(long k = 0; k < width; k++)
+            sum += kernel[k] * pin[x + k];
+          pout[x] = sum;
+          }
+        }
+      else
+        {
+        // Accumulate whole rows, so that the inner loop stays contiguous
+        std::fill(pout, pout + osize[0], 0.0f);
+        for(long k = 0; k < width; k++)
+          {
+          const RealType *prow = pin + k * istride[axis];
+          RealType w = kernel[k];
+          for(long x = 0; x < osize[0]; x++)
+            pout[x] += w * prow[x];
+          }
+        }
+      }
+    }
+}
+
+template<typename TInputImage,typename TOutputImage>
+void
+EdgePreprocessingImageFilter<TInputImage,TOutputImage>
+::ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread,
+                       itk::ThreadIdType threadId)
+{
+  // Tile size. The x extent is kept long so that rows stay contiguous, while
+  // the y and z extents are small so that a tile plus its halo fits in cache
+  static const long TILE_SIZE[3] = { 128, 32, 16 };
+
+  const InputImageType *input = this->GetInput();
+  OutputImageType *output = this->GetOutput();
+
+  // The input is accessed directly through its buffer. Voxels outside of the
+  // buffered region are replaced by the nearest voxel inside of it, which is
+  // the boundary condition used by the Gaussian and gradient filters
+  const typename InputImageType::RegionType &bufRegion = input->GetBufferedRegion();
+  const InputPixelType *inBuffer = input->GetBufferPointer();
+  long lo[3], hi[3];
+  for(int d = 0; d < 3; d++)
+    {
+    lo[d] = bufRegion.GetIndex()[d];
+    hi[d] = lo[d] + static_cast<long>(bufRegion.GetSize()[d]) - 1;
+    }
+  long inStride[3] = { 1, hi[0] - lo[0] + 1, (hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) };
+
+  // Scaling of the central differences, matching GradientMagnitudeImageFilter
+  // which takes the image spacing into account
+  RealType dscale[3];
+  for(int d = 0; d < 3; d++)
+    dscale[d] = static_cast<RealType>(0.5 / input->GetSpacing()[d]);
+
+  const long r = m_KernelRadius;
+
+  // Break the region into tiles
+  long t0[3], tn[3], ntiles[3];
+  for(int d = 0; d < 3; d++)
+    {
+    t0[d] = outputRegionForThread.GetIndex()[d];
+    tn[d] = outputRegionForThread.GetSize()[d];
+    ntiles[d] = (tn[d] + TILE_SIZE[d] - 1) / TILE_SIZE[d];
+    }
+
+  itk::ProgressReporter progress(this, threadId, ntiles[0] * ntiles[1] * ntiles[2]);
+
+  // Each thread uses its own copy of the functor and its own buffers
+  FunctorType functor = m_Functor;
+  std::vector<RealType> bufA, bufB;
+
+  for(long iz = 0; iz < ntiles[2]; iz++)
+    {
+    for(long iy = 0; iy < ntiles[1]; iy++)
+      {
+      for(long ix = 0; ix < ntiles[0]; ix++)
+        {
+        // Extent of the tile
+        long tile[3] = { ix, iy, iz }, a[3], n[3];
+        for(int d = 0; d < 3; d++)
+          {
+          a[d] = t0[d] + tile[d] * TILE_SIZE[d];
+          n[d] = std::min(TILE_SIZE[d], t0[d] + tn[d] - a[d]);
+          }
+
+        // The block of blurred voxels that the central differences need. It
+        // extends one voxel past the tile, except at the edge of the image
+        long b[3], bn[3], e[3];
+        for(int d = 0; d < 3; d++)
+          {
+          b[d] = std::max(lo[d], a[d] - 1);
+          bn[d] = std::min(hi[d], a[d] + n[d]) - b[d] + 1;
+          e[d] = bn[d] + 2 * r;
+          }
+
+        // Gather the input over the block padded by the kernel radius
+        bufA.resize(e[0] * e[1] * e[2]);
+        bufB.resize(bn[0] * e[1] * e[2]);
+        RealType *p = &bufA[0];
+        for(long z = 0; z < e[2]; z++)
+          {
+          long zz = std::min(hi[2], std::max(lo[2], b[2] - r + z)) - lo[2];
+          for(long y = 0; y < e[1]; y++)
+            {
+            long yy = std::min(hi[1], std::max(lo[1], b[1] - r + y)) - lo[1];
+            const InputPixelType *row = inBuffer + yy * inStride[1] + zz * inStride[2];
+            for(long x = 0; x < e[0]; x++)
+              {
+              long xx = std::min(hi[0], std::max(lo[0], b[0] - r + x)) - lo[0];
+              *p++ = static_cast<RealType>(row[xx]);
+              }
+            }
+          }
+
+        // Separable blur: A -> B along x, B -> A along y, A -> B along z
+        long sx[3] = { e[0], e[1], e[2] };
+        this->ConvolveAlongAxis(&bufA[0], sx, 0, &bufB[0]);
+        long sy[3] = { bn[0], e[1], e[2] };
+        this->ConvolveAlongAxis(&bufB[0], sy, 1, &bufA[0]);
+        long sz[3] = { bn[0], bn[1], e[2] };
+        this->ConvolveAlongAxis(&bufA[0], sz, 2, &bufB[0]);
+
+        // Gradient magnitude by central differences on the blurred block,
+        // remapped to speed and written to the output
+        const RealType *blur = &bufB[0];
+        long bs[3] = { 1, bn[0], bn[0] * bn[1] };
+        for(long z = 0; z < n[2]; z++)
+          {
+          long cz = a[2] + z - b[2];
+          long zm = std::max(cz - 1, 0L), zp = std::min(cz + 1, bn[2] - 1);
+          for(long y = 0; y < n[1]; y++)
+            {
+            long cy = a[1] + y - b[1];
+            long ym = std::max(cy - 1, 0L), yp = std::min(cy + 1, bn[1] - 1);
+
+            typename OutputImageType::IndexType idx;
+            idx[0] = a[0]; idx[1] = a[1] + y; idx[2] = a[2] + z;
+            OutputPixelType *out = output->GetBufferPointer() + output->ComputeOffset(idx);
+
+            const RealType *rowYM = blur + ym * bs[1] + cz * bs[2];
+            const RealType *rowYP = blur + yp * bs[1] + cz * bs[2];
+            const RealType *rowZM = blur + cy * bs[1] + zm * bs[2];
+            const RealType *rowZP = blur + cy * bs[1] + zp * bs[2];
+            const RealType *row = blur + cy * bs[1] + cz * bs[2];
+
+            for(long x = 0; x < n[0]; x++)
+              {
+              long cx = a[0] + x - b[0];
+              long xm = std::max(cx - 1, 0L), xp = std::min(cx + 1, bn[0] - 1);
+              RealType gx = (row[xp] - row[xm]) * dscale[0];
+              RealType gy = (rowYP[cx] - rowYM[cx]) * dscale[1];
+              RealType gz = (rowZP[cx] - rowZM[cx]) * dscale[2];
+              out[x] = static_cast<OutputPixelType>(
+                    functor(std::sqrt(gx * gx + gy * gy + gz * gz)));
+              }
+            }
+          }
+
+        progress.CompletedPixel();
+        }
+      }
+    }
 }
 
 template<typename TInputImage,typename TOutputImage>
@@ -197,8 +337,16 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
     const_cast< TInputImage * >( this->GetInput() );
   OutputImagePointer outputPtr = this->GetOutput();
 
-  // Use the largest possible region (hack)
-  inputPtr->SetRequestedRegion(
-        inputPtr->GetLargestPossibleRegion());
-}
+  if(!inputPtr || !outputPtr)
+    return;
 
+  // The kernel radius depends on the settings
+  this->UpdateKernel();
+
+  // Pad the output requested region by the Gaussian kernel radius plus one
+  // voxel for the central differences
+  typename TInputImage::RegionType region = outputPtr->GetRequestedRegion();
+  region.PadByRadius(m_KernelRadius + 1);
+  region.Crop(inputPtr->GetLargestPossibleRegion());
+  inputPtr->SetRequestedRegion(region);
+}
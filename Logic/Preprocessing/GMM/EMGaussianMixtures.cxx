@@ -1,27 +1,24 @@
 #include "EMGaussianMixtures.h"
 #include <iostream>
+#include <algorithm>
 #include <ctime>
+#include <cmath>
+#include <limits>
 
-EMGaussianMixtures::EMGaussianMixtures(double **x, int dataSize, int dataDim, int numOfClass)
+// Number of samples in each block processed by a single thread. Blocks are
+// fixed in size so that partial sums are always combined in the same order
+static const int EM_BLOCK_SIZE = 4096;
+
+EMGaussianMixtures::EMGaussianMixtures(const double *x, int dataSize, int dataDim, int numOfClass)
   :m_x(x), m_numOfData(dataSize), m_dimOfGaussian(dataDim), m_numOfGaussian(numOfClass), m_setPriorFlag(0), m_numOfIteration(0), m_fail(0)
 {
-  m_latent = new double*[dataSize];
-  m_probs = new double[dataSize*numOfClass];
-  for (int i = 0; i < dataSize; i++)
-    {
-    m_latent[i] = &m_probs[i*numOfClass];
-    }
-  m_log_pdf = new double*[dataSize];
-  m_probs2 = new double[dataSize*numOfClass];
-  for (int i = 0; i < dataSize; i++)
-    {
-    m_log_pdf[i] = &m_probs2[i*numOfClass];
-    }
-  m_tmp1 = new double[numOfClass];
-  m_tmp2 = new double[dataDim];
-  m_tmp3 = new double[dataDim*dataDim];
+  m_latent = new double[dataSize*numOfClass];
+  m_log_pdf = new double[dataSize*numOfClass];
   m_sum = new double[numOfClass];
   m_weight = new double[numOfClass];
+  m_prior = NULL;
+
+  m_numOfBlocks = (dataSize + EM_BLOCK_SIZE - 1) / EM_BLOCK_SIZE;
 
   m_gmm = GaussianMixtureModel::New();
   m_gmm->Initialize(dataDim, numOfClass);
@@ -29,19 +26,28 @@ EMGaussianMixtures::EMGaussianMixtures(double **x, int dataSize, int dataDim, in
   m_maxIteration = 30;
   m_precision = 1.0e-7;
   m_logLikelihood = std::numeric_limits<double>::infinity();
+
+  this->Reset();
 }
 
 EMGaussianMixtures::~EMGaussianMixtures()
 {
-  delete m_probs;
-  delete m_probs2;
-  delete m_latent;
-  delete m_log_pdf;
-  delete m_tmp1;
-  delete m_tmp2;
-  delete m_tmp3;
-  delete m_sum;
-  delete m_weight;
+  delete[] m_latent;
+  delete[] m_log_pdf;
+  delete[] m_sum;
+  delete[] m_weight;
+}
+
+void EMGaussianMixtures::GetBlockRange(int block, int &i0, int &i1) const
+{
+  i0 = block * EM_BLOCK_SIZE;
+  i1 = std::min(i0 + EM_BLOCK_SIZE, m_numOfData);
+}
+
+double *EMGaussianMixtures::GetPartial(int stride)
+{
+  m_partial.assign(m_numOfBlocks * stride, 0.0);
+  return m_partial.data();
 }
 
 void EMGaussianMixtures::Reset(void)
@@ -49,11 +55,8 @@ void EMGaussianMixtures::Reset(void)
   m_numOfIteration = 0;
   m_fail = 0;
   m_logLikelihood = std::numeric_limits<double>::infinity();
-  for (int i = 0; i < m_numOfData*m_numOfGaussian; i++)
-    {
-    m_probs[i] = 0;
-    m_probs2[i] = 0;
-    }
+  std::fill(m_latent, m_latent + m_numOfData*m_numOfGaussian, 0.0);
+  std::fill(m_log_pdf, m_log_pdf + m_numOfData*m_numOfGaussian, 0.0);
 }
 
 void EMGaussianMixtures::SetMaxIteration(int maxIteration)
@@ -85,7 +88,7 @@ void EMGaussianMixtures::SetGaussianMixtureModel(GaussianMixtureModel *gmm)
     }
 }
 
-void EMGaussianMixtures::SetPrior(double **prior)
+void EMGaussianMixtures::SetPrior(const double *prior)
 {
   m_prior = prior;
   m_setPriorFlag = 1;
@@ -102,24 +105,35 @@ int EMGaussianMixtures::GetMaxIteration(void)
   return m_maxIteration;
 }
 
-double ** EMGaussianMixtures::Update(void)
+double EMGaussianMixtures::GetLogLikelihoodChange(double oldLogLikelihood, double newLogLikelihood) const
+{
+  // There is no previous value on the first iteration
+  if (!std::isfinite(oldLogLikelihood))
+    return std::numeric_limits<double>::infinity();
+
+  // The log-likelihood is a sum over the samples, so its change is divided
+  // by the number of samples to compare it to the precision
+  return (newLogLikelihood - oldLogLikelihood) / m_numOfData;
+}
+
+const double * EMGaussianMixtures::Update(void)
 {
-  double currentLogLikelihood = 0;
   m_numOfIteration = 0;
   m_fail = 0;
-  while ((fabs(m_logLikelihood - currentLogLikelihood) > m_precision) && (m_numOfIteration < m_maxIteration))
+  m_logLikelihood = std::numeric_limits<double>::infinity();
+  while (m_numOfIteration < m_maxIteration)
     {
-    if (m_logLikelihood < currentLogLikelihood)
+    ++m_numOfIteration;
+    EvaluatePDF();
+    double currentLogLikelihood = EvaluateLogLikelihood();
+    double change = GetLogLikelihoodChange(m_logLikelihood, currentLogLikelihood);
+    if (change < -m_precision)
       {
       m_fail = 1;
-      std::cout << "!!!!!! Log Likelihood increase, EM fails" << std::endl;
+      std::cout << "!!!!!! Log Likelihood decrease, EM fails" << std::endl;
       std::cout << "old=" <<m_logLikelihood << std::endl << "new=" << currentLogLikelihood << std::endl;
-      // break;
       }
-    ++m_numOfIteration;
     m_logLikelihood = currentLogLikelihood;
-    EvaluatePDF();
-    currentLogLikelihood = EvaluateLogLikelihood();
     UpdateLatent();
     UpdateMean();
     UpdateCovariance();
@@ -133,11 +147,14 @@ double ** EMGaussianMixtures::Update(void)
     std::cout << "log likelihood:" << std::endl << m_logLikelihood << std::endl;
     PrintParameters();
     //getchar();
+
+    if (fabs(change) <= m_precision)
+      break;
     }
   return m_latent;
 }
 
-double ** EMGaussianMixtures::UpdateOnce(void)
+const double * EMGaussianMixtures::UpdateOnce(void)
 {
   long start = 0;
   long end = 0;
@@ -149,13 +166,14 @@ double ** EMGaussianMixtures::UpdateOnce(void)
   double currentLogLikelihood = EvaluateLogLikelihood();
   end = clock();
   std::cout << "evaluate likelihood spending " << (end-start)/1000 << std::endl;
-  if (m_logLikelihood < currentLogLikelihood)
+  double change = GetLogLikelihoodChange(m_logLikelihood, currentLogLikelihood);
+  if (change < -m_precision)
     {
     m_fail = 1;
-    std::cout << "!!!!!! Log Likelihood increase, EM fails" << std::endl;
+    std::cout << "!!!!!! Log Likelihood decrease, EM fails" << std::endl;
     std::cout << "old=" <<m_logLikelihood << std::endl << "new=" << currentLogLikelihood << std::endl;
     }
-  if (fabs(m_logLikelihood - currentLogLikelihood) <= m_precision)
+  if (fabs(change) <= m_precision)
     {
     std::cout << "Log Likelihood converged" << std::endl;
     }
@@ -196,13 +214,18 @@ double ** EMGaussianMixtures::UpdateOnce(void)
 
 void EMGaussianMixtures::EvaluatePDF(void)
 {
-  for (int i = 0; i < m_numOfData; i++)
+  // Each task evaluates one Gaussian over one block of samples
+  int nTasks = m_numOfBlocks * m_numOfGaussian;
+
+#pragma omp parallel for schedule(dynamic)
+  for (int t = 0; t < nTasks; t++)
     {
-    for (int j = 0; j < m_numOfGaussian; j++)
-      {
-      m_log_pdf[i][j] = m_gmm->EvaluateLogPDF(j, m_x[i]);
-      }
+    int j = t % m_numOfGaussian, i0, i1;
+    GetBlockRange(t / m_numOfGaussian, i0, i1);
+    m_gmm->EvaluateLogPDF(j, m_x + i0, i1 - i0, m_numOfData,
+                          m_log_pdf + j * m_numOfData + i0);
     }
+
   if (m_setPriorFlag == 0)
     {
     for (int j = 0; j < m_numOfGaussian; j++)
@@ -266,161 +289,162 @@ double EMGaussianMixtures::ComputePosterior(int nGauss, double *log_pdf, double
 
 void EMGaussianMixtures::UpdateLatent(void)
 {
-  double sum = 0;
-  for (int i = 0; i < m_numOfGaussian; i++)
-    {
-    m_sum[i] = 0;
-    }
+  int N = m_numOfData, K = m_numOfGaussian;
+  double *partial = GetPartial(K);
 
   // Compute log of the weights and store in logw
-  vnl_vector<double> logw(m_numOfGaussian);
-  for(int i = 0; i < m_numOfGaussian; i++)
-    logw(i) = log(m_weight[i]);
-  
-  if (m_setPriorFlag == 0)
+  vnl_vector<double> logw(K);
+  for(int j = 0; j < K; j++)
+    logw(j) = log(m_weight[j]);
+
+#pragma omp parallel for
+  for (int b = 0; b < m_numOfBlocks; b++)
     {
-    for (int i = 0; i < m_numOfData; i++)
+    int i0, i1;
+    GetBlockRange(b, i0, i1);
+    double *sum = partial + b * K;
+
+    // Per-sample scratch arrays (gathered from the class-major arrays)
+    vnl_vector<double> lp(K), w(K), lw(K);
+    if (m_setPriorFlag == 0)
       {
-      for (int j = 0; j < m_numOfGaussian; j++)
-        {
-        m_latent[i][j] = ComputePosterior(m_numOfGaussian, m_log_pdf[i], m_weight, logw.data_block(), j);
-        m_sum[j] += m_latent[i][j];
-        }
+      w.copy_in(m_weight);
+      lw = logw;
+      }
 
+    for (int i = i0; i < i1; i++)
+      {
+      for (int j = 0; j < K; j++)
+        lp[j] = m_log_pdf[j * N + i];
 
-      /*
-      sum = 0;
-      for (int j = 0; j < m_numOfGaussian; j++)
+      // With a prior, the per-sample prior takes the place of the weights
+      if (m_setPriorFlag)
         {
-        m_tmp1[j] = m_weight[j] * m_pdf[i][j];
-        sum += m_tmp1[j];
-        }
-      if(sum == 0)
-        {
-        for (int j = 0; j < m_numOfGaussian; j++)
+        for (int j = 0; j < K; j++)
           {
-          m_latent[i][j] = 1.0 / m_numOfGaussian;
-          m_sum[j] += m_latent[i][j];
+          w[j] = m_prior[j * N + i];
+          lw[j] = log(w[j]);
           }
         }
-      else
+
+      for (int j = 0; j < K; j++)
         {
-        for (int j = 0; j < m_numOfGaussian; j++)
-          {
-          m_latent[i][j] = m_tmp1[j] / sum;
-          m_sum[j] += m_latent[i][j];
-          }
+        double post = ComputePosterior(K, lp.data_block(), w.data_block(), lw.data_block(), j);
+        m_latent[j * N + i] = post;
+        sum[j] += post;
         }
-        */
       }
     }
-  else
+
+  // Combine the partial sums in block order
+  for (int j = 0; j < K; j++)
     {
-    /**= THIS IS NOT USED
-    for (int i = 0; i < m_numOfData; i++)
-      {
-      sum = 0;
-      for (int j = 0; j < m_numOfGaussian; j++)
-        {
-        m_tmp1[j] = m_prior[i][j] * m_pdf[i][j];
-        sum += m_tmp1[j];
-        }
-      for (int j = 0; j < m_numOfGaussian; j++)
-        {
-        m_latent[i][j] = m_tmp1[j] / sum;
-        m_sum[j] += m_latent[i][j];
-        }
-      }
-      */
+    m_sum[j] = 0;
+    for (int b = 0; b < m_numOfBlocks; b++)
+      m_sum[j] += partial[b * K + j];
     }
 }
 
 void EMGaussianMixtures::UpdateMean(void)
 {
-  for (int i = 0; i < m_numOfGaussian; i++)
+  int N = m_numOfData, K = m_numOfGaussian, D = m_dimOfGaussian;
+  double *partial = GetPartial(K * D);
+
+#pragma omp parallel for
+  for (int b = 0; b < m_numOfBlocks; b++)
     {
-    for (int j = 0; j < m_dimOfGaussian; j++)
-      {
-      m_tmp2[j] = 0;
-      }
-    
-    for (int j = 0; j < m_numOfData; j++)
+    int i0, i1;
+    GetBlockRange(b, i0, i1);
+    for (int j = 0; j < K; j++)
       {
-      for (int k = 0; k < m_dimOfGaussian; k++)
+      const double *lj = m_latent + j * N;
+      for (int k = 0; k < D; k++)
         {
-        m_tmp2[k] += m_latent[j][i] * m_x[j][k];
+        const double *xk = m_x + k * N;
+        double s = 0;
+        for (int i = i0; i < i1; i++)
+          s += lj[i] * xk[i];
+        partial[(b * K + j) * D + k] = s;
         }
       }
+    }
+
+  VectorType mean(D);
+  for (int j = 0; j < K; j++)
+    {
+    mean.fill(0.0);
+    for (int b = 0; b < m_numOfBlocks; b++)
+      for (int k = 0; k < D; k++)
+        mean[k] += partial[(b * K + j) * D + k];
 
     // This can lead to a possible divide by zero situation. In case the sum
-    // of latent variables for class i is zero, we set the mean of that class
+    // of latent variables for class j is zero, we set the mean of that class
     // to infinity
-    if(m_sum[i] > 0)
-      {
-      for (int j = 0; j < m_dimOfGaussian; j++)
-        {
-        m_tmp2[j] = m_tmp2[j] / m_sum[i];
-        }
-      }
+    if(m_sum[j] > 0)
+      mean /= m_sum[j];
     else
-      {
-      for (int j = 0; j < m_dimOfGaussian; j++)
-        {
-        m_tmp2[j] = - std::numeric_limits<double>::infinity();
-        }
-      }
-
+      mean.fill(- std::numeric_limits<double>::infinity());
 
-    m_gmm->SetMean(i, VectorType(m_tmp2, m_dimOfGaussian));
+    m_gmm->SetMean(j, mean);
     }
 }
 
 void EMGaussianMixtures::UpdateCovariance(void)
 {
-  for (int i = 0; i < m_numOfGaussian; i++)
+  int N = m_numOfData, K = m_numOfGaussian, D = m_dimOfGaussian;
+  double *partial = GetPartial(K * D * D);
+
+  // Copy the current means into a contiguous array
+  std::vector<double> mu(K * D);
+  for (int j = 0; j < K; j++)
+    for (int k = 0; k < D; k++)
+      mu[j * D + k] = m_gmm->GetMean(j)[k];
+
+#pragma omp parallel for
+  for (int b = 0; b < m_numOfBlocks; b++)
     {
-    const VectorType &current_mean = m_gmm->GetMean(i);
-    
-    for (int j = 0; j < m_dimOfGaussian; j++)
-      {
-      for (int k = 0; k < m_dimOfGaussian; k++)
-        {
-        m_tmp3[j*m_dimOfGaussian+k] = 0;
-        }
-      }
-    
-    for (int j = 0; j < m_numOfData; j++)
+    int i0, i1;
+    GetBlockRange(b, i0, i1);
+    for (int j = 0; j < K; j++)
       {
-      for (int k = 0; k < m_dimOfGaussian; k++)
+      const double *lj = m_latent + j * N;
+      double *cov = partial + (b * K + j) * D * D;
+      for (int k = 0; k < D; k++)
         {
-        m_tmp2[k] = m_x[j][k] - current_mean[k];
-        }
-      for (int k = 0; k < m_dimOfGaussian; k++)
-        {
-        for (int l = 0; l < m_dimOfGaussian; l++)
+        const double *xk = m_x + k * N;
+        double mk = mu[j * D + k];
+        for (int l = k; l < D; l++)
           {
-          m_tmp3[k*m_dimOfGaussian+l] += m_tmp2[k] * m_tmp2[l] * m_latent[j][i];
+          const double *xl = m_x + l * N;
+          double ml = mu[j * D + l];
+          double s = 0;
+          for (int i = i0; i < i1; i++)
+            s += lj[i] * (xk[i] - mk) * (xl[i] - ml);
+          cov[k * D + l] = s;
+          cov[l * D + k] = s;
           }
         }
       }
+    }
 
-    if(m_sum[i] > 0)
-      {
-      for (int j = 0; j < m_dimOfGaussian*m_dimOfGaussian; j++)
-        {
-        m_tmp3[j] = m_tmp3[j] / m_sum[i];
-        }
-      }
-    else
+  MatrixType cov(D, D);
+  for (int j = 0; j < K; j++)
+    {
+    cov.fill(0.0);
+    for (int b = 0; b < m_numOfBlocks; b++)
       {
-      for (int j = 0; j < m_dimOfGaussian*m_dimOfGaussian; j++)
-        {
-        m_tmp3[j] = 0.0;
-        }
+      const double *pc = partial + (b * K + j) * D * D;
+      for (int k = 0; k < D; k++)
+        for (int l = 0; l < D; l++)
+          cov(k,l) += pc[k * D + l];
       }
 
+    if(m_sum[j] > 0)
+      cov /= m_sum[j];
+    else
+      cov.fill(0.0);
 
-    m_gmm->SetCovariance(i, MatrixType(m_tmp3, m_dimOfGaussian, m_dimOfGaussian));
+    m_gmm->SetCovariance(j, cov);
     }
 }
 
@@ -434,35 +458,41 @@ void EMGaussianMixtures::UpdateWeight(void)
 
 double EMGaussianMixtures::EvaluateLogLikelihood(void)
 {
-  double tmp1 = 0;
-  double tmp2 = 0;
-  if (m_setPriorFlag == 0)
-    {
-    for (int i = 0; i < m_numOfData; i++)
-      {
-      tmp1 = 0;
-      for (int j = 0; j < m_numOfGaussian; j++)
-        {
-        if(!m_gmm->GetGaussian(j)->isDeltaFunction())
-          tmp1 += m_weight[j] * exp(m_log_pdf[i][j]);
-        }
-      tmp2 += log(tmp1);
-      }
-    }
-  else
+  int N = m_numOfData, K = m_numOfGaussian;
+  double *partial = GetPartial(1);
+
+  // Delta functions are excluded from the likelihood
+  std::vector<int> use(K);
+  for (int j = 0; j < K; j++)
+    use[j] = !m_gmm->GetGaussian(j)->isDeltaFunction();
+
+#pragma omp parallel for
+  for (int b = 0; b < m_numOfBlocks; b++)
     {
-    for (int i = 0; i < m_numOfData; i++)
+    int i0, i1;
+    GetBlockRange(b, i0, i1);
+    double s = 0;
+    for (int i = i0; i < i1; i++)
       {
-      tmp1 = 0;
-      for (int j = 0; j < m_numOfGaussian; j++)
+      double p = 0;
+      for (int j = 0; j < K; j++)
         {
-        if(!m_gmm->GetGaussian(j)->isDeltaFunction())
-          tmp1 += m_prior[i][j] * exp(m_log_pdf[i][j]);
+        if(use[j])
+          {
+          double w = m_setPriorFlag ? m_prior[j * N + i] : m_weight[j];
+          p += w * exp(m_log_pdf[j * N + i]);
+          }
         }
-      tmp2 += log(tmp1);
+      s += log(p);
       }
+    partial[b] = s;
     }
-  return tmp1;
+
+  double loglik = 0;
+  for (int b = 0; b < m_numOfBlocks; b++)
+    loglik += partial[b];
+
+  return loglik;
 }
 
 void EMGaussianMixtures::PrintParameters(void)
@@ -3,11 +3,20 @@
 
 #include "GaussianMixtureModel.h"
 #include "SNAPCommon.h"
+#include <vector>
 
+/**
+ * Expectation-maximization for Gaussian mixture models. The samples and the
+ * latent variables are kept in contiguous structure-of-arrays buffers: the
+ * k-th component of sample i is x[k * dataSize + i], and the posterior of
+ * class j for sample i is latent[j * dataSize + i]. The E and M steps are
+ * parallelized over fixed-size blocks of samples; partial sums are combined
+ * in block order, so the results do not depend on the number of threads.
+ */
 class EMGaussianMixtures
 {
 public:
-  EMGaussianMixtures(double **x, int dataSize, int dataDim, int numOfClass);
+  EMGaussianMixtures(const double *x, int dataSize, int dataDim, int numOfClass);
   ~EMGaussianMixtures();
 
   typedef Gaussian::MatrixType MatrixType;
@@ -21,16 +30,20 @@ public:
                      const MatrixType &covariance,
                      double weight);
   void SetGaussianMixtureModel(GaussianMixtureModel *gmm);
-  void SetPrior(double **prior);
+  /** Set per-sample class priors, in the same layout as the latent array */
+  void SetPrior(const double *prior);
   void RemovePrior(void);
 
   GaussianMixtureModel *GetGaussianMixtureModel() const { return m_gmm; }
 
+  /** Get the posterior array, latent[j * dataSize + i] */
+  const double *GetLatent() const { return m_latent; }
+
   
   int GetMaxIteration(void);
 
-  double ** Update(void);
-  double ** UpdateOnce(void);
+  const double * Update(void);
+  const double * UpdateOnce(void);
   double EvaluateLogLikelihood(void);
   void PrintParameters(void);
 
@@ -43,27 +56,35 @@ private:
   void UpdateCovariance(void);
   void UpdateWeight(void);
   
-  double **m_latent;
-  double **m_log_pdf;
-  double **m_prior;
-  double **m_x;
-  double *m_probs;
-  double *m_probs2;
-  double *m_tmp1;
-  double *m_tmp2;
-  double *m_tmp3;
+  // Range of samples [i0, i1) in the given block
+  void GetBlockRange(int block, int &i0, int &i1) const;
+
+  // Partial sums for each block, m_partial[block * stride + ...]
+  double *GetPartial(int stride);
+
+  // Change in the log-likelihood per sample, which is compared to the
+  // precision. Infinite if there is no previous log-likelihood
+  double GetLogLikelihoodChange(double oldLogLikelihood, double newLogLikelihood) const;
+
+  double *m_latent;
+  double *m_log_pdf;
+  const double *m_prior;
+  const double *m_x;
   double *m_sum;
   double *m_weight;
   double m_logLikelihood;
-  int m_numOfGaussian;
+  int m_numOfData;
   int m_dimOfGaussian;
+  int m_numOfGaussian;
+  int m_numOfBlocks;
   int m_maxIteration;
   int m_numOfIteration;
-  int m_numOfData;
   int m_setPriorFlag;
   int m_fail;
   double m_precision;
 
+  std::vector<double> m_partial;
+
   SmartPtr<GaussianMixtureModel> m_gmm;
 };
 
@@ -4,6 +4,7 @@
 #include <vnl/vnl_trace.h>
 #include <vnl/algo/vnl_symmetric_eigensystem.h>
 #include <limits>
+#include <algorithm>
 
 Gaussian::Gaussian(int dimension)
   :m_dimension(dimension)
@@ -95,6 +96,54 @@ double Gaussian::EvaluateLogPDF(VectorType &x, VectorType &xscratch)
   return 0.5 * logz;
 }
 
+void Gaussian::EvaluateLogPDF(const double *x, int n, int stride, double *out) const
+{
+  // Samples are processed in small blocks so that the projections onto the
+  // eigenvectors stay in cache and the inner loops run over contiguous data
+  const int BLOCK = 256;
+  double z[BLOCK];
+
+  for(int b = 0; b < n; b += BLOCK)
+    {
+    int nb = std::min(BLOCK, n - b);
+    double *ob = out + b;
+    for(int i = 0; i < nb; i++)
+      ob[i] = 0.0;
+
+    for(int j = 0; j < m_dimension; j++)
+      {
+      // Project the mean-subtracted samples onto the j-th eigenvector
+      for(int i = 0; i < nb; i++)
+        z[i] = 0.0;
+
+      for(int k = 0; k < m_dimension; k++)
+        {
+        const double *xk = x + k * stride + b;
+        double v_jk = m_Vt(j,k), mu_k = m_mean_vector[k];
+        for(int i = 0; i < nb; i++)
+          z[i] += v_jk * (xk[i] - mu_k);
+        }
+
+      // Same logic as the single-sample code above
+      if(m_Lambda[j] == 0)
+        {
+        for(int i = 0; i < nb; i++)
+          if(z[i] != 0)
+            ob[i] = -std::numeric_limits<double>::infinity();
+        }
+      else
+        {
+        double fac = m_DiagNormFac[j], lambda = m_Lambda[j];
+        for(int i = 0; i < nb; i++)
+          ob[i] -= fac + (z[i] * z[i] / lambda);
+        }
+      }
+
+    for(int i = 0; i < nb; i++)
+      ob[i] *= 0.5;
+    }
+}
+
 double Gaussian::EvaluatePDF(double *x)
 {
   // We got to exponentiate somewhere, so might as well do it here
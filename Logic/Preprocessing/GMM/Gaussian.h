@@ -26,6 +26,11 @@ public:
   // Evaluate log PDF with user-provided scratch buffer
   double EvaluateLogPDF(VectorType &x, VectorType &xscratch);
 
+  // Evaluate log PDF for n samples stored in structure-of-arrays layout, i.e.,
+  // component k of sample i is x[k * stride + i]. This method does not use
+  // any member scratch buffers and can be called from multiple threads.
+  void EvaluateLogPDF(const double *x, int n, int stride, double *out) const;
+
   void PrintParameters();
 
   // Tests whether the Gaussian is a delta function (i.e., has zero total variance)
@@ -151,6 +151,13 @@ double GaussianMixtureModel::EvaluateLogPDF(
   return m_gaussian[index]->EvaluateLogPDF(x, xscratch);
 }
 
+void GaussianMixtureModel::EvaluateLogPDF(
+    int index, const double *x, int n, int stride, double *out)
+{
+  assert(index < m_numOfGaussian);
+  m_gaussian[index]->EvaluateLogPDF(x, n, stride, out);
+}
+
 
 void GaussianMixtureModel::PrintParameters()
 {
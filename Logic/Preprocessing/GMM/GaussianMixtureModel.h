@@ -38,6 +38,9 @@ public:
   double EvaluateLogPDF(int index, vnl_vector<double> &x, VectorType &xscratch);
   double EvaluatePDF(int index, double *x);
 
+  // Batch evaluation over samples in structure-of-arrays layout (thread-safe)
+  void EvaluateLogPDF(int index, const double *x, int n, int stride, double *out);
+
 
   void PrintParameters();
 
@@ -2,8 +2,12 @@
 #include "math.h"
 #include "time.h"
 #include "stdlib.h"
+#include <algorithm>
 
-KMeansPlusPlus::KMeansPlusPlus(double **x, int dataSize, int dataDim, int numOfClusters)
+// Number of samples processed by one thread at a time
+static const int KMEANS_BLOCK_SIZE = 4096;
+
+KMeansPlusPlus::KMeansPlusPlus(const double *x, int dataSize, int dataDim, int numOfClusters)
   :m_dataSize(dataSize), m_dataDim(dataDim), m_numOfClusters(numOfClusters)
 {
   m_x = x;
@@ -12,119 +16,146 @@ KMeansPlusPlus::KMeansPlusPlus(double **x, int dataSize, int dataDim, int numOfC
   m_xCounter = new int[numOfClusters];
   m_distance = new double[dataSize];
 
+  m_numOfBlocks = (dataSize + KMEANS_BLOCK_SIZE - 1) / KMEANS_BLOCK_SIZE;
+  m_blockDistSum.resize(m_numOfBlocks, 0.0);
+
   m_gmm = GaussianMixtureModel::New();
   m_gmm->Initialize(dataDim, numOfClusters);
 }
 
 KMeansPlusPlus::~KMeansPlusPlus()
 {
-  delete m_centers;
-  delete m_xCenter;
-  delete m_xCounter;
-  delete m_distance;
+  delete[] m_centers;
+  delete[] m_xCenter;
+  delete[] m_xCounter;
+  delete[] m_distance;
+}
+
+void KMeansPlusPlus::GetBlockRange(int block, int &i0, int &i1) const
+{
+  i0 = block * KMEANS_BLOCK_SIZE;
+  i1 = std::min(i0 + KMEANS_BLOCK_SIZE, m_dataSize);
 }
 
-double KMeansPlusPlus::Distance(const double *x, const double *y)
+double KMeansPlusPlus::Distance(int i, const double *y) const
 {
   double tmp = 0;
-  for (int i = 0; i < m_dataDim; i++)
+  for (int k = 0; k < m_dataDim; k++)
   {
-    tmp += (x[i] - y[i]) * (x[i] - y[i]);
+    double d = m_x[k * m_dataSize + i] - y[k];
+    tmp += d * d;
   }
   return sqrt(tmp);
 }
 
-void KMeansPlusPlus::Initialize(void)
+void KMeansPlusPlus::UpdateDistances(int c)
 {
-  // for (int i = 0; i < numOfClusters; i++)
-  // {
-  //   m_xCounter[i] = 0;
-  // }
-
-  srand(time(0));
-
-  m_centers[0] = (int)(((double) rand() / (double) RAND_MAX) * m_dataSize);
-  double distSum = 0;
-  for (int i = 0; i < m_dataSize; i++)
-    {
-    m_xCenter[i] = m_centers[0];
-    m_distance[i] = Distance(m_x[i], m_x[m_centers[0]]);
-    distSum += m_distance[i];
-    }
-  m_xCounter[0] = m_dataSize;
+  // Gather the coordinates of the new center
+  std::vector<double> center(m_dataDim);
+  for (int k = 0; k < m_dataDim; k++)
+    center[k] = m_x[k * m_dataSize + m_centers[c]];
 
-  double probDist = 0;
-  double currentSum = 0;
-  int idx = 0;
-  for (int i = 1; i < m_numOfClusters; i++)
+#pragma omp parallel for
+  for (int b = 0; b < m_numOfBlocks; b++)
     {
-    m_xCounter[i] = 0;
-    probDist = ((double) rand() / (double) RAND_MAX) * distSum;
-    currentSum = 0;
-    for (idx = 0; idx < m_dataSize; idx++)
+    int i0, i1;
+    GetBlockRange(b, i0, i1);
+    double distSum = 0;
+    for (int i = i0; i < i1; i++)
       {
-      currentSum += m_distance[idx];
-      if (currentSum >= probDist)
+      double dist = Distance(i, center.data());
+      if (c == 0 || m_distance[i] > dist)
         {
-        break;
+        m_distance[i] = dist;
+        m_xCenter[i] = c;
         }
+      distSum += m_distance[i];
       }
+    m_blockDistSum[b] = distSum;
+    }
+}
 
-    m_centers[i] = idx;
+int KMeansPlusPlus::SampleByDistance(void)
+{
+  double distSum = 0;
+  for (int b = 0; b < m_numOfBlocks; b++)
+    distSum += m_blockDistSum[b];
 
-    distSum = 0;
-    for (int j = 0; j < m_dataSize; j++)
-      {
-      if (m_distance[j] > Distance(m_x[j], m_x[m_centers[i]]))
-        {
-        ++m_xCounter[i];
-        for (int k = 0; k < i; k++)
-          {
-          if (m_centers[k] == m_xCenter[j])
-            {
-            --m_xCounter[k];
-            break;
-            }
-          }
-        m_distance[j] = Distance(m_x[j], m_x[m_centers[i]]);
-        m_xCenter[j] = m_centers[i];
-        }
-      distSum += m_distance[j];
-      }
+  double probDist = ((double) rand() / (double) RAND_MAX) * distSum;
+
+  // Find the block where the cumulative distance reaches probDist
+  double currentSum = 0;
+  int b = 0;
+  while (b < m_numOfBlocks - 1 && currentSum + m_blockDistSum[b] < probDist)
+    currentSum += m_blockDistSum[b++];
+
+  // Find the sample within the block
+  int i0, i1;
+  GetBlockRange(b, i0, i1);
+  for (int i = i0; i < i1; i++)
+    {
+    currentSum += m_distance[i];
+    if (currentSum >= probDist)
+      return i;
     }
 
-  Gaussian::VectorType tmpMean(m_dataDim, 0.0);
-  for (int i = 0; i < m_numOfClusters; i++)
+  return i1 - 1;
+}
+
+void KMeansPlusPlus::Initialize(void)
+{
+  srand(time(0));
+
+  // Pick the first center at random, then pick each subsequent center with
+  // probability proportional to the distance to the closest existing center
+  m_centers[0] = std::min(
+        (int)(((double) rand() / (double) RAND_MAX) * m_dataSize), m_dataSize - 1);
+  UpdateDistances(0);
+
+  for (int c = 1; c < m_numOfClusters; c++)
     {
-    m_gmm->SetMean(i, tmpMean);
+    m_centers[c] = SampleByDistance();
+    UpdateDistances(c);
     }
 
-  for (int i = 0; i < m_dataSize; i++)
+  // Accumulate the counts, sums and radii of the clusters for each block
+  int K = m_numOfClusters, D = m_dataDim;
+  std::vector<int> blockCount(m_numOfBlocks * K, 0);
+  std::vector<double> blockSum(m_numOfBlocks * K * D, 0.0);
+
+#pragma omp parallel for
+  for (int b = 0; b < m_numOfBlocks; b++)
     {
-    for (int j = 0; j < m_numOfClusters; j++)
+    int i0, i1;
+    GetBlockRange(b, i0, i1);
+    int *count = &blockCount[b * K];
+    double *sum = &blockSum[b * K * D];
+    for (int i = i0; i < i1; i++)
       {
-      if (m_xCenter[i] == m_centers[j])
-        {
-        tmpMean = m_gmm->GetMean(j);
-        for (int k = 0; k < m_dataDim; k++)
-          {
-          tmpMean[k] = tmpMean[k] + m_x[i][k];
-          }
-        m_gmm->SetMean(j, tmpMean);
-        break;
-        }
+      int c = m_xCenter[i];
+      count[c]++;
+      for (int k = 0; k < D; k++)
+        sum[c * D + k] += m_x[k * m_dataSize + i];
       }
     }
-  // m_gmm->PrintParameters();
-  // getchar();
-  for (int i = 0; i < m_numOfClusters; i++)
+
+  Gaussian::VectorType tmpMean(D);
+  std::vector<double> means(K * D);
+  for (int c = 0; c < K; c++)
     {
-    tmpMean = m_gmm->GetMean(i);
+    m_xCounter[c] = 0;
+    tmpMean.fill(0.0);
+    for (int b = 0; b < m_numOfBlocks; b++)
+      {
+      m_xCounter[c] += blockCount[b * K + c];
+      for (int k = 0; k < D; k++)
+        tmpMean[k] += blockSum[(b * K + c) * D + k];
+      }
 
-    if(m_xCounter[i] > 0)
+    if(m_xCounter[c] > 0)
       {
       // If this class is not empty, we set its mean
-      tmpMean /= m_xCounter[i];
+      tmpMean /= m_xCounter[c];
       }
     else
       {
@@ -132,42 +163,42 @@ void KMeansPlusPlus::Initialize(void)
       tmpMean.fill(-std::numeric_limits<double>::infinity());
       }
 
-    m_gmm->SetMean(i, tmpMean);
+    m_gmm->SetMean(c, tmpMean);
+    std::copy(tmpMean.begin(), tmpMean.end(), means.begin() + c * D);
     }
 
-  double *radius = new double[m_numOfClusters];
-  for (int i = 0; i < m_numOfClusters; i++)
-    {
-    radius[i] = 0;
-    }
-  for (int i = 0; i < m_dataSize; i++)
+  // Compute the radius of each cluster (largest distance to the mean)
+  std::vector<double> blockRadius(m_numOfBlocks * K, 0.0);
+
+#pragma omp parallel for
+  for (int b = 0; b < m_numOfBlocks; b++)
     {
-    for (int j = 0; j < m_numOfClusters; j++)
+    int i0, i1;
+    GetBlockRange(b, i0, i1);
+    double *radius = &blockRadius[b * K];
+    for (int i = i0; i < i1; i++)
       {
-      if (m_xCenter[i] == m_centers[j])
-        {
-        double dist = Distance(m_x[i], m_gmm->GetMean(j).data_block());
-        if (radius[j] < dist)
-          {
-          radius[j] = dist;
-          }
-        break;
-        }
+      int c = m_xCenter[i];
+      double dist = Distance(i, &means[c * D]);
+      if (radius[c] < dist)
+        radius[c] = dist;
       }
     }
 
-  Gaussian::MatrixType tmpcovar(m_dataDim, m_dataDim, 0);
-  for (int i = 0; i < m_numOfClusters; i++)
+  Gaussian::MatrixType tmpcovar(D, D, 0);
+  for (int c = 0; c < K; c++)
     {
-    for (int j = 0; j < m_dataDim; j++)
+    double radius = 0;
+    for (int b = 0; b < m_numOfBlocks; b++)
+      radius = std::max(radius, blockRadius[b * K + c]);
+
+    for (int j = 0; j < D; j++)
       {
-      tmpcovar(j,j) = radius[i];
+      tmpcovar(j,j) = radius;
       }
-    m_gmm->SetCovariance(i, tmpcovar);
+    m_gmm->SetCovariance(c, tmpcovar);
     }
 
-  delete[] radius;
-
   for (int i = 0; i < m_numOfClusters; i++)
     {
     m_gmm->SetWeight(i, 1.0/(double) m_numOfClusters);
@@ -3,18 +3,34 @@
 
 #include "GaussianMixtureModel.h"
 #include "SNAPCommon.h"
+#include <vector>
 
+/**
+ * K-means++ seeding of a Gaussian mixture model. The data is in the same
+ * structure-of-arrays layout as in EMGaussianMixtures, i.e., the k-th
+ * component of sample i is x[k * dataSize + i]. Distance updates and the
+ * accumulation of cluster statistics are parallelized over blocks of samples.
+ */
 class KMeansPlusPlus
 {
 public:
-  KMeansPlusPlus(double **x, int dataSize, int dataDim, int numOfClusters);
+  KMeansPlusPlus(const double *x, int dataSize, int dataDim, int numOfClusters);
   ~KMeansPlusPlus();
 
-  double Distance(const double *x, const double *y);
+  /** Distance between sample i and a point y */
+  double Distance(int i, const double *y) const;
   void Initialize(void);
   GaussianMixtureModel * GetGaussianMixtureModel(void);
 private:
-  double **m_x;
+  // Assign samples to cluster c if it is closer than their current center
+  void UpdateDistances(int c);
+
+  // Draw a sample with probability proportional to its distance
+  int SampleByDistance(void);
+
+  void GetBlockRange(int block, int &i0, int &i1) const;
+
+  const double *m_x;
   int *m_xCenter;
   int *m_centers;
   int *m_xCounter;
@@ -22,6 +38,11 @@ private:
   int m_dataSize;
   int m_dataDim;
   int m_numOfClusters;
+  int m_numOfBlocks;
+
+  // Sum of distances in each block
+  std::vector<double> m_blockDistSum;
+
   SmartPtr<GaussianMixtureModel> m_gmm;
 };
 
@@ -6,11 +6,17 @@
 #include "ImageWrapper.h"
 #include "ImageWrapperTraits.h"
 
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
 #include <algorithm>
 
+const int UnsupervisedClustering::DEFAULT_MAX_SAMPLES = 100000;
+
 UnsupervisedClustering::UnsupervisedClustering()
 {
   m_ClusteringEM = NULL;
+  m_ClusteringInitializer = NULL;
+  m_DataSource = NULL;
   m_NumberOfClusters = 3;
   m_DataArray = NULL;
   m_NumberOfSamples = 0;
@@ -25,15 +31,7 @@ UnsupervisedClustering::~UnsupervisedClustering()
     }
 
   if(m_DataArray)
-    {
-    // Delete the main data buffer
-    delete m_DataArray[0];
-
-    // Delete the pointers into the buffer
-    delete m_DataArray;
-    }
-
-
+    delete[] m_DataArray;
 }
 
 
@@ -45,7 +43,7 @@ void UnsupervisedClustering::SetDataSource(SNAPImageData *imageData)
     m_SamplesDirty = true;
 
     int nvox = m_DataSource->GetMain()->GetNumberOfVoxels();
-    m_NumberOfSamples = (nvox > 10000) ? 10000 : nvox;
+    m_NumberOfSamples = std::min(nvox, DEFAULT_MAX_SAMPLES);
     }
 }
 
@@ -55,26 +53,43 @@ void UnsupervisedClustering::SetMixtureModel(GaussianMixtureModel *model)
   m_MixtureModel = m_ClusteringEM->GetGaussianMixtureModel();
 }
 
-#include "itkImageRandomConstIteratorWithIndex.hxx"
-
 void UnsupervisedClustering::SampleDataSource()
 {
   if(m_DataArray)
-    {
-    // Delete the main data buffer
-    delete m_DataArray[0];
+    delete[] m_DataArray;
 
-    // Delete the pointers into the buffer
-    delete m_DataArray;
-    }
+  // Collect the raw buffers of the layers and the number of data components.
+  // In SNAP mode all of these layers share the voxel grid of the speed image,
+  // so the buffers can be read directly, without going through the slicers
+  typedef AnatomicScalarImageWrapper::ImageType ScalarImageType;
+  typedef AnatomicImageWrapper::ImageType VectorImageType;
+
+  std::vector<const itk::ImageBase<3> *> layerImage;
+  std::vector<const GreyType *> layerBuffer;
+  std::vector<int> layerComp;
 
-  // Figure out the number of data components
   unsigned int nComp = 0;
   for(LayerIterator lit = m_DataSource->GetLayers(
         MAIN_ROLE | OVERLAY_ROLE);
       !lit.IsAtEnd(); ++lit)
     {
-    nComp += lit.GetLayer()->GetNumberOfComponents();
+    if(lit.GetLayerAsScalar())
+      {
+      AnatomicScalarImageWrapper *w = dynamic_cast<AnatomicScalarImageWrapper *>(lit.GetLayer());
+      ScalarImageType *img = w->GetImage();
+      layerImage.push_back(img);
+      layerBuffer.push_back(img->GetBufferPointer());
+      layerComp.push_back(1);
+      }
+    else
+      {
+      AnatomicImageWrapper *w = dynamic_cast<AnatomicImageWrapper *>(lit.GetLayer());
+      VectorImageType *img = w->GetImage();
+      layerImage.push_back(img);
+      layerBuffer.push_back(img->GetBufferPointer());
+      layerComp.push_back(img->GetNumberOfComponentsPerPixel());
+      }
+    nComp += layerComp.back();
     }
 
   // Size the data array
@@ -82,55 +97,66 @@ void UnsupervisedClustering::SampleDataSource()
   int nsam = (m_NumberOfSamples == 0) ? nvox : m_NumberOfSamples;
 
   // Create data structure for the EM code
-  m_DataArray = new double *[nsam];
-  double *buffer = new double[nsam * nComp];
-  for(int i = 0; i < nsam; i++, buffer+=nComp)
-    m_DataArray[i] = buffer;
-
-  // Create a random walk through the speed image, which should be initialized
-  // at this point. We iterate over the speed image because we can easily access
-  // its internal image (it's always a scalar image)
+  m_DataArray = new double[nsam * nComp];
+
+  // The sample locations are drawn in the space of the speed image, which
+  // should be initialized at this point.
   assert(m_DataSource->IsSpeedLoaded());
   typedef SpeedImageWrapper::ImageType SpeedImage;
-
   SpeedImage *speed = m_DataSource->GetSpeed()->GetImage();
-  typedef itk::ImageRandomConstIteratorWithIndex<SpeedImage> RandomIter;
-  RandomIter itRand(speed, speed->GetBufferedRegion());
-  itRand.SetNumberOfSamples(nsam);
+  itk::ImageRegion<3> region = speed->GetBufferedRegion();
 
-  // Initialize the 'central' samples list
-  m_CenterSamples.clear();
-  m_CenterSamples.reserve(400);
+  // Draw random voxel offsets (with replacement, as ImageRandomConstIterator
+  // does) and sort them so that the buffers are read in memory order.
+  std::vector<itk::OffsetValueType> offsets(nsam);
+  if(nsam == nvox)
+    {
+    for(int i = 0; i < nsam; i++)
+      offsets[i] = i;
+    }
+  else
+    {
+    typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RNG;
+    RNG::Pointer rng = RNG::GetInstance();
+    for(int i = 0; i < nsam; i++)
+      offsets[i] = rng->GetIntegerVariate(nvox - 1);
+    std::sort(offsets.begin(), offsets.end());
+    }
 
-  // Define the center region
-  itk::ImageRegion<3> rcenter = speed->GetBufferedRegion();
-  rcenter.ShrinkByRadius(to_itkSize(Vector3d(rcenter.GetSize()) * 0.2));
+  // Copy the voxel values into the structure-of-arrays buffer
+  int nLayers = (int) layerBuffer.size();
 
-  // Do the random walk
-  int pVoxel = 0;
-  for(; !itRand.IsAtEnd(); ++itRand)
+#pragma omp parallel for
+  for(int i = 0; i < nsam; i++)
     {
-    // Go to the next sample location
-    itk::Index<3> idx = itRand.GetIndex();
-
-    // TODO: this is a really slow way to collect samples!
+    itk::Index<3> idx = speed->ComputeIndex(offsets[i]);
     int iOffset = 0;
-    for(LayerIterator lit = m_DataSource->GetLayers(MAIN_ROLE | OVERLAY_ROLE);
-        !lit.IsAtEnd(); ++lit)
+    for(int l = 0; l < nLayers; l++)
       {
-      ImageWrapperBase *iw = lit.GetLayer();
-      iw->GetVoxelAsDouble(idx, m_DataArray[pVoxel] + iOffset);
-      iOffset += iw->GetNumberOfComponents();
+      int nc = layerComp[l];
+      const GreyType *p = layerBuffer[l] + layerImage[l]->ComputeOffset(idx) * nc;
+      for(int k = 0; k < nc; k++, iOffset++)
+        m_DataArray[iOffset * nsam + i] = p[k];
       }
+    }
 
-    // Store as a 'central' sample if in the central 60% of the image
-    if(m_CenterSamples.size() < 400 && rcenter.IsInside(idx))
-      {
-      m_CenterSamples.push_back(pVoxel);
-      }
+  // Define the center region
+  itk::ImageRegion<3> rcenter = region;
+  rcenter.ShrinkByRadius(to_itkSize(Vector3d(rcenter.GetSize()) * 0.2));
 
-    pVoxel++;
-    }
+  // Store up to 400 'central' samples (in the central 60% of the image). Since
+  // the samples are sorted, we take them at a regular stride so that they are
+  // spread over the whole central region
+  std::vector<int> central;
+  for(int i = 0; i < nsam; i++)
+    if(rcenter.IsInside(speed->ComputeIndex(offsets[i])))
+      central.push_back(i);
+
+  m_CenterSamples.clear();
+  m_CenterSamples.reserve(400);
+  size_t stride = std::max((size_t) 1, central.size() / 400);
+  for(size_t j = 0; j < central.size() && m_CenterSamples.size() < 400; j += stride)
+    m_CenterSamples.push_back(central[j]);
 
   m_NumberOfVoxels = nsam;
 
@@ -202,7 +228,8 @@ void UnsupervisedClustering::InitializeEM()
 void UnsupervisedClustering::SortClustersByRelevance()
 {
   int ng = m_MixtureModel->GetNumberOfGaussians();
-  vnl_vector<double> log_pdf(ng), log_w(ng), w(ng);
+  int nc = m_MixtureModel->GetNumberOfComponents();
+  vnl_vector<double> log_pdf(ng), log_w(ng), w(ng), x(nc), x_scratch(nc);
 
   // the array to sort
   typedef std::pair<double, int> RelevancePair;
@@ -219,9 +246,12 @@ void UnsupervisedClustering::SortClustersByRelevance()
   for(int i = 0; i < m_CenterSamples.size(); i++)
     {
     int s = m_CenterSamples[i];
+    for(int d = 0; d < nc; d++)
+      x[d] = m_DataArray[d * m_NumberOfVoxels + s];
+
     for(int k = 0; k < ng; k++)
       {
-      log_pdf[k] = m_MixtureModel->EvaluateLogPDF(k, m_DataArray[s]);
+      log_pdf[k] = m_MixtureModel->EvaluateLogPDF(k, x, x_scratch);
       }
 
     for(int k = 0; k < ng; k++)
@@ -254,7 +284,7 @@ void UnsupervisedClustering::SortClustersByRelevance()
 void UnsupervisedClustering::Iterate()
 {
   long start = clock();
-  double **post = m_ClusteringEM->UpdateOnce();
+  m_ClusteringEM->UpdateOnce();
   m_MixtureModel->PrintParameters();
   long end = clock();
   std::cout << "spending " << (end-start)/1000 << std::endl;
@@ -50,12 +50,16 @@ protected:
   GaussianMixtureModel *m_MixtureModel;
   SNAPImageData *m_DataSource;
 
+  // Default cap on the number of samples drawn from the image
+  static const int DEFAULT_MAX_SAMPLES;
+
   int m_NumberOfClusters, m_NumberOfComponents, m_NumberOfVoxels, m_NumberOfSamples;
 
   bool m_SamplesDirty;
 
-  // TODO: probably double is larger than we need
-  double **m_DataArray;
+  // Samples in structure-of-arrays layout: component k of sample i is stored
+  // in m_DataArray[k * m_NumberOfVoxels + i]
+  double *m_DataArray;
 
   // A set of samples located near the center of the image, used to sort
   // initial clusters in terms of relevance to the user
@@ -1,8 +1,10 @@
 #include "MomentTextures.h"
 #include "itkImage.h"
 #include "itkVectorImage.h"
-#include "itkImageRegionIteratorWithIndex.h"
-#include "itkNeighborhoodIterator.h"
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <cmath>
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -11,71 +13,358 @@ const int MAX_VAL=100000;
 
 namespace bilwaj {
 
+namespace {
+
+/**
+ * Compensated (Neumaier) summation. The running window sums below add values
+ * and later subtract them again; without compensation, the rounding residue
+ * of large intensities that have left the window can swamp the moments of a
+ * neighborhood with a small intensity range.
+ */
+struct CompensatedSum
+{
+  double sum, comp;
+
+  void Reset() { sum = 0.0; comp = 0.0; }
+
+  void Add(double x)
+  {
+    double t = sum + x;
+    comp += (std::fabs(sum) >= std::fabs(x)) ? (sum - t) + x : (x - t) + sum;
+    sum = t;
+  }
+
+  double Get() const { return sum + comp; }
+};
+
+inline long ClampIndex(long i, long lo, long hi)
+{
+  return (i < lo) ? lo : ((i > hi) ? hi : i);
+}
+
+/**
+ * Sliding-window minimum (of inmin) and maximum (of inmax) with window w over
+ * a line of n values spaced by 'step', using monotone queues (amortized O(1)
+ * per value). Writes n - w + 1 outputs spaced by 'ostep'. The queue arrays
+ * must hold n entries.
+ */
+void SlidingMinMax(const float *inmin, const float *inmax, long step, long n, long w,
+                   float *omin, float *omax, long ostep, long *qmin, long *qmax)
+{
+  long hmin = 0, tmin = 0, hmax = 0, tmax = 0;
+  for(long i = 0; i < n; i++)
+    {
+    float vmin = inmin[i * step], vmax = inmax[i * step];
+    while(tmin > hmin && inmin[qmin[tmin-1] * step] >= vmin)
+      tmin--;
+    qmin[tmin++] = i;
+    while(tmax > hmax && inmax[qmax[tmax-1] * step] <= vmax)
+      tmax--;
+    qmax[tmax++] = i;
+
+    // Output whose window ends at i
+    long o = i - w + 1;
+    if(o >= 0)
+      {
+      while(qmin[hmin] < o)
+        hmin++;
+      while(qmax[hmax] < o)
+        hmax++;
+      omin[o * ostep] = inmin[qmin[hmin] * step];
+      omax[o * ostep] = inmax[qmax[hmax] * step];
+      }
+    }
+}
+
+/**
+ * Computes, for one input plane, the box sums of the powers of the intensity
+ * and the box minimum and maximum over the x-y extent of the neighborhood,
+ * for every voxel of the output region. Sums are stored as
+ * psum[(y * nx + x) * nv + c * nd + k] for the power k+1 of component c.
+ */
+template <class TComponent>
+class MomentTexturePlaneWorker
+{
+public:
+  MomentTexturePlaneWorker(const TComponent *buffer, const long *lo, const long *hi,
+                           const long *o0, const long *n, const long *r,
+                           int nc, int nd)
+    : m_Buffer(buffer), m_NC(nc), m_ND(nd), m_NV(nc * nd)
+  {
+    for(int d = 0; d < 3; d++)
+      {
+      m_Lo[d] = lo[d]; m_Hi[d] = hi[d];
+      m_O0[d] = o0[d]; m_N[d] = n[d]; m_W[d] = 2 * r[d] + 1;
+      }
+
+    m_Stride[0] = 1;
+    m_Stride[1] = hi[0] - lo[0] + 1;
+    m_Stride[2] = m_Stride[1] * (hi[1] - lo[1] + 1);
+
+    m_EX = m_N[0] + m_W[0] - 1;
+    m_EY = m_N[1] + m_W[1] - 1;
+
+    m_LineVal.resize(m_EX * m_NC);
+    m_LinePow.resize(m_EX * m_NV);
+    m_RowSum.resize(m_EY * m_N[0] * m_NV);
+    m_RowMin.resize(m_EY * m_N[0] * m_NC);
+    m_RowMax.resize(m_EY * m_N[0] * m_NC);
+    m_ColSum.resize(m_N[0] * m_NV);
+    m_QMin.resize(std::max(m_EX, m_EY));
+    m_QMax.resize(std::max(m_EX, m_EY));
+  }
+
+  void ComputePlane(long z, double *psum, float *pmin, float *pmax)
+  {
+    long nx = m_N[0], ny = m_N[1];
+
+    // Pass along x for each row of the extended neighborhood
+    for(long ty = 0; ty < m_EY; ty++)
+      {
+      long y = ClampIndex(m_O0[1] - (m_W[1] - 1) / 2 + ty, m_Lo[1], m_Hi[1]);
+      const TComponent *row = m_Buffer +
+          ((z - m_Lo[2]) * m_Stride[2] + (y - m_Lo[1]) * m_Stride[1]) * m_NC;
+
+      // Gather the row with replicated edges and compute the powers
+      for(long tx = 0; tx < m_EX; tx++)
+        {
+        long x = ClampIndex(m_O0[0] - (m_W[0] - 1) / 2 + tx, m_Lo[0], m_Hi[0]);
+        const TComponent *p = row + (x - m_Lo[0]) * m_NC;
+        for(int c = 0; c < m_NC; c++)
+          {
+          double v = p[c], vk = v;
+          double *lp = &m_LinePow[tx * m_NV + c * m_ND];
+          m_LineVal[tx * m_NC + c] = (float) v;
+          lp[0] = v;
+          for(int k = 1; k < m_ND; k++)
+            {
+            vk *= v;
+            lp[k] = vk;
+            }
+          }
+        }
+
+      // Running window sums along x
+      double *rs = &m_RowSum[ty * nx * m_NV];
+      for(int i = 0; i < m_NV; i++)
+        {
+        CompensatedSum cs;
+        cs.Reset();
+        for(long tx = 0; tx < m_W[0]; tx++)
+          cs.Add(m_LinePow[tx * m_NV + i]);
+        rs[i] = cs.Get();
+        for(long t = 1; t < nx; t++)
+          {
+          cs.Add(m_LinePow[(t + m_W[0] - 1) * m_NV + i]);
+          cs.Add(-m_LinePow[(t - 1) * m_NV + i]);
+          rs[t * m_NV + i] = cs.Get();
+          }
+        }
+
+      // Window minimum and maximum along x
+      for(int c = 0; c < m_NC; c++)
+        {
+        SlidingMinMax(&m_LineVal[c], &m_LineVal[c], m_NC, m_EX, m_W[0],
+                      &m_RowMin[ty * nx * m_NC + c], &m_RowMax[ty * nx * m_NC + c], m_NC,
+                      &m_QMin[0], &m_QMax[0]);
+        }
+      }
+
+    // Pass along y, one output row at a time
+    long rowLen = nx * m_NV;
+    for(long j = 0; j < rowLen; j++)
+      m_ColSum[j].Reset();
+
+    for(long ty = 0; ty < m_W[1]; ty++)
+      for(long j = 0; j < rowLen; j++)
+        m_ColSum[j].Add(m_RowSum[ty * rowLen + j]);
+
+    for(long j = 0; j < rowLen; j++)
+      psum[j] = m_ColSum[j].Get();
+
+    for(long u = 1; u < ny; u++)
+      {
+      const double *rin = &m_RowSum[(u + m_W[1] - 1) * rowLen];
+      const double *rout = &m_RowSum[(u - 1) * rowLen];
+      double *ps = psum + u * rowLen;
+      for(long j = 0; j < rowLen; j++)
+        {
+        m_ColSum[j].Add(rin[j]);
+        m_ColSum[j].Add(-rout[j]);
+        ps[j] = m_ColSum[j].Get();
+        }
+      }
+
+    // Window minimum and maximum along y
+    for(long t = 0; t < nx * m_NC; t++)
+      {
+      SlidingMinMax(&m_RowMin[t], &m_RowMax[t], nx * m_NC, m_EY, m_W[1],
+                    pmin + t, pmax + t, nx * m_NC, &m_QMin[0], &m_QMax[0]);
+      }
+  }
+
+protected:
+  const TComponent *m_Buffer;
+  long m_Lo[3], m_Hi[3], m_O0[3], m_N[3], m_W[3], m_Stride[3];
+  long m_EX, m_EY;
+  int m_NC, m_ND, m_NV;
+
+  std::vector<float> m_LineVal, m_RowMin, m_RowMax;
+  std::vector<double> m_LinePow, m_RowSum;
+  std::vector<CompensatedSum> m_ColSum;
+  std::vector<long> m_QMin, m_QMax;
+};
+
+} // anonymous namespace
+
 template <class TInputImage, class TOutputImage>
 void
 MomentTextureFilter<TInputImage, TOutputImage>
 ::ThreadedGenerateData(const RegionType & outputRegionForThread,
                        itk::ThreadIdType threadId)
 {
-  // Iterator for the output region
-  typedef itk::ImageRegionIteratorWithIndex<OutputImageType> OutputIteratorType;
-  OutputIteratorType TexIt(this->GetOutput(), outputRegionForThread);
+  const InputImageType *input = this->GetInput();
+  OutputImageType *output = this->GetOutput();
+
+  // Number of components in the input and number of moments per component
+  const int nc = input->GetNumberOfComponentsPerPixel();
+  const int nd = m_HighestDegree;
+  const int nv = nc * nd;
+
+  // Extent of the input buffer, and of the region handled by this thread
+  const RegionType &inRegion = input->GetBufferedRegion();
+  long lo[3], hi[3], o0[3], n[3], r[3];
+  for(int d = 0; d < 3; d++)
+    {
+    lo[d] = inRegion.GetIndex(d);
+    hi[d] = lo[d] + inRegion.GetSize(d) - 1;
+    o0[d] = outputRegionForThread.GetIndex(d);
+    n[d] = outputRegionForThread.GetSize(d);
+    r[d] = m_Radius[d];
+    }
 
-  // Neighborhood iterator for the input region
-  typedef itk::ConstNeighborhoodIterator<InputImageType> NeighborhoodIterator;
-  NeighborhoodIterator InpIt(m_Radius,this->GetInput(), outputRegionForThread);
+  if(n[0] == 0 || n[1] == 0 || n[2] == 0)
+    return;
 
-  // Accumulator array
-  vnl_vector<float> accumX(m_HighestDegree);
-  OutputPixelType out_pix(m_HighestDegree);
+  // The planes needed to slide the window by one slice along z are kept in a
+  // ring buffer, indexed by the input slice
+  MomentTexturePlaneWorker<InputComponentType> worker(
+        input->GetBufferPointer(), lo, hi, o0, n, r, nc, nd);
 
-  for( TexIt.GoToBegin(); !TexIt.IsAtEnd(); ++TexIt, ++InpIt)
+  const long planeSize = n[0] * n[1];
+  const long nring = 2 * r[2] + 2;
+  std::vector<double> ringSum(nring * planeSize * nv);
+  std::vector<float> ringMin(nring * planeSize * nc), ringMax(nring * planeSize * nc);
+  std::vector<long> ringZ(nring, LONG_MIN);
+
+  // Running sums along z for each voxel of the output slice
+  std::vector<CompensatedSum> acc(planeSize * nv);
+
+  // Binomial coefficients for expanding central moments in terms of raw sums
+  vnl_matrix<double> binom(nd + 1, nd + 1, 0.0);
+  for(int k = 0; k <= nd; k++)
     {
-    // On the first pass through the neighborhood compute the mean intensity and
-    // the intensity range in the neighborhood
-    float accum=0.0;
-    float min=0; //Store minimum voxel intensity value
-    float max=0; //Store maximum voxel intensity value
+    binom(k, 0) = 1.0;
+    for(int j = 1; j <= k; j++)
+      binom(k, j) = binom(k - 1, j - 1) + ((j < k) ? binom(k - 1, j) : 0.0);
+    }
 
-    for(int j=0;j<InpIt.Size();j++)
+  const double count = (2.0 * r[0] + 1) * (2.0 * r[1] + 1) * (2.0 * r[2] + 1);
+  vnl_vector<double> raw(nd + 1);
+
+  // Output buffer, written directly
+  OutputComponentType *outBuffer = output->GetBufferPointer();
+  const int nout = output->GetNumberOfComponentsPerPixel();
+
+  for(long z = o0[2]; z < o0[2] + n[2]; z++)
+    {
+    // Make sure all the planes in the window [z-r-1, z+r] are in the ring
+    long zfirst = ClampIndex(z - r[2] - 1, lo[2], hi[2]);
+    long zlast = ClampIndex(z + r[2], lo[2], hi[2]);
+    for(long zp = zfirst; zp <= zlast; zp++)
       {
-      InputPixelType pix = InpIt.GetPixel(j);
-      accum += pix;
-      min=MIN(min, pix);
-      max=MAX(max, pix);
+      long slot = (zp - lo[2]) % nring;
+      if(ringZ[slot] != zp)
+        {
+        worker.ComputePlane(zp,
+                            &ringSum[slot * planeSize * nv],
+                            &ringMin[slot * planeSize * nc],
+                            &ringMax[slot * planeSize * nc]);
+        ringZ[slot] = zp;
+        }
       }
 
-    float range = max-min;
-    float mean = accum / InpIt.Size();
-
-    // On the second pass, compute the moments
-    accumX.fill(0.0f);
-    for(int j=0;j<InpIt.Size();j++)
+    // Update the running sums along z. Slices past the edge of the image
+    // replicate the edge slice, so they are counted more than once
+    if(z == o0[2])
       {
-      InputPixelType pix = InpIt.GetPixel(j);
-      float norm_val = ((pix - mean) / range), norm_val_k = norm_val;
-      accumX[0] += norm_val;
-      for(int k = 1; k < m_HighestDegree; k++)
+      for(long j = 0; j < planeSize * nv; j++)
+        acc[j].Reset();
+      for(long dz = -r[2]; dz <= r[2]; dz++)
         {
-        norm_val_k *= norm_val;
-        accumX[k] += norm_val_k;
+        long slot = (ClampIndex(z + dz, lo[2], hi[2]) - lo[2]) % nring;
+        const double *ps = &ringSum[slot * planeSize * nv];
+        for(long j = 0; j < planeSize * nv; j++)
+          acc[j].Add(ps[j]);
+        }
+      }
+    else
+      {
+      const double *pin = &ringSum[((zlast - lo[2]) % nring) * planeSize * nv];
+      const double *pout = &ringSum[((zfirst - lo[2]) % nring) * planeSize * nv];
+      for(long j = 0; j < planeSize * nv; j++)
+        {
+        acc[j].Add(pin[j]);
+        acc[j].Add(-pout[j]);
         }
       }
 
-    // Scale the moments by neighborhood size
-    accumX /= InpIt.Size();
+    // Compute the features for each voxel in the output slice
+    long zmin = ClampIndex(z - r[2], lo[2], hi[2]);
+    for(long t = 0; t < planeSize; t++)
+      {
+      typename OutputImageType::IndexType idx;
+      idx[0] = o0[0] + t % n[0];
+      idx[1] = o0[1] + t / n[0];
+      idx[2] = z;
+      OutputComponentType *out = outBuffer + output->ComputeOffset(idx) * nout;
 
-    // The first moment should just be the mean
-    accumX[0] = mean / range;
+      for(int c = 0; c < nc; c++)
+        {
+        // Range over the neighborhood. As in the original implementation of
+        // this filter, the minimum and maximum start at zero
+        float min = 0, max = 0;
+        for(long zp = zmin; zp <= zlast; zp++)
+          {
+          long k = ((zp - lo[2]) % nring) * planeSize * nc + t * nc + c;
+          min = MIN(min, ringMin[k]);
+          max = MAX(max, ringMax[k]);
+          }
+        double range = max - min;
 
-    // Assign to the output voxel
-    for(int k = 0; k < m_HighestDegree; k++)
-      {
-      out_pix[k] = static_cast<OutputComponentType>(1000 * accumX[k]);
-      }
+        // Raw moments E[x^j] of the neighborhood
+        raw[0] = 1.0;
+        for(int j = 1; j <= nd; j++)
+          raw[j] = acc[t * nv + c * nd + j - 1].Get() / count;
+        double mean = raw[1];
 
-    // Assign to the output voxel
-    TexIt.Set(out_pix);
+        // The first feature is the mean, the rest are central moments,
+        // expanded as sum_j C(k,j) E[x^j] (-mean)^(k-j)
+        OutputComponentType *oc = out + c * nd;
+        oc[0] = static_cast<OutputComponentType>(range > 0 ? 1000 * mean / range : 0);
+        for(int k = 2; k <= nd; k++)
+          {
+          double mk = 0.0, mpow = 1.0;
+          for(int j = k; j >= 0; j--)
+            {
+            mk += binom(k, j) * raw[j] * mpow;
+            mpow *= -mean;
+            }
+          oc[k - 1] = static_cast<OutputComponentType>(
+                range > 0 ? 1000 * mk / std::pow(range, k) : 0);
+          }
+        }
+      }
     }
 }
 
@@ -85,10 +374,32 @@ MomentTextureFilter<TInputImage, TOutputImage>
 ::UpdateOutputInformation()
 {
   Superclass::UpdateOutputInformation();
-  this->GetOutput()->SetNumberOfComponentsPerPixel(m_HighestDegree);
+  this->GetOutput()->SetNumberOfComponentsPerPixel(
+        m_HighestDegree * this->GetInput()->GetNumberOfComponentsPerPixel());
+}
+
+template <class TInputImage, class TOutputImage>
+void
+MomentTextureFilter<TInputImage, TOutputImage>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  // Pad the requested region by the radius of the neighborhood
+  InputImageType *input = const_cast<InputImageType *>(this->GetInput());
+  if(input)
+    {
+    RegionType region = input->GetRequestedRegion();
+    region.PadByRadius(m_Radius);
+    region.Crop(input->GetLargestPossibleRegion());
+    input->SetRequestedRegion(region);
+    }
 }
 
 template class MomentTextureFilter<itk::Image<short, 3>, itk::VectorImage<short, 3> >;
+template class MomentTextureFilter<itk::Image<float, 3>, itk::VectorImage<float, 3> >;
+template class MomentTextureFilter<itk::VectorImage<short, 3>, itk::VectorImage<short, 3> >;
+template class MomentTextureFilter<itk::VectorImage<float, 3>, itk::VectorImage<float, 3> >;
 
 /*
 //Returns the estimated moment around the mean associated of the degree(th) order
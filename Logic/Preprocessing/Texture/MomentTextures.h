@@ -13,6 +13,19 @@ template <class TImage> class ImageRegionIteratorWithIndex;
 
 namespace bilwaj {
 
+/**
+ * Computes moment texture features in a box neighborhood around each voxel.
+ * For every component of the input, the output holds HighestDegree values:
+ * the neighborhood mean divided by the intensity range, followed by the
+ * central moments of order 2..HighestDegree, normalized by the range. The
+ * range always includes zero, and all features are scaled by 1000.
+ *
+ * The features are computed from separable running sums of the powers of the
+ * intensity, so the cost per voxel is O(HighestDegree) for the moments and
+ * does not grow with the volume of the neighborhood. Neighborhoods that cross
+ * the edge of the image use replicated edge voxels. The input may be a scalar
+ * image or a VectorImage; the filter is only implemented for 3D images.
+ */
 template <class TInputImage, class TOutputImage>
 class MomentTextureFilter
     : public itk::ImageToImageFilter<TInputImage, TOutputImage>
@@ -33,6 +46,7 @@ public:
   typedef typename InputImageType::RegionType          RegionType;
   typedef typename InputImageType::SizeType            SizeType;
   typedef typename InputImageType::PixelType           InputPixelType;
+  typedef typename InputImageType::InternalPixelType   InputComponentType;
   typedef TOutputImage                                 OutputImageType;
   typedef typename OutputImageType::PixelType          OutputPixelType;
   typedef typename OutputImageType::InternalPixelType  OutputComponentType;
@@ -55,6 +69,8 @@ protected:
 
   virtual void UpdateOutputInformation() ITK_OVERRIDE;
 
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
   // Highest degree for which to generate the textures
   unsigned int m_HighestDegree;
 
@@ -0,0 +1,169 @@
+#ifndef BrickedImage_h
+#define BrickedImage_h
+
+#include <utility>
+#include <vector>
+#include <itkImageBase.h>
+#include "RLELine.h"
+
+/** Label image stored as a grid of bricks (tiles of VBrickSize^3 voxels),
+* each of which is encoded in the way that suits its contents.
+*
+* RLEImage compresses label images very well when they consist of a few
+* large structures, but is counterproductive for fragmented label maps
+* (automatic parcellations, supervoxels) whose lines contain hundreds of
+* runs. In this image, each brick is either
+*   - constant, storing a single value (empty space, interior of structures),
+*   - run-length encoded along x, with RLELine lines of VBrickSize pixels,
+*   - dense, storing every voxel,
+* whichever takes the least memory. The encoding is chosen when the brick is
+* imported or filled, and chosen again after a number of voxels in the brick
+* have been edited, so it follows the contents as the segmentation changes.
+*
+* Bricks at the upper edges of the image are cropped to the image. Different
+* bricks can be read and written by different threads at the same time, but
+* a brick must not be written by more than one thread at a time.
+*/
+template< typename TPixel, unsigned int VBrickSize = 32 >
+class BrickedImage : public itk::ImageBase< 3 >
+{
+public:
+    /** Standard class typedefs */
+    typedef BrickedImage                        Self;
+    typedef itk::ImageBase< 3 >                 Superclass;
+    typedef itk::SmartPointer< Self >           Pointer;
+    typedef itk::SmartPointer< const Self >     ConstPointer;
+    typedef itk::WeakPointer< const Self >      ConstWeakPointer;
+
+    /** Method for creation through the object factory. */
+    itkNewMacro(Self);
+
+    /** Run-time type information (and related methods). */
+    itkTypeMacro(BrickedImage, ImageBase);
+
+    typedef TPixel PixelType;
+    typedef TPixel ValueType;
+    typedef TPixel InternalPixelType;
+
+    itkStaticConstMacro(ImageDimension, unsigned int, 3);
+    itkStaticConstMacro(BrickSize, unsigned int, VBrickSize);
+
+    typedef typename Superclass::IndexType      IndexType;
+    typedef typename Superclass::IndexValueType IndexValueType;
+    typedef typename Superclass::SizeType       SizeType;
+    typedef typename Superclass::RegionType     RegionType;
+
+    /** Run-length encoded line within a brick */
+    typedef std::pair< unsigned short, TPixel > RLSegment;
+    typedef RLELine< RLSegment >                RLLine;
+
+    /** How the voxels of a brick are stored */
+    enum BrickEncoding { BRICK_CONSTANT = 0, BRICK_RLE, BRICK_DENSE };
+
+    /** Allocate the bricks, which are all set to the default pixel value */
+    virtual void Allocate(bool initialize = false) ITK_OVERRIDE;
+
+    /** Release the bricks */
+    virtual void Initialize() ITK_OVERRIDE;
+
+    /** Set all the voxels to a value */
+    void FillBuffer(const TPixel & value);
+
+    /** Get the value of a voxel */
+    TPixel GetPixel(const IndexType & index) const;
+
+    /** Set the value of a voxel. The brick is converted to another encoding
+    * if needed, and its encoding is chosen again after enough edits. */
+    void SetPixel(const IndexType & index, const TPixel & value);
+
+    /** Read the n voxels along x starting at the given index, which must all
+    * lie in the same brick. Used by the region iterators. */
+    void GetRow(const IndexType & start, unsigned int n, TPixel *out) const;
+
+    /** Encode the image from a dense buffer of the buffered region (x fastest) */
+    void Import(const TPixel *buffer);
+
+    /** Decode the image into a dense buffer of the buffered region */
+    void Export(TPixel *buffer) const;
+
+    /** Choose the encoding of every brick again */
+    void Optimize();
+
+    /** Copy the voxels in the plane index[axis] = sliceIndex into a buffer.
+    * The voxel at offset i from the start of the buffered region is written to
+    * origin + sum_d i[d] * stride[d], so that the slice can be transposed and
+    * flipped on the way. Used by IRISSlicer. */
+    void CopySlice(unsigned int axis, IndexValueType sliceIndex,
+                   TPixel *origin, const long stride[3]) const;
+
+    /** Number of bricks along each axis */
+    const SizeType & GetBrickGridSize() const { return m_GridSize; }
+
+    /** Encoding of the brick that contains a voxel */
+    BrickEncoding GetBrickEncoding(const IndexType & index) const;
+
+    /** Number of bricks with each encoding */
+    unsigned long GetNumberOfBricks(BrickEncoding encoding) const;
+
+    /** Approximate number of bytes used to store the voxels */
+    unsigned long GetMemoryFootprint() const;
+
+    virtual unsigned int GetNumberOfComponentsPerPixel() const ITK_OVERRIDE
+    {
+        return 1;
+    }
+
+protected:
+    BrickedImage() { m_GridSize.Fill(0); }
+    virtual ~BrickedImage() {}
+    void PrintSelf(std::ostream & os, itk::Indent indent) const ITK_OVERRIDE;
+
+    struct Brick
+    {
+        unsigned char encoding;
+        unsigned int size[3];
+        unsigned int edits;
+        TPixel value;
+        std::vector< TPixel > dense;
+        std::vector< RLLine > lines;
+    };
+
+    // Find the brick containing a voxel, and the position of the voxel in it
+    Brick & LocateBrick(const IndexType & index, unsigned int local[3]);
+    const Brick & LocateBrick(const IndexType & index, unsigned int local[3]) const;
+
+    // Decode n voxels of the row (y, z) of a brick, starting at x, writing
+    // them to out with the given stride
+    static void DecodeRow(const Brick & brick, unsigned int x, unsigned int y,
+                          unsigned int z, unsigned int n, TPixel *out, long stride);
+
+    // Get a single voxel of a brick
+    static TPixel GetBrickVoxel(const Brick & brick, unsigned int x, unsigned int y,
+                                unsigned int z);
+
+    // Encode a brick from its voxels (x fastest), choosing the best encoding
+    static void EncodeBrick(Brick & brick, const TPixel *voxels);
+
+    // Choose the encoding of a brick again, based on its current contents
+    static void ReencodeBrick(Brick & brick);
+
+    // Memory used by the voxels of a brick
+    static unsigned long GetBrickFootprint(const Brick & brick);
+
+    // Offset of the first voxel of a brick from the start of the buffered region
+    void GetBrickOrigin(size_t brickIndex, long origin[3]) const;
+
+private:
+    BrickedImage(const Self &);    //purposely not implemented
+    void operator=(const Self &);  //purposely not implemented
+
+    SizeType m_GridSize;
+    std::vector< Brick > m_Bricks;
+};
+
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "BrickedImage.txx"
+#endif
+
+#endif //BrickedImage_h
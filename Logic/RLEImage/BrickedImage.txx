@@ -0,0 +1,474 @@
+#ifndef BrickedImage_txx
+#define BrickedImage_txx
+
+#include "BrickedImage.h"
+#include <algorithm>
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::Allocate(bool itkNotUsed(initialize))
+{
+    this->ComputeOffsetTable();
+
+    SizeType size = this->GetBufferedRegion().GetSize();
+    size_t nBricks = 1;
+    for (unsigned int d = 0; d < 3; d++)
+    {
+        m_GridSize[d] = (size[d] + VBrickSize - 1) / VBrickSize;
+        nBricks *= m_GridSize[d];
+    }
+
+    // All bricks start out constant, holding the default value
+    m_Bricks.clear();
+    m_Bricks.resize(nBricks);
+    for (size_t b = 0; b < nBricks; b++)
+    {
+        Brick & brick = m_Bricks[b];
+        long origin[3];
+        this->GetBrickOrigin(b, origin);
+        for (unsigned int d = 0; d < 3; d++)
+            brick.size[d] = std::min((long) VBrickSize, (long) size[d] - origin[d]);
+        brick.encoding = BRICK_CONSTANT;
+        brick.edits = 0;
+        brick.value = TPixel();
+    }
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::Initialize()
+{
+    Superclass::Initialize();
+    m_Bricks.clear();
+    m_GridSize.Fill(0);
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::FillBuffer(const TPixel & value)
+{
+    for (size_t b = 0; b < m_Bricks.size(); b++)
+    {
+        Brick & brick = m_Bricks[b];
+        std::vector< TPixel >().swap(brick.dense);
+        std::vector< RLLine >().swap(brick.lines);
+        brick.encoding = BRICK_CONSTANT;
+        brick.edits = 0;
+        brick.value = value;
+    }
+    this->Modified();
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::GetBrickOrigin(size_t brickIndex, long origin[3]) const
+{
+    origin[0] = (brickIndex % m_GridSize[0]) * VBrickSize;
+    origin[1] = ((brickIndex / m_GridSize[0]) % m_GridSize[1]) * VBrickSize;
+    origin[2] = (brickIndex / (m_GridSize[0] * m_GridSize[1])) * VBrickSize;
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+inline typename BrickedImage< TPixel, VBrickSize >::Brick &
+BrickedImage< TPixel, VBrickSize >
+::LocateBrick(const IndexType & index, unsigned int local[3])
+{
+    const IndexType & start = this->GetBufferedRegion().GetIndex();
+    size_t b[3];
+    for (unsigned int d = 0; d < 3; d++)
+    {
+        long offset = index[d] - start[d];
+        b[d] = offset / VBrickSize;
+        local[d] = offset % VBrickSize;
+    }
+    return m_Bricks[b[0] + m_GridSize[0] * (b[1] + m_GridSize[1] * b[2])];
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+inline const typename BrickedImage< TPixel, VBrickSize >::Brick &
+BrickedImage< TPixel, VBrickSize >
+::LocateBrick(const IndexType & index, unsigned int local[3]) const
+{
+    return const_cast< Self * >(this)->LocateBrick(index, local);
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+inline TPixel BrickedImage< TPixel, VBrickSize >
+::GetBrickVoxel(const Brick & brick, unsigned int x, unsigned int y, unsigned int z)
+{
+    if (brick.encoding == BRICK_CONSTANT)
+        return brick.value;
+
+    if (brick.encoding == BRICK_DENSE)
+        return brick.dense[x + brick.size[0] * (y + brick.size[1] * z)];
+
+    const RLLine & line = brick.lines[y + brick.size[1] * z];
+    unsigned int t = 0;
+    for (size_t i = 0; i < line.size(); i++)
+    {
+        t += line[i].first;
+        if (x < t)
+            return line[i].second;
+    }
+    return line.back().second;
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::DecodeRow(const Brick & brick, unsigned int x, unsigned int y, unsigned int z,
+            unsigned int n, TPixel *out, long stride)
+{
+    if (brick.encoding == BRICK_CONSTANT)
+    {
+        for (unsigned int k = 0; k < n; k++, out += stride)
+            *out = brick.value;
+    }
+    else if (brick.encoding == BRICK_DENSE)
+    {
+        const TPixel *p = &brick.dense[x + brick.size[0] * (y + brick.size[1] * z)];
+        for (unsigned int k = 0; k < n; k++, out += stride)
+            *out = p[k];
+    }
+    else if (n > 0)
+    {
+        // Find the run containing x, and how many voxels of it are left
+        const RLLine & line = brick.lines[y + brick.size[1] * z];
+        size_t i = 0;
+        unsigned int t = line[0].first;
+        while (t <= x)
+            t += line[++i].first;
+
+        unsigned int remainder = t - x;
+        for (unsigned int k = 0; k < n; k++, out += stride)
+        {
+            *out = line[i].second;
+            if (--remainder == 0 && k + 1 < n)
+                remainder = line[++i].first;
+        }
+    }
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::EncodeBrick(Brick & brick, const TPixel *voxels)
+{
+    size_t nRows = brick.size[1] * brick.size[2];
+    size_t nVoxels = nRows * brick.size[0];
+    brick.edits = 0;
+
+    // Count the runs in each row
+    std::vector< unsigned int > runs(nRows);
+    size_t nRuns = 0;
+    unsigned long rleCost = nRows * sizeof(RLLine);
+    for (size_t r = 0; r < nRows; r++)
+    {
+        const TPixel *row = voxels + r * brick.size[0];
+        runs[r] = 1;
+        for (unsigned int x = 1; x < brick.size[0]; x++)
+            if (row[x] != row[x - 1])
+                runs[r]++;
+        nRuns += runs[r];
+        if (runs[r] > RLLine::inline_capacity())
+            rleCost += runs[r] * sizeof(RLSegment);
+    }
+
+    // A uniform brick has one run per row, all with the same value
+    bool uniform = (nRuns == nRows);
+    for (size_t r = 1; uniform && r < nRows; r++)
+        uniform = (voxels[r * brick.size[0]] == voxels[0]);
+
+    if (uniform)
+    {
+        std::vector< TPixel >().swap(brick.dense);
+        std::vector< RLLine >().swap(brick.lines);
+        brick.encoding = BRICK_CONSTANT;
+        brick.value = voxels[0];
+    }
+    else if (rleCost < nVoxels * sizeof(TPixel))
+    {
+        std::vector< TPixel >().swap(brick.dense);
+        brick.lines.resize(nRows);
+        for (size_t r = 0; r < nRows; r++)
+        {
+            const TPixel *row = voxels + r * brick.size[0];
+            RLLine line;
+            line.reserve(runs[r]);
+            unsigned short length = 1;
+            for (unsigned int x = 1; x < brick.size[0]; x++)
+            {
+                if (row[x] == row[x - 1])
+                    length++;
+                else
+                {
+                    line.push_back(RLSegment(length, row[x - 1]));
+                    length = 1;
+                }
+            }
+            line.push_back(RLSegment(length, row[brick.size[0] - 1]));
+            brick.lines[r].swap(line);
+        }
+        brick.encoding = BRICK_RLE;
+    }
+    else
+    {
+        std::vector< RLLine >().swap(brick.lines);
+        brick.dense.assign(voxels, voxels + nVoxels);
+        brick.encoding = BRICK_DENSE;
+    }
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::ReencodeBrick(Brick & brick)
+{
+    brick.edits = 0;
+    if (brick.encoding == BRICK_CONSTANT)
+        return;
+
+    std::vector< TPixel > voxels(brick.size[0] * brick.size[1] * brick.size[2]);
+    for (unsigned int z = 0; z < brick.size[2]; z++)
+        for (unsigned int y = 0; y < brick.size[1]; y++)
+            DecodeRow(brick, 0, y, z, brick.size[0],
+                      &voxels[brick.size[0] * (y + brick.size[1] * z)], 1);
+    EncodeBrick(brick, &voxels[0]);
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+TPixel BrickedImage< TPixel, VBrickSize >
+::GetPixel(const IndexType & index) const
+{
+    unsigned int l[3];
+    const Brick & brick = this->LocateBrick(index, l);
+    return GetBrickVoxel(brick, l[0], l[1], l[2]);
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::GetRow(const IndexType & start, unsigned int n, TPixel *out) const
+{
+    unsigned int l[3];
+    const Brick & brick = this->LocateBrick(start, l);
+    DecodeRow(brick, l[0], l[1], l[2], n, out, 1);
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::SetPixel(const IndexType & index, const TPixel & value)
+{
+    unsigned int l[3];
+    Brick & brick = this->LocateBrick(index, l);
+
+    if (brick.encoding == BRICK_CONSTANT)
+    {
+        if (value == brick.value)
+            return;
+
+        // Split the brick into rows, each a single run
+        RLLine line(1, RLSegment(brick.size[0], brick.value));
+        brick.lines.assign(brick.size[1] * brick.size[2], line);
+        brick.encoding = BRICK_RLE;
+    }
+
+    if (brick.encoding == BRICK_DENSE)
+    {
+        TPixel & voxel = brick.dense[l[0] + brick.size[0] * (l[1] + brick.size[1] * l[2])];
+        if (voxel == value)
+            return;
+        voxel = value;
+    }
+    else
+    {
+        // Decode the row, change the voxel and encode the row again
+        TPixel row[VBrickSize];
+        DecodeRow(brick, 0, l[1], l[2], brick.size[0], row, 1);
+        if (row[l[0]] == value)
+            return;
+        row[l[0]] = value;
+
+        RLLine & line = brick.lines[l[1] + brick.size[1] * l[2]];
+        line.clear();
+        unsigned short length = 1;
+        for (unsigned int x = 1; x < brick.size[0]; x++)
+        {
+            if (row[x] == row[x - 1])
+                length++;
+            else
+            {
+                line.push_back(RLSegment(length, row[x - 1]));
+                length = 1;
+            }
+        }
+        line.push_back(RLSegment(length, row[brick.size[0] - 1]));
+    }
+
+    // Once as many voxels have been edited as there are rows in the brick,
+    // the best encoding may have changed
+    if (++brick.edits >= brick.size[1] * brick.size[2])
+        ReencodeBrick(brick);
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::Import(const TPixel *buffer)
+{
+    SizeType size = this->GetBufferedRegion().GetSize();
+
+#pragma omp parallel for
+    for (int b = 0; b < (int) m_Bricks.size(); b++)
+    {
+        Brick & brick = m_Bricks[b];
+        long origin[3];
+        this->GetBrickOrigin(b, origin);
+
+        // Gather the voxels of the brick
+        std::vector< TPixel > voxels(brick.size[0] * brick.size[1] * brick.size[2]);
+        TPixel *out = &voxels[0];
+        for (unsigned int z = 0; z < brick.size[2]; z++)
+            for (unsigned int y = 0; y < brick.size[1]; y++)
+            {
+                const TPixel *row = buffer + origin[0]
+                    + size[0] * ((origin[1] + y) + size[1] * (origin[2] + z));
+                out = std::copy(row, row + brick.size[0], out);
+            }
+
+        EncodeBrick(brick, &voxels[0]);
+    }
+    this->Modified();
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::Export(TPixel *buffer) const
+{
+    SizeType size = this->GetBufferedRegion().GetSize();
+
+#pragma omp parallel for
+    for (int b = 0; b < (int) m_Bricks.size(); b++)
+    {
+        const Brick & brick = m_Bricks[b];
+        long origin[3];
+        this->GetBrickOrigin(b, origin);
+        for (unsigned int z = 0; z < brick.size[2]; z++)
+            for (unsigned int y = 0; y < brick.size[1]; y++)
+            {
+                TPixel *row = buffer + origin[0]
+                    + size[0] * ((origin[1] + y) + size[1] * (origin[2] + z));
+                DecodeRow(brick, 0, y, z, brick.size[0], row, 1);
+            }
+    }
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::Optimize()
+{
+#pragma omp parallel for
+    for (int b = 0; b < (int) m_Bricks.size(); b++)
+        ReencodeBrick(m_Bricks[b]);
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::CopySlice(unsigned int axis, IndexValueType sliceIndex,
+            TPixel *origin, const long stride[3]) const
+{
+    long offset = sliceIndex - this->GetBufferedRegion().GetIndex(axis);
+    size_t bSlice = offset / VBrickSize;
+    unsigned int local = offset % VBrickSize;
+
+    // Only the bricks that intersect the slice are visited
+    unsigned int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+    int nBricks = m_GridSize[a1] * m_GridSize[a2];
+
+#pragma omp parallel for
+    for (int k = 0; k < nBricks; k++)
+    {
+        size_t b[3];
+        b[axis] = bSlice;
+        b[a1] = k % m_GridSize[a1];
+        b[a2] = k / m_GridSize[a1];
+        const Brick & brick = m_Bricks[b[0] + m_GridSize[0] * (b[1] + m_GridSize[1] * b[2])];
+
+        TPixel *out = origin;
+        for (unsigned int d = 0; d < 3; d++)
+            out += b[d] * VBrickSize * stride[d];
+
+        if (axis == 0)
+        {
+            // One voxel from each row of the brick
+            out += local * stride[0];
+            for (unsigned int z = 0; z < brick.size[2]; z++)
+                for (unsigned int y = 0; y < brick.size[1]; y++)
+                    out[y * stride[1] + z * stride[2]] = GetBrickVoxel(brick, local, y, z);
+        }
+        else if (axis == 1)
+        {
+            out += local * stride[1];
+            for (unsigned int z = 0; z < brick.size[2]; z++)
+                DecodeRow(brick, 0, local, z, brick.size[0], out + z * stride[2], stride[0]);
+        }
+        else
+        {
+            out += local * stride[2];
+            for (unsigned int y = 0; y < brick.size[1]; y++)
+                DecodeRow(brick, 0, y, local, brick.size[0], out + y * stride[1], stride[0]);
+        }
+    }
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+typename BrickedImage< TPixel, VBrickSize >::BrickEncoding
+BrickedImage< TPixel, VBrickSize >
+::GetBrickEncoding(const IndexType & index) const
+{
+    unsigned int l[3];
+    return (BrickEncoding) this->LocateBrick(index, l).encoding;
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+unsigned long BrickedImage< TPixel, VBrickSize >
+::GetNumberOfBricks(BrickEncoding encoding) const
+{
+    unsigned long n = 0;
+    for (size_t b = 0; b < m_Bricks.size(); b++)
+        if (m_Bricks[b].encoding == encoding)
+            n++;
+    return n;
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+unsigned long BrickedImage< TPixel, VBrickSize >
+::GetBrickFootprint(const Brick & brick)
+{
+    unsigned long bytes = brick.dense.capacity() * sizeof(TPixel)
+        + brick.lines.capacity() * sizeof(RLLine);
+    for (size_t r = 0; r < brick.lines.size(); r++)
+        if (!brick.lines[r].is_inline())
+            bytes += brick.lines[r].capacity() * sizeof(RLSegment);
+    return bytes;
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+unsigned long BrickedImage< TPixel, VBrickSize >
+::GetMemoryFootprint() const
+{
+    unsigned long bytes = m_Bricks.capacity() * sizeof(Brick);
+    for (size_t b = 0; b < m_Bricks.size(); b++)
+        bytes += GetBrickFootprint(m_Bricks[b]);
+    return bytes;
+}
+
+template< typename TPixel, unsigned int VBrickSize >
+void BrickedImage< TPixel, VBrickSize >
+::PrintSelf(std::ostream & os, itk::Indent indent) const
+{
+    Superclass::PrintSelf(os, indent);
+    os << indent << "Brick size: " << VBrickSize << std::endl;
+    os << indent << "Brick grid size: " << m_GridSize << std::endl;
+    os << indent << "Constant bricks: " << this->GetNumberOfBricks(BRICK_CONSTANT) << std::endl;
+    os << indent << "Run-length encoded bricks: " << this->GetNumberOfBricks(BRICK_RLE) << std::endl;
+    os << indent << "Dense bricks: " << this->GetNumberOfBricks(BRICK_DENSE) << std::endl;
+    os << indent << "Memory footprint: " << this->GetMemoryFootprint() << " bytes" << std::endl;
+}
+
+#endif //BrickedImage_txx
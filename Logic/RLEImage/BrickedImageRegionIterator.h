@@ -0,0 +1,161 @@
+#ifndef BrickedImageRegionIterator_h
+#define BrickedImageRegionIterator_h
+
+#include "BrickedImage.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+
+namespace itk
+{
+/** \class ImageRegionConstIterator
+* \brief Walks a region of a BrickedImage in the same order as the
+* ImageRegionConstIterator of a regular image (x fastest).
+*
+* The part of the current row that lies within a brick is decoded into a
+* small buffer when the iterator enters it, so that only one brick lookup
+* is needed per VBrickSize voxels.
+*/
+template< typename TPixel, unsigned int VBrickSize >
+class ImageRegionConstIterator< BrickedImage< TPixel, VBrickSize > >
+{
+public:
+    /** Standard class typedef. */
+    typedef ImageRegionConstIterator                   Self;
+    typedef BrickedImage< TPixel, VBrickSize >         ImageType;
+
+    itkStaticConstMacro(ImageIteratorDimension, unsigned int, 3);
+
+    typedef typename ImageType::IndexType              IndexType;
+    typedef typename ImageType::IndexValueType         IndexValueType;
+    typedef typename ImageType::SizeType               SizeType;
+    typedef typename ImageType::RegionType             RegionType;
+    typedef typename ImageType::InternalPixelType      InternalPixelType;
+    typedef typename ImageType::PixelType              PixelType;
+
+    /** Default constructor */
+    ImageRegionConstIterator() : m_Image(NULL), m_AtEnd(true) { }
+
+    /** Constructor establishes an iterator to walk a particular image and a
+    * particular region of that image. */
+    ImageRegionConstIterator(const ImageType *ptr, const RegionType & region)
+        : m_Image(ptr), m_Region(region)
+    {
+        this->GoToBegin();
+    }
+
+    /** Move the iterator to the first voxel of the region */
+    void GoToBegin()
+    {
+        m_Index = m_Region.GetIndex();
+        m_EndIndex0 = m_Region.GetIndex(0) + m_Region.GetSize(0);
+        m_AtEnd = (m_Region.GetNumberOfPixels() == 0);
+        if (!m_AtEnd)
+            this->LoadRow();
+    }
+
+    /** Whether the iterator has walked past the last voxel of the region */
+    bool IsAtEnd() const { return m_AtEnd; }
+
+    /** Index of the current voxel */
+    const IndexType & GetIndex() const { return m_Index; }
+
+    /** The region walked by the iterator */
+    const RegionType & GetRegion() const { return m_Region; }
+
+    /** Value of the current voxel */
+    PixelType Get() const { return m_Row[m_Index[0] - m_RowStart]; }
+
+    /** Move to the next voxel, wrapping to the next row of the region */
+    Self & operator++()
+    {
+        if (++m_Index[0] < m_RowEnd)
+            return *this;
+
+        if (m_Index[0] < m_EndIndex0)
+        {
+            // Entering the next brick along the row
+            this->LoadRow();
+            return *this;
+        }
+
+        m_Index[0] = m_Region.GetIndex(0);
+        for (unsigned int d = 1; d < 3; d++)
+        {
+            if (++m_Index[d] < (IndexValueType) (m_Region.GetIndex(d) + m_Region.GetSize(d)))
+            {
+                this->LoadRow();
+                return *this;
+            }
+            m_Index[d] = m_Region.GetIndex(d);
+        }
+
+        m_AtEnd = true;
+        return *this;
+    }
+
+protected:
+    // Decode the part of the current row that lies in the current brick
+    void LoadRow()
+    {
+        IndexValueType start0 = m_Image->GetBufferedRegion().GetIndex(0);
+        IndexValueType brickEnd =
+            start0 + ((m_Index[0] - start0) / VBrickSize + 1) * VBrickSize;
+        m_RowStart = m_Index[0];
+        m_RowEnd = std::min(brickEnd, m_EndIndex0);
+        m_Image->GetRow(m_Index, m_RowEnd - m_RowStart, m_Row);
+    }
+
+    const ImageType *m_Image;
+    RegionType m_Region;
+    IndexType m_Index;
+    IndexValueType m_EndIndex0, m_RowStart, m_RowEnd;
+    bool m_AtEnd;
+    TPixel m_Row[VBrickSize];
+};
+
+/** \class ImageRegionIterator
+* \brief Read/write region iterator for BrickedImage. Writes go through
+* BrickedImage::SetPixel, so each brick keeps track of its edits.
+*/
+template< typename TPixel, unsigned int VBrickSize >
+class ImageRegionIterator< BrickedImage< TPixel, VBrickSize > >
+    : public ImageRegionConstIterator< BrickedImage< TPixel, VBrickSize > >
+{
+public:
+    /** Standard class typedefs. */
+    typedef ImageRegionIterator                                           Self;
+    typedef ImageRegionConstIterator< BrickedImage< TPixel, VBrickSize > > Superclass;
+
+    typedef typename Superclass::ImageType             ImageType;
+    typedef typename Superclass::IndexType             IndexType;
+    typedef typename Superclass::RegionType            RegionType;
+    typedef typename Superclass::PixelType             PixelType;
+
+    /** Default constructor */
+    ImageRegionIterator() : m_WritableImage(NULL) { }
+
+    /** Constructor establishes an iterator to walk a particular image and a
+    * particular region of that image. */
+    ImageRegionIterator(ImageType *ptr, const RegionType & region)
+        : Superclass(ptr, region), m_WritableImage(ptr) { }
+
+    /** Set the value of the current voxel */
+    void Set(const PixelType & value)
+    {
+        m_WritableImage->SetPixel(this->m_Index, value);
+        this->m_Row[this->m_Index[0] - this->m_RowStart] = value;
+    }
+
+    Self & operator++()
+    {
+        Superclass::operator++();
+        return *this;
+    }
+
+protected:
+    ImageType *m_WritableImage;
+};
+
+} // end namespace itk
+
+#endif //BrickedImageRegionIterator_h
@@ -5,6 +5,7 @@
 #include <vector>
 #include <itkImageBase.h>
 #include <itkImage.h>
+#include "RLELine.h"
 
 /** Run-Length Encoded image.
 * It saves memory for label images at the expense of processing times.
@@ -16,6 +17,17 @@
 * It is best if pixel type and counter type have the same byte size
 * (for memory alignment purposes).
 *
+* Thread safety: every run-length line is a separate object, so different
+* threads can write to the image at the same time as long as no line is
+* written by more than one thread, and no thread reads a line that another
+* one writes. This holds for regions that are disjoint in the indices other
+* than x, such as the pieces made by SplitRegionByLines() or by the default
+* region splitter of ITK filters (which never splits along x unless the
+* region is a single line). Pixels can be written with iterators, SetPixel()
+* or AssignLine(). Allocate(), FillBuffer(), CleanUp(), CompactLines() and
+* SetOnTheFlyCleanup() touch all the lines and must not run concurrently
+* with anything else.
+*
 * Copied and adapted from itk::Image.
 */
 template< typename TPixel, unsigned int VImageDimension = 3, typename CounterType = unsigned short >
@@ -47,8 +59,9 @@ public:
     * second element is the pixel value. */
     typedef std::pair<CounterType, PixelType> RLSegment;
 
-    /** A Run-Length encoded line of pixels. */
-    typedef std::vector<RLSegment> RLLine;
+    /** A Run-Length encoded line of pixels. Lines of one or two segments
+    * are stored without heap allocation, see RLELine. */
+    typedef RLELine<RLSegment> RLLine;
 
     /** Internal Pixel representation. Used to maintain a uniform API
     * with Image Adaptors and allow to keep a particular internal
@@ -106,6 +119,7 @@ public:
         // Call the superclass which should initialize the BufferedRegion ivar.
         Superclass::Initialize();
         m_OnTheFlyCleanup = true;
+        ReleaseLineArena();
         myBuffer = BufferType::New();
     }
 
@@ -144,6 +158,24 @@ public:
     * This method is used by iterators directly. */
     int SetPixel(RLLine & line, IndexValueType & segmentRemainder, IndexValueType & realIndex, const TPixel & value);
 
+    /** Replace n pixels of a line, starting at the given index, with values.
+    * The line is rebuilt in one pass, which is much faster than setting the
+    * pixels one at a time. Different lines can be assigned by different
+    * threads at the same time. */
+    void AssignLine(const IndexType & start, SizeValueType n, const TPixel *values);
+
+    /** Replace the pixels of a region with the values in a dense buffer that
+    * holds the region with x varying fastest (e.g. the buffer of an itk::Image
+    * with the same buffered region). The lines are assigned in parallel. */
+    void AssignRegion(const RegionType & region, const TPixel *buffer);
+
+    /** Split a region into at most n pieces that do not share any run-length
+    * line, cutting it along the slowest axis other than x that has more than
+    * one line. The pieces can be written by different threads. Returns the
+    * number of pieces. */
+    static unsigned int SplitRegionByLines(const RegionType & region, unsigned int n,
+                                           std::vector<RegionType> & pieces);
+
     /** \brief Get a pixel. SLOW! Better use iterators for pixel access. */
     const TPixel & GetPixel(const IndexType & index) const;
 
@@ -196,6 +228,17 @@ public:
     * Automatically called when turning on OnTheFlyCleanup. */
     void CleanUp() const;
 
+    /** Moves the segments of all lines that do not fit in the inline storage
+    * of RLLine into a single block of memory (arena), in buffer order. This
+    * removes the per-line heap blocks and their slack, and keeps the lines
+    * that are sliced together close in memory. Lines that later grow move
+    * back to their own heap block. Called by the filters that create an
+    * RLEImage from an itk::Image, i.e., when a segmentation is loaded. */
+    void CompactLines();
+
+    /** Number of segments held in the arena */
+    itk::SizeValueType GetLineArenaSize() const { return m_LineArena.size(); }
+
     /** Should same-valued segments be merged on the fly?
     * On the fly merging usually provides better performance. */
     bool GetOnTheFlyCleanup() const { return m_OnTheFlyCleanup; }
@@ -220,7 +263,10 @@ protected:
     }
     void PrintSelf(std::ostream & os, itk::Indent indent) const ITK_OVERRIDE;
 
-    virtual ~RLEImage() {}
+    virtual ~RLEImage()
+    {
+        ReleaseLineArena();
+    }
 
     /** Compute helper matrices used to transform Index coordinates to
     * PhysicalPoint coordinates and back. This method is virtual and will be
@@ -235,6 +281,21 @@ protected:
     /** Merges adjacent segments with duplicate values in a single line. */
     void CleanUpLine(RLLine & line) const;
 
+    /** Appends a run to a line, merging it with the last run if they have
+    * the same value. */
+    static void AppendRun(RLLine & line, CounterType count, const TPixel & value);
+
+    /** Replaces n pixels of a line, starting at offset x0 from the start of
+    * the line, with values. The caller checks that the pixels are inside the
+    * line; this does no checking and raises no ITK exceptions, so it can
+    * be called in a parallel loop. */
+    static void AssignRuns(RLLine & line, IndexValueType x0, SizeValueType n, const TPixel *values);
+
+    /** Frees the arena. If detachLines is set and the buffer is shared with
+    * another object, the lines stored in the arena are first moved to their
+    * own storage. */
+    void ReleaseLineArena(bool detachLines = true);
+
 private:
     bool m_OnTheFlyCleanup; //should same-valued segments be merged on the fly
 
@@ -243,6 +304,9 @@ private:
 
     /** Memory for the current buffer. */
     mutable typename BufferType::Pointer myBuffer;
+
+    /** Shared storage for the segments of long lines, see CompactLines(). */
+    std::vector<RLSegment> m_LineArena;
 };
 
 
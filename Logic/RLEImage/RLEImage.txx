@@ -56,6 +56,9 @@ void RLEImage<TPixel, VImageDimension, CounterType>::Allocate(bool initialize)
         line[0] = segment;
         myBuffer->FillBuffer(line);
     }
+
+    // No line refers to the arena any more
+    ReleaseLineArena(false);
 }
 
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
@@ -66,33 +69,95 @@ void RLEImage<TPixel, VImageDimension, CounterType>
     RLLine line(1);
     line[0] = segment;
     myBuffer->FillBuffer(line);
+
+    // No line refers to the arena any more
+    ReleaseLineArena(false);
+}
+
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+void RLEImage<TPixel, VImageDimension, CounterType>
+::CompactLines()
+{
+    RLLine *lines = myBuffer->GetBufferPointer();
+    itk::SizeValueType nLines = myBuffer->GetPixelContainer()->Size();
+
+    // Count the segments that do not fit inline
+    itk::SizeValueType nSegments = 0;
+    for (itk::SizeValueType i = 0; i < nLines; i++)
+        if (lines[i].size() > RLLine::inline_capacity())
+            nSegments += lines[i].size();
+
+    // Copy them into a new arena. The lines still in the old arena are moved
+    // out of it here, so the old arena can be freed afterwards
+    std::vector<RLSegment> arena(nSegments);
+    itk::SizeValueType pos = 0;
+    for (itk::SizeValueType i = 0; i < nLines; i++)
+    {
+        if (lines[i].size() > RLLine::inline_capacity())
+        {
+            lines[i].move_to_external(&arena[pos]);
+            pos += lines[i].size();
+        }
+        else
+            lines[i].shrink_to_fit();
+    }
+
+    m_LineArena.swap(arena);
+}
+
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+void RLEImage<TPixel, VImageDimension, CounterType>
+::ReleaseLineArena(bool detachLines)
+{
+    if (m_LineArena.empty())
+        return;
+
+    // Lines only need to leave the arena if someone else holds the buffer
+    if (detachLines && myBuffer->GetReferenceCount() > 1)
+    {
+        RLLine *lines = myBuffer->GetBufferPointer();
+        itk::SizeValueType nLines = myBuffer->GetPixelContainer()->Size();
+        for (itk::SizeValueType i = 0; i < nLines; i++)
+            if (lines[i].is_external())
+                lines[i].shrink_to_fit();
+    }
+
+    std::vector<RLSegment>().swap(m_LineArena);
 }
 
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
 void RLEImage<TPixel, VImageDimension, CounterType>::CleanUpLine(RLLine & line) const
 {
-    CounterType x = 0;
-    RLLine out;
-    out.reserve(this->GetLargestPossibleRegion().GetSize(0));
-    do
+    if (line.empty())
+        return;
+
+    // Merging only removes runs, so the line is rewritten in place. This
+    // keeps a line that lives in the arena there
+    size_t w = 0;
+    for (size_t x = 1; x < line.size(); x++)
     {
-        out.push_back(line[x]);
-        while (++x < line.size() && line[x].second == line[x - 1].second)
-            out.back().first += line[x].first;
-    } while (x < line.size());
-    out.swap(line);
+        if (line[x].second == line[w].second)
+            line[w].first += line[x].first;
+        else
+            line[++w] = line[x];
+    }
+    line.resize(w + 1);
+
+    // Give up the heap block of a line that now fits inline
+    if (line.size() <= RLLine::inline_capacity())
+        line.shrink_to_fit();
 }
 
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
 void RLEImage<TPixel, VImageDimension, CounterType>::CleanUp() const
 {
-    assert(!myBuffer.empty());
     if (this->GetLargestPossibleRegion().GetSize(0) == 0)
         return;
+    RLLine *lines = myBuffer->GetBufferPointer();
+    int nLines = (int) myBuffer->GetPixelContainer()->Size();
 #pragma omp parallel for
-    for (CounterType z = 0; z < myBuffer.size(); z++)
-        for (CounterType y = 0; y < myBuffer[0].size(); y++)
-            CleanUpLine(myBuffer[z][y]);
+    for (int i = 0; i < nLines; i++)
+        CleanUpLine(lines[i]);
 }
 
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
@@ -209,6 +274,136 @@ SetPixel(const IndexType & index, const TPixel & value)
     throw itk::ExceptionObject(__FILE__, __LINE__, "Reached past the end of Run-Length line!", __FUNCTION__);
 }
 
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+inline void RLEImage<TPixel, VImageDimension, CounterType>::
+AppendRun(RLLine & line, CounterType count, const TPixel & value)
+{
+    if (count == 0)
+        return;
+    if (!line.empty() && line.back().second == value)
+        line.back().first += count;
+    else
+        line.push_back(RLSegment(count, value));
+}
+
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+void RLEImage<TPixel, VImageDimension, CounterType>::
+AssignLine(const IndexType & start, SizeValueType n, const TPixel *values)
+{
+    //complete Run-Length Lines have to be buffered
+    itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(0)
+        == this->GetLargestPossibleRegion().GetSize(0),
+        "BufferedRegion must contain complete run-length lines!");
+    if (n == 0)
+        return;
+    RegionType region;
+    region.SetIndex(start);
+    region.SetSize(0, n);
+    for (unsigned int d = 1; d < VImageDimension; d++)
+        region.SetSize(d, 1);
+    itkAssertOrThrowMacro(this->GetBufferedRegion().IsInside(region),
+        "Assigned pixels must be inside the BufferedRegion!");
+    AssignRuns(myBuffer->GetPixel(truncateIndex(start)),
+        start[0] - this->GetBufferedRegion().GetIndex(0), n, values);
+}
+
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+void RLEImage<TPixel, VImageDimension, CounterType>::
+AssignRuns(RLLine & line, IndexValueType x0, SizeValueType n, const TPixel *values)
+{
+    IndexValueType x1 = x0 + n;
+
+    // Copy the runs before x0, cutting the run that contains it
+    RLLine out;
+    IndexValueType t = 0;
+    size_t i = 0;
+    for (; i < line.size() && t + line[i].first <= x0; i++)
+    {
+        AppendRun(out, line[i].first, line[i].second);
+        t += line[i].first;
+    }
+    if (i < line.size() && t < x0)
+        AppendRun(out, CounterType(x0 - t), line[i].second);
+
+    // Encode the new values
+    for (SizeValueType k = 0; k < n; k++)
+        AppendRun(out, 1, values[k]);
+
+    // Copy the runs after x1, cutting the run that contains it
+    for (; i < line.size() && t + line[i].first <= x1; i++)
+        t += line[i].first;
+    if (i < line.size())
+    {
+        AppendRun(out, CounterType(t + line[i].first - x1), line[i].second);
+        for (i++; i < line.size(); i++)
+            AppendRun(out, line[i].first, line[i].second);
+    }
+
+    // A line in the arena is rewritten in place if the new runs fit
+    line.assign(out.begin(), out.end());
+}
+
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+void RLEImage<TPixel, VImageDimension, CounterType>::
+AssignRegion(const RegionType & region, const TPixel *buffer)
+{
+    //complete Run-Length Lines have to be buffered. The preconditions are
+    //checked here, since exceptions can not leave the parallel loop
+    itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(0)
+        == this->GetLargestPossibleRegion().GetSize(0),
+        "BufferedRegion must contain complete run-length lines!");
+    if (region.GetNumberOfPixels() == 0)
+        return;
+    itkAssertOrThrowMacro(this->GetBufferedRegion().IsInside(region),
+        "Assigned region must be inside the BufferedRegion!");
+
+    SizeValueType nx = region.GetSize(0);
+    IndexValueType x0 = region.GetIndex(0) - this->GetBufferedRegion().GetIndex(0);
+    typename BufferType::RegionType lineRegion = truncateRegion(region);
+    int nLines = (int) lineRegion.GetNumberOfPixels();
+
+#pragma omp parallel for
+    for (int k = 0; k < nLines; k++)
+    {
+        IndexType index;
+        index[0] = region.GetIndex(0);
+        SizeValueType r = k;
+        for (unsigned int d = 1; d < VImageDimension; d++)
+        {
+            index[d] = region.GetIndex(d) + r % region.GetSize(d);
+            r /= region.GetSize(d);
+        }
+        AssignRuns(myBuffer->GetPixel(truncateIndex(index)), x0, nx, buffer + k * nx);
+    }
+
+    this->Modified();
+}
+
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+unsigned int RLEImage<TPixel, VImageDimension, CounterType>::
+SplitRegionByLines(const RegionType & region, unsigned int n, std::vector<RegionType> & pieces)
+{
+    // Find the slowest axis with more than one line
+    unsigned int axis = VImageDimension - 1;
+    while (axis > 1 && region.GetSize(axis) <= 1)
+        axis--;
+
+    SizeValueType len = region.GetSize(axis);
+    n = (unsigned int) std::max((SizeValueType) 1, std::min((SizeValueType) n, len));
+
+    pieces.clear();
+    for (unsigned int i = 0; i < n; i++)
+    {
+        IndexValueType i0 = region.GetIndex(axis) + len * i / n;
+        IndexValueType i1 = region.GetIndex(axis) + len * (i + 1) / n;
+        RegionType piece = region;
+        piece.SetIndex(axis, i0);
+        piece.SetSize(axis, i1 - i0);
+        pieces.push_back(piece);
+    }
+    return n;
+}
+
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
 const TPixel & RLEImage<TPixel, VImageDimension, CounterType>::
 GetPixel(const IndexType & index) const
@@ -247,11 +442,12 @@ void RLEImage<TPixel, VImageDimension, CounterType>
     }
 
     double cr = double(c*(sizeof(PixelType) + sizeof(CounterType))
-        + sizeof(std::vector<RLLine>) * this->GetOffsetTable()[VImageDimension] / this->GetOffsetTable()[1])
+        + sizeof(RLLine) * this->GetOffsetTable()[VImageDimension] / this->GetOffsetTable()[1])
         / (this->GetOffsetTable()[VImageDimension] * sizeof(PixelType));
 
     os << indent << "OnTheFlyCleanup: " << (m_OnTheFlyCleanup ? "On" : "Off") << std::endl;
     os << indent << "RLEImage compressed pixel count: " << c << std::endl;
+    os << indent << "Segments in line arena: " << m_LineArena.size() << std::endl;
     int prec = os.precision(3);
     os << indent << "Compressed size in relation to original size: "<< cr*100 <<"%" << std::endl;
     os.precision(prec);
@@ -138,6 +138,18 @@ public:
       this->segmentRemainder = 1;
       return *this;
   }
+
+  /** Move to the first pixel of the next line of the region, skipping the
+   * rest of the current line in one step. At the last line, the iterator is
+   * set to be one pixel past the end of the region. */
+  void NextLine()
+  {
+      ++(this->bi);
+      if (!this->bi.IsAtEnd())
+          this->SetIndexInternal(this->m_BeginIndex0);
+      else
+          this->m_Index0 = this->m_BeginIndex0;
+  }
 };
 
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
@@ -0,0 +1,315 @@
+#ifndef RLELine_h
+#define RLELine_h
+
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+
+/** A run-length encoded line of pixels.
+* This is a container with the subset of the std::vector interface that is
+* used by RLEImage and its iterators, tuned for the way label images are
+* stored. Most lines of a label image hold one or two runs, so up to
+* VInlineCount runs are stored inside the line object itself, without any
+* heap allocation. Longer lines are stored either in their own heap block,
+* or in an arena that is shared by all the lines of an image (see
+* RLEImage::CompactLines), in which case the line does not own its storage.
+*
+* A line in the arena can be modified in place as long as it does not grow.
+* When it needs more room, it moves to its own heap block. Copies of a line
+* never refer to the arena.
+*/
+template< typename TSegment, unsigned int VInlineCount = 2 >
+class RLELine
+{
+public:
+    typedef TSegment         value_type;
+    typedef TSegment &       reference;
+    typedef const TSegment & const_reference;
+    typedef TSegment *       iterator;
+    typedef const TSegment * const_iterator;
+    typedef TSegment *       pointer;
+    typedef const TSegment * const_pointer;
+    typedef std::size_t      size_type;
+    typedef std::ptrdiff_t   difference_type;
+
+    RLELine() : m_Size(0), m_Capacity(VInlineCount), m_External(false) {}
+
+    explicit RLELine(size_type n, const TSegment & value = TSegment())
+        : m_Size(0), m_Capacity(VInlineCount), m_External(false)
+    {
+        this->assign(n, value);
+    }
+
+    RLELine(const RLELine & other)
+        : m_Size(0), m_Capacity(VInlineCount), m_External(false)
+    {
+        this->assign(other.begin(), other.end());
+    }
+
+    ~RLELine()
+    {
+        this->release();
+    }
+
+    RLELine & operator=(const RLELine & other)
+    {
+        if (this != &other)
+        {
+            // Never write a copy into the arena
+            if (m_External)
+                this->reset();
+            this->assign(other.begin(), other.end());
+        }
+        return *this;
+    }
+
+    size_type size() const { return m_Size; }
+    size_type capacity() const { return m_Capacity; }
+    bool empty() const { return m_Size == 0; }
+
+    /** Number of runs that can be stored inside the line object */
+    static size_type inline_capacity() { return VInlineCount; }
+
+    /** Whether the runs are stored inside the line object */
+    bool is_inline() const { return m_Capacity <= VInlineCount; }
+
+    /** Whether the runs are stored in memory not owned by the line */
+    bool is_external() const { return m_External; }
+
+    TSegment * data() { return this->is_inline() ? m_Storage.m_Inline : m_Storage.m_Heap; }
+    const TSegment * data() const { return this->is_inline() ? m_Storage.m_Inline : m_Storage.m_Heap; }
+
+    iterator begin() { return this->data(); }
+    iterator end() { return this->data() + m_Size; }
+    const_iterator begin() const { return this->data(); }
+    const_iterator end() const { return this->data() + m_Size; }
+
+    reference operator[](size_type i) { return this->data()[i]; }
+    const_reference operator[](size_type i) const { return this->data()[i]; }
+
+    reference front() { return this->data()[0]; }
+    const_reference front() const { return this->data()[0]; }
+    reference back() { return this->data()[m_Size - 1]; }
+    const_reference back() const { return this->data()[m_Size - 1]; }
+
+    void clear() { m_Size = 0; }
+
+    void reserve(size_type n)
+    {
+        if (n > m_Capacity)
+            this->reallocate(n);
+    }
+
+    void resize(size_type n, const TSegment & value = TSegment())
+    {
+        // Shrinking only drops runs from the end
+        if (n > m_Size)
+        {
+            this->reserve(n);
+            std::fill(this->data() + m_Size, this->data() + n, value);
+        }
+        m_Size = n;
+    }
+
+    void assign(size_type n, const TSegment & value)
+    {
+        m_Size = 0;
+        this->reserve(n);
+        std::fill(this->data(), this->data() + n, value);
+        m_Size = n;
+    }
+
+    template< typename TIterator >
+    void assign(TIterator first, TIterator last)
+    {
+        size_type n = std::distance(first, last);
+        m_Size = 0;
+        this->reserve(n);
+        std::copy(first, last, this->data());
+        m_Size = n;
+    }
+
+    void push_back(const TSegment & value)
+    {
+        if (m_Size == m_Capacity)
+        {
+            // Copy first, since value may refer to an element of this line
+            TSegment copy = value;
+            this->reallocate(this->grown_capacity(m_Size + 1));
+            this->data()[m_Size++] = copy;
+        }
+        else
+            this->data()[m_Size++] = value;
+    }
+
+    iterator insert(iterator pos, const TSegment & value)
+    {
+        return this->insert(pos, 1, value);
+    }
+
+    iterator insert(iterator pos, size_type n, const TSegment & value)
+    {
+        TSegment copy = value;
+        size_type i = pos - this->begin();
+        this->make_room(i, n);
+        std::fill(this->data() + i, this->data() + i + n, copy);
+        return this->begin() + i;
+    }
+
+    /** Insert a range, which must not be part of this line */
+    template< typename TIterator >
+    iterator insert(iterator pos, TIterator first, TIterator last)
+    {
+        size_type i = pos - this->begin();
+        size_type n = std::distance(first, last);
+        this->make_room(i, n);
+        std::copy(first, last, this->data() + i);
+        return this->begin() + i;
+    }
+
+    iterator erase(iterator pos)
+    {
+        return this->erase(pos, pos + 1);
+    }
+
+    iterator erase(iterator first, iterator last)
+    {
+        std::copy(last, this->end(), first);
+        m_Size -= last - first;
+        return first;
+    }
+
+    void swap(RLELine & other)
+    {
+        Storage tmp;
+        this->move_storage(tmp, *this);
+        this->move_storage(m_Storage, other);
+        this->move_storage(other.m_Storage, *this, tmp);
+        unsigned int size = m_Size, capacity = m_Capacity, external = m_External;
+        m_Size = other.m_Size;
+        m_Capacity = other.m_Capacity;
+        m_External = other.m_External;
+        other.m_Size = size;
+        other.m_Capacity = capacity;
+        other.m_External = external;
+    }
+
+    /** Copy the runs to external memory (with room for size() runs) owned by
+    * the caller, and use it as the storage of this line from now on. Lines
+    * that fit in the inline storage are moved there instead. */
+    void move_to_external(TSegment * storage)
+    {
+        if (m_Size <= VInlineCount)
+        {
+            this->shrink_to_fit();
+            return;
+        }
+        std::copy(this->begin(), this->end(), storage);
+        this->release();
+        m_Storage.m_Heap = storage;
+        m_Capacity = m_Size;
+        m_External = true;
+    }
+
+    /** Move the runs into storage owned by the line, using the inline storage
+    * if they fit, and release any excess heap memory */
+    void shrink_to_fit()
+    {
+        if (this->is_inline() || (m_Size == m_Capacity && !m_External))
+            return;
+        this->reallocate(m_Size);
+    }
+
+    bool operator==(const RLELine & other) const
+    {
+        return m_Size == other.m_Size && std::equal(this->begin(), this->end(), other.begin());
+    }
+
+    bool operator!=(const RLELine & other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    union Storage
+    {
+        TSegment m_Inline[VInlineCount];
+        TSegment * m_Heap;
+        Storage() {}
+    };
+
+    Storage m_Storage;
+    unsigned int m_Size;
+    unsigned int m_Capacity : 31;
+    unsigned int m_External : 1;
+
+    size_type grown_capacity(size_type n) const
+    {
+        return std::max(n, size_type(2 * m_Capacity));
+    }
+
+    // Free the heap block, if the line owns one
+    void release()
+    {
+        if (!this->is_inline() && !m_External)
+            delete[] m_Storage.m_Heap;
+    }
+
+    // Forget the current storage (without freeing it), leaving an empty line
+    void reset()
+    {
+        m_Size = 0;
+        m_Capacity = VInlineCount;
+        m_External = false;
+    }
+
+    // Move the runs to new storage of the given capacity (at least size())
+    void reallocate(size_type n)
+    {
+        if (n <= VInlineCount)
+        {
+            if (this->is_inline())
+                return;
+            TSegment * old = m_Storage.m_Heap;
+            std::copy(old, old + m_Size, m_Storage.m_Inline);
+            if (!m_External)
+                delete[] old;
+            m_Capacity = VInlineCount;
+        }
+        else
+        {
+            TSegment * block = new TSegment[n];
+            std::copy(this->begin(), this->end(), block);
+            this->release();
+            m_Storage.m_Heap = block;
+            m_Capacity = n;
+        }
+        m_External = false;
+    }
+
+    // Open a gap of n runs at position i
+    void make_room(size_type i, size_type n)
+    {
+        if (m_Size + n > m_Capacity)
+            this->reallocate(this->grown_capacity(m_Size + n));
+        TSegment * p = this->data();
+        std::copy_backward(p + i, p + m_Size, p + m_Size + n);
+        m_Size += n;
+    }
+
+    // Copy the storage of a line, given whether it is inline
+    static void move_storage(Storage & dst, const RLELine & src)
+    {
+        move_storage(dst, src, src.m_Storage);
+    }
+
+    static void move_storage(Storage & dst, const RLELine & src, const Storage & srcStorage)
+    {
+        if (src.is_inline())
+            std::copy(srcStorage.m_Inline, srcStorage.m_Inline + src.m_Size, dst.m_Inline);
+        else
+            dst.m_Heap = srcStorage.m_Heap;
+    }
+};
+
+#endif //RLELine_h
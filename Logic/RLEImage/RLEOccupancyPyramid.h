@@ -0,0 +1,123 @@
+#ifndef RLEOccupancyPyramid_h
+#define RLEOccupancyPyramid_h
+
+#include <vector>
+#include <itkObject.h>
+#include <itkObjectFactory.h>
+#include "RLEImage.h"
+
+/** Coarse summary of the values of an RLEImage, kept as the minimum and
+* maximum value in each brick of 8^3 voxels and in each brick of 64^3 voxels.
+*
+* Code that walks through a label image looking for particular labels (ray
+* picking in the 3D view, bounding boxes of structures) can skip a whole
+* brick when no label in its [min, max] range is of interest, which for
+* sparse segmentations skips most of the image. The pyramid is computed from
+* the run-length lines, so a brick that lies within a single run costs
+* nothing to summarize, and it can be updated for the region covered by an
+* edit instead of being built again.
+*
+* Bricks at the upper edges of the image are cropped to the image.
+*/
+template< typename TImage >
+class RLEOccupancyPyramid : public itk::Object
+{
+public:
+    /** Standard class typedefs */
+    typedef RLEOccupancyPyramid                 Self;
+    typedef itk::Object                         Superclass;
+    typedef itk::SmartPointer< Self >           Pointer;
+    typedef itk::SmartPointer< const Self >     ConstPointer;
+
+    /** Method for creation through the object factory. */
+    itkNewMacro(Self);
+
+    /** Run-time type information (and related methods). */
+    itkTypeMacro(RLEOccupancyPyramid, Object);
+
+    typedef TImage                              ImageType;
+    typedef typename ImageType::PixelType       PixelType;
+    typedef typename ImageType::IndexType       IndexType;
+    typedef typename ImageType::IndexValueType  IndexValueType;
+    typedef typename ImageType::SizeType        SizeType;
+    typedef typename ImageType::RegionType      RegionType;
+
+    itkStaticConstMacro(ImageDimension, unsigned int, 3);
+
+    /** Number of levels: bricks of 8^3 and 64^3 voxels */
+    itkStaticConstMacro(NumberOfLevels, unsigned int, 2);
+
+    /** Compute the pyramid for the buffered region of an image */
+    void Build(const ImageType *image);
+
+    /** Compute the bricks that overlap a region of the image again, after the
+    * voxels in the region have changed. The image must have the region that
+    * the pyramid was built for. */
+    void Update(const ImageType *image, const RegionType & region);
+
+    /** Whether the pyramid has been built */
+    bool IsBuilt() const { return m_Region.GetNumberOfPixels() > 0; }
+
+    /** The image region summarized by the pyramid */
+    const RegionType & GetRegion() const { return m_Region; }
+
+    unsigned int GetNumberOfLevels() const { return NumberOfLevels; }
+
+    /** Size of the bricks along each axis at a level */
+    static unsigned int GetBrickSize(unsigned int level) { return 8u << (3 * level); }
+
+    /** Number of bricks along each axis at a level */
+    const SizeType & GetGridSize(unsigned int level) const { return m_GridSize[level]; }
+
+    /** Range of the values in the brick that contains a voxel */
+    void GetBrickRange(unsigned int level, const IndexType & index,
+                       PixelType & minValue, PixelType & maxValue) const
+    {
+        const Range & r = m_Ranges[level][this->GetBrickOffset(level, index)];
+        minValue = r.min;
+        maxValue = r.max;
+    }
+
+    /** The brick that contains a voxel, cropped to the image */
+    RegionType GetBrickRegion(unsigned int level, const IndexType & index) const;
+
+    /** Bounding box of the 8^3 bricks that contain any value other than the
+    * background, cropped to the image. The region is empty if there are none. */
+    RegionType GetOccupiedRegion(const PixelType & background) const;
+
+protected:
+    RLEOccupancyPyramid() {}
+    virtual ~RLEOccupancyPyramid() {}
+    void PrintSelf(std::ostream & os, itk::Indent indent) const ITK_OVERRIDE;
+
+    struct Range
+    {
+        PixelType min, max;
+    };
+
+    // Offset of the brick containing a voxel in the brick array of a level
+    size_t GetBrickOffset(unsigned int level, const IndexType & index) const
+    {
+        unsigned int shift = 3 * (level + 1);
+        const SizeType & grid = m_GridSize[level];
+        size_t bx = (index[0] - m_Region.GetIndex(0)) >> shift;
+        size_t by = (index[1] - m_Region.GetIndex(1)) >> shift;
+        size_t bz = (index[2] - m_Region.GetIndex(2)) >> shift;
+        return bx + grid[0] * (by + grid[1] * bz);
+    }
+
+private:
+    RLEOccupancyPyramid(const Self &);  //purposely not implemented
+    void operator=(const Self &);       //purposely not implemented
+
+    RegionType m_Region;
+    SizeType m_GridSize[NumberOfLevels];
+    std::vector< Range > m_Ranges[NumberOfLevels];
+};
+
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "RLEOccupancyPyramid.txx"
+#endif
+
+#endif //RLEOccupancyPyramid_h
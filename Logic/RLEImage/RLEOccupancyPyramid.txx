@@ -0,0 +1,205 @@
+#ifndef RLEOccupancyPyramid_txx
+#define RLEOccupancyPyramid_txx
+
+#include "RLEOccupancyPyramid.h"
+#include <algorithm>
+#include <itkNumericTraits.h>
+
+template< typename TImage >
+void RLEOccupancyPyramid< TImage >
+::Build(const ImageType *image)
+{
+    m_Region = image->GetBufferedRegion();
+    for (unsigned int level = 0; level < NumberOfLevels; level++)
+    {
+        unsigned int bs = GetBrickSize(level);
+        for (unsigned int d = 0; d < ImageDimension; d++)
+            m_GridSize[level][d] = (m_Region.GetSize(d) + bs - 1) / bs;
+        m_Ranges[level].resize(m_GridSize[level][0] * m_GridSize[level][1] * m_GridSize[level][2]);
+    }
+
+    this->Update(image, m_Region);
+}
+
+template< typename TImage >
+void RLEOccupancyPyramid< TImage >
+::Update(const ImageType *image, const RegionType & region)
+{
+    itkAssertOrThrowMacro(image->GetBufferedRegion() == m_Region,
+        "The image region differs from the region of the occupancy pyramid");
+
+    RegionType r = region;
+    if (!r.Crop(m_Region))
+        return;
+
+    // The 8^3 bricks that overlap the region (inclusive, relative to m_Region)
+    IndexValueType lo[3], hi[3], nv[3];
+    for (unsigned int d = 0; d < ImageDimension; d++)
+    {
+        nv[d] = m_Region.GetSize(d);
+        lo[d] = (r.GetIndex(d) - m_Region.GetIndex(d)) >> 3;
+        hi[d] = (r.GetIndex(d) + (IndexValueType) r.GetSize(d) - 1 - m_Region.GetIndex(d)) >> 3;
+    }
+
+    const typename ImageType::BufferType *buffer = image->GetBuffer();
+    const SizeType & grid0 = m_GridSize[0];
+    IndexValueType xa = lo[0] << 3, xb = std::min((hi[0] + 1) << 3, nv[0]);
+
+    // Each brick row is summarized from the runs of its lines that fall
+    // within the range of bricks along x
+#pragma omp parallel for
+    for (int bz = (int) lo[2]; bz <= (int) hi[2]; bz++)
+    {
+        typename ImageType::BufferType::IndexType lineIndex;
+        for (IndexValueType by = lo[1]; by <= hi[1]; by++)
+        {
+            Range *row = &m_Ranges[0][grid0[0] * (by + grid0[1] * bz)];
+            for (IndexValueType bx = lo[0]; bx <= hi[0]; bx++)
+            {
+                row[bx].min = itk::NumericTraits< PixelType >::max();
+                row[bx].max = itk::NumericTraits< PixelType >::NonpositiveMin();
+            }
+
+            IndexValueType y1 = std::min((by + 1) << 3, nv[1]);
+            IndexValueType z1 = std::min(((IndexValueType) bz + 1) << 3, nv[2]);
+            for (IndexValueType z = (IndexValueType) bz << 3; z < z1; z++)
+            {
+                for (IndexValueType y = by << 3; y < y1; y++)
+                {
+                    lineIndex[0] = m_Region.GetIndex(1) + y;
+                    lineIndex[1] = m_Region.GetIndex(2) + z;
+                    const typename ImageType::RLLine & line = buffer->GetPixel(lineIndex);
+
+                    IndexValueType t = 0;
+                    for (size_t i = 0; i < line.size() && t < xb; i++)
+                    {
+                        IndexValueType t1 = t + line[i].first;
+                        if (t1 > xa)
+                        {
+                            const PixelType & v = line[i].second;
+                            IndexValueType b1 = (std::min(t1, xb) - 1) >> 3;
+                            for (IndexValueType b = std::max(t, xa) >> 3; b <= b1; b++)
+                            {
+                                if (v < row[b].min)
+                                    row[b].min = v;
+                                if (v > row[b].max)
+                                    row[b].max = v;
+                            }
+                        }
+                        t = t1;
+                    }
+                }
+            }
+        }
+    }
+
+    // The 64^3 bricks are summarized from their 8^3 bricks
+    const SizeType & grid1 = m_GridSize[1];
+#pragma omp parallel for
+    for (int cz = (int) (lo[2] >> 3); cz <= (int) (hi[2] >> 3); cz++)
+    {
+        IndexValueType bz1 = std::min(((IndexValueType) cz + 1) << 3, (IndexValueType) grid0[2]);
+        for (IndexValueType cy = lo[1] >> 3; cy <= hi[1] >> 3; cy++)
+        {
+            IndexValueType by1 = std::min((cy + 1) << 3, (IndexValueType) grid0[1]);
+            for (IndexValueType cx = lo[0] >> 3; cx <= hi[0] >> 3; cx++)
+            {
+                IndexValueType bx1 = std::min((cx + 1) << 3, (IndexValueType) grid0[0]);
+                Range & rc = m_Ranges[1][cx + grid1[0] * (cy + grid1[1] * cz)];
+                rc.min = itk::NumericTraits< PixelType >::max();
+                rc.max = itk::NumericTraits< PixelType >::NonpositiveMin();
+                for (IndexValueType bz = (IndexValueType) cz << 3; bz < bz1; bz++)
+                {
+                    for (IndexValueType by = cy << 3; by < by1; by++)
+                    {
+                        const Range *row = &m_Ranges[0][grid0[0] * (by + grid0[1] * bz)];
+                        for (IndexValueType bx = cx << 3; bx < bx1; bx++)
+                        {
+                            if (row[bx].min < rc.min)
+                                rc.min = row[bx].min;
+                            if (row[bx].max > rc.max)
+                                rc.max = row[bx].max;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    this->Modified();
+}
+
+template< typename TImage >
+typename RLEOccupancyPyramid< TImage >::RegionType
+RLEOccupancyPyramid< TImage >
+::GetBrickRegion(unsigned int level, const IndexType & index) const
+{
+    IndexValueType bs = GetBrickSize(level);
+    RegionType brick;
+    for (unsigned int d = 0; d < ImageDimension; d++)
+    {
+        IndexValueType start = m_Region.GetIndex(d);
+        IndexValueType i0 = start + (index[d] - start) / bs * bs;
+        IndexValueType end = start + (IndexValueType) m_Region.GetSize(d);
+        brick.SetIndex(d, i0);
+        brick.SetSize(d, std::min(i0 + bs, end) - i0);
+    }
+    return brick;
+}
+
+template< typename TImage >
+typename RLEOccupancyPyramid< TImage >::RegionType
+RLEOccupancyPyramid< TImage >
+::GetOccupiedRegion(const PixelType & background) const
+{
+    const SizeType & grid = m_GridSize[0];
+    IndexValueType lo[3], hi[3];
+    for (unsigned int d = 0; d < ImageDimension; d++)
+    {
+        lo[d] = grid[d];
+        hi[d] = -1;
+    }
+
+    size_t k = 0;
+    for (IndexValueType bz = 0; bz < (IndexValueType) grid[2]; bz++)
+    {
+        for (IndexValueType by = 0; by < (IndexValueType) grid[1]; by++)
+        {
+            for (IndexValueType bx = 0; bx < (IndexValueType) grid[0]; bx++, k++)
+            {
+                const Range & r = m_Ranges[0][k];
+                if (r.min == background && r.max == background)
+                    continue;
+                lo[0] = std::min(lo[0], bx); hi[0] = std::max(hi[0], bx);
+                lo[1] = std::min(lo[1], by); hi[1] = std::max(hi[1], by);
+                lo[2] = std::min(lo[2], bz); hi[2] = std::max(hi[2], bz);
+            }
+        }
+    }
+
+    RegionType occupied;
+    if (hi[0] < 0)
+        return occupied;
+
+    for (unsigned int d = 0; d < ImageDimension; d++)
+    {
+        IndexValueType i0 = lo[d] << 3;
+        IndexValueType i1 = std::min((hi[d] + 1) << 3, (IndexValueType) m_Region.GetSize(d));
+        occupied.SetIndex(d, m_Region.GetIndex(d) + i0);
+        occupied.SetSize(d, i1 - i0);
+    }
+    return occupied;
+}
+
+template< typename TImage >
+void RLEOccupancyPyramid< TImage >
+::PrintSelf(std::ostream & os, itk::Indent indent) const
+{
+    Superclass::PrintSelf(os, indent);
+    os << indent << "Region: " << m_Region << std::endl;
+    for (unsigned int level = 0; level < NumberOfLevels; level++)
+        os << indent << "Brick grid size (" << GetBrickSize(level) << "^3): "
+           << m_GridSize[level] << std::endl;
+}
+
+#endif //RLEOccupancyPyramid_txx
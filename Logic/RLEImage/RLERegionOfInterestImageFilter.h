@@ -183,6 +183,10 @@ protected:
     void ThreadedGenerateData(const RegionType & outputRegionForThread,
         ThreadIdType threadId) ITK_OVERRIDE;
 
+    /** Moves the long lines of the output into a single arena, see
+    * RLEImage::CompactLines(). */
+    virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
 private:
     RegionOfInterestImageFilter(const Self &); //purposely not implemented
     void operator=(const Self &);              //purposely not implemented
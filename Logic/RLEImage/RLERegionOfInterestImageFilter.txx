@@ -348,6 +348,15 @@ void RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
 }
 
 
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+void RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
+    RLEImage<TPixel, VImageDimension, CounterType> >
+    ::AfterThreadedGenerateData()
+{
+    this->GetOutput()->CompactLines();
+}
+
+
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
 void RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
     Image<TPixel, VImageDimension> >
@@ -155,6 +155,17 @@ public:
   /** Loop up intensity at an arbitrary slice index in reference space */
   OutputPixelType LookupIntensityAtReferenceIndex(const itk::ImageBase<3> *ref_space, const IndexType &index);
 
+  /**
+   * Look up intensities at a set of indices in reference space. The filter is
+   * updated once for all the indices, and the mapping from reference space to
+   * the input image is resolved once and reused while the transform and the
+   * image geometry are unchanged. Unlike LookupIntensityAtReferenceIndex, this
+   * also handles indices that are not in the current slice.
+   */
+  void LookupIntensitiesAtReferenceIndices(const itk::ImageBase<3> *ref_space,
+                                           const IndexType *index, unsigned int n,
+                                           OutputPixelType *out);
+
 protected:
 
   AdaptiveSlicingPipeline();
@@ -179,6 +190,18 @@ protected:
 
   IndexType m_SliceIndex;
 
+  // Affine mapping from reference space index to input continuous index, for
+  // linear oblique transforms. It is valid for the reference space and the
+  // transform it was computed from, if neither was modified since.
+  vnl_matrix_fixed<double, 3, 3> m_ReferenceToInputMatrix;
+  vnl_vector_fixed<double, 3> m_ReferenceToInputOffset;
+  const itk::ImageBase<3> *m_ReferenceToInputSpace;
+  const ObliqueTransformType *m_ReferenceToInputTransform;
+  itk::TimeStamp m_ReferenceToInputTime;
+
+  // Update the affine mapping if needed; returns false if the transform is not linear
+  bool UpdateReferenceToInputMapping(const itk::ImageBase<3> *ref_space);
+
   void MapInputsToSlicers();
 };
 
@@ -96,6 +96,10 @@ AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
 
   // Initially use the ortho
   m_UseOrthogonalSlicing = true;
+
+  // No reference space mapping has been computed
+  m_ReferenceToInputSpace = NULL;
+  m_ReferenceToInputTransform = NULL;
 }
 
 template<typename TInputImage, typename TOutputImage, typename TPreviewImage>
@@ -288,7 +292,137 @@ AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
     }
 }
 
+template<typename TInputImage, typename TOutputImage, typename TPreviewImage>
+bool
+AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
+::UpdateReferenceToInputMapping(const itk::ImageBase<3> *ref_space)
+{
+  const ObliqueTransformType *tran = this->GetObliqueTransform();
+  if(!tran->IsLinear())
+    return false;
+
+  // Check if the mapping is still valid
+  const InputImageType *input = this->GetInput();
+  itk::ModifiedTimeType t_map = m_ReferenceToInputTime.GetMTime();
+  if(m_ReferenceToInputSpace == ref_space && m_ReferenceToInputTransform == tran
+     && t_map > ref_space->GetMTime() && t_map > tran->GetMTime() && t_map > input->GetMTime())
+    return true;
+
+  // Map the origin and the unit steps along each axis of reference space to
+  // the input image. Since all three mappings are affine, this gives the
+  // whole mapping
+  itk::ContinuousIndex<double, 3> cix[4];
+  for(int j = 0; j < 4; j++)
+    {
+    itk::Index<3> ref_index;
+    ref_index.Fill(0);
+    if(j > 0)
+      ref_index[j-1] = 1;
+
+    itk::Point<double, 3> ref_point, native_point;
+    ref_space->TransformIndexToPhysicalPoint(ref_index, ref_point);
+    native_point = tran->TransformPoint(ref_point);
+    input->TransformPhysicalPointToContinuousIndex(native_point, cix[j]);
+    }
+
+  for(int i = 0; i < 3; i++)
+    {
+    m_ReferenceToInputOffset[i] = cix[0][i];
+    for(int j = 0; j < 3; j++)
+      m_ReferenceToInputMatrix(i, j) = cix[j+1][i] - cix[0][i];
+    }
+
+  m_ReferenceToInputSpace = ref_space;
+  m_ReferenceToInputTransform = tran;
+  m_ReferenceToInputTime.Modified();
+  return true;
+}
+
+template<typename TInputImage, typename TOutputImage, typename TPreviewImage>
+void
+AdaptiveSlicingPipeline<TInputImage, TOutputImage, TPreviewImage>
+::LookupIntensitiesAtReferenceIndices(
+    const itk::ImageBase<3> *ref_space, const IndexType *index, unsigned int n,
+    OutputPixelType *out)
+{
+  // Update the filter once for all the indices
+  this->Update();
+
+  const InputImageType *input = this->GetInput();
+  OutputImageType *output = this->GetOutput();
+
+  // In the orthogonal case, indices in the current slice are read from the
+  // slice, so that the preview image, if any, is used. Other indices are
+  // read directly from the input image, which has the same geometry as the
+  // reference space. The preview is not used for them, since it is only
+  // computed for the slices being displayed. In the oblique case, the input
+  // is interpolated, using the cached affine mapping if the transform is
+  // linear.
+  Vector3ui slice_pos(0);
+  bool use_affine = false;
+  if(m_UseOrthogonalSlicing)
+    {
+    slice_pos = this->GetOrthogonalTransform()->TransformVoxelIndex(Vector3ui(m_SliceIndex));
+    }
+  else
+    {
+    use_affine = this->UpdateReferenceToInputMapping(ref_space);
+    }
+
+  // The interpolation worker is created on first use
+  typedef typename NonOrthogonalSlicerType::WorkerType WorkerType;
+  WorkerType *worker = NULL;
+  unsigned int k = output->GetNumberOfComponentsPerPixel();
+  std::vector<OutputComponentType> out_arr(k);
+
+  for(unsigned int i = 0; i < n; i++)
+    {
+    if(m_UseOrthogonalSlicing)
+      {
+      Vector3ui slice_3d = this->GetOrthogonalTransform()->TransformVoxelIndex(Vector3ui(index[i]));
+      if(slice_3d[2] == slice_pos[2]
+         || !input->GetBufferedRegion().IsInside(index[i]))
+        {
+        itk::Index<2> slice_idx; slice_idx[0] = slice_3d[0]; slice_idx[1] = slice_3d[1];
+        out[i] = output->GetPixel(slice_idx);
+        }
+      else
+        {
+        out[i] = input->GetPixel(index[i]);
+        }
+      continue;
+      }
+
+    // Map the index to the input image
+    itk::ContinuousIndex<double, 3> native_cindex;
+    if(use_affine)
+      {
+      for(int d = 0; d < 3; d++)
+        {
+        native_cindex[d] = m_ReferenceToInputOffset[d];
+        for(int j = 0; j < 3; j++)
+          native_cindex[d] += m_ReferenceToInputMatrix(d, j) * index[i][j];
+        }
+      }
+    else
+      {
+      itk::Point<double, 3> cursor_point, native_point;
+      ref_space->TransformIndexToPhysicalPoint(index[i], cursor_point);
+      native_point = this->GetObliqueTransform()->TransformPoint(cursor_point);
+      input->TransformPhysicalPointToContinuousIndex(native_point, native_cindex);
+      }
+
+    // Interpolate the input image
+    if(!worker)
+      worker = new WorkerType(const_cast<InputImageType *>(input));
+
+    OutputComponentType *dummy = &out_arr[0];
+    worker->ProcessVoxel(native_cindex.GetDataPointer(), false, &dummy);
+    AdaptiveSlicingPipeline_PixelFiller<OutputImageType>::MakePixel(output, out[i], &out_arr[0]);
+    }
 
+  delete worker;
+}
 
 
 #endif // ADAPTIVESLICINGPIPELINE_TXX
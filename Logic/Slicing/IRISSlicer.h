@@ -38,6 +38,7 @@
 #include <ImageCoordinateTransform.h>
 
 #include "RLEImageRegionConstIterator.h"
+#include "BrickedImage.h"
 #include <itkImageToImageFilter.h>
 #include <itkImageSliceConstIteratorWithIndex.h>
 #include <itkImageRegionIteratorWithIndex.h>
@@ -372,9 +373,147 @@ private:
 
 };
 
+//specialization for bricked label image, which copies the slice brick by brick
+template< typename TPixel, unsigned int VBrickSize, class TOutputImage, class TPreviewImage>
+class ITK_EXPORT IRISSlicer<BrickedImage<TPixel, VBrickSize>, TOutputImage, TPreviewImage >
+    : public itk::ImageToImageFilter<BrickedImage<TPixel, VBrickSize>, TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef IRISSlicer                                                     Self;
+  typedef BrickedImage<TPixel, VBrickSize>                     InputImageType;
+  typedef itk::ImageToImageFilter<InputImageType, TOutputImage>    Superclass;
+  typedef itk::SmartPointer<Self>                                     Pointer;
+  typedef itk::SmartPointer<const Self>                          ConstPointer;
+
+  typedef typename InputImageType::ConstPointer             InputImagePointer;
+  typedef typename InputImageType::PixelType                   InputPixelType;
+  typedef typename InputImageType::InternalPixelType       InputComponentType;
+
+  typedef TPreviewImage                                      PreviewImageType;
+  typedef typename PreviewImageType::ConstPointer         PreviewImagePointer;
+  typedef typename PreviewImageType::PixelType               PreviewPixelType;
+  typedef typename PreviewImageType::InternalPixelType   PreviewComponentType;
+
+  typedef TOutputImage                                        OutputImageType;
+  typedef typename OutputImageType::Pointer                OutputImagePointer;
+  typedef typename OutputImageType::PixelType                 OutputPixelType;
+  typedef typename OutputImageType::InternalPixelType     OutputComponentType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self)
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(IRISSlicer, ImageToImageFilter)
+
+  /** Some more typedefs. */
+  typedef typename InputImageType::RegionType             InputImageRegionType;
+  typedef typename OutputImageType::RegionType           OutputImageRegionType;
+  typedef itk::ImageSliceConstIteratorWithIndex<InputImageType>  InputIteratorType;
+  typedef itk::ImageRegionIteratorWithIndex<OutputImageType>  SimpleOutputIteratorType;
+  typedef itk::ImageLinearIteratorWithIndex<OutputImageType> OutputIteratorType;
+
+  /** Set the current slice index */
+  itkSetMacro(SliceIndex, unsigned int);
+  itkGetMacro(SliceIndex, unsigned int);
+
+  /** Set the image axis along which the subsequent slices lie */
+  itkSetMacro(SliceDirectionImageAxis, unsigned int);
+  itkGetMacro(SliceDirectionImageAxis, unsigned int);
+
+  /** Set the image axis along which the subsequent lines in a slice lie */
+  itkSetMacro(LineDirectionImageAxis, unsigned int);
+  itkGetMacro(LineDirectionImageAxis, unsigned int);
+
+  /** Set the image axis along which the subsequent pixels in a line lie */
+  itkSetMacro(PixelDirectionImageAxis, unsigned int);
+  itkGetMacro(PixelDirectionImageAxis, unsigned int);
+
+  /** Set the direction of line traversal */
+  itkSetMacro(LineTraverseForward, bool);
+  itkGetMacro(LineTraverseForward, bool);
+
+  /** Set the direction of pixel traversal */
+  itkSetMacro(PixelTraverseForward, bool);
+  itkGetMacro(PixelTraverseForward, bool);
+
+  /** Add a second `preview' input to the slicer. The slicer will check if
+    the preview input is newer than the main input, and if so, will obtain
+    the data from the preview input. This is used in the speed preview
+    framework, but could also be adapted for other features. Setting the
+    preview input to NULL disables this feature. */
+  void SetPreviewInput(PreviewImageType *input);
+
+  /**
+    Get the preview input.
+    */
+  PreviewImageType *GetPreviewInput();
+
+  /**
+     * Indicate whether the main input should always be bypassed when the preview
+     * input is present. If not, the slicer will use whichever input is newer.
+     */
+  itkGetMacro(BypassMainInput, bool)
+  itkSetMacro(BypassMainInput, bool)
+
+protected:
+
+  IRISSlicer();
+  virtual ~IRISSlicer() {};
+  void PrintSelf(std::ostream &s, itk::Indent indent) const ITK_OVERRIDE;
+
+  /**
+    * IRISSlicer can produce an image which is a different
+    * resolution than its input image.  As such, IRISSlicer
+    * needs to provide an implementation for
+    * GenerateOutputInformation() in order to inform the pipeline
+    * execution model.  The original documentation of this method is
+    * below.
+    *
+    * \sa ProcessObject::GenerateOutputInformaton()  */
+  virtual void GenerateOutputInformation() ITK_OVERRIDE;
+
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  /**
+    * This method maps an input region to an output region
+    */
+  virtual void CallCopyOutputRegionToInputRegion(InputImageRegionType &destRegion,
+                                                 const OutputImageRegionType &srcRegion) ITK_OVERRIDE;
+
+  void GenerateData() ITK_OVERRIDE;
+
+private:
+  IRISSlicer(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+
+  // Current slice in each of the dimensions
+  unsigned int m_SliceIndex;
+
+  // Image axis corresponding to the slice direction
+  unsigned int m_SliceDirectionImageAxis;
+
+  // Image axis corresponding to the line direction
+  unsigned int m_LineDirectionImageAxis;
+
+  // Image axis corresponding to the pixel direction
+  unsigned int m_PixelDirectionImageAxis;
+
+  // Whether the line direction is reversed
+  bool m_LineTraverseForward;
+
+  // Whether the pixel direction is reversed
+  bool m_PixelTraverseForward;
+
+  // Whether the main input should always be bypassed
+  bool m_BypassMainInput;
+
+};
+
 #ifndef ITK_MANUAL_INSTANTIATION
 #include "IRISSlicer.txx"
 #include "IRISSlicer_RLE.txx"
+#include "IRISSlicer_Bricked.txx"
 #endif
 
 #endif //__IRISSlicer_h_
@@ -0,0 +1,126 @@
+#include "SliceLayerCompositor.h"
+
+// Divide a product of two bytes by 255, with rounding. Exact for x <= 255*255
+inline unsigned int div255(unsigned int x)
+{
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+SliceLayerCompositor::SliceLayerCompositor()
+{
+  this->SetNumberOfRequiredInputs(1);
+  m_Opacity.resize(1, 255);
+}
+
+void
+SliceLayerCompositor
+::SetNumberOfLayers(unsigned int n)
+{
+  if(n != m_Opacity.size())
+    {
+    this->SetNumberOfIndexedInputs(n);
+    m_Opacity.resize(n, 255);
+    this->Modified();
+    }
+}
+
+unsigned int
+SliceLayerCompositor
+::GetNumberOfLayers() const
+{
+  return m_Opacity.size();
+}
+
+void
+SliceLayerCompositor
+::SetLayer(unsigned int i, const SliceType *slice, double opacity)
+{
+  assert(i < m_Opacity.size());
+
+  // SetNthInput does nothing if the input has not changed
+  this->SetNthInput(i, const_cast<SliceType *>(slice));
+
+  // Use the same conversion to bytes as in OpenGLSliceTexture::DrawTransparent
+  unsigned char op = (i == 0) ? 255 : (unsigned char)(opacity * 255);
+  if(op != m_Opacity[i])
+    {
+    m_Opacity[i] = op;
+    this->Modified();
+    }
+}
+
+void
+SliceLayerCompositor
+::CopyRowOpaque(const PixelType *src, PixelType *trg, size_t n)
+{
+  const unsigned char *s = src->GetDataPointer();
+  unsigned char *t = trg->GetDataPointer();
+  for(size_t i = 0; i < 4 * n; i += 4)
+    {
+    t[i] = s[i];
+    t[i+1] = s[i+1];
+    t[i+2] = s[i+2];
+    t[i+3] = 255;
+    }
+}
+
+void
+SliceLayerCompositor
+::BlendRowOver(const PixelType *src, unsigned int opacity, PixelType *trg, size_t n)
+{
+  const unsigned char *s = src->GetDataPointer();
+  unsigned char *t = trg->GetDataPointer();
+  for(size_t i = 0; i < 4 * n; i += 4)
+    {
+    // Effective alpha of the source pixel; the source color premultiplied by
+    // it is added to the target color scaled by the remaining transparency
+    unsigned int a = div255(s[i+3] * opacity);
+    unsigned int ia = 255 - a;
+    t[i]   = (unsigned char) div255(s[i] * a + t[i] * ia);
+    t[i+1] = (unsigned char) div255(s[i+1] * a + t[i+1] * ia);
+    t[i+2] = (unsigned char) div255(s[i+2] * a + t[i+2] * ia);
+    t[i+3] = (unsigned char) (a + div255(t[i+3] * ia));
+    }
+}
+
+void
+SliceLayerCompositor
+::ThreadedGenerateData(const OutputImageRegionType &region,
+                       itk::ThreadIdType itkNotUsed(threadId))
+{
+  SliceType *output = this->GetOutput();
+  size_t nx = region.GetSize()[0];
+  unsigned int nLayers = this->GetNumberOfIndexedInputs();
+
+  // The layers that are visible at all
+  std::vector<const SliceType *> overlays;
+  std::vector<unsigned int> opacity;
+  for(unsigned int i = 1; i < nLayers; i++)
+    {
+    const SliceType *slice = this->GetInput(i);
+    if(slice && m_Opacity[i] > 0)
+      {
+      overlays.push_back(slice);
+      opacity.push_back(m_Opacity[i]);
+      }
+    }
+
+  // Process the region one row at a time
+  const SliceType *base = this->GetInput(0);
+  itk::Index<2> idx = region.GetIndex();
+  for(unsigned int y = 0; y < region.GetSize()[1]; y++)
+    {
+    idx[1] = region.GetIndex()[1] + y;
+    PixelType *trg = output->GetBufferPointer() + output->ComputeOffset(idx);
+
+    CopyRowOpaque(base->GetBufferPointer() + base->ComputeOffset(idx), trg, nx);
+
+    for(unsigned int j = 0; j < overlays.size(); j++)
+      {
+      const SliceType *slice = overlays[j];
+      BlendRowOver(slice->GetBufferPointer() + slice->ComputeOffset(idx),
+                   opacity[j], trg, nx);
+      }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef SLICELAYERCOMPOSITOR_H
+#define SLICELAYERCOMPOSITOR_H
+
+#include "SNAPCommon.h"
+#include "itkRGBAPixel.h"
+#include <itkImageToImageFilter.h>
+#include <vector>
+
+/**
+ * This filter blends the display slices of several image layers into a
+ * single RGBA slice, so that a slice view can be drawn with one texture
+ * instead of one texture per layer.
+ *
+ * The first input is the base layer, which is drawn opaque (its alpha is
+ * ignored, as when it is drawn by OpenGL without blending). The remaining
+ * inputs are drawn over it in order, each with its own opacity, which is
+ * combined with the alpha of its pixels. Blending uses the 'over' operator
+ * on premultiplied colors, i.e., the same result as glBlendFunc(GL_SRC_ALPHA,
+ * GL_ONE_MINUS_SRC_ALPHA) on an opaque framebuffer, up to rounding.
+ *
+ * All inputs must have the same size. The work is done a row at a time with
+ * integer arithmetic, in loops that the compiler can vectorize. The filter
+ * has no OpenGL dependencies.
+ */
+class SliceLayerCompositor :
+    public itk::ImageToImageFilter<itk::Image<itk::RGBAPixel<unsigned char>, 2>,
+                                   itk::Image<itk::RGBAPixel<unsigned char>, 2> >
+{
+public:
+
+  typedef itk::RGBAPixel<unsigned char>                              PixelType;
+  typedef itk::Image<PixelType, 2>                                   SliceType;
+
+  typedef SliceLayerCompositor                                            Self;
+  typedef itk::ImageToImageFilter<SliceType, SliceType>             Superclass;
+  typedef itk::SmartPointer<Self>                                      Pointer;
+  typedef itk::SmartPointer<const Self>                           ConstPointer;
+
+  typedef Superclass::OutputImageRegionType              OutputImageRegionType;
+
+  itkTypeMacro(SliceLayerCompositor, ImageToImageFilter)
+  itkNewMacro(Self)
+
+  /**
+   * Set the number of layers, including the base layer. Layers past this
+   * number are removed. The filter is only modified if the number changes.
+   */
+  void SetNumberOfLayers(unsigned int n);
+
+  /** Get the number of layers, including the base layer */
+  unsigned int GetNumberOfLayers() const;
+
+  /**
+   * Set the slice and opacity (between 0 and 1) of the i-th layer. Layer 0
+   * is the base layer, whose opacity is ignored. The filter is only modified
+   * if the slice or the opacity change.
+   */
+  void SetLayer(unsigned int i, const SliceType *slice, double opacity = 1.0);
+
+  /** Copy a row of base layer pixels to the output, making them opaque */
+  static void CopyRowOpaque(const PixelType *src, PixelType *trg, size_t n);
+
+  /**
+   * Blend a row of pixels over a row of output pixels. The opacity (0-255)
+   * multiplies the alpha of the source pixels.
+   */
+  static void BlendRowOver(const PixelType *src, unsigned int opacity,
+                           PixelType *trg, size_t n);
+
+protected:
+
+  SliceLayerCompositor();
+  virtual ~SliceLayerCompositor() {}
+
+  /** The actual work */
+  void ThreadedGenerateData(const OutputImageRegionType &region,
+                            itk::ThreadIdType threadId) ITK_OVERRIDE;
+
+  // The slices of different layers may have slightly different geometry
+  virtual void VerifyInputInformation() ITK_OVERRIDE { }
+
+  // Opacity of each layer, in the range 0-255 as in glColor4ub
+  std::vector<unsigned char> m_Opacity;
+};
+
+#endif // SLICELAYERCOMPOSITOR_H
@@ -0,0 +1,62 @@
+#ifndef SLICEUPDATEREGIONTRACKER_H
+#define SLICEUPDATEREGIONTRACKER_H
+
+#include "itkImage.h"
+#include <vector>
+
+/**
+ * This class finds the part of a 2D slice that changed since the last time
+ * it was seen. It is used by OpenGLSliceTexture so that only the changed
+ * rectangle of a slice is sent to the graphics card, e.g., when a few voxels
+ * of the segmentation are painted.
+ *
+ * The slices are regenerated by the slicing and display mapping pipelines,
+ * which do not report which pixels they changed, so the tracker keeps a copy
+ * of the last slice and compares the new slice to it row by row. Comparing
+ * is much cheaper than uploading the slice. The tracker also counts the
+ * number of bytes in the regions that it reports as changed.
+ */
+template <class TPixel>
+class SliceUpdateRegionTracker
+{
+public:
+
+  typedef itk::Image<TPixel, 2>                                    ImageType;
+  typedef itk::ImageRegion<2>                                     RegionType;
+
+  SliceUpdateRegionTracker();
+
+  /**
+   * Compare the slice to the slice passed in on the previous call, and
+   * return the bounding box of the pixels that differ. The whole buffered
+   * region is returned on the first call, after Reset(), and when the size
+   * of the slice changes. A region of size zero means no change.
+   */
+  RegionType Update(const ImageType *image);
+
+  /** Forget the last slice, so that the next update returns the whole slice */
+  void Reset();
+
+  /** Total number of bytes in the regions returned by Update() */
+  unsigned long GetBytesUpdated() const { return m_BytesUpdated; }
+
+  /** Reset the byte counter */
+  void ResetBytesUpdated() { m_BytesUpdated = 0; }
+
+protected:
+
+  // Copy of the last slice
+  std::vector<TPixel> m_Copy;
+
+  // Size of the last slice
+  itk::Size<2> m_Size;
+
+  // Byte counter
+  unsigned long m_BytesUpdated;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "SliceUpdateRegionTracker.txx"
+#endif
+
+#endif // SLICEUPDATEREGIONTRACKER_H
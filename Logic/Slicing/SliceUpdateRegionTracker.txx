@@ -0,0 +1,81 @@
+#include "SliceUpdateRegionTracker.h"
+#include <cstring>
+#include <algorithm>
+
+template <class TPixel>
+SliceUpdateRegionTracker<TPixel>
+::SliceUpdateRegionTracker()
+{
+  m_Size.Fill(0);
+  m_BytesUpdated = 0;
+}
+
+template <class TPixel>
+void
+SliceUpdateRegionTracker<TPixel>
+::Reset()
+{
+  m_Copy.clear();
+  m_Size.Fill(0);
+}
+
+template <class TPixel>
+typename SliceUpdateRegionTracker<TPixel>::RegionType
+SliceUpdateRegionTracker<TPixel>
+::Update(const ImageType *image)
+{
+  RegionType region = image->GetBufferedRegion();
+  itk::Size<2> size = region.GetSize();
+  size_t nx = size[0], ny = size[1];
+  const TPixel *buffer = image->GetBufferPointer();
+
+  // Without a copy of the same size, the whole slice has changed
+  if(size != m_Size || m_Copy.size() != nx * ny)
+    {
+    m_Copy.assign(buffer, buffer + nx * ny);
+    m_Size = size;
+    m_BytesUpdated += nx * ny * sizeof(TPixel);
+    return region;
+    }
+
+  // Find the bounding box of the changed pixels, updating the copy as we go
+  size_t x0 = nx, x1 = 0, y0 = ny, y1 = 0;
+  for(size_t y = 0; y < ny; y++)
+    {
+    const TPixel *row = buffer + y * nx;
+    TPixel *copy = &m_Copy[y * nx];
+    if(memcmp(row, copy, nx * sizeof(TPixel)) == 0)
+      continue;
+
+    // Find the first and last changed pixels in the row, only searching the
+    // part of the row that is outside of the current bounding box
+    size_t a = 0, b = nx - 1;
+    while(a < x0 && memcmp(row + a, copy + a, sizeof(TPixel)) == 0)
+      a++;
+    while(b > x1 && b > a && memcmp(row + b, copy + b, sizeof(TPixel)) == 0)
+      b--;
+
+    x0 = std::min(x0, a);
+    x1 = std::max(x1, b);
+    if(y0 == ny)
+      y0 = y;
+    y1 = y;
+
+    memcpy(copy, row, nx * sizeof(TPixel));
+    }
+
+  // Nothing changed
+  if(y0 == ny)
+    {
+    region.SetSize(0, 0);
+    region.SetSize(1, 0);
+    return region;
+    }
+
+  region.SetIndex(0, region.GetIndex(0) + x0);
+  region.SetIndex(1, region.GetIndex(1) + y0);
+  region.SetSize(0, x1 + 1 - x0);
+  region.SetSize(1, y1 + 1 - y0);
+  m_BytesUpdated += region.GetNumberOfPixels() * sizeof(TPixel);
+  return region;
+}
@@ -0,0 +1,219 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include <itkImage.h>
+#include <itkAffineTransform.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include "AdaptiveSlicingPipeline.h"
+#include "ImageCoordinateTransform.h"
+
+typedef itk::Image<short, 3> ImageType;
+typedef itk::Image<short, 2> SliceType;
+typedef AdaptiveSlicingPipeline<ImageType, SliceType, ImageType> PipelineType;
+typedef itk::AffineTransform<double, 3> AffineTransformType;
+typedef PipelineType::IndexType IndexType;
+
+// An image whose every voxel has a different intensity, shifted by offset
+SmartPtr<ImageType> makeImage(short offset)
+{
+  itk::ImageRegion<3> region;
+  region.SetSize(0, 20);
+  region.SetSize(1, 16);
+  region.SetSize(2, 12);
+
+  SmartPtr<ImageType> image = ImageType::New();
+  image->SetRegions(region);
+  double spacing[] = {1.0, 1.2, 2.0};
+  image->SetSpacing(spacing);
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<ImageType> it(image, region);
+  for(; !it.IsAtEnd(); ++it)
+    {
+    IndexType idx = it.GetIndex();
+    it.Set(offset + idx[0] + 20 * idx[1] + 320 * idx[2]);
+    }
+  return image;
+}
+
+// Indices in the current slice (z = 5 in the image), and anywhere else
+std::vector<IndexType> makeIndices(const IndexType &cursor)
+{
+  std::vector<IndexType> indices;
+  srand(12345);
+  for(int i = 0; i < 200; i++)
+    {
+    IndexType idx;
+    idx[0] = rand() % 20;
+    idx[1] = rand() % 16;
+    idx[2] = (i % 4 == 0) ? cursor[2] : rand() % 12;
+    indices.push_back(idx);
+    }
+  indices.push_back(cursor);
+  return indices;
+}
+
+// Orthogonal slicing: the batched lookup must give the same value as moving
+// the slice to each index and looking up the intensity there. With a preview,
+// indices outside of the current slice are read from the input image, since
+// the preview is only computed for the displayed slices
+int testOrthogonal(const Vector3i &axes, bool preview)
+{
+  SmartPtr<ImageType> image = makeImage(0);
+  SmartPtr<ImageType> previewImage = makeImage(10000);
+  Vector3ui size = Vector3ui(image->GetBufferedRegion().GetSize());
+
+  SmartPtr<ImageCoordinateTransform> tran = ImageCoordinateTransform::New();
+  tran->SetTransform(axes, size);
+
+  SmartPtr<PipelineType> pipeline = PipelineType::New();
+  pipeline->SetInput(image);
+  pipeline->SetOrthogonalTransform(tran);
+  pipeline->SetObliqueTransform(AffineTransformType::New());
+  pipeline->SetUseOrthogonalSlicing(true);
+  if(preview)
+    {
+    pipeline->SetPreviewImage(previewImage);
+    previewImage->Modified();
+    }
+
+  IndexType cursor = {{7, 9, 5}};
+  std::vector<IndexType> indices = makeIndices(cursor);
+  Vector3ui cursor_slice = tran->TransformVoxelIndex(Vector3ui(cursor));
+
+  // Per-index lookup
+  std::vector<short> expected(indices.size());
+  for(unsigned int i = 0; i < indices.size(); i++)
+    {
+    Vector3ui slice_3d = tran->TransformVoxelIndex(Vector3ui(indices[i]));
+    if(preview && slice_3d[2] != cursor_slice[2])
+      {
+      expected[i] = image->GetPixel(indices[i]);
+      }
+    else
+      {
+      pipeline->SetSliceIndex(indices[i]);
+      expected[i] = pipeline->LookupIntensityAtSliceIndex(image);
+      }
+    }
+
+  // Batched lookup
+  std::vector<short> result(indices.size());
+  pipeline->SetSliceIndex(cursor);
+  pipeline->LookupIntensitiesAtReferenceIndices(image, &indices[0], indices.size(), &result[0]);
+
+  int errors = 0;
+  for(unsigned int i = 0; i < indices.size(); i++)
+    {
+    if(result[i] != expected[i])
+      {
+      cerr << "Orthogonal lookup at " << indices[i] << (preview ? " with preview" : "")
+           << ": " << result[i] << " instead of " << expected[i] << endl;
+      errors++;
+      }
+    }
+  return errors;
+}
+
+// Compare the batched and the per-index lookup for oblique slicing
+int compareOblique(PipelineType *pipeline, ImageType *refSpace,
+                   const std::vector<IndexType> &indices, const char *what)
+{
+  std::vector<short> result(indices.size());
+  pipeline->LookupIntensitiesAtReferenceIndices(refSpace, &indices[0], indices.size(), &result[0]);
+
+  int errors = 0;
+  for(unsigned int i = 0; i < indices.size(); i++)
+    {
+    // The affine mapping is computed differently from the transform, and the
+    // interpolated value is rounded, so allow for a difference of one
+    short expected = pipeline->LookupIntensityAtReferenceIndex(refSpace, indices[i]);
+    if(abs(result[i] - expected) > 1)
+      {
+      cerr << "Oblique lookup at " << indices[i] << " (" << what << "): "
+           << result[i] << " instead of " << expected << endl;
+      errors++;
+      }
+    }
+  return errors;
+}
+
+// Oblique slicing with a linear transform uses the cached mapping from the
+// reference space to the input, which must follow changes to the transform
+// and to the reference space
+int testOblique()
+{
+  SmartPtr<ImageType> image = makeImage(0);
+  SmartPtr<ImageType> refSpace = makeImage(0);
+
+  // The viewport of the oblique slice
+  SmartPtr<ImageType> viewport = ImageType::New();
+  itk::ImageRegion<3> vpRegion;
+  vpRegion.SetSize(0, 32);
+  vpRegion.SetSize(1, 32);
+  vpRegion.SetSize(2, 1);
+  viewport->SetRegions(vpRegion);
+
+  // A rotation about the center of the image, with a translation
+  SmartPtr<AffineTransformType> tran = AffineTransformType::New();
+  AffineTransformType::InputPointType center;
+  center[0] = 10.0; center[1] = 9.6; center[2] = 12.0;
+  AffineTransformType::OutputVectorType shift;
+  shift[0] = 0.7; shift[1] = -0.4; shift[2] = 0.3;
+  AffineTransformType::OutputVectorType axis;
+  axis[0] = 0.0; axis[1] = 0.0; axis[2] = 1.0;
+  tran->SetCenter(center);
+  tran->Rotate3D(axis, 0.2);
+  tran->Translate(shift);
+
+  SmartPtr<PipelineType> pipeline = PipelineType::New();
+  pipeline->SetInput(image);
+  pipeline->SetOrthogonalTransform(ImageCoordinateTransform::New());
+  pipeline->SetObliqueTransform(tran);
+  pipeline->SetObliqueReferenceImage(viewport);
+  pipeline->SetUseOrthogonalSlicing(false);
+
+  IndexType cursor = {{7, 9, 5}};
+  std::vector<IndexType> indices = makeIndices(cursor);
+
+  int errors = compareOblique(pipeline, refSpace, indices, "initial");
+
+  // Repeat with the cached mapping
+  errors += compareOblique(pipeline, refSpace, indices, "cached");
+
+  // Change the transform
+  axis[0] = 1.0; axis[2] = 0.0;
+  tran->Rotate3D(axis, -0.15);
+  tran->Modified();
+  errors += compareOblique(pipeline, refSpace, indices, "transform changed");
+
+  // Change the reference space
+  double spacing[] = {1.1, 1.0, 1.5};
+  refSpace->SetSpacing(spacing);
+  errors += compareOblique(pipeline, refSpace, indices, "reference space changed");
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  errors += testOrthogonal(Vector3i(1, 2, 3), false);
+  errors += testOrthogonal(Vector3i(1, 2, 3), true);
+  errors += testOrthogonal(Vector3i(2, -3, 1), false);
+  errors += testOrthogonal(Vector3i(2, -3, 1), true);
+  errors += testOblique();
+
+  if(errors)
+    {
+    cerr << errors << " errors in batched intensity lookup" << endl;
+    return 1;
+    }
+
+  cout << "Batched intensity lookup test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include <itkImage.h>
+#include <itkImageRegionIterator.h>
+#include "BrickedImage.h"
+#include "BrickedImageRegionIterator.h"
+#include "IRISSlicer.h"
+
+typedef BrickedImage<short> BrickedImageType;
+typedef itk::Image<short, 3> DenseImageType;
+typedef itk::Image<short, 2> SliceImageType;
+
+// Compare every voxel of the bricked image to the reference
+int compareImages(BrickedImageType *bricked, DenseImageType *dense)
+{
+  int errors = 0;
+  itk::ImageRegionConstIterator<BrickedImageType> it(bricked, bricked->GetBufferedRegion());
+  itk::ImageRegionConstIterator<DenseImageType> itRef(dense, dense->GetBufferedRegion());
+  for(; !itRef.IsAtEnd(); ++it, ++itRef)
+    {
+    if(it.IsAtEnd() || it.GetIndex() != itRef.GetIndex() || it.Get() != itRef.Get()
+       || bricked->GetPixel(itRef.GetIndex()) != itRef.Get())
+      errors++;
+    }
+  if(!it.IsAtEnd())
+    errors++;
+  return errors;
+}
+
+// Fill the reference with a few large structures, a block of fragmented
+// labels and a thin sheet, so that all three brick encodings are used
+void fillReference(DenseImageType *dense)
+{
+  itk::ImageRegionIterator<DenseImageType> it(dense, dense->GetBufferedRegion());
+  for(; !it.IsAtEnd(); ++it)
+    {
+    DenseImageType::IndexType idx = it.GetIndex();
+    long dx = idx[0] - 30, dy = idx[1] - 30, dz = idx[2] - 20;
+    short label = 0;
+    if(dx * dx + dy * dy + dz * dz < 400)
+      label = 1;
+    if(idx[0] >= 70 && idx[1] < 40)
+      label = rand() % 20;
+    if(idx[2] == 45)
+      label = 3;
+    it.Set(label);
+    }
+}
+
+// Paint random boxes into both images with region iterators
+void paintBoxes(BrickedImageType *bricked, DenseImageType *dense, int nBoxes)
+{
+  DenseImageType::SizeType sz = dense->GetBufferedRegion().GetSize();
+  for(int k = 0; k < nBoxes; k++)
+    {
+    DenseImageType::RegionType box;
+    for(int d = 0; d < 3; d++)
+      {
+      box.SetIndex(d, rand() % sz[d]);
+      box.SetSize(d, 1 + rand() % (sz[d] - box.GetIndex(d)));
+      }
+    short label = rand() % 6;
+    itk::ImageRegionIterator<BrickedImageType> it(bricked, box);
+    itk::ImageRegionIterator<DenseImageType> itRef(dense, box);
+    for(; !it.IsAtEnd(); ++it, ++itRef)
+      {
+      it.Set(label);
+      itRef.Set(label);
+      }
+    }
+}
+
+// Compare the slices extracted by the bricked slicer and the generic slicer
+int compareSlices(BrickedImageType *bricked, DenseImageType *dense)
+{
+  typedef IRISSlicer<BrickedImageType, SliceImageType, BrickedImageType> BrickedSlicerType;
+  typedef IRISSlicer<DenseImageType, SliceImageType, DenseImageType> DenseSlicerType;
+
+  static const unsigned int axes[6][3] =
+    { {0, 1, 2}, {1, 0, 2}, {0, 2, 1}, {2, 0, 1}, {1, 2, 0}, {2, 1, 0} };
+
+  int errors = 0;
+  for(int p = 0; p < 6; p++)
+    {
+    unsigned int pixelAxis = axes[p][0], lineAxis = axes[p][1], sliceAxis = axes[p][2];
+    unsigned int nSlices = dense->GetBufferedRegion().GetSize(sliceAxis);
+    for(unsigned int slice = 0; slice < nSlices; slice += 7)
+      {
+      for(int dir = 0; dir < 4; dir++)
+        {
+        BrickedSlicerType::Pointer bs = BrickedSlicerType::New();
+        DenseSlicerType::Pointer ds = DenseSlicerType::New();
+        bs->SetInput(bricked);
+        ds->SetInput(dense);
+
+        bs->SetSliceDirectionImageAxis(sliceAxis);
+        bs->SetLineDirectionImageAxis(lineAxis);
+        bs->SetPixelDirectionImageAxis(pixelAxis);
+        bs->SetSliceIndex(slice);
+        bs->SetPixelTraverseForward((dir & 1) == 0);
+        bs->SetLineTraverseForward((dir & 2) == 0);
+
+        ds->SetSliceDirectionImageAxis(sliceAxis);
+        ds->SetLineDirectionImageAxis(lineAxis);
+        ds->SetPixelDirectionImageAxis(pixelAxis);
+        ds->SetSliceIndex(slice);
+        ds->SetPixelTraverseForward((dir & 1) == 0);
+        ds->SetLineTraverseForward((dir & 2) == 0);
+
+        bs->Update();
+        ds->Update();
+
+        itk::ImageRegionConstIterator<SliceImageType> it(
+              bs->GetOutput(), bs->GetOutput()->GetBufferedRegion());
+        itk::ImageRegionConstIterator<SliceImageType> itRef(
+              ds->GetOutput(), ds->GetOutput()->GetBufferedRegion());
+        for(; !itRef.IsAtEnd(); ++it, ++itRef)
+          if(it.Get() != itRef.Get())
+            errors++;
+        }
+      }
+    }
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  srand(1234);
+  int errors = 0;
+
+  // The size is not a multiple of the brick size, so edge bricks are partial
+  DenseImageType::SizeType sz = {{ 100, 70, 50 }};
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(sz);
+  dense->Allocate();
+  fillReference(dense);
+
+  BrickedImageType::Pointer bricked = BrickedImageType::New();
+  bricked->SetRegions(sz);
+  bricked->Allocate();
+  bricked->Import(dense->GetBufferPointer());
+  errors += compareImages(bricked, dense);
+
+  for(int e = BrickedImageType::BRICK_CONSTANT; e <= BrickedImageType::BRICK_DENSE; e++)
+    {
+    if(bricked->GetNumberOfBricks((BrickedImageType::BrickEncoding) e) == 0)
+      {
+      cerr << "No bricks use encoding " << e << endl;
+      errors++;
+      }
+    }
+
+  size_t denseBytes = sz[0] * sz[1] * sz[2] * sizeof(short);
+  cout << "Bricked image uses " << bricked->GetMemoryFootprint() << " bytes, dense image "
+       << denseBytes << " bytes" << endl;
+  if(bricked->GetMemoryFootprint() >= denseBytes)
+    {
+    cerr << "The bricked image is not smaller than the dense image" << endl;
+    errors++;
+    }
+
+  errors += compareSlices(bricked, dense);
+
+  // Edits change the encoding of the bricks as they accumulate
+  for(int pass = 0; pass < 3; pass++)
+    {
+    paintBoxes(bricked, dense, 50);
+    errors += compareImages(bricked, dense);
+    }
+
+  bricked->Optimize();
+  errors += compareImages(bricked, dense);
+  errors += compareSlices(bricked, dense);
+
+  vector<short> exported(sz[0] * sz[1] * sz[2]);
+  bricked->Export(&exported[0]);
+  for(size_t i = 0; i < exported.size(); i++)
+    if(exported[i] != dense->GetBufferPointer()[i])
+      errors++;
+
+  // Filling the image makes every brick constant
+  bricked->FillBuffer(2);
+  dense->FillBuffer(2);
+  errors += compareImages(bricked, dense);
+  if(bricked->GetNumberOfBricks(BrickedImageType::BRICK_RLE)
+     || bricked->GetNumberOfBricks(BrickedImageType::BRICK_DENSE))
+    {
+    cerr << "Filled image has non-constant bricks" << endl;
+    errors++;
+    }
+
+  if(errors)
+    {
+    cerr << errors << " errors in bricked label image" << endl;
+    return 1;
+    }
+
+  cout << "Bricked label image test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,231 @@
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+#include "IRISApplication.h"
+#include "SegmentationUpdateIterator.h"
+
+typedef SegmentationUpdateIterator::LabelImageType LabelImageType;
+typedef itk::ImageRegionIterator<LabelImageType> LabelIterator;
+
+// The scalpel relabels the voxels for which this is positive
+double distance(long x, long y, long z, const Vector3d &normal, double intercept)
+{
+  return x * normal[0] + y * normal[1] + z * normal[2] - intercept;
+}
+
+// The span must lie within the scanline, so that the caller never steps
+// past the end of the line
+int checkSpanBounds(long xMin, long xMax, long x0, long x1)
+{
+  if(xMin <= x0 && x0 <= x1 && x1 <= xMax)
+    return 0;
+
+  cerr << "Span [" << x0 << "," << x1 << ") is outside of [" << xMin << "," << xMax << ")" << endl;
+  return 1;
+}
+
+// Planes that lie entirely on one side of the scanline give empty spans, or
+// spans that cover the whole line, within its bounds
+int testPlanesOutsideLine()
+{
+  int errors = 0;
+  long xMin = 0, xMax = 64;
+  for(int side = -1; side <= 1; side += 2)
+    {
+    for(int flip = -1; flip <= 1; flip += 2)
+      {
+      // The plane x = 100 (or x = -36), with the normal in either direction
+      Vector3d normal(flip * 1.0, flip * 0.01, 0.0);
+      double xPlane = (side > 0) ? 100.0 : -36.0;
+      double intercept = flip * xPlane;
+
+      for(long y = 0; y < 4; y++)
+        {
+        long x0, x1;
+        IRISApplication::ComputeCutPlaneSpan(y, 0, xMin, xMax, normal, intercept, x0, x1);
+        errors += checkSpanBounds(xMin, xMax, x0, x1);
+
+        // The whole line is on the same side of the plane
+        bool inPlane = distance(xMin, y, 0, normal, intercept) > 0;
+        if(inPlane != (x0 == xMin && x1 == xMax) || (!inPlane && x0 != x1))
+          {
+          cerr << "Wrong span for plane outside of the line" << endl;
+          errors++;
+          }
+        }
+      }
+    }
+  return errors;
+}
+
+// Label image with random runs of a few labels
+LabelImageType::Pointer makeLabelImage(const LabelImageType::RegionType &region)
+{
+  LabelImageType::Pointer image = LabelImageType::New();
+  image->SetRegions(region);
+  image->Allocate();
+
+  LabelType label = 0;
+  for(LabelIterator it(image, region); !it.IsAtEnd(); ++it)
+    {
+    if(rand() % 5 == 0)
+      label = rand() % 4;
+    it.Set(label);
+    }
+  return image;
+}
+
+LabelImageType::Pointer copyLabelImage(LabelImageType *source)
+{
+  LabelImageType::RegionType region = source->GetBufferedRegion();
+  LabelImageType::Pointer image = LabelImageType::New();
+  image->SetRegions(region);
+  image->Allocate();
+
+  LabelIterator itSrc(source, region), itTrg(image, region);
+  for(; !itSrc.IsAtEnd(); ++itSrc, ++itTrg)
+    itTrg.Set(itSrc.Get());
+  return image;
+}
+
+// The undo deltas are run-length encoded, so equal deltas have equal runs
+int compareDeltas(SegmentationUpdateIterator::UndoDelta *dSpan,
+                  SegmentationUpdateIterator::UndoDelta *dVoxel)
+{
+  bool same = dSpan->GetNumberOfRLEs() == dVoxel->GetNumberOfRLEs();
+  for(size_t i = 0; same && i < dSpan->GetNumberOfRLEs(); i++)
+    same = dSpan->GetRLEValue(i) == dVoxel->GetRLEValue(i)
+           && dSpan->GetRLELength(i) == dVoxel->GetRLELength(i);
+  if(!same)
+    cerr << "Undo delta of the span update differs from the per-voxel update" << endl;
+  return same ? 0 : 1;
+}
+
+// Painting a span of each line at once must give the same labels and the
+// same undo delta as painting the span one voxel at a time
+int testSpanPainting(int nTrials)
+{
+  LabelImageType::RegionType region;
+  region.SetIndex(0, -3); region.SetIndex(1, 2); region.SetIndex(2, 1);
+  region.SetSize(0, 40); region.SetSize(1, 6); region.SetSize(2, 3);
+
+  int errors = 0;
+  for(int t = 0; t < nTrials; t++)
+    {
+    DrawOverFilter draw_over;
+    draw_over.CoverageMode = (CoverageModeType) (rand() % 3);
+    draw_over.DrawOverLabel = rand() % 4;
+    LabelType active = rand() % 4;
+
+    // The update region may be smaller than the image along x
+    LabelImageType::RegionType rUpdate = region;
+    long xr0 = rand() % 8, xr1 = 40 - rand() % 8;
+    rUpdate.SetIndex(0, region.GetIndex(0) + xr0);
+    rUpdate.SetSize(0, xr1 - xr0);
+
+    LabelImageType::Pointer imgSpan = makeLabelImage(region);
+    LabelImageType::Pointer imgVoxel = copyLabelImage(imgSpan);
+    SegmentationUpdateIterator itSpan(imgSpan, rUpdate, active, draw_over);
+    SegmentationUpdateIterator itVoxel(imgVoxel, rUpdate, active, draw_over);
+
+    // The spans may be empty or extend past the update region
+    long rx0 = rUpdate.GetIndex(0), rx1 = rx0 + (long) rUpdate.GetSize(0);
+    int nLines = (int) (rUpdate.GetSize(1) * rUpdate.GetSize(2));
+    for(int k = 0; k < nLines; k++)
+      {
+      long x0 = rx0 - 4 + rand() % 48, x1 = (rand() % 4 == 0) ? x0 : rx0 - 4 + rand() % 48;
+      itSpan.PaintSpanAsForegroundPreserveClear(x0, x1);
+      for(long x = rx0; x < rx1; x++)
+        {
+        if(x >= x0 && x < x1)
+          itVoxel.PaintAsForegroundPreserveClear();
+        ++itVoxel;
+        }
+      }
+
+    if(!itSpan.IsAtEnd() || !itVoxel.IsAtEnd())
+      {
+      cerr << "Span update did not reach the end of the region" << endl;
+      return errors + 1;
+      }
+
+    itSpan.Finalize();
+    itVoxel.Finalize();
+    if(itSpan.GetNumberOfChangedVoxels() != itVoxel.GetNumberOfChangedVoxels())
+      {
+      cerr << "Span update changed " << itSpan.GetNumberOfChangedVoxels()
+           << " voxels instead of " << itVoxel.GetNumberOfChangedVoxels() << endl;
+      errors++;
+      }
+    errors += compareDeltas(itSpan.GetDelta(), itVoxel.GetDelta());
+
+    LabelIterator itA(imgSpan, region), itB(imgVoxel, region);
+    for(; !itA.IsAtEnd(); ++itA, ++itB)
+      {
+      if(itA.Get() != itB.Get())
+        {
+        cerr << "Label " << itA.Get() << " instead of " << itB.Get()
+             << " at " << itA.GetIndex() << endl;
+        errors++;
+        break;
+        }
+      }
+    }
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int nTrials = argc > 1 ? atoi(argv[1]) : 10000;
+
+  // Random planes, including axis-aligned ones and ones that pass exactly
+  // through voxel centers, are compared to the per-voxel test
+  srand(1234);
+  int errors = testPlanesOutsideLine();
+  for(int t = 0; t < nTrials; t++)
+    {
+    Vector3d normal;
+    for(int d = 0; d < 3; d++)
+      normal[d] = (rand() % 4 == 0) ? 0.0 : (rand() % 2001 - 1000) / 137.0;
+
+    double intercept = (t % 4 == 0)
+                       ? normal[0] * (rand() % 64) + normal[1] * (rand() % 64)
+                       : (rand() % 20001 - 10000) / 53.0;
+
+    long xMin = rand() % 8, xMax = xMin + rand() % 64;
+    for(long z = 0; z < 4; z++)
+      {
+      for(long y = 0; y < 32; y++)
+        {
+        long x0, x1;
+        IRISApplication::ComputeCutPlaneSpan(y, z, xMin, xMax, normal, intercept, x0, x1);
+        errors += checkSpanBounds(xMin, xMax, x0, x1);
+        for(long x = xMin; x < xMax; x++)
+          {
+          bool inPlane = distance(x, y, z, normal, intercept) > 0;
+          bool inSpan = (x >= x0 && x < x1);
+          if(inPlane != inSpan)
+            errors++;
+          }
+        }
+      }
+    }
+
+  if(errors)
+    {
+    cerr << errors << " voxels or spans were on the wrong side of the cut plane" << endl;
+    return 1;
+    }
+
+  if(testSpanPainting(nTrials / 10 + 1))
+    {
+    cerr << "Painting spans of the label image differs from painting voxels" << endl;
+    return 1;
+    }
+
+  cout << "Computed and painted cut plane spans for " << nTrials << " planes without errors" << endl;
+  return 0;
+}
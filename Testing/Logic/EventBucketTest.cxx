@@ -0,0 +1,135 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+#include <itkObject.h>
+#include <itkCommand.h>
+#include "SNAPEvents.h"
+#include "EventBucket.h"
+#include "Rebroadcaster.h"
+
+// Counts the events fired by an object
+class EventCounter : public itk::Command
+{
+public:
+  typedef EventCounter Self;
+  typedef itk::SmartPointer<Self> Pointer;
+  itkNewMacro(Self)
+
+  void Execute(itk::Object *, const itk::EventObject &) ITK_OVERRIDE { m_Count++; }
+  void Execute(const itk::Object *, const itk::EventObject &) ITK_OVERRIDE { m_Count++; }
+
+  unsigned long m_Count;
+
+protected:
+  EventCounter() : m_Count(0) {}
+};
+
+// Events of the same type from the same source are coalesced
+int testBucket()
+{
+  int errors = 0;
+  itk::Object::Pointer a = itk::Object::New(), b = itk::Object::New();
+  EventBucket bucket;
+
+  // Fill the bucket a few times, as in a drag, so entries get reused
+  for(int frame = 0; frame < 3; frame++)
+    {
+    unsigned long t0 = bucket.GetMTime();
+    for(int i = 0; i < 1000; i++)
+      {
+      bucket.PutEvent(CursorUpdateEvent(), a);
+      bucket.PutEvent(itk::ModifiedEvent(), a);
+      bucket.PutEvent(CursorUpdateEvent(), b);
+      }
+
+    // The types change from frame to frame
+    if(frame == 1)
+      bucket.PutEvent(MainImageDimensionsChangeEvent(), b);
+    else
+      bucket.PutEvent(LayerChangeEvent(), a);
+
+    if(bucket.GetMTime() == t0 || bucket.IsEmpty())
+      errors++;
+
+    // Child events are found when looking for the parent
+    if(!bucket.HasEvent(CursorUpdateEvent(), a) || !bucket.HasEvent(CursorUpdateEvent(), b)
+       || !bucket.HasEvent(itk::ModifiedEvent()) || !bucket.HasEvent(IRISEvent(), b)
+       || !bucket.HasEvent(LayerChangeEvent()) || bucket.HasEvent(SegmentationChangeEvent())
+       || bucket.HasEvent(itk::ModifiedEvent(), b))
+      errors++;
+
+    if((frame == 1) != bucket.HasEvent(MainImageDimensionsChangeEvent())
+       || (frame == 1) != bucket.HasEvent(LayerChangeEvent(), b))
+      errors++;
+
+    ostringstream oss;
+    oss << bucket;
+    string text = oss.str();
+    if(count(text.begin(), text.end(), ',') != 3)
+      {
+      cerr << "Events are not coalesced: " << text << endl;
+      errors++;
+      }
+
+    bucket.Clear();
+    if(!bucket.IsEmpty() || bucket.HasEvent(itk::AnyEvent()))
+      errors++;
+    }
+
+  return errors;
+}
+
+// Rebroadcast events are recorded in the bucket and counted
+int testRebroadcastCounts()
+{
+  int errors = 0;
+  Rebroadcaster::ResetEventCounts();
+
+  EventBucket bucket;
+  itk::Object::Pointer source = itk::Object::New(), target = itk::Object::New();
+  EventCounter::Pointer counter = EventCounter::New();
+  target->AddObserver(ModelUpdateEvent(), counter);
+  Rebroadcaster::Rebroadcast(source, itk::ModifiedEvent(), target, ModelUpdateEvent(), &bucket);
+
+  for(int i = 0; i < 500; i++)
+    source->Modified();
+
+  Rebroadcaster::EventCountMap counts;
+  Rebroadcaster::GetEventCounts(counts);
+  if(counter->m_Count != 500 || counts["Object"] != 500
+     || !bucket.HasEvent(itk::ModifiedEvent(), source))
+    errors++;
+
+  // Counts are kept after the objects are deleted
+  source = NULL;
+  Rebroadcaster::GetEventCounts(counts);
+  if(counts["Object"] != 500)
+    errors++;
+
+  Rebroadcaster::PrintEventCounts(cout);
+  Rebroadcaster::ResetEventCounts();
+  Rebroadcaster::GetEventCounts(counts);
+  if(counts.size())
+    errors++;
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+  errors += testBucket();
+  errors += testRebroadcastCounts();
+
+  if(errors)
+    {
+    cerr << errors << " errors in event bucket" << endl;
+    return 1;
+    }
+
+  cout << "Event bucket test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,146 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+
+using namespace std;
+
+#include "IPCHandler.h"
+
+// A message that is easy to check for torn copies: all the fields of a
+// complete message have the same value
+struct TestMessage
+{
+  long counter;
+  long pattern[127];
+
+  void Fill(long value)
+  {
+    counter = value;
+    for(int i = 0; i < 127; i++)
+      pattern[i] = value;
+  }
+
+  bool IsComplete() const
+  {
+    for(int i = 0; i < 127; i++)
+      if(pattern[i] != counter)
+        return false;
+    return true;
+  }
+};
+
+const long N_MESSAGES = 20000;
+
+// Read messages until the last one has been seen, counting torn copies and
+// messages that arrive out of order
+void readMessages(IPCHandler *reader, int *errors)
+{
+  long last = 0;
+  TestMessage msg;
+  while(last < N_MESSAGES)
+    {
+    if(reader->Read(&msg))
+      {
+      if(!msg.IsComplete() || msg.counter < last)
+        (*errors)++;
+      last = msg.counter;
+      }
+    }
+}
+
+// Read messages in one thread while they are broadcast in another
+int testConcurrentReads(IPCHandler &writer, IPCHandler &reader)
+{
+  int errors = 0;
+  thread readerThread(readMessages, &reader, &errors);
+
+  TestMessage msg;
+  for(long i = 1; i <= N_MESSAGES; i++)
+    {
+    msg.Fill(i);
+    writer.Broadcast(&msg);
+    }
+
+  readerThread.join();
+  return errors;
+}
+
+void waitForMessage(IPCHandler *reader, unsigned int *last_seen, int *errors)
+{
+  if(!reader->WaitForMessage(*last_seen, 5000))
+    (*errors)++;
+}
+
+// A session waiting for messages must wake up soon after one is sent
+int testWakeup(IPCHandler &writer, IPCHandler &reader)
+{
+  int errors = 0;
+  unsigned int last_seen = reader.GetMessageCounter();
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+
+  thread waiterThread(waitForMessage, &reader, &last_seen, &errors);
+
+  this_thread::sleep_for(chrono::milliseconds(50));
+  TestMessage msg;
+  msg.Fill(-1);
+  writer.Broadcast(&msg);
+  waiterThread.join();
+
+  double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+  cout << "Waiting session woke up after " << ms << " ms" << endl;
+  if(ms > 1000 || last_seen != reader.GetMessageCounter())
+    errors++;
+
+  // Nothing new: the wait times out
+  if(reader.WaitForMessage(last_seen, 20))
+    errors++;
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+  const short version = 0x7e;
+
+  IPCHandler writer, reader;
+  writer.Attach(argv[0], version, sizeof(TestMessage));
+  reader.Attach(argv[0], version, sizeof(TestMessage));
+
+  if(!writer.IsAttached() || !reader.IsAttached())
+    {
+    // Without shared memory, the handler must fail quietly
+    TestMessage msg;
+    msg.Fill(1);
+    unsigned int last_seen = 0;
+    if(writer.Broadcast(&msg) || reader.Read(&msg) || reader.WaitForMessage(last_seen, 10))
+      errors++;
+    cout << "Shared memory is not available, checked the fallback only" << endl;
+    }
+  else
+    {
+    errors += testConcurrentReads(writer, reader);
+    errors += testWakeup(writer, reader);
+
+    // A session with a different message size must not attach
+    IPCHandler other;
+    other.Attach(argv[0], version, sizeof(TestMessage) / 2);
+    if(other.IsAttached())
+      {
+      other.Close();
+      errors++;
+      }
+
+    reader.Close();
+    writer.Close();
+    }
+
+  if(errors)
+    {
+    cerr << errors << " errors in IPC handler" << endl;
+    return 1;
+    }
+
+  cout << "IPC handler test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,170 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include <itkTimeProbe.h>
+#include "ImageAnnotationData.h"
+#include "Registry.h"
+
+typedef ImageAnnotationData::AbstractAnnotation AbstractAnnotation;
+typedef ImageAnnotationData::AnnotationVector AnnotationVector;
+
+const int SLICES = 64;
+
+// Create a landmark or a line segment with random position and settings
+SmartPtr<AbstractAnnotation> makeAnnotation(int k)
+{
+  int plane = rand() % 3;
+  SmartPtr<AbstractAnnotation> ann;
+  if(k % 4 == 0)
+    {
+    annot::LineSegment seg;
+    for(int d = 0; d < 3; d++)
+      {
+      seg.first[d] = rand() % SLICES;
+      seg.second[d] = rand() % SLICES;
+      }
+    seg.second[plane] = seg.first[plane];
+    SmartPtr<annot::LineSegmentAnnotation> lsa = annot::LineSegmentAnnotation::New();
+    lsa->SetSegment(seg);
+    ann = lsa.GetPointer();
+    }
+  else
+    {
+    annot::Landmark lm;
+    lm.Text = "landmark";
+    lm.Offset = Vector2d(5.0, 5.0);
+    for(int d = 0; d < 3; d++)
+      lm.Pos[d] = rand() % SLICES + 0.25;
+    SmartPtr<annot::LandmarkAnnotation> lma = annot::LandmarkAnnotation::New();
+    lma->SetLandmark(lm);
+    ann = lma.GetPointer();
+    }
+
+  ann->SetPlane(plane);
+  ann->SetVisibleInAllSlices(k % 50 == 0);
+
+  // Line segments only have a slice in their own plane
+  ann->SetVisibleInAllPlanes(ann->GetType() == annot::LANDMARK && k % 7 == 0);
+  ann->SetColor(Vector3d(1.0, 0.0, 0.0));
+  ann->SetSelected(false);
+  return ann;
+}
+
+// Compare the index to a search of the whole list in every slice
+int checkIndex(ImageAnnotationData *data)
+{
+  int errors = 0;
+  AnnotationVector found;
+  for(int plane = 0; plane < 3; plane++)
+    {
+    for(int slice = -1; slice <= SLICES; slice++)
+      {
+      AnnotationVector expected;
+      ImageAnnotationData::AnnotationConstIterator it;
+      for(it = data->GetAnnotations().begin(); it != data->GetAnnotations().end(); ++it)
+        if((*it)->IsVisible(plane, slice))
+          expected.push_back(it->GetPointer());
+
+      data->GetAnnotationsInSlice(plane, slice, found);
+      if(found != expected)
+        errors++;
+      }
+    }
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int nAnnot = argc > 1 ? atoi(argv[1]) : 20000;
+  int errors = 0;
+  srand(1234);
+
+  SmartPtr<ImageAnnotationData> data = ImageAnnotationData::New();
+  for(int k = 0; k < nAnnot; k++)
+    {
+    SmartPtr<AbstractAnnotation> ann = makeAnnotation(k);
+    data->AddAnnotation(ann);
+    }
+  errors += checkIndex(data);
+
+  // Move some annotations to other slices, and change the visibility of others
+  vector<AbstractAnnotation *> all;
+  ImageAnnotationData::AnnotationConstIterator it;
+  for(it = data->GetAnnotations().begin(); it != data->GetAnnotations().end(); ++it)
+    all.push_back(it->GetPointer());
+
+  for(int k = 0; k < nAnnot / 10; k++)
+    {
+    AbstractAnnotation *ann = all[rand() % all.size()];
+    if(k % 5 == 0)
+      {
+      ann->SetVisibleInAllSlices(!ann->GetVisibleInAllSlices());
+      }
+    else
+      {
+      Vector3d offset(0.0);
+      offset[ann->GetPlane()] = rand() % 9 - 4;
+      ann->MoveBy(offset);
+      }
+    data->UpdateAnnotation(ann);
+    }
+  errors += checkIndex(data);
+
+  // Delete some of the annotations in a few slices
+  AnnotationVector found;
+  for(int slice = 0; slice < SLICES; slice += 3)
+    {
+    data->GetAnnotationsInSlice(slice % 3, slice, found);
+    for(AnnotationVector::const_iterator it_del = found.begin(); it_del != found.end(); ++it_del)
+      if(rand() % 2)
+        data->RemoveAnnotation(*it_del);
+    }
+  errors += checkIndex(data);
+
+  // Save and load the annotations
+  itk::TimeProbe tSave, tLoad, tQuery;
+  Registry reg;
+  tSave.Start();
+  data->SaveAnnotations(reg);
+  tSave.Stop();
+
+  SmartPtr<ImageAnnotationData> loaded = ImageAnnotationData::New();
+  tLoad.Start();
+  loaded->LoadAnnotations(reg);
+  tLoad.Stop();
+
+  if(loaded->GetAnnotations().size() != data->GetAnnotations().size())
+    errors++;
+  errors += checkIndex(loaded);
+
+  // Query every slice, as when paging through the image
+  unsigned long n_found = 0;
+  tQuery.Start();
+  for(int plane = 0; plane < 3; plane++)
+    for(int slice = 0; slice < SLICES; slice++)
+      {
+      loaded->GetAnnotationsInSlice(plane, slice, found);
+      n_found += found.size();
+      }
+  tQuery.Stop();
+
+  // Reset clears the index too
+  loaded->Reset();
+  errors += checkIndex(loaded);
+
+  cout << data->GetAnnotations().size() << " annotations: save " << tSave.GetTotal()
+       << " s, load " << tLoad.GetTotal() << " s, query all slices " << tQuery.GetTotal()
+       << " s (" << n_found << " found)" << endl;
+
+  if(errors)
+    {
+    cerr << errors << " errors in annotation index" << endl;
+    return 1;
+    }
+
+  cout << "Image annotation data test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include <itkImage.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkTimeProbe.h>
+#include "SNAPLevelSetDriver.h"
+#include "SnakeParameters.h"
+
+typedef SNAPLevelSetDriver3d DriverType;
+typedef DriverType::FloatImageType FloatImageType;
+typedef DriverType::ShortImageType ShortImageType;
+
+// Speed image for a region competition snake: positive inside of an
+// ellipsoid and negative outside, with a smooth transition
+ShortImageType::Pointer makeSpeedImage(int size)
+{
+  ShortImageType::Pointer speed = ShortImageType::New();
+  ShortImageType::SizeType sz;
+  sz.Fill(size);
+  speed->SetRegions(sz);
+  speed->Allocate();
+
+  double c = 0.5 * (size - 1);
+  double radius[] = { 0.40 * size, 0.30 * size, 0.35 * size };
+  itk::ImageRegionIteratorWithIndex<ShortImageType> it(speed, speed->GetBufferedRegion());
+  for(; !it.IsAtEnd(); ++it)
+    {
+    double r = 0;
+    for(int d = 0; d < 3; d++)
+      {
+      double x = (it.GetIndex()[d] - c) / radius[d];
+      r += x * x;
+      }
+    double v = (1.0 - sqrt(r)) * 8.0;
+    v = v > 1.0 ? 1.0 : (v < -1.0 ? -1.0 : v);
+    it.Set((short)(v * 0x7fff));
+    }
+  return speed;
+}
+
+// Initial level set: a sphere in the middle of the image, using the same
+// binary values as the bubble initialization in SNAP
+FloatImageType::Pointer makeInitialLevelSet(int size)
+{
+  FloatImageType::Pointer phi = FloatImageType::New();
+  FloatImageType::SizeType sz;
+  sz.Fill(size);
+  phi->SetRegions(sz);
+  phi->Allocate();
+
+  double c = 0.5 * (size - 1), radius = 0.08 * size;
+  itk::ImageRegionIteratorWithIndex<FloatImageType> it(phi, phi->GetBufferedRegion());
+  for(; !it.IsAtEnd(); ++it)
+    {
+    double r = 0;
+    for(int d = 0; d < 3; d++)
+      r += (it.GetIndex()[d] - c) * (it.GetIndex()[d] - c);
+    it.Set(sqrt(r) < radius ? -4.0f : 4.0f);
+    }
+  return phi;
+}
+
+// Run the snake with the given solver, return the inside of the final contour
+vector<bool> runSolver(SnakeParameters::SolverType solver, const char *name,
+                       int size, int iterations)
+{
+  ShortImageType::Pointer speed = makeSpeedImage(size);
+  FloatImageType::Pointer init = makeInitialLevelSet(size);
+
+  SnakeParameters param = SnakeParameters::GetDefaultInOutParameters();
+  param.SetSolver(solver);
+
+  itk::TimeProbe probe;
+  probe.Start();
+  DriverType driver(init, speed, param);
+  for(int i = 0; i < iterations; i += 10)
+    driver.Run(10);
+  probe.Stop();
+
+  double seconds = probe.GetTotal();
+  cout << name << ": " << driver.GetElapsedIterations() << " iterations in "
+       << seconds << " s (" << driver.GetElapsedIterations() / seconds
+       << " iterations/s)" << endl;
+
+  vector<bool> mask;
+  FloatImageType *result = driver.GetCurrentState();
+  itk::ImageRegionConstIterator<FloatImageType> it(result, result->GetBufferedRegion());
+  for(; !it.IsAtEnd(); ++it)
+    mask.push_back(it.Get() < 0);
+  return mask;
+}
+
+double dice(const vector<bool> &a, const vector<bool> &b)
+{
+  long na = 0, nb = 0, nab = 0;
+  for(size_t i = 0; i < a.size(); i++)
+    {
+    na += a[i];
+    nb += b[i];
+    nab += a[i] && b[i];
+    }
+  return (na + nb) ? 2.0 * nab / (na + nb) : 1.0;
+}
+
+int main(int argc, char *argv[])
+{
+  int size = argc > 1 ? atoi(argv[1]) : 96;
+  int iterations = argc > 2 ? atoi(argv[2]) : 200;
+
+  vector<bool> sparse = runSolver(
+        SnakeParameters::PARALLEL_SPARSE_FIELD_SOLVER, "ParallelSparseField",
+        size, iterations);
+  vector<bool> blocked = runSolver(
+        SnakeParameters::BLOCKED_NARROW_BAND_SOLVER, "BlockedNarrowBand",
+        size, iterations);
+
+  double overlap = dice(sparse, blocked);
+  cout << "Dice overlap between solvers: " << overlap << endl;
+
+  if(overlap < 0.95)
+    {
+    cerr << "Blocked narrow band solver disagrees with sparse field solver" << endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+#include "MomentTextures.h"
+#include "itkImage.h"
+#include "itkVectorImage.h"
+
+// Fill a scalar or vector image of the given size with random intensities,
+// including negative values and runs of zeros
+template <class TImage>
+typename TImage::Pointer makeImage(long nx, long ny, long nz, int nc, double scale)
+{
+  typename TImage::RegionType region;
+  region.SetSize(0, nx); region.SetSize(1, ny); region.SetSize(2, nz);
+
+  typename TImage::Pointer image = TImage::New();
+  image->SetRegions(region);
+  image->SetNumberOfComponentsPerPixel(nc);
+  image->Allocate();
+
+  typename TImage::InternalPixelType *p = image->GetBufferPointer();
+  for(long i = 0; i < nx * ny * nz * nc; i++)
+    p[i] = (rand() % 4 == 0) ? 0 : (rand() % 3501 - 500) * scale;
+  return image;
+}
+
+inline long clampIndex(long i, long n)
+{
+  return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+// Compute the features of one voxel directly from its neighborhood, with the
+// voxels past the edge of the image replicating the edge voxels
+void bruteForceMoments(const vector<double> &values, long nx, long ny, long nz, int nc,
+                       int c, long x, long y, long z, const long *r, int nd,
+                       vector<double> &features)
+{
+  vector<double> nbr;
+  double min = 0, max = 0, sum = 0;
+  for(long dz = -r[2]; dz <= r[2]; dz++)
+    for(long dy = -r[1]; dy <= r[1]; dy++)
+      for(long dx = -r[0]; dx <= r[0]; dx++)
+        {
+        long off = (clampIndex(z + dz, nz) * ny + clampIndex(y + dy, ny)) * nx
+                   + clampIndex(x + dx, nx);
+        double v = values[off * nc + c];
+        nbr.push_back(v);
+        min = std::min(min, v);
+        max = std::max(max, v);
+        sum += v;
+        }
+
+  double range = max - min, mean = sum / nbr.size();
+  features.assign(nd, 0.0);
+  features[0] = range > 0 ? 1000 * mean / range : 0;
+  for(int k = 2; k <= nd; k++)
+    {
+    double mk = 0.0;
+    for(size_t i = 0; i < nbr.size(); i++)
+      mk += std::pow(nbr[i] - mean, k);
+    mk /= nbr.size();
+    features[k - 1] = range > 0 ? 1000 * mk / std::pow(range, k) : 0;
+    }
+}
+
+// Run the filter and compare every feature of every voxel to the brute force
+// computation. Integer outputs are truncated, so they may be off by one
+template <class TInputImage, class TOutputImage>
+int testFilter(TInputImage *input, const long *r, int nd, double tol, const char *what)
+{
+  typedef bilwaj::MomentTextureFilter<TInputImage, TOutputImage> FilterType;
+  typename FilterType::Pointer filter = FilterType::New();
+  typename TInputImage::SizeType radius;
+  for(int d = 0; d < 3; d++)
+    radius[d] = r[d];
+  filter->SetInput(input);
+  filter->SetRadius(radius);
+  filter->SetHighestDegree(nd);
+  filter->Update();
+
+  TOutputImage *output = filter->GetOutput();
+  const typename TInputImage::RegionType &region = input->GetBufferedRegion();
+  long nx = region.GetSize(0), ny = region.GetSize(1), nz = region.GetSize(2);
+  int nc = input->GetNumberOfComponentsPerPixel();
+  if((int) output->GetNumberOfComponentsPerPixel() != nc * nd
+     || output->GetBufferedRegion() != region)
+    {
+    cerr << what << ": wrong output size or number of components" << endl;
+    return 1;
+    }
+
+  vector<double> values(input->GetBufferPointer(),
+                        input->GetBufferPointer() + nx * ny * nz * nc);
+  const typename TOutputImage::InternalPixelType *out = output->GetBufferPointer();
+
+  int errors = 0;
+  vector<double> features;
+  for(long z = 0; z < nz; z++)
+    for(long y = 0; y < ny; y++)
+      for(long x = 0; x < nx; x++)
+        for(int c = 0; c < nc; c++)
+          {
+          bruteForceMoments(values, nx, ny, nz, nc, c, x, y, z, r, nd, features);
+          long off = ((z * ny + y) * nx + x) * nc * nd + c * nd;
+          for(int k = 0; k < nd; k++)
+            {
+            if(std::fabs(out[off + k] - features[k]) > tol)
+              {
+              if(errors == 0)
+                cerr << what << ", radius " << r[0] << "," << r[1] << "," << r[2]
+                     << ", degree " << nd << ": feature " << k << " of component " << c
+                     << " at " << x << "," << y << "," << z << " is " << out[off + k]
+                     << " instead of " << features[k] << endl;
+              errors++;
+              }
+            }
+          }
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  srand(1234);
+
+  // Radii that fit in the image, that are anisotropic, and that are larger
+  // than the image along some axes, so that most neighborhoods are padded
+  long radii[][3] = { {0, 0, 0}, {1, 1, 1}, {2, 1, 3}, {4, 5, 2} };
+  int nRadii = sizeof(radii) / sizeof(radii[0]);
+
+  typedef itk::Image<short, 3> ShortImage;
+  typedef itk::Image<float, 3> FloatImage;
+  typedef itk::VectorImage<short, 3> ShortVectorImage;
+  typedef itk::VectorImage<float, 3> FloatVectorImage;
+
+  ShortImage::Pointer imgShort = makeImage<ShortImage>(11, 7, 6, 1, 1.0);
+  FloatImage::Pointer imgFloat = makeImage<FloatImage>(9, 8, 5, 1, 0.37);
+  ShortVectorImage::Pointer imgShortVec = makeImage<ShortVectorImage>(7, 6, 9, 2, 1.0);
+  FloatVectorImage::Pointer imgFloatVec = makeImage<FloatVectorImage>(6, 9, 7, 3, 0.37);
+
+  int errors = 0;
+  for(int i = 0; i < nRadii; i++)
+    {
+    for(int nd = 1; nd <= 4; nd++)
+      {
+      errors += testFilter<ShortImage, ShortVectorImage>(
+            imgShort, radii[i], nd, 1.0, "Short image");
+      errors += testFilter<FloatImage, FloatVectorImage>(
+            imgFloat, radii[i], nd, 1.0e-2, "Float image");
+      errors += testFilter<ShortVectorImage, ShortVectorImage>(
+            imgShortVec, radii[i], nd, 1.0, "Short vector image");
+      errors += testFilter<FloatVectorImage, FloatVectorImage>(
+            imgFloatVec, radii[i], nd, 1.0e-2, "Float vector image");
+      }
+    }
+
+  if(errors)
+    {
+    cerr << errors << " moment features differ from the brute force computation" << endl;
+    return 1;
+    }
+
+  cout << "Moment texture features match the brute force computation" << endl;
+  return 0;
+}
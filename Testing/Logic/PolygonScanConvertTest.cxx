@@ -0,0 +1,96 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include <itkImage.h>
+#include "SNAPCommon.h"
+#include "PolygonScanConvert.h"
+
+typedef itk::Image<unsigned char, 2> SliceType;
+typedef std::vector<Vector2d> PolygonType;
+typedef PolygonScanConvert<SliceType, float, PolygonType::iterator> ScanConvertType;
+
+// Crossing number of a point with respect to the polygon (even-odd rule)
+bool insideEvenOdd(const PolygonType &p, double x, double y)
+{
+  bool inside = false;
+  for(size_t i = 0, j = p.size() - 1; i < p.size(); j = i++)
+    {
+    if((p[i][1] <= y) != (p[j][1] <= y))
+      {
+      double xi = p[j][0] + (y - p[j][1]) * (p[i][0] - p[j][0]) / (p[i][1] - p[j][1]);
+      if(x < xi)
+        inside = !inside;
+      }
+    }
+  return inside;
+}
+
+// Winding number of the polygon around a point (nonzero rule)
+bool insideNonzero(const PolygonType &p, double x, double y)
+{
+  int wind = 0;
+  for(size_t i = 0, j = p.size() - 1; i < p.size(); j = i++)
+    {
+    const Vector2d &a = p[j], &b = p[i];
+    double side = (b[0] - a[0]) * (y - a[1]) - (x - a[0]) * (b[1] - a[1]);
+    if(a[1] <= y && b[1] > y && side > 0)
+      wind++;
+    else if(a[1] > y && b[1] <= y && side < 0)
+      wind--;
+    }
+  return wind != 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int nTrials = argc > 1 ? atoi(argv[1]) : 200;
+  int n = 64;
+
+  SliceType::Pointer slice = SliceType::New();
+  SliceType::SizeType sz;
+  sz.Fill(n);
+  slice->SetRegions(sz);
+  slice->Allocate();
+
+  // Random polygons, many of them self-intersecting and extending past the
+  // edges of the slice, are compared to a point in polygon test at each pixel
+  srand(1234);
+  int errors = 0;
+  for(int t = 0; t < nTrials; t++)
+    {
+    PolygonType poly(3 + rand() % 12);
+    for(size_t i = 0; i < poly.size(); i++)
+      poly[i] = Vector2d((rand() % 8000) / 100.0 - 8.0, (rand() % 8000) / 100.0 - 8.0);
+
+    for(int rule = ScanConvertType::EVEN_ODD; rule <= ScanConvertType::NONZERO; rule++)
+      {
+      ScanConvertType::RasterizeFilled(poly.begin(), poly.size(), slice,
+                                       (ScanConvertType::FillRule) rule);
+
+      itk::Index<2> idx;
+      for(idx[1] = 0; idx[1] < n; idx[1]++)
+        {
+        for(idx[0] = 0; idx[0] < n; idx[0]++)
+          {
+          double x = idx[0] + 0.5, y = idx[1] + 0.5;
+          bool inside = (rule == ScanConvertType::EVEN_ODD)
+                        ? insideEvenOdd(poly, x, y) : insideNonzero(poly, x, y);
+          if(inside != (slice->GetPixel(idx) != 0))
+            errors++;
+          }
+        }
+      }
+    }
+
+  if(errors)
+    {
+    cerr << errors << " pixels were scan converted incorrectly" << endl;
+    return 1;
+    }
+
+  cout << "Scan converted " << nTrials << " polygons without errors" << endl;
+  return 0;
+}
@@ -0,0 +1,184 @@
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+#include "QuantileSketch.h"
+
+// Portable random number generator, so that the data is the same everywhere
+class TestRandom
+{
+public:
+  TestRandom(unsigned long seed) : m_State(seed) {}
+
+  // Uniform in (0, 1)
+  double Uniform()
+  {
+    m_State = m_State * 6364136223846793005ull + 1442695040888963407ull;
+    return ((m_State >> 11) + 0.5) / 9007199254740992.0;
+  }
+
+protected:
+  unsigned long long m_State;
+};
+
+// Distance between the rank q*n and the ranks taken by the value in the
+// sorted data, as a fraction of n. Values with duplicates take a range of
+// ranks, and any rank in the range is correct
+double rankError(const vector<double> &sorted, double value, double q)
+{
+  double n = sorted.size();
+  double lo = lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+  double hi = upper_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+  double target = q * n;
+  if(target < lo)
+    return (lo - target) / n;
+  if(target > hi)
+    return (target - hi) / n;
+  return 0.0;
+}
+
+// Integers in random order, exponential values, and a few heavily repeated
+// values
+vector<double> makeData(int dist, int n)
+{
+  TestRandom rnd(1234 + dist);
+  vector<double> data(n);
+  for(int i = 0; i < n; i++)
+    {
+    double u = rnd.Uniform();
+    data[i] = (dist == 0) ? i : (dist == 1) ? -100.0 * log(u) : floor(20.0 * u * u);
+    }
+
+  if(dist == 0)
+    for(int i = n - 1; i > 0; i--)
+      swap(data[i], data[(int) (rnd.Uniform() * (i + 1))]);
+
+  return data;
+}
+
+// Check the range, the rank error of the quantiles and the memory used by a
+// sketch of the given data
+int checkSketch(const QuantileSketch &sketch, const vector<double> &data,
+                unsigned int k, const char *what)
+{
+  vector<double> sorted = data;
+  sort(sorted.begin(), sorted.end());
+
+  int errors = 0;
+  if(sketch.GetCount() != data.size()
+     || sketch.GetMinimum() != sorted.front() || sketch.GetMaximum() != sorted.back()
+     || sketch.GetQuantile(0.0) != sorted.front() || sketch.GetQuantile(1.0) != sorted.back())
+    {
+    cerr << what << ": wrong count or range" << endl;
+    errors++;
+    }
+
+  // The rank error of KLL is O(1/k); this sketch stays within about 1.3 / k
+  double maxError = 0.0, bound = 2.0 / k;
+  for(int i = 1; i < 1000; i++)
+    {
+    double q = i / 1000.0;
+    maxError = max(maxError, rankError(sorted, sketch.GetQuantile(q), q));
+    }
+  if(maxError > bound)
+    {
+    cerr << what << ": rank error " << maxError << " exceeds " << bound << endl;
+    errors++;
+    }
+
+  // The capacities of the levels sum to less than 3k, but each level can
+  // hold at least two values, and there is at most one level per bit of n
+  size_t maxRetained = 3 * k + 2 * 64;
+  if(sketch.GetNumberOfRetainedValues() > maxRetained)
+    {
+    cerr << what << ": " << sketch.GetNumberOfRetainedValues()
+         << " values retained with k = " << k << endl;
+    errors++;
+    }
+
+  return errors;
+}
+
+// Sketches of parts of the data, merged together, e.g., by the threads that
+// sample an image, must satisfy the same bounds as a sketch of all the data
+int testMerge(const vector<double> &data, unsigned int k, int nParts, const char *what)
+{
+  vector<QuantileSketch> parts(nParts, QuantileSketch(k));
+  for(size_t i = 0; i < data.size(); i++)
+    parts[(i * nParts) / data.size()].Add(data[i]);
+
+  QuantileSketch merged(k);
+  merged.Merge(QuantileSketch(k));
+  for(int p = 0; p < nParts; p++)
+    merged.Merge(parts[p]);
+  merged.Merge(QuantileSketch(k));
+
+  return checkSketch(merged, data, k, what);
+}
+
+// Small sketches are not compacted, so their quantiles, and those of their
+// merge, are exact
+int testExact()
+{
+  vector<double> data = makeData(1, 150);
+  QuantileSketch a(200), b(200), empty(200);
+  for(int i = 0; i < 150; i++)
+    (i < 80 ? a : b).Add(data[i]);
+  a.Merge(b);
+
+  int errors = 0;
+  if(empty.GetCount() != 0 || empty.GetQuantile(0.5) != 0.0)
+    {
+    cerr << "Empty sketch is not empty" << endl;
+    errors++;
+    }
+
+  sort(data.begin(), data.end());
+  for(int i = 1; i < 100; i++)
+    {
+    double q = i / 100.0;
+    double exact = data[(size_t) ceil(q * data.size()) - 1];
+    if(a.GetQuantile(q) != exact)
+      {
+      cerr << "Quantile " << q << " of merged small sketches is " << a.GetQuantile(q)
+           << " instead of " << exact << endl;
+      errors++;
+      }
+    }
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *names[] = { "Shuffled integers", "Exponential", "Repeated values" };
+  unsigned int ks[] = { 50, 200 };
+
+  int errors = testExact();
+  for(int dist = 0; dist < 3; dist++)
+    {
+    vector<double> data = makeData(dist, 200000);
+    for(int j = 0; j < 2; j++)
+      {
+      QuantileSketch sketch(ks[j]);
+      for(size_t i = 0; i < data.size(); i++)
+        sketch.Add(data[i]);
+
+      errors += checkSketch(sketch, data, ks[j], names[dist]);
+      errors += testMerge(data, ks[j], 8, names[dist]);
+      errors += testMerge(data, ks[j], 37, names[dist]);
+      }
+    }
+
+  if(errors)
+    {
+    cerr << errors << " quantile sketch checks failed" << endl;
+    return 1;
+    }
+
+  cout << "Quantile sketch is within its rank error bound" << endl;
+  return 0;
+}
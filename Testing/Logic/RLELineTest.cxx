@@ -0,0 +1,208 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include <itkImage.h>
+#include <itkImageRegionIterator.h>
+#include "RLEImage.h"
+#include "RLEImageRegionIterator.h"
+
+typedef RLEImage<short> RLEImageType;
+typedef RLEImageType::RLSegment SegmentType;
+typedef RLEImageType::RLLine LineType;
+typedef itk::Image<short, 3> DenseImageType;
+
+bool sameLine(const LineType &line, const vector<SegmentType> &ref)
+{
+  if(line.size() != ref.size())
+    return false;
+  for(size_t i = 0; i < ref.size(); i++)
+    if(line[i] != ref[i])
+      return false;
+  return true;
+}
+
+// Apply random edits to a line and to a std::vector, and compare them
+int testLineOperations(int nTrials)
+{
+  vector<SegmentType> arena(4096);
+  int errors = 0;
+  for(int t = 0; t < nTrials; t++)
+    {
+    LineType a, b(1, SegmentType(3, 4));
+    vector<SegmentType> ra, rb(1, SegmentType(3, 4));
+    size_t used = 0;
+    for(int k = 0; k < 64; k++)
+      {
+      SegmentType s(rand() % 10, rand() % 5);
+      size_t i = rand() % (ra.size() + 1);
+      switch(rand() % 9)
+        {
+        case 0: a.push_back(s); ra.push_back(s); break;
+        case 1: a.insert(a.begin() + i, s); ra.insert(ra.begin() + i, s); break;
+        case 2: a.insert(a.begin() + i, 2, s); ra.insert(ra.begin() + i, 2, s); break;
+        case 3:
+          if(i < ra.size()) { a.erase(a.begin() + i); ra.erase(ra.begin() + i); }
+          break;
+        case 4: a.swap(b); ra.swap(rb); break;
+        case 5:
+          if(used + ra.size() <= arena.size())
+            { a.move_to_external(&arena[used]); used += ra.size(); }
+          break;
+        case 6: a.shrink_to_fit(); break;
+        case 8:
+          {
+          size_t n = rand() % (ra.size() + 4);
+          a.resize(n, s); ra.resize(n, s);
+          }
+          break;
+        case 7:
+          {
+          LineType c(a); a = b; b = c; ra.swap(rb);
+          a.insert(a.end(), c.begin(), c.end()); ra.insert(ra.end(), rb.begin(), rb.end());
+          }
+          break;
+        }
+
+      if(!sameLine(a, ra) || !sameLine(b, rb))
+        {
+        errors++;
+        break;
+        }
+      }
+    }
+  return errors;
+}
+
+// Shrink lines stored inline, on the heap and in an arena
+int testShrink()
+{
+  int errors = 0;
+  vector<SegmentType> arena(16);
+  for(int storage = 0; storage < 3; storage++)
+    {
+    size_t n = (storage == 0) ? LineType::inline_capacity() : 8;
+    LineType line;
+    vector<SegmentType> ref;
+    for(size_t i = 0; i < n; i++)
+      {
+      line.push_back(SegmentType(i + 1, i));
+      ref.push_back(SegmentType(i + 1, i));
+      }
+    if(storage == 2)
+      line.move_to_external(&arena[0]);
+
+    if(line.is_inline() != (storage == 0) || line.is_external() != (storage == 2))
+      errors++;
+
+    // Shrink, then shrink to nothing, then grow back
+    for(size_t m = n; m > 0; m--)
+      {
+      line.resize(m - 1);
+      ref.resize(m - 1);
+      if(!sameLine(line, ref))
+        errors++;
+      }
+
+    line.resize(3, SegmentType(7, 1));
+    ref.resize(3, SegmentType(7, 1));
+    if(!sameLine(line, ref))
+      errors++;
+    }
+
+  // The arena next to the line must be untouched
+  if(arena[8] != SegmentType())
+    errors++;
+
+  return errors;
+}
+
+// Paint random boxes into an RLE image and a dense image and compare them
+int compareImages(RLEImageType *rle, DenseImageType *dense)
+{
+  itk::ImageRegionConstIterator<RLEImageType> it(rle, rle->GetBufferedRegion());
+  itk::ImageRegionConstIterator<DenseImageType> itRef(dense, dense->GetBufferedRegion());
+  int errors = 0;
+  for(; !it.IsAtEnd(); ++it, ++itRef)
+    if(it.Get() != itRef.Get())
+      errors++;
+  return errors;
+}
+
+void paintBoxes(RLEImageType *rle, DenseImageType *dense, int nBoxes)
+{
+  for(int b = 0; b < nBoxes; b++)
+    {
+    RLEImageType::RegionType box;
+    for(int d = 0; d < 3; d++)
+      {
+      int sz = rle->GetBufferedRegion().GetSize(d);
+      int i0 = rand() % sz, len = 1 + rand() % (sz - i0);
+      box.SetIndex(d, i0);
+      box.SetSize(d, std::min(len, 6));
+      }
+
+    short label = rand() % 4;
+    itk::ImageRegionIterator<RLEImageType> it(rle, box);
+    itk::ImageRegionIterator<DenseImageType> itRef(dense, box);
+    for(; !it.IsAtEnd(); ++it, ++itRef)
+      {
+      it.Set(label);
+      itRef.Set(label);
+      }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  srand(1234);
+  int errors = testLineOperations(2000);
+  errors += testShrink();
+
+  // An RLE image keeps its contents when long lines are moved to the arena,
+  // and when those lines are edited afterwards
+  RLEImageType::SizeType sz = {{ 40, 24, 16 }};
+  RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetRegions(sz);
+  rle->Allocate();
+  rle->FillBuffer(0);
+
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(sz);
+  dense->Allocate();
+  dense->FillBuffer(0);
+
+  for(int pass = 0; pass < 4; pass++)
+    {
+    paintBoxes(rle, dense, 200);
+    rle->CompactLines();
+    errors += compareImages(rle, dense);
+    }
+
+  if(rle->GetLineArenaSize() == 0)
+    {
+    cerr << "No lines were moved to the arena" << endl;
+    errors++;
+    }
+
+  // Filling the image releases the arena
+  rle->FillBuffer(1);
+  dense->FillBuffer(1);
+  errors += compareImages(rle, dense);
+  if(rle->GetLineArenaSize() != 0)
+    {
+    cerr << "The arena was not released" << endl;
+    errors++;
+    }
+
+  if(errors)
+    {
+    cerr << errors << " errors in RLE line storage" << endl;
+    return 1;
+    }
+
+  cout << "RLE line storage test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,244 @@
+#include <iostream>
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+#include <itkImage.h>
+#include <itkImageRegionIterator.h>
+#include "RLEImage.h"
+#include "RLEOccupancyPyramid.h"
+#include "ImageRayIntersectionFinder.h"
+
+typedef RLEImage<unsigned short> RLEImageType;
+typedef itk::Image<unsigned short, 3> DenseImageType;
+typedef RLEOccupancyPyramid<RLEImageType> PyramidType;
+
+// Labels 1, 3, 4 and 5 are hits, label 2 is hidden
+class HitTester
+{
+public:
+  int operator()(unsigned short label) const
+  {
+    return (label != 0 && label != 2) ? 1 : 0;
+  }
+};
+
+// Compare the range of every brick to the voxels of the dense image
+int checkRanges(PyramidType *pyramid, DenseImageType *dense)
+{
+  int errors = 0;
+  DenseImageType::RegionType full = dense->GetBufferedRegion();
+  for(unsigned int level = 0; level < pyramid->GetNumberOfLevels(); level++)
+    {
+    long bs = PyramidType::GetBrickSize(level);
+    PyramidType::IndexType idx;
+    for(idx[2] = 0; idx[2] < (long) full.GetSize(2); idx[2] += bs)
+      for(idx[1] = 0; idx[1] < (long) full.GetSize(1); idx[1] += bs)
+        for(idx[0] = 0; idx[0] < (long) full.GetSize(0); idx[0] += bs)
+          {
+          PyramidType::RegionType brick = pyramid->GetBrickRegion(level, idx);
+          unsigned short vmin = 0xffff, vmax = 0;
+          itk::ImageRegionConstIterator<DenseImageType> it(dense, brick);
+          for(; !it.IsAtEnd(); ++it)
+            {
+            vmin = std::min(vmin, it.Get());
+            vmax = std::max(vmax, it.Get());
+            }
+
+          unsigned short pmin, pmax;
+          pyramid->GetBrickRange(level, idx, pmin, pmax);
+          if(pmin != vmin || pmax != vmax)
+            errors++;
+          }
+    }
+  return errors;
+}
+
+// Entry parameter of the ray p0 + t * r (t >= 0) into the unit box at v, or
+// DBL_MAX if the ray does not cross the box
+double rayEntry(const double p0[3], const double r[3], const long v[3])
+{
+  double ta = 0.0, tb = DBL_MAX;
+  for(int d = 0; d < 3; d++)
+    {
+    if(r[d] == 0)
+      {
+      if(p0[d] < v[d] || p0[d] >= v[d] + 1)
+        return DBL_MAX;
+      }
+    else
+      {
+      double t0 = (v[d] - p0[d]) / r[d], t1 = (v[d] + 1 - p0[d]) / r[d];
+      ta = std::max(ta, std::min(t0, t1));
+      tb = std::min(tb, std::max(t0, t1));
+      }
+    }
+  return (ta < tb - 1e-9) ? ta : DBL_MAX;
+}
+
+// The ray must hit the first hit voxel along the ray, found by brute force
+int checkRays(RLEImageType *rle, PyramidType *pyramid, DenseImageType *dense, int nRays)
+{
+  typedef ImageRayIntersectionFinder<RLEImageType, HitTester> FinderType;
+  FinderType finder;
+  HitTester tester;
+  finder.SetHitTester(tester);
+
+  int errors = 0;
+  DenseImageType::SizeType sz = dense->GetBufferedRegion().GetSize();
+  for(int k = 0; k < nRays; k++)
+    {
+    // Rays start around the image and are aimed at a random voxel, or along
+    // the image axes
+    Vector3d start, ray;
+    for(int d = 0; d < 3; d++)
+      start[d] = (rand() % 1000 / 1000.0 * 1.6 - 0.3) * sz[d];
+    DenseImageType::IndexType target;
+    for(int d = 0; d < 3; d++)
+      target[d] = rand() % sz[d];
+    for(int d = 0; d < 3; d++)
+      ray[d] = target[d] - start[d];
+    if(k % 5 == 0)
+      {
+      ray.fill(0.0);
+      ray[k % 3] = (k % 2) ? 1.0 : -1.0;
+      }
+
+    Vector3i hit;
+    int result = finder.FindIntersection(rle, pyramid, start, ray, hit);
+
+    double p0[3], r[3], len = ray.two_norm();
+    for(int d = 0; d < 3; d++)
+      {
+      p0[d] = start[d] + 0.5;
+      r[d] = ray[d] / len;
+      }
+
+    // Find the first hit voxel and whether the ray crosses the image
+    double tBest = DBL_MAX;
+    bool crosses = false;
+    itk::ImageRegionConstIterator<DenseImageType> it(dense, dense->GetBufferedRegion());
+    for(; !it.IsAtEnd(); ++it)
+      {
+      long v[3] = { it.GetIndex()[0], it.GetIndex()[1], it.GetIndex()[2] };
+      double t = rayEntry(p0, r, v);
+      if(t < DBL_MAX)
+        {
+        crosses = true;
+        if(tester(it.Get()))
+          tBest = std::min(tBest, t);
+        }
+      }
+
+    if(!crosses)
+      {
+      if(result != -1)
+        errors++;
+      }
+    else if(tBest == DBL_MAX)
+      {
+      if(result != 0)
+        errors++;
+      }
+    else if(result != 1)
+      {
+      errors++;
+      }
+    else
+      {
+      DenseImageType::IndexType idx = {{ hit[0], hit[1], hit[2] }};
+      long v[3] = { hit[0], hit[1], hit[2] };
+      if(!tester(dense->GetPixel(idx)) || fabs(rayEntry(p0, r, v) - tBest) > 1e-6)
+        errors++;
+      }
+    }
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  srand(1234);
+  int errors = 0;
+
+  // The size is not a multiple of the brick sizes
+  RLEImageType::SizeType sz = {{ 90, 75, 50 }};
+  RLEImageType::RegionType full;
+  full.SetSize(sz);
+
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(full);
+  dense->Allocate();
+  dense->FillBuffer(0);
+
+  // A few small blobs in an otherwise empty image
+  for(int b = 0; b < 6; b++)
+    {
+    long c[3] = { rand() % 90, rand() % 75, rand() % 50 }, rad = 3 + rand() % 6;
+    unsigned short label = 1 + b % 5;
+    itk::ImageRegionIterator<DenseImageType> it(dense, full);
+    for(; !it.IsAtEnd(); ++it)
+      {
+      long dx = it.GetIndex()[0] - c[0], dy = it.GetIndex()[1] - c[1], dz = it.GetIndex()[2] - c[2];
+      if(dx * dx + dy * dy + dz * dz < rad * rad)
+        it.Set(label);
+      }
+    }
+
+  RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetRegions(full);
+  rle->Allocate();
+  rle->AssignRegion(full, dense->GetBufferPointer());
+
+  PyramidType::Pointer pyramid = PyramidType::New();
+  pyramid->Build(rle);
+  errors += checkRanges(pyramid, dense);
+  errors += checkRays(rle, pyramid, dense, 300);
+
+  // Paint boxes and update the pyramid for the painted region only
+  for(int k = 0; k < 30; k++)
+    {
+    RLEImageType::RegionType box;
+    for(int d = 0; d < 3; d++)
+      {
+      box.SetIndex(d, rand() % sz[d]);
+      box.SetSize(d, 1 + rand() % std::min(20L, (long) (sz[d] - box.GetIndex(d))));
+      }
+
+    vector<unsigned short> values(box.GetNumberOfPixels(), rand() % 6);
+    rle->AssignRegion(box, &values[0]);
+
+    itk::ImageRegionIterator<DenseImageType> itRef(dense, box);
+    for(; !itRef.IsAtEnd(); ++itRef)
+      itRef.Set(values[0]);
+
+    pyramid->Update(rle, box);
+    }
+  errors += checkRanges(pyramid, dense);
+  errors += checkRays(rle, pyramid, dense, 200);
+
+  // Every labeled voxel must be in the occupied region
+  PyramidType::RegionType occupied = pyramid->GetOccupiedRegion(0);
+  itk::ImageRegionConstIterator<DenseImageType> it(dense, full);
+  for(; !it.IsAtEnd(); ++it)
+    if(it.Get() != 0 && !occupied.IsInside(it.GetIndex()))
+      errors++;
+
+  // An empty image has no occupied region
+  rle->FillBuffer(0);
+  pyramid->Build(rle);
+  if(pyramid->GetOccupiedRegion(0).GetNumberOfPixels() != 0)
+    errors++;
+
+  if(errors)
+    {
+    cerr << errors << " errors in label occupancy pyramid" << endl;
+    return 1;
+    }
+
+  cout << "Label occupancy pyramid test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include <itkImage.h>
+#include <itkImageRegionIterator.h>
+#include "RLEImage.h"
+#include "RLEImageRegionIterator.h"
+
+typedef RLEImage<short> RLEImageType;
+typedef itk::Image<short, 3> DenseImageType;
+
+int compareImages(RLEImageType *rle, DenseImageType *dense)
+{
+  int errors = 0;
+  itk::ImageRegionConstIterator<RLEImageType> it(rle, rle->GetBufferedRegion());
+  itk::ImageRegionConstIterator<DenseImageType> itRef(dense, dense->GetBufferedRegion());
+  for(; !itRef.IsAtEnd(); ++it, ++itRef)
+    if(it.Get() != itRef.Get())
+      errors++;
+  return errors;
+}
+
+// The pieces must cover the region exactly, and no two pieces may share a line
+int testSplit(const RLEImageType::RegionType &region, unsigned int n)
+{
+  vector<RLEImageType::RegionType> pieces;
+  unsigned int np = RLEImageType::SplitRegionByLines(region, n, pieces);
+  if(np != pieces.size() || np == 0 || np > n)
+    return 1;
+
+  int errors = 0;
+  itk::SizeValueType total = 0;
+  for(size_t i = 0; i < pieces.size(); i++)
+    {
+    if(pieces[i].GetIndex(0) != region.GetIndex(0)
+       || pieces[i].GetSize(0) != region.GetSize(0)
+       || !region.IsInside(pieces[i])
+       || pieces[i].GetNumberOfPixels() == 0)
+      errors++;
+    for(size_t j = 0; j < i; j++)
+      {
+      RLEImageType::RegionType overlap = pieces[i];
+      if(overlap.Crop(pieces[j]))
+        errors++;
+      }
+    total += pieces[i].GetNumberOfPixels();
+    }
+  if(total != region.GetNumberOfPixels())
+    errors++;
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  srand(1234);
+  int errors = 0;
+
+  RLEImageType::SizeType sz = {{ 60, 33, 21 }};
+  RLEImageType::RegionType full;
+  full.SetSize(sz);
+
+  errors += testSplit(full, 1);
+  errors += testSplit(full, 8);
+  errors += testSplit(full, 100);
+  RLEImageType::RegionType sheet = full;
+  sheet.SetIndex(2, 5);
+  sheet.SetSize(2, 1);
+  errors += testSplit(sheet, 7);
+
+  RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetRegions(sz);
+  rle->Allocate();
+  rle->FillBuffer(0);
+
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(sz);
+  dense->Allocate();
+  dense->FillBuffer(0);
+
+  // Some lines are moved to the arena, to check that they are rewritten
+  // correctly in place
+  for(int k = 0; k < 200; k++)
+    {
+    RLEImageType::IndexType idx = {{ rand() % 60, rand() % 33, rand() % 21 }};
+    short label = rand() % 4;
+    rle->SetPixel(idx, label);
+    dense->SetPixel(idx, label);
+    }
+  rle->CompactLines();
+
+  // Assign random boxes from a dense buffer
+  for(int k = 0; k < 50; k++)
+    {
+    RLEImageType::RegionType box;
+    for(int d = 0; d < 3; d++)
+      {
+      box.SetIndex(d, rand() % sz[d]);
+      box.SetSize(d, 1 + rand() % (sz[d] - box.GetIndex(d)));
+      }
+
+    vector<short> values(box.GetNumberOfPixels());
+    short base = rand() % 5;
+    for(size_t i = 0; i < values.size(); i++)
+      values[i] = (rand() % 8 == 0) ? rand() % 5 : base;
+
+    rle->AssignRegion(box, &values[0]);
+
+    size_t i = 0;
+    itk::ImageRegionIterator<DenseImageType> itRef(dense, box);
+    for(; !itRef.IsAtEnd(); ++itRef)
+      itRef.Set(values[i++]);
+    }
+  errors += compareImages(rle, dense);
+
+  // Paint the pieces of the image from different threads with iterators
+  vector<RLEImageType::RegionType> pieces;
+  int np = RLEImageType::SplitRegionByLines(full, 8, pieces);
+
+#pragma omp parallel for
+  for(int p = 0; p < np; p++)
+    {
+    itk::ImageRegionIterator<RLEImageType> it(rle, pieces[p]);
+    for(; !it.IsAtEnd(); ++it)
+      {
+      RLEImageType::IndexType idx = it.GetIndex();
+      if((idx[0] / 7 + idx[1] / 5 + idx[2]) % 3 == 0)
+        it.Set(p + 1);
+      }
+    }
+
+  for(int p = 0; p < np; p++)
+    {
+    itk::ImageRegionIterator<DenseImageType> itRef(dense, pieces[p]);
+    for(; !itRef.IsAtEnd(); ++itRef)
+      {
+      DenseImageType::IndexType idx = itRef.GetIndex();
+      if((idx[0] / 7 + idx[1] / 5 + idx[2]) % 3 == 0)
+        itRef.Set(p + 1);
+      }
+    }
+  errors += compareImages(rle, dense);
+
+  // Replace the whole image from the dense buffer
+  itk::ImageRegionIterator<DenseImageType> itRef(dense, full);
+  for(; !itRef.IsAtEnd(); ++itRef)
+    itRef.Set(itRef.GetIndex()[0] < 30 ? 1 : 2);
+  rle->AssignRegion(full, dense->GetBufferPointer());
+  errors += compareImages(rle, dense);
+
+  // A region outside of the image is reported with an exception, and the
+  // image is left unchanged
+  RLEImageType::RegionType outside = full;
+  outside.SetIndex(1, 1);
+  try
+    {
+    rle->AssignRegion(outside, dense->GetBufferPointer());
+    cerr << "Assigning a region outside of the image did not throw" << endl;
+    errors++;
+    }
+  catch(itk::ExceptionObject &)
+    {
+    }
+  errors += compareImages(rle, dense);
+
+  if(errors)
+    {
+    cerr << errors << " errors in parallel RLE writes" << endl;
+    return 1;
+    }
+
+  cout << "Parallel RLE write test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,246 @@
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+
+using namespace std;
+
+#include <itkTimeProbe.h>
+#include "Registry.h"
+#include "IRISException.h"
+
+// Fill a registry that looks like a large workspace: layers with contrast
+// curves and metadata folders, and many annotations
+void makeWorkspace(Registry &ws, int nEntries)
+{
+  ws["SaveLocation"] << "/data/project";
+  ws["Version"] << "20190101";
+
+  int count = 2, layer = 0;
+  while(count < nEntries)
+    {
+    Registry &folder = ws.Folder(Registry::Key("Layers.Layer[%03d]", layer++));
+    folder["AbsolutePath"] << "/data/project/image_<A&B>.nii.gz";
+    folder["Role"] << "OverlayRole";
+    folder["LayerMetaData.Alpha"] << 0.5;
+    folder["LayerMetaData.Sticky"] << (layer % 2 == 0);
+    count += 4;
+
+    // Contrast curve
+    Registry &curve = folder.Folder("LayerMetaData.DisplayMapping.Curve");
+    curve["NumberOfControlPoints"] << 64;
+    for(int i = 0; i < 64; i++)
+      curve[Registry::Key("PointData[%d]", i)] << Vector2d(i / 63.0, (i * i) / 3969.0);
+    count += 65;
+
+    // DICOM metadata
+    Registry &meta = folder.Folder("ImageMetaData");
+    for(int i = 0; i < 60; i++)
+      meta[Registry::Key("%04x|%04x", 0x0008 + i % 3, 0x1000 + i)] << "Value 'quoted' \"too\"";
+    count += 60;
+
+    // Annotations
+    Registry &annot = folder.Folder("Annotations");
+    std::vector<double> coords(6);
+    for(int i = 0; i < 40; i++)
+      {
+      for(int j = 0; j < 6; j++)
+        coords[j] = i * 1.5 + j;
+      annot.Folder(Registry::Key("Element[%d]", i)).PutArray(coords);
+      }
+    count += 40 * 7;
+    }
+}
+
+// Check the parser on small documents
+int testParser()
+{
+  int errors = 0;
+
+  // Comments, a DOCTYPE, single quotes, character references, upper case
+  const char *good =
+      "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+      "<!-- A comment with <tags> and -- dashes --->\n"
+      "<!DOCTYPE registry [\n"
+      "<!ELEMENT registry (entry*,folder*)>\n"
+      "<!ATTLIST entry value CDATA \"]>\">\n"
+      "]>\n"
+      "<registry>\n"
+      "  <entry key=\"a\" value=\"1 &lt; 2 &amp;&amp; &#65;&#x42;\" />\n"
+      "  <Folder KEY='f'>\n"
+      "    <entry key='b' value='line\n"
+      "break' />\n"
+      "    <![CDATA[ <entry key=\"ignored\" value=\"\" /> ]]>\n"
+      "    <folder key=\"g\"><entry key=\"c\" value=\"&#xe9;\"/></folder>\n"
+      "  </Folder>\n"
+      "</registry>\n";
+
+  Registry reg;
+  istringstream iss(good);
+  reg.ReadFromXMLStream(iss);
+  if(reg["a"][""] != string("1 < 2 && AB")
+     || reg["f.b"][""] != string("line break")
+     || reg["f.g.c"][""] != string("\xc3\xa9")
+     || reg.HasEntry("f.ignored"))
+    {
+    cerr << "Parsed values differ from expected" << endl;
+    errors++;
+    }
+
+  // Malformed documents must be rejected
+  const char *bad[] = {
+    "",
+    "<registry><entry key=\"a\" value=\"1\" />",
+    "<registry><folder key=\"a\"></registry></folder>",
+    "<registry><entry key=\"a\" /></registry>",
+    "<registry><folder></folder></registry>",
+    "<registry><item key=\"a\" value=\"1\" /></registry>",
+    "<registry><entry key=\"a\" value=\"&nbsp;\" /></registry>",
+    "<registry><entry key=\"a\" value=1 /></registry>",
+    "<registry></registry><registry></registry>",
+    NULL
+  };
+
+  for(int i = 0; bad[i]; i++)
+    {
+    Registry r;
+    istringstream iss_bad(bad[i]);
+    try
+      {
+      r.ReadFromXMLStream(iss_bad);
+      cerr << "Malformed document " << i << " was accepted" << endl;
+      errors++;
+      }
+    catch(IRISException &)
+      {
+      }
+    }
+
+  return errors;
+}
+
+// Check the folder operations on the flat representation
+int testFolders()
+{
+  int errors = 0;
+  Registry reg;
+
+  // References stay valid as entries are added
+  RegistryValue &first = reg["m"];
+  Registry &folder = reg.Folder("x.y");
+  for(int i = 0; i < 1000; i++)
+    {
+    reg[Registry::Key("k%d", 1000 - i)] << i;
+    reg.Folder(Registry::Key("f%d", i));
+    }
+  first << "first";
+  folder["z"] << 1;
+  if(reg["m"][""] != string("first") || !reg.HasEntry("x.y.z") || !reg.HasFolder("x.y")
+     || reg.HasEntry("x.z") || reg.HasFolder("x.y.z"))
+    errors++;
+
+  // Keys are listed in order
+  Registry::StringListType keys;
+  reg.GetEntryKeys(keys);
+  if(keys.size() != 1001 || keys.front() != "k1" || keys.back() != "m")
+    errors++;
+
+  reg.RemoveKeys("k");
+  keys.clear();
+  if(reg.GetEntryKeys(keys) != 1)
+    errors++;
+
+  // Assignment from one of our own subfolders
+  Registry sub = reg.Folder("x");
+  reg = reg.Folder("x");
+  if(reg != sub || !reg.HasEntry("y.z"))
+    errors++;
+
+  reg.Folder("empty.empty");
+  reg.CleanEmptyFolders();
+  if(reg.HasFolder("empty"))
+    errors++;
+
+  return errors;
+}
+
+// Keys leave the key pool once no registry uses them
+int testKeyPool()
+{
+  int errors = 0;
+  size_t nKeys = Registry::GetNumberOfInternedKeys();
+  {
+    Registry ws;
+    makeWorkspace(ws, 2000);
+    Registry copy(ws);
+    copy.Folder("Layers.Layer[000]").RemoveKeys("Role");
+    copy.Folder("Layers.Layer[000].Annotations").Clear();
+    copy.CleanEmptyFolders();
+    if(Registry::GetNumberOfInternedKeys() <= nKeys)
+      errors++;
+  }
+
+  if(Registry::GetNumberOfInternedKeys() != nKeys)
+    {
+    cerr << Registry::GetNumberOfInternedKeys() - nKeys
+         << " keys left in the key pool" << endl;
+    errors++;
+    }
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int nEntries = argc > 1 ? atoi(argv[1]) : 10000;
+  int errors = 0;
+
+  errors += testParser();
+  errors += testFolders();
+  errors += testKeyPool();
+
+  // Benchmark on a synthetic workspace
+  itk::TimeProbe tBuild, tWrite, tRead, tCopy;
+  Registry ws;
+  tBuild.Start();
+  makeWorkspace(ws, nEntries);
+  tBuild.Stop();
+
+  Registry::StringListType keys;
+  ws.CollectKeys(keys);
+
+  const char *fn = "RegistryXMLTest.xml";
+  tWrite.Start();
+  ws.WriteToXMLFile(fn, "Synthetic workspace");
+  tWrite.Stop();
+
+  Registry wsRead;
+  tRead.Start();
+  wsRead.ReadFromXMLFile(fn);
+  tRead.Stop();
+
+  tCopy.Start();
+  Registry wsCopy(wsRead);
+  tCopy.Stop();
+
+  remove(fn);
+
+  if(wsRead != ws || wsCopy != ws)
+    {
+    cerr << "Registry read from XML differs from the one written" << endl;
+    errors++;
+    }
+
+  cout << "Workspace with " << keys.size() << " entries: build " << tBuild.GetTotal()
+       << " s, write " << tWrite.GetTotal() << " s, read " << tRead.GetTotal()
+       << " s, copy " << tCopy.GetTotal() << " s" << endl;
+
+  if(errors)
+    {
+    cerr << errors << " errors in registry" << endl;
+    return 1;
+    }
+
+  cout << "Registry XML test passed" << endl;
+  return 0;
+}
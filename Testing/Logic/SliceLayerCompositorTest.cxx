@@ -0,0 +1,162 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+#include <itkImageRegionIterator.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkTimeProbe.h>
+#include "SliceLayerCompositor.h"
+
+typedef SliceLayerCompositor::SliceType SliceType;
+typedef SliceLayerCompositor::PixelType PixelType;
+
+// Make a slice with pseudo-random colors and alpha
+SliceType::Pointer makeSlice(int nx, int ny, unsigned int seed)
+{
+  SliceType::Pointer slice = SliceType::New();
+  SliceType::SizeType sz;
+  sz[0] = nx; sz[1] = ny;
+  slice->SetRegions(sz);
+  slice->Allocate();
+
+  itk::ImageRegionIterator<SliceType> it(slice, slice->GetBufferedRegion());
+  for(; !it.IsAtEnd(); ++it)
+    {
+    PixelType p;
+    for(int c = 0; c < 4; c++)
+      {
+      seed = seed * 1103515245u + 12345u;
+      p[c] = (unsigned char) ((seed >> 16) & 0xff);
+      }
+    it.Set(p);
+    }
+  return slice;
+}
+
+int main(int argc, char *argv[])
+{
+  int nx = argc > 1 ? atoi(argv[1]) : 509;
+  int ny = argc > 2 ? atoi(argv[2]) : 317;
+  int nOverlays = 5;
+
+  // Base layer, overlays with different opacity, as drawn by the slice renderer
+  vector<SliceType::Pointer> slices;
+  vector<double> opacity;
+  for(int i = 0; i <= nOverlays; i++)
+    {
+    slices.push_back(makeSlice(nx, ny, 1000 + i));
+    opacity.push_back(i == 0 ? 1.0 : 0.2 * i);
+    }
+
+  SliceLayerCompositor::Pointer compositor = SliceLayerCompositor::New();
+  compositor->SetNumberOfLayers(nOverlays + 1);
+  for(int i = 0; i <= nOverlays; i++)
+    compositor->SetLayer(i, slices[i], opacity[i]);
+
+  itk::TimeProbe probe;
+  probe.Start();
+  compositor->Update();
+  probe.Stop();
+  cout << "Composited " << nOverlays + 1 << " layers of " << nx << "x" << ny
+       << " in " << probe.GetTotal() << " sec" << endl;
+
+  // Compare to blending in floating point, as done by OpenGL
+  int max_error = 0;
+  vector< itk::ImageRegionConstIterator<SliceType> > its;
+  for(int i = 0; i <= nOverlays; i++)
+    its.push_back(itk::ImageRegionConstIterator<SliceType>(
+                    slices[i], slices[i]->GetBufferedRegion()));
+
+  SliceType *output = compositor->GetOutput();
+  itk::ImageRegionConstIterator<SliceType> itOut(output, output->GetBufferedRegion());
+  for(; !itOut.IsAtEnd(); ++itOut)
+    {
+    double rgb[3];
+    for(int c = 0; c < 3; c++)
+      rgb[c] = its[0].Get()[c];
+
+    for(int i = 1; i <= nOverlays; i++)
+      {
+      PixelType p = its[i].Get();
+      double a = (p[3] / 255.0) * ((unsigned char)(opacity[i] * 255) / 255.0);
+      for(int c = 0; c < 3; c++)
+        rgb[c] = p[c] * a + rgb[c] * (1.0 - a);
+      }
+
+    PixelType q = itOut.Get();
+    for(int c = 0; c < 3; c++)
+      max_error = std::max(max_error, (int) (std::fabs(q[c] - rgb[c]) + 0.5));
+
+    if(q[3] != 255)
+      {
+      cerr << "Composited slice is not opaque" << endl;
+      return EXIT_FAILURE;
+      }
+
+    for(int i = 0; i <= nOverlays; i++)
+      ++its[i];
+    }
+
+  // Rounding happens once per layer, so allow one unit per layer
+  cout << "Maximum difference from floating point blending: " << max_error << endl;
+  if(max_error > nOverlays)
+    {
+    cerr << "Composited slice differs from floating point blending" << endl;
+    return EXIT_FAILURE;
+    }
+
+  // Setting the same layers again should not cause the slice to be recomputed
+  itk::ModifiedTimeType mtime = output->GetPipelineMTime();
+  itk::ModifiedTimeType utime = output->GetUpdateMTime();
+  for(int i = 0; i <= nOverlays; i++)
+    compositor->SetLayer(i, slices[i], opacity[i]);
+  compositor->Update();
+  if(output->GetPipelineMTime() != mtime || output->GetUpdateMTime() != utime)
+    {
+    cerr << "Compositor updated without any changes to its inputs" << endl;
+    return EXIT_FAILURE;
+    }
+
+  // Changing the opacity or the contents of a layer should
+  compositor->SetLayer(2, slices[2], 0.0);
+  compositor->Update();
+  if(output->GetUpdateMTime() == utime)
+    {
+    cerr << "Compositor not updated after opacity change" << endl;
+    return EXIT_FAILURE;
+    }
+
+  utime = output->GetUpdateMTime();
+  slices[1]->Modified();
+  compositor->Update();
+  if(output->GetUpdateMTime() == utime)
+    {
+    cerr << "Compositor not updated after layer change" << endl;
+    return EXIT_FAILURE;
+    }
+
+  // With all overlays transparent, the output is the base layer
+  for(int i = 1; i <= nOverlays; i++)
+    compositor->SetLayer(i, slices[i], 0.0);
+  compositor->Update();
+
+  itk::ImageRegionConstIterator<SliceType> itBase(slices[0], slices[0]->GetBufferedRegion());
+  itk::ImageRegionConstIterator<SliceType> itOut2(output, output->GetBufferedRegion());
+  for(; !itOut2.IsAtEnd(); ++itOut2, ++itBase)
+    {
+    for(int c = 0; c < 3; c++)
+      {
+      if(itOut2.Get()[c] != itBase.Get()[c])
+        {
+        cerr << "Transparent overlays changed the base layer" << endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
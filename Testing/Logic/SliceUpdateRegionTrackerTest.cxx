@@ -0,0 +1,102 @@
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+#include <itkImage.h>
+#include <itkRGBAPixel.h>
+#include "SliceUpdateRegionTracker.h"
+
+typedef itk::RGBAPixel<unsigned char> PixelType;
+typedef SliceUpdateRegionTracker<PixelType> TrackerType;
+typedef TrackerType::ImageType SliceType;
+typedef TrackerType::RegionType RegionType;
+
+// Paint a square brush dab into an RGBA slice
+void paintDab(SliceType *slice, int cx, int cy, int radius, unsigned char label)
+{
+  PixelType color;
+  color[0] = label; color[1] = 255 - label; color[2] = label / 2; color[3] = 255;
+
+  itk::Index<2> idx;
+  for(idx[1] = cy - radius; idx[1] <= cy + radius; idx[1]++)
+    for(idx[0] = cx - radius; idx[0] <= cx + radius; idx[0]++)
+      if(slice->GetBufferedRegion().IsInside(idx))
+        slice->SetPixel(idx, color);
+}
+
+int checkRegion(const RegionType &region, int x, int y, int w, int h)
+{
+  if(region.GetIndex(0) != x || region.GetIndex(1) != y
+     || (int) region.GetSize(0) != w || (int) region.GetSize(1) != h)
+    {
+    cerr << "Expected region [" << x << "," << y << "] + [" << w << "," << h
+         << "], got " << region << endl;
+    return 1;
+    }
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 1024;
+
+  // A blank segmentation slice
+  SliceType::Pointer slice = SliceType::New();
+  SliceType::SizeType sz;
+  sz.Fill(n);
+  slice->SetRegions(sz);
+  slice->Allocate();
+  slice->FillBuffer(PixelType(static_cast<unsigned char>(0)));
+
+  TrackerType tracker;
+  int errors = 0;
+  unsigned long full_bytes = n * n * sizeof(PixelType);
+
+  // The first update covers the whole slice
+  errors += checkRegion(tracker.Update(slice), 0, 0, n, n);
+
+  // Without changes, nothing is uploaded
+  errors += checkRegion(tracker.Update(slice), 0, 0, 0, 0);
+
+  // A single brush dab
+  paintDab(slice, 100, 200, 2, 1);
+  errors += checkRegion(tracker.Update(slice), 98, 198, 5, 5);
+
+  // A brush stroke: each dab only covers the newly painted pixels
+  tracker.ResetBytesUpdated();
+  int nDabs = 100;
+  for(int i = 0; i < nDabs; i++)
+    {
+    int x = 300 + 3 * i, y = 400 + i;
+    paintDab(slice, x, y, 4, 2);
+    RegionType region = tracker.Update(slice);
+    if(region.GetNumberOfPixels() > 81)
+      {
+      cerr << "Dab " << i << " uploads too many pixels: " << region << endl;
+      errors++;
+      }
+    }
+
+  cout << "Bytes uploaded for " << nDabs << " dabs: " << tracker.GetBytesUpdated()
+       << " vs. " << nDabs * full_bytes << " for full slices" << endl;
+
+  // Two dabs far apart give their bounding box
+  paintDab(slice, 10, 20, 0, 3);
+  paintDab(slice, n - 5, n - 30, 0, 3);
+  errors += checkRegion(tracker.Update(slice), 10, 20, n - 14, n - 49);
+
+  // After a reset the whole slice is reported again
+  tracker.Reset();
+  errors += checkRegion(tracker.Update(slice), 0, 0, n, n);
+
+  // A change of size is reported as the whole slice
+  SliceType::Pointer small = SliceType::New();
+  sz.Fill(n / 2);
+  small->SetRegions(sz);
+  small->Allocate();
+  small->FillBuffer(PixelType(static_cast<unsigned char>(0)));
+  errors += checkRegion(tracker.Update(small), 0, 0, n / 2, n / 2);
+
+  return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
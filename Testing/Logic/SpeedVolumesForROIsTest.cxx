@@ -0,0 +1,177 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include <itkImageRegionConstIterator.h>
+#include "IRISApplication.h"
+#include "IRISImageData.h"
+#include "SNAPImageData.h"
+#include "ImageWrapperBase.h"
+#include "ThresholdSettings.h"
+#include "ImageIODelegates.h"
+#include "UIReporterDelegates.h"
+#include "itksys/SystemTools.hxx"
+
+typedef IRISApplication::SpeedImageType SpeedImageType;
+
+class DummySystemInfoDelegate : public SystemInfoDelegate
+{
+public:
+  DummySystemInfoDelegate(const char *argv0) : m_ExecutableName(argv0) {}
+
+  virtual std::string GetApplicationDirectory()
+    { return itksys::SystemTools::GetFilenamePath(m_ExecutableName); }
+  virtual std::string GetApplicationFile() { return m_ExecutableName; }
+  virtual std::string GetApplicationPermanentDataLocation() { return ".itksnap.test"; }
+  virtual std::string GetUserDocumentsLocation() { return ".itksnap.test"; }
+  virtual std::string EncodeServerURL(const std::string &url) { return url; }
+
+  virtual void LoadResourceAsImage2D(std::string tag, GrayscaleImage *image) {}
+  virtual void LoadResourceAsRegistry(std::string tag, Registry &reg) {}
+  virtual void WriteRGBAImage2D(std::string file, RGBAImageType *image) {}
+
+protected:
+  std::string m_ExecutableName;
+};
+
+SNAPSegmentationROISettings makeROI(int x, int y, int z, int sx, int sy, int sz,
+                                    double resample = 1.0)
+{
+  itk::ImageRegion<3> region;
+  region.SetIndex(0, x); region.SetIndex(1, y); region.SetIndex(2, z);
+  region.SetSize(0, sx); region.SetSize(1, sy); region.SetSize(2, sz);
+
+  SNAPSegmentationROISettings roi;
+  roi.SetROI(region);
+  roi.SetResampleDimensions(Vector3ui((unsigned int) (sx * resample),
+                                      (unsigned int) (sy * resample),
+                                      (unsigned int) (sz * resample)));
+  roi.SetInterpolationMethod(TRILINEAR);
+  return roi;
+}
+
+// Compare the geometry and the voxels of two speed images. The filters are
+// the same, so the voxels only differ by rounding
+int compareSpeed(SpeedImageType *batch, SpeedImageType *single,
+                 int roi, const char *what)
+{
+  if(batch->GetBufferedRegion() != single->GetBufferedRegion())
+    {
+    cerr << what << " ROI " << roi << ": region " << batch->GetBufferedRegion()
+         << " instead of " << single->GetBufferedRegion() << endl;
+    return 1;
+    }
+
+  if(batch->GetOrigin().EuclideanDistanceTo(single->GetOrigin()) > 1e-6
+     || batch->GetSpacing() != single->GetSpacing())
+    {
+    cerr << what << " ROI " << roi << ": origin " << batch->GetOrigin()
+         << " spacing " << batch->GetSpacing() << " instead of "
+         << single->GetOrigin() << " spacing " << single->GetSpacing() << endl;
+    return 1;
+    }
+
+  typedef itk::ImageRegionConstIterator<SpeedImageType> IteratorType;
+  IteratorType itBatch(batch, batch->GetBufferedRegion());
+  IteratorType itSingle(single, single->GetBufferedRegion());
+  int nDiff = 0;
+  for(; !itBatch.IsAtEnd(); ++itBatch, ++itSingle)
+    {
+    if(abs(itBatch.Get() - itSingle.Get()) > 1)
+      {
+      if(nDiff == 0)
+        cerr << what << " ROI " << roi << ": " << itBatch.Get() << " instead of "
+             << itSingle.Get() << " at " << itBatch.GetIndex() << endl;
+      nDiff++;
+      }
+    }
+
+  if(nDiff)
+    cerr << what << " ROI " << roi << ": " << nDiff << " voxels differ" << endl;
+  return nDiff ? 1 : 0;
+}
+
+// Compute the speed images for all the ROIs at once, then one at a time in
+// SNAP mode, and compare them
+int testMode(IRISApplication *app, const std::vector<SNAPSegmentationROISettings> &rois,
+             PreprocessingMode mode, const char *what)
+{
+  IRISApplication::SpeedImageList batch;
+  app->ComputeSpeedVolumesForROIs(rois, mode, batch);
+  if(batch.size() != rois.size())
+    {
+    cerr << what << ": " << batch.size() << " speed images for "
+         << rois.size() << " ROIs" << endl;
+    return 1;
+    }
+
+  int errors = 0;
+  for(unsigned int i = 0; i < rois.size(); i++)
+    {
+    app->InitializeSNAPImageData(rois[i]);
+    app->EnterPreprocessingMode(mode);
+    app->ApplyCurrentPreprocessingModeToSpeedVolume();
+
+    SpeedImageType *single = app->GetSNAPImageData()->GetSpeed()->GetImage();
+    errors += compareSpeed(batch[i], single, i, what);
+
+    app->EnterPreprocessingMode(PREPROCESS_NONE);
+    app->ReleaseSNAPImageData();
+    }
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2)
+    {
+    cerr << "Usage: " << argv[0] << " main_image" << endl;
+    return 1;
+    }
+
+  DummySystemInfoDelegate sidel(argv[0]);
+  SystemInterface::SetSystemInfoDelegate(&sidel);
+
+  SmartPtr<IRISApplication> app = IRISApplication::New();
+  IRISWarningList wl;
+  app->LoadImage(argv[1], MAIN_ROLE, wl);
+
+  // Regions that overlap, one that touches the edge of the image, the whole
+  // image, and regions that are resampled
+  Vector3ui size = app->GetIRISImageData()->GetMain()->GetSize();
+  std::vector<SNAPSegmentationROISettings> rois;
+  rois.push_back(makeROI(10, 20, 5, 30, 40, 20));
+  rois.push_back(makeROI(25, 35, 10, 30, 40, 20));
+  rois.push_back(makeROI(size[0] - 20, 0, size[2] - 16, 20, 24, 16));
+  rois.push_back(makeROI(0, 0, 0, size[0], size[1], size[2]));
+  rois.push_back(makeROI(5, 5, 5, 40, 40, 40, 0.5));
+  rois.push_back(makeROI(20, 30, 10, 20, 20, 20, 1.5));
+
+  // Threshold settings are shared by the batch and the SNAP mode filters
+  ScalarImageWrapperBase *scalar =
+      app->GetIRISImageData()->GetMain()->GetDefaultScalarRepresentation();
+  ThresholdSettings *ts =
+      dynamic_cast<ThresholdSettings *>(scalar->GetUserData("ThresholdSettings"));
+  if(!ts->GetInitialized())
+    ts->InitializeToDefaultForImage(scalar);
+
+  int errors = 0;
+  errors += testMode(app, rois, PREPROCESS_THRESHOLD, "Two-sided threshold");
+
+  // A one-sided threshold depends on the intensity range of the ROI
+  ts->SetThresholdMode(ThresholdSettings::LOWER);
+  errors += testMode(app, rois, PREPROCESS_THRESHOLD, "Lower threshold");
+  errors += testMode(app, rois, PREPROCESS_EDGE, "Edge");
+
+  if(errors)
+    {
+    cerr << errors << " speed images differ from SNAP mode" << endl;
+    return 1;
+    }
+
+  cout << "Batch speed image test passed" << endl;
+  return 0;
+}
@@ -0,0 +1,195 @@
+#include <iostream>
+#include <cstdio>
+#include <atomic>
+
+using namespace std;
+
+#include <itkImageFileWriter.h>
+#include <itkImageFileReader.h>
+#include <itkTimeProbe.h>
+#include "ThumbnailService.h"
+#include "UIReporterDelegates.h"
+#include "Registry.h"
+
+typedef ThumbnailService::ImageType ImageType;
+typedef ThumbnailService::PixelType PixelType;
+
+// Writes the thumbnails with ITK, and counts them
+class CountingSystemInfoDelegate : public SystemInfoDelegate
+{
+public:
+  CountingSystemInfoDelegate() : m_Writes(0) {}
+
+  virtual std::string GetApplicationDirectory() { return "."; }
+  virtual std::string GetApplicationFile() { return "ThumbnailServiceTest"; }
+  virtual std::string GetApplicationPermanentDataLocation() { return "."; }
+  virtual std::string GetUserDocumentsLocation() { return "."; }
+  virtual std::string EncodeServerURL(const std::string &url) { return url; }
+
+  virtual void LoadResourceAsImage2D(std::string tag, GrayscaleImage *image) {}
+  virtual void LoadResourceAsRegistry(std::string tag, Registry &reg) {}
+
+  virtual void WriteRGBAImage2D(std::string file, RGBAImageType *image)
+    {
+    typedef itk::ImageFileWriter<RGBAImageType> WriterType;
+    WriterType::Pointer writer = WriterType::New();
+    writer->SetInput(image);
+    writer->SetFileName(file.c_str());
+    writer->Update();
+    m_Writes++;
+    }
+
+  std::atomic<int> m_Writes;
+};
+
+// A display slice of a single color, like a large image would have
+SmartPtr<ImageType> makeSlice(unsigned char value)
+{
+  itk::ImageRegion<2> region;
+  region.SetSize(0, 512);
+  region.SetSize(1, 384);
+
+  SmartPtr<ImageType> slice = ImageType::New();
+  slice->SetRegions(region);
+  slice->Allocate();
+
+  unsigned char rgba[] = {value, value, value, 128};
+  slice->FillBuffer(PixelType(rgba));
+  return slice;
+}
+
+// The thumbnail must be square and opaque, with the slice color in the center
+bool checkThumbnail(ImageType *thumb, unsigned char value)
+{
+  if(!thumb || thumb->GetBufferedRegion().GetSize()[0] != 128
+     || thumb->GetBufferedRegion().GetSize()[1] != 128)
+    return false;
+
+  itk::Index<2> center = {{64, 64}};
+  PixelType p = thumb->GetPixel(center);
+  return p[0] == value && p[3] == 255;
+}
+
+std::string thumbFile(int i)
+{
+  return Registry::Key("ThumbnailServiceTest_%03d.png", i);
+}
+
+// Read a thumbnail from disk, bypassing the service
+SmartPtr<ImageType> readThumbnail(const std::string &file)
+{
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  SmartPtr<ReaderType> reader = ReaderType::New();
+  reader->SetFileName(file.c_str());
+  try
+    {
+    reader->Update();
+    }
+  catch(itk::ExceptionObject &)
+    {
+    return NULL;
+    }
+  SmartPtr<ImageType> thumb = reader->GetOutput();
+  return thumb;
+}
+
+int main(int argc, char *argv[])
+{
+  int nRequests = argc > 1 ? atoi(argv[1]) : 200;
+  const int nFiles = 20;
+  int errors = 0;
+
+  CountingSystemInfoDelegate delegate;
+  itk::TimeProbe tRequest, tFlush, tCached;
+
+  {
+    ThumbnailService service(&delegate);
+    service.SetCacheSize(8);
+
+    // Request thumbnails for a few files over and over, as when images are
+    // opened and closed back to back. Each request for a file has a different
+    // color, and the last request for each file wins
+    std::vector<unsigned char> lastValue(nFiles);
+    for(int i = 0; i < nRequests; i++)
+      {
+      int f = i % nFiles;
+      lastValue[f] = (unsigned char) ((f + nFiles * (i / nFiles)) % 256);
+      SmartPtr<ImageType> slice = makeSlice(lastValue[f]);
+
+      tRequest.Start();
+      service.RequestThumbnail(thumbFile(f), slice, 128);
+      tRequest.Stop();
+      }
+
+    // Thumbnails that have not been written yet are available
+    int last = (nRequests - 1) % nFiles;
+    if(!checkThumbnail(service.GetThumbnail(thumbFile(last)), lastValue[last]))
+      {
+      cerr << "Pending thumbnail is not available" << endl;
+      errors++;
+      }
+
+    tFlush.Start();
+    service.Flush();
+    tFlush.Stop();
+
+    // Duplicate requests are coalesced, but every file is written
+    if(delegate.m_Writes < nFiles || delegate.m_Writes > nRequests)
+      errors++;
+
+    // The file holds the thumbnail of the last request, whichever requests
+    // were coalesced or written before it
+    for(int i = 0; i < nFiles; i++)
+      if(!checkThumbnail(readThumbnail(thumbFile(i)), lastValue[i]))
+        {
+        cerr << "Thumbnail file " << i << " is not from the last request" << endl;
+        errors++;
+        }
+
+    // Read all the thumbnails back, most of them from disk since the cache
+    // is small, then the most recent ones from memory
+    for(int i = 0; i < nFiles; i++)
+      if(!checkThumbnail(service.GetThumbnail(thumbFile(i)), lastValue[i]))
+        {
+        cerr << "Thumbnail " << i << " is wrong" << endl;
+        errors++;
+        }
+
+    tCached.Start();
+    for(int k = 0; k < 100; k++)
+      for(int i = nFiles - 8; i < nFiles; i++)
+        if(!service.GetThumbnail(thumbFile(i)))
+          errors++;
+    tCached.Stop();
+
+    // A file that was never written
+    if(service.GetThumbnail("ThumbnailServiceTest_none.png"))
+      errors++;
+
+    // Requests made just before the service is destroyed are still written
+    delegate.m_Writes = 0;
+    service.RequestThumbnail(thumbFile(nFiles), makeSlice(0), 128);
+  }
+
+  if(delegate.m_Writes != 1)
+    {
+    cerr << "Thumbnail requested before exit was not written" << endl;
+    errors++;
+    }
+
+  cout << nRequests << " requests for " << nFiles << " thumbnails: request "
+       << tRequest.GetTotal() << " s, write " << tFlush.GetTotal()
+       << " s, 800 cached lookups " << tCached.GetTotal() << " s" << endl;
+
+  for(int i = 0; i <= nFiles; i++)
+    remove(thumbFile(i).c_str());
+
+  if(errors)
+    {
+    cerr << errors << " errors in thumbnail service" << endl;
+    return 1;
+    }
+
+  cout << "Thumbnail service test passed" << endl;
+  return 0;
+}
@@ -53,6 +53,11 @@
 #include "IRISApplication.h"
 #include "AffineTransformHelper.h"
 #include "itkTransform.h"
+#include "ImageIODelegates.h"
+#include "SliceMontageRenderer.h"
+#include "UIReporterDelegates.h"
+#include "SystemInterface.h"
+#include "itkImageFileWriter.h"
 
 #include "json/json.h"
 
@@ -123,6 +128,13 @@ int usage(int rc)
   cout << "                                      renaming with C printf pattern (e.g. 'left %s')" << endl;
   cout << "Annotation object commands" << endl;
   cout << "  -annot-list                       : List all annotations in the workspace" << endl;
+  cout << "Snapshot commands (render slices without a display)" << endl;
+  cout << "  -snap-tiles <view> <n>            : Add n evenly spaced slices of a view to the montage. The" << endl;
+  cout << "                                      view is axial|coronal|sagittal or 'all' for all three" << endl;
+  cout << "  -snap-slice <view> <index>        : Add a slice of a view (0-based index) to the montage" << endl;
+  cout << "  -snap-layout <ncols> [spacing]    : Set the number of columns and pixel spacing of the montage" << endl;
+  cout << "  -snap-montage <file>              : Render the montage to an image file (e.g., PNG), using the" << endl;
+  cout << "                                      color maps, contrast and labels of the workspace, and clear it" << endl;
   cout << "Distributed segmentation server (DSS) user commands: " << endl;
   cout << "  -dss-auth <url> [user] [passwd]   : Sign in to the server. This will create a token" << endl;
   cout << "                                      that may be used in future -dss calls" << endl;
@@ -338,6 +350,99 @@ int PrintTicketLog(int ticket_id, int id_start = 0)
 } 
 
 
+/**
+ * System information for the IRISApplication used to render snapshots. There
+ * is no GUI, so there are no resources to load
+ */
+class HeadlessSystemInfoDelegate : public SystemInfoDelegate
+{
+public:
+  HeadlessSystemInfoDelegate(const char *argv0)
+    : m_ExecutableName(argv0) {}
+
+  virtual std::string GetApplicationDirectory()
+    { return SystemTools::GetFilenamePath(m_ExecutableName); }
+
+  virtual std::string GetApplicationFile()
+    { return m_ExecutableName; }
+
+  virtual std::string GetApplicationPermanentDataLocation()
+    {
+    std::string home;
+    SystemTools::GetEnv("HOME", home);
+    return home + "/.itksnap.org/ITK-SNAP";
+    }
+
+  virtual std::string GetUserDocumentsLocation()
+    { return SystemTools::GetCurrentWorkingDirectory(); }
+
+  virtual std::string EncodeServerURL(const std::string &url)
+    { return url; }
+
+  virtual void LoadResourceAsImage2D(std::string tag, GrayscaleImage *image) {}
+  virtual void LoadResourceAsRegistry(std::string tag, Registry &reg) {}
+
+  virtual void WriteRGBAImage2D(std::string file, RGBAImageType *image)
+    {
+    typedef itk::ImageFileWriter<RGBAImageType> WriterType;
+    WriterType::Pointer writer = WriterType::New();
+    writer->SetInput(image);
+    writer->SetFileName(file.c_str());
+    writer->Update();
+    }
+
+protected:
+  std::string m_ExecutableName;
+};
+
+/**
+ * A request for slices in a snapshot montage. If n_slices is zero, the
+ * single slice 'slice' is requested
+ */
+struct SnapshotTileRequest
+{
+  AnatomicalDirection view;
+  int n_slices, slice;
+};
+
+AnatomicalDirection ParseSnapshotView(const string &view)
+{
+  if(view == "axial")
+    return ANATOMY_AXIAL;
+  else if(view == "coronal")
+    return ANATOMY_CORONAL;
+  else if(view == "sagittal")
+    return ANATOMY_SAGITTAL;
+
+  throw IRISException("Unknown view %s, expected axial, coronal or sagittal", view.c_str());
+}
+
+/**
+ * Load the workspace into an IRISApplication for rendering snapshots. The
+ * workspace is saved into a temporary directory first, since it may have been
+ * modified by earlier commands
+ */
+SmartPtr<IRISApplication> LoadWorkspaceForSnapshots(const WorkspaceAPI &ws, const char *argv0)
+{
+  static HeadlessSystemInfoDelegate delegate(argv0);
+  if(!SystemInterface::GetSystemInfoDelegate())
+    SystemInterface::SetSystemInfoDelegate(&delegate);
+
+  string tempdir = WorkspaceAPI::GetTempDirName();
+  SystemTools::MakeDirectory(tempdir);
+  string ws_file = tempdir + "/snapshot.itksnap";
+
+  WorkspaceAPI ws_copy = ws;
+  ws_copy.SaveAsXMLFile(ws_file.c_str());
+
+  SmartPtr<IRISApplication> app = IRISApplication::New();
+  IRISWarningList warnings;
+  app->OpenProject(ws_file, warnings);
+
+  SystemTools::RemoveADirectory(tempdir);
+  return app;
+}
+
 int main(int argc, char *argv[])
 {
   // There must be some commands!
@@ -369,6 +474,13 @@ int main(int argc, char *argv[])
   // TODO: implement this
   int context_ticket_id;
 
+  // Snapshot montage settings. The workspace is only loaded for rendering
+  // again if other commands were run since it was last loaded
+  std::vector<SnapshotTileRequest> snap_tiles;
+  int snap_columns = 4, snap_spacing = 2;
+  SmartPtr<IRISApplication> snap_app;
+  bool snap_app_stale = true;
+
   // Parse the commands in order
   while(!cl.is_at_end())
     {
@@ -699,6 +811,52 @@ int main(int argc, char *argv[])
         {
         ws.PrintAnnotationList(cout, prefix);
         }
+      else if(arg == "-snap-tiles" || arg == "-snap-slice")
+        {
+        string view = cl.read_string();
+        int value = cl.read_integer();
+        for(int d = 0; d < 3; d++)
+          {
+          SnapshotTileRequest req;
+          req.view = (view == "all") ? (AnatomicalDirection) d : ParseSnapshotView(view);
+          req.n_slices = (arg == "-snap-tiles") ? value : 0;
+          req.slice = (arg == "-snap-tiles") ? 0 : value;
+          snap_tiles.push_back(req);
+          if(view != "all")
+            break;
+          }
+        }
+      else if(arg == "-snap-layout")
+        {
+        snap_columns = cl.read_integer();
+        if(cl.command_arg_count() > 0)
+          snap_spacing = cl.read_integer();
+        }
+      else if(arg == "-snap-montage")
+        {
+        string fn = cl.read_output_filename();
+
+        if(!snap_app || snap_app_stale)
+          {
+          snap_app = LoadWorkspaceForSnapshots(ws, argv[0]);
+          snap_app_stale = false;
+          }
+
+        SmartPtr<SliceMontageRenderer> renderer = SliceMontageRenderer::New();
+        renderer->SetDriver(snap_app);
+        renderer->SetNumberOfColumns(snap_columns);
+        renderer->SetTileSpacing(snap_spacing);
+        for(unsigned int i = 0; i < snap_tiles.size(); i++)
+          {
+          if(snap_tiles[i].n_slices > 0)
+            renderer->AddEvenlySpacedTiles(snap_tiles[i].view, snap_tiles[i].n_slices);
+          else
+            renderer->AddTile(snap_tiles[i].view, snap_tiles[i].slice);
+          }
+
+        renderer->WriteMontage(fn.c_str());
+        snap_tiles.clear();
+        }
       else if(arg == "-dss-auth")
         {
         // Read the url of the server
@@ -1084,6 +1242,10 @@ int main(int argc, char *argv[])
       return -1;
       }
 
+    // Commands other than snapshot commands may change the workspace
+    if(arg.compare(0, 5, "-snap") != 0)
+      snap_app_stale = true;
+
     // Increment the command index
     cmd_index++;
     }